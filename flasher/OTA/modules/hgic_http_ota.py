@@ -2,11 +2,15 @@
 """HTTP OTA upload helpers.
 
 Implements the same flow as the web UI:
-  POST /api/ota_begin {size, crc32}
+  POST /api/ota_begin {size, crc32, fw_size, fw_crc32}
   POST /api/ota_chunk {off, b64}  (repeated)
   POST /api/ota_end   {crc32}
   POST /api/ota_write {}
 
+When the tar carries fw.bin the first chunk pass only verifies it. ota_end
+then answers {"program": true} and the chunks are sent once more; the
+firmware partition is written during that second pass.
+
 This module is intentionally UI-agnostic. Use callbacks for stage/progress.
 """
 
@@ -15,6 +19,8 @@ from __future__ import annotations
 import base64
 import json
 import subprocess
+import tarfile
+import io
 import time
 import urllib.error
 import urllib.request
@@ -171,6 +177,21 @@ def calc_crc32_u32(data: bytes) -> int:
     return int(zlib.crc32(data) & 0xFFFFFFFF)
 
 
+def find_fw_member(data: bytes) -> Optional[tuple[int, int]]:
+    """Length and CRC32 of the fw.bin member of the tar, None if absent."""
+
+    with tarfile.open(fileobj=io.BytesIO(data), mode="r:") as tf:
+        for m in tf.getmembers():
+            name = m.name
+            while name.startswith("./") or name.startswith("/"):
+                name = name[1:] if name.startswith("/") else name[2:]
+            if name == "fw.bin" and m.isfile():
+                f = tf.extractfile(m)
+                fw = f.read() if f else b""
+                return len(fw), calc_crc32_u32(fw)
+    return None
+
+
 def upload_ota_file_http(
     ip: str,
     ota_path: Path | str,
@@ -199,49 +220,62 @@ def upload_ota_file_http(
     crc = calc_crc32_u32(data)
     stage(f"CRC32 = 0x{crc:08x}")
 
+    begin: dict[str, Any] = {"size": len(data), "crc32": crc}
+    fw = find_fw_member(data)
+    if fw is not None:
+        begin["fw_size"], begin["fw_crc32"] = fw
+        stage(f"fw.bin {fw[0]} bytes, CRC32 = 0x{fw[1]:08x}")
+
     stage("Starting OTA session...")
     _post_json_retry(
         base + "/api/ota_begin",
-        {"size": len(data), "crc32": crc},
+        begin,
         tries=cfg.tries,
         base_delay_ms=cfg.base_delay_ms,
         timeout_s=cfg.timeout_s,
     )
 
-    stage("Uploading OTA file...")
-    off = 0
-    t0 = time.time()
-    total = len(data)
-
-    while off < total:
-        nxt = min(off + int(cfg.chunk_size), total)
-        chunk = data[off:nxt]
-        b64 = base64.b64encode(chunk).decode("ascii")
-
-        _post_json_retry(
-            base + "/api/ota_chunk",
-            {"off": int(off), "b64": b64},
+    def send_all() -> dict[str, Any]:
+        off = 0
+        t0 = time.time()
+        total = len(data)
+
+        while off < total:
+            nxt = min(off + int(cfg.chunk_size), total)
+            chunk = data[off:nxt]
+            b64 = base64.b64encode(chunk).decode("ascii")
+
+            _post_json_retry(
+                base + "/api/ota_chunk",
+                {"off": int(off), "b64": b64},
+                tries=cfg.tries,
+                base_delay_ms=cfg.base_delay_ms,
+                timeout_s=cfg.timeout_s,
+            )
+
+            off = nxt
+
+            if progress_cb:
+                elapsed = time.time() - t0
+                speed = off / elapsed if elapsed > 0 else 0.0
+                progress_cb(off, total, speed)
+
+        return _post_json_retry(
+            base + "/api/ota_end",
+            {"crc32": crc},
             tries=cfg.tries,
             base_delay_ms=cfg.base_delay_ms,
             timeout_s=cfg.timeout_s,
         )
 
-        off = nxt
+    stage("Uploading OTA file..." if fw is None else "Uploading OTA file for verification...")
+    r = send_all()
 
-        if progress_cb:
-            elapsed = time.time() - t0
-            speed = off / elapsed if elapsed > 0 else 0.0
-            progress_cb(off, total, speed)
-
-    _post_json_retry(
-        base + "/api/ota_end",
-        {"crc32": crc},
-        tries=cfg.tries,
-        base_delay_ms=cfg.base_delay_ms,
-        timeout_s=cfg.timeout_s,
-    )
+    if r.get("program"):
+        stage("Verified. Uploading again to write firmware to flash...")
+        send_all()
 
-    stage("Writing firmware to flash...")
+    stage("Applying update...")
     _post_json_retry(
         base + "/api/ota_write",
         {"write": True},
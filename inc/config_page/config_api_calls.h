@@ -3,40 +3,51 @@
 
 #include <stdint.h>
 #include "cJSON.h"
+#include "config_page/json_writer.h"
 
 void web_api_notify_change( void );
 uint32_t web_api_change_version( void );
 
-int32_t web_api_heartbeat_get( const cJSON *in, cJSON *out );
-int32_t web_api_ok_get( const cJSON *in, cJSON *out );
+int32_t web_api_heartbeat_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_ok_get( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_halow_cfg_get( const cJSON *in, cJSON *out );
-int32_t web_api_halow_cfg_post( const cJSON *in, cJSON *out );
+int32_t web_api_halow_cfg_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_halow_cfg_post( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_net_cfg_get( const cJSON *in, cJSON *out );
-int32_t web_api_net_cfg_post( const cJSON *in, cJSON *out );
+int32_t web_api_net_cfg_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_net_cfg_post( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_tcp_server_cfg_get( const cJSON *in, cJSON *out );
-int32_t web_api_tcp_server_cfg_post( const cJSON *in, cJSON *out );
+int32_t web_api_tcp_server_cfg_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_tcp_server_cfg_post( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_lbt_cfg_get( const cJSON *in, cJSON *out );
-int32_t web_api_lbt_cfg_post( const cJSON *in, cJSON *out );
+int32_t web_api_udp_server_cfg_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_udp_server_cfg_post( const cJSON *in, json_writer_t *out );
+int32_t web_api_bridge_cfg_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_bridge_cfg_post( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_dev_stat_get( const cJSON *in, cJSON *out );
-int32_t web_api_radio_stat_get( const cJSON *in, cJSON *out );
-int32_t web_api_radio_stat_post( const cJSON *in, cJSON *out );
+int32_t web_api_lbt_cfg_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_lbt_cfg_post( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_online_ota_get( const cJSON *in, cJSON *out );
-int32_t web_api_online_ota_post( const cJSON *in, cJSON *out );
+int32_t web_api_dev_stat_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_radio_stat_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_radio_stat_post( const cJSON *in, json_writer_t *out );
+int32_t web_api_link_stat_get( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_stat_get( const cJSON *in, cJSON *out );
-int32_t web_api_all_get( const cJSON *in, cJSON *out );
+int32_t web_api_online_ota_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_online_ota_post( const cJSON *in, json_writer_t *out );
 
-int32_t web_api_stat_reset( const cJSON *in, cJSON *out );
-int32_t web_api_ota_begin_post( const cJSON *in, cJSON *out );
-int32_t web_api_ota_chunk_post( const cJSON *in, cJSON *out );
-int32_t web_api_ota_end_post( const cJSON *in, cJSON *out );
-int32_t web_api_ota_write_post( const cJSON *in, cJSON *out );
-int32_t web_api_reboot_post( const cJSON *in, cJSON *out );
+int32_t web_api_stat_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_all_get( const cJSON *in, json_writer_t *out );
+
+int32_t web_api_stat_reset( const cJSON *in, json_writer_t *out );
+int32_t web_api_ota_begin_post( const cJSON *in, json_writer_t *out );
+int32_t web_api_ota_chunk_post( const cJSON *in, json_writer_t *out );
+int32_t web_api_ota_end_post( const cJSON *in, json_writer_t *out );
+int32_t web_api_ota_status_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_ota_write_post( const cJSON *in, json_writer_t *out );
+int32_t web_api_json_bench_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_flash_bench_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_fec_bench_get( const cJSON *in, json_writer_t *out );
+int32_t web_api_reboot_post( const cJSON *in, json_writer_t *out );
 
 #endif // __CONFIG_API_CALLS_H__
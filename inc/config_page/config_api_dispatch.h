@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "cJSON.h"
+#include "config_page/json_writer.h"
 
 #define WEB_API_RC_OK                 (0)
 #define WEB_API_RC_BAD_REQUEST        (-400)
@@ -14,6 +15,6 @@
 int32_t web_api_dispatch( const char *method,
                           const char *uri,
                           const cJSON *in_json,
-                          cJSON *out_json );
+                          json_writer_t *out );
 
 #endif /* __CONFIG_API_DISPATCH_H__ */
@@ -0,0 +1,63 @@
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Streaming JSON emitter for the web API responses.
+ *
+ * Writes straight into a caller supplied buffer, no heap is used. Without a
+ * flush callback the document must fit in the buffer, otherwise `overflow` is
+ * set and the rest is dropped. With a callback the buffer is handed out every
+ * time it fills up, so documents of any size can go directly to a socket.
+ *
+ * `key` is the member name inside an object and NULL inside an array or for
+ * the root value.
+ *
+ * In tree mode (json_writer_init_tree) the same calls build a cJSON tree with
+ * cJSON_AddItemTo* instead, so /api/json_bench can compare against the tree
+ * based responses using the very same handlers.
+ */
+
+#define JSON_WRITER_MAX_DEPTH   (16)
+
+struct cJSON;
+
+typedef int32_t (*json_writer_flush_cb)(void *arg, const char *data, uint32_t len);
+
+typedef struct {
+    char                *buf;
+    uint32_t             size;
+    uint32_t             len;
+    uint32_t             total;         // bytes emitted incl. flushed ones
+    json_writer_flush_cb flush_cb;
+    void                *flush_arg;
+    struct cJSON       **tree;          // tree mode: open containers per depth, NULL otherwise
+    uint16_t             first;         // bit n: nothing written yet at depth n
+    uint8_t              depth;
+    bool                 overflow;
+} json_writer_t;
+
+void json_writer_init( json_writer_t *jw, char *buf, uint32_t size,
+                       json_writer_flush_cb flush_cb, void *flush_arg );
+/* stack holds JSON_WRITER_MAX_DEPTH entries, stack[0] receives the root */
+void json_writer_init_tree( json_writer_t *jw, struct cJSON **stack );
+void json_writer_reset( json_writer_t *jw );
+/* Flushes what is buffered; returns the document length or -1 on overflow */
+int32_t json_writer_finish( json_writer_t *jw );
+
+void json_obj_begin( json_writer_t *jw, const char *key );
+void json_obj_end( json_writer_t *jw );
+void json_arr_begin( json_writer_t *jw, const char *key );
+void json_arr_end( json_writer_t *jw );
+
+void json_add_str( json_writer_t *jw, const char *key, const char *s );
+void json_add_int( json_writer_t *jw, const char *key, int64_t v );
+void json_add_bool( json_writer_t *jw, const char *key, bool v );
+void json_add_null( json_writer_t *jw, const char *key );
+/* Shortest of %.{prec}g, integers come out without a fraction */
+void json_add_num( json_writer_t *jw, const char *key, double v, int prec );
+
+#endif // __JSON_WRITER_H__
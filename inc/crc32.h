@@ -0,0 +1,36 @@
+#ifndef __CRC32_H_
+#define __CRC32_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * CRC-32 (IEEE 802.3, reflected, init/xorout 0xFFFFFFFF), same value as
+ * zlib crc32(). All functions take and return the finalized CRC, so a
+ * running value can be passed straight back in: crc = crc32_update(crc, ...)
+ * starting from 0.
+ */
+
+typedef struct {
+    uint32_t crc;
+    uint16_t cookie;    // HW engine hold cookie
+    bool     hw;        // engine held for this stream
+    bool     hw_started;
+} crc32_stream_t;
+
+/* Software, table driven. Safe from any context. */
+uint32_t crc32_update(uint32_t crc, const void *data, uint32_t len);
+
+/* One shot over a RAM buffer; uses the CRC engine for large buffers. */
+uint32_t crc32_calc(const void *data, uint32_t len);
+
+/*
+ * Streaming with the CRC engine held between updates. Meant for synchronous
+ * loops (e.g. verifying a file); falls back to software when the engine is
+ * busy or fails. Data must be in RAM.
+ */
+void crc32_stream_begin(crc32_stream_t *s);
+void crc32_stream_update(crc32_stream_t *s, const void *data, uint32_t len);
+uint32_t crc32_stream_end(crc32_stream_t *s);
+
+#endif // __CRC32_H_
@@ -0,0 +1,72 @@
+#ifndef __DEFRAMER_H_
+#define __DEFRAMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Streaming frame splitter for the TCP modem byte stream.
+ *
+ * Frames are emitted verbatim (opening and closing delimiter included, escapes
+ * untouched), so the far side receives exactly what the host wrote and can
+ * decode it with its own KISS/HDLC parser. A frame is emitted as a list of
+ * pieces pointing into the fed segments, one piece when it is fully contained
+ * in one segment. Only the part of a frame still open when deframer_feed*()
+ * returns is copied into the caller supplied buffer, it comes out as the
+ * first piece once the frame closes.
+ */
+
+#define DEFRAMER_KISS_FEND      0xC0
+#define DEFRAMER_KISS_FESC      0xDB
+#define DEFRAMER_HDLC_FLAG      0x7E
+
+#define DEFRAMER_KISS_CMD_DATA  0x00
+#define DEFRAMER_KISS_CMD_MASK  0x0F
+
+typedef enum {
+    DEFRAMER_MODE_AUTO = 0,     // Lock on the first byte of the stream
+    DEFRAMER_MODE_KISS,         // FEND delimited, command byte after FEND
+    DEFRAMER_MODE_HDLC,         // 0x7E delimited (Reticulum TCP interface default)
+    DEFRAMER_MODE_RAW,          // No framing, split into raw_max chunks
+} deframer_mode_t;
+
+#define DEFRAMER_SEGS_MAX       8           // Pieces of an open frame held by reference, more are copied
+#define DEFRAMER_FRAME_SEGS_MAX (DEFRAMER_SEGS_MAX + 2)     // Buffered head + held pieces + closing piece
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+} deframer_seg_t;
+
+/* cnt <= DEFRAMER_FRAME_SEGS_MAX pieces, len bytes in total */
+typedef void (*deframer_frame_cb)(void *arg, const deframer_seg_t *seg, uint32_t cnt, uint32_t len);
+typedef void (*deframer_cmd_cb)(void *arg, uint8_t cmd, const uint8_t *data, uint32_t len);
+
+typedef struct {
+    deframer_mode_t   mode_cfg;
+    deframer_mode_t   mode;
+    bool              synced;       // Delimiter seen, bytes belong to a frame
+    bool              discard;      // Current frame overflowed, drop until delimiter
+    uint8_t          *buf;
+    uint32_t          buf_size;
+    uint32_t          buf_len;
+    uint32_t          raw_max;      // Chunk size in raw mode
+
+    deframer_frame_cb frame_cb;
+    deframer_cmd_cb   cmd_cb;
+    void             *cb_arg;
+
+    uint32_t          frames;
+    uint32_t          commands;
+    uint32_t          dropped;
+} deframer_t;
+
+/* raw_max: chunk size of the raw mode, 0 or more than buf_size means buf_size */
+void deframer_init(deframer_t *d, deframer_mode_t mode, uint8_t *buf, uint32_t buf_size,
+                   uint32_t raw_max, deframer_frame_cb frame_cb, deframer_cmd_cb cmd_cb, void *arg);
+void deframer_reset(deframer_t *d);
+void deframer_feed(deframer_t *d, const uint8_t *data, uint32_t len);
+/* Consecutive stream segments, all valid until the call returns, e.g. a pbuf chain */
+void deframer_feed_segs(deframer_t *d, const deframer_seg_t *seg, uint32_t cnt);
+
+#endif // __DEFRAMER_H_
@@ -0,0 +1,41 @@
+#ifndef __FAL_NORFLASH_PORT_H__
+#define __FAL_NORFLASH_PORT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    FAL_NOR_READ_NORMAL = 0,    // 0x03 single wire
+    FAL_NOR_READ_DUAL,          // 0x3B dual output
+    FAL_NOR_READ_QUAD,          // 0x6B quad output
+} fal_norflash_read_mode_t;
+
+typedef struct {
+    uint32_t writes;        // write() calls through FAL
+    uint32_t loads;         // sector images read into the cache
+    uint32_t flushes;       // dirty sector write-backs
+    uint32_t erases;        // write-backs that needed a sector erase
+    uint32_t erase_skips;   // write-backs programmed without erase
+} fal_norflash_stat_t;
+
+typedef struct {
+    fal_norflash_read_mode_t mode;
+    bool     dma;
+    uint32_t bytes;
+    uint32_t time_us;
+    uint32_t kbps;          // measured, KiB/s
+    uint32_t model_kbps;    // bus-limited estimate for the same transfer, KiB/s
+} fal_norflash_bench_t;
+
+/* Write back the cached sector. Call before anything that must survive a reset. */
+int32_t fal_norflash_flush(void);
+void fal_norflash_stat_get(fal_norflash_stat_t *stat);
+
+/* Read with the probed bus mode, DMA for bulk transfers. Flash must be opened. */
+void fal_norflash_spi_read(uint32_t addr, uint8_t *buf, uint32_t size);
+fal_norflash_read_mode_t fal_norflash_read_mode_get(void);
+const char *fal_norflash_read_mode_name(fal_norflash_read_mode_t mode);
+/* Times 64 KiB reads per mode (PIO/DMA). Returns number of entries filled. */
+int32_t fal_norflash_bench(fal_norflash_bench_t *res, uint32_t max);
+
+#endif // __FAL_NORFLASH_PORT_H__
@@ -4,26 +4,88 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-struct hgic_rx_info;
+/* Link metrics of one received frame, taken from the LMAC RX descriptor */
+typedef struct {
+    uint8_t  src[6];        // Transmitter address (addr2) of the sender
+    int8_t   signal;        // dBm
+    int8_t   evm;           // dB
+    int16_t  freq_off;      // Carrier offset as reported by the LMAC
+    uint8_t  mcs;
+    uint8_t  bw;            // MHz
+} halow_rx_meta_t;
 
 typedef void (*halow_rx_cb)(
-    struct hgic_rx_info *info,
+    const halow_rx_meta_t *meta,
     const uint8_t *data,
     int32_t len);
 
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+} halow_iov_t;
+
+typedef enum {
+    HALOW_TXQ_POLICY_BACKPRESSURE = 0,  // Caller waits until the TX task frees space, never from the tcpip thread
+    HALOW_TXQ_POLICY_DROP_NEW,          // New frame is rejected (default)
+    HALOW_TXQ_POLICY_DROP_OLDEST,       // Oldest queued frame is discarded
+} halow_txq_policy_t;
+
+typedef struct {
+    uint32_t frames;        // Currently queued
+    uint32_t bytes;         // Currently queued
+    uint32_t max_frames;    // High watermark
+    uint32_t queued;
+    uint32_t dropped;
+    uint32_t lmac_err;
+} halow_txq_stat_t;
+
+/* Software aggregation: several queued frames sent as one over-the-air frame */
+typedef struct {
+    uint32_t tx_aggregates;
+    uint32_t tx_subframes;  // Frames sent inside aggregates
+    uint32_t rx_aggregates;
+    uint32_t rx_subframes;
+    uint32_t rx_errors;     // Malformed aggregates, the rest is dropped
+} halow_agg_stat_t;
+
+/* Forward error correction over blocks of frames, see halow_fec.h */
+typedef struct {
+    uint32_t tx_blocks;
+    uint32_t tx_parity;     // Parity frames sent
+    uint32_t rx_blocks;
+    uint32_t rx_lost;       // Data frames missing from received blocks
+    uint32_t rx_recovered;  // ... restored from parity and delivered
+    uint32_t rx_unrecovered;
+    uint32_t rx_errors;     // Malformed FEC frames
+    uint16_t loss_permille; // Frame loss from other senders, by sequence gaps
+    uint8_t  parity_now;    // Parity frames per block at the moment, 0: FEC off
+} halow_fec_stat_t;
+
 typedef struct {
     uint16_t central_freq;
     uint8_t bandwidth;
     uint8_t mcs;
     uint8_t rf_power;
     uint8_t rf_super_power;
+    uint16_t agg_max;       // Aggregate payload limit in bytes, 0: aggregation off
+    uint8_t agg_hold_ms;    // How long a lone frame waits for company
+    uint8_t fec_k;          // Data frames per FEC block, 0: FEC off
+    uint8_t fec_m;          // Parity frames per block, 0: adaptive to the observed loss
+    uint8_t fec_hold_ms;    // How long an open block waits for more frames
 } halow_config_t;
 
 bool halow_init(uint32_t rxbuf, uint32_t rxbuf_size,
                 uint32_t tdma_buf, uint32_t tdma_buf_size);
 
 void halow_set_rx_cb(halow_rx_cb cb);
+void halow_set_addr(const uint8_t addr[6]);
 int32_t halow_tx(const uint8_t *data, uint32_t len);
+int32_t halow_tx_iov(const halow_iov_t *iov, uint32_t cnt);
+int32_t halow_tx_iov_wait(const halow_iov_t *iov, uint32_t cnt, uint32_t wait_ms);
+halow_txq_stat_t halow_txq_stat_get(void);
+halow_agg_stat_t halow_agg_stat_get(void);
+halow_fec_stat_t halow_fec_stat_get(void);
+uint32_t halow_airtime_us(uint32_t mpdu_len);
 void halow_config_load(halow_config_t *cfg);
 void halow_config_save(const halow_config_t *cfg);
 void halow_config_apply(const halow_config_t *cfg);
@@ -0,0 +1,64 @@
+#ifndef __HALOW_BRIDGE_H_
+#define __HALOW_BRIDGE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/netif.h"
+#include "lwip/ip4_addr.h"
+
+/*
+ * Layer 2 operating mode: the Ethernet port and the radio are the two ports
+ * of an lwIP bridge (bridgeif) with a learning forwarding database, and every
+ * Ethernet frame goes on air as one radio frame. The device's own IP stack
+ * sits on the bridge interface. The mode owns the radio, the modem transports
+ * (TCP/UDP) do not transmit while it is active.
+ *
+ * Frames towards the radio wait in a queue bounded by the airtime it holds,
+ * frames older than twice that bound are dropped instead of being sent late.
+ * Broadcast and multicast frames are limited to bcast_pps per second.
+ */
+
+typedef int32_t (*halow_bridge_tx_cb_t)(const uint8_t *data, uint32_t len);
+
+typedef struct {
+    bool enabled;               // Takes effect after a reboot
+    uint16_t bcast_pps;         // Group addressed frames per second to the radio, 0: unlimited
+    uint16_t queue_ms;          // Airtime the radio queue may hold
+} halow_bridge_config_t;
+
+typedef struct {
+    uint32_t tx_frames;         // Ethernet -> radio
+    uint32_t tx_bytes;
+    uint32_t rx_frames;         // Radio -> Ethernet
+    uint32_t rx_bytes;
+    uint32_t drop_bcast;        // Over the broadcast/multicast rate
+    uint32_t drop_airtime;      // Queue already holds queue_ms of airtime
+    uint32_t drop_full;         // Queue memory exhausted
+    uint32_t drop_late;         // Waited longer than 2 * queue_ms
+    uint32_t drop_size;         // Runt or oversized frame
+    uint32_t rx_drop;           // Radio frame not accepted by the stack
+    uint32_t queued_us;         // Airtime currently queued
+} halow_bridge_stat_t;
+
+/* Last lwiperf session (TCP port 5001) */
+typedef struct {
+    bool valid;
+    bool ok;                    // Finished, not aborted
+    ip4_addr_t remote;
+    uint32_t bytes;
+    uint32_t ms;
+    uint32_t kbps;
+} halow_bridge_iperf_t;
+
+/* Bridge netif when the mode is enabled and set up, NULL otherwise */
+struct netif *halow_bridge_init(struct netif *eth, const uint8_t mac[6], halow_bridge_tx_cb_t cb);
+bool halow_bridge_active(void);
+void halow_bridge_input(const uint8_t *data, int32_t len);
+void halow_bridge_config_load(halow_bridge_config_t *cfg);
+void halow_bridge_config_save(const halow_bridge_config_t *cfg);
+void halow_bridge_config_apply(const halow_bridge_config_t *cfg);
+halow_bridge_stat_t halow_bridge_stat_get(void);
+halow_bridge_iperf_t halow_bridge_iperf_get(void);
+
+#endif //__HALOW_BRIDGE_H_
@@ -0,0 +1,46 @@
+#ifndef __HALOW_FEC_H_
+#define __HALOW_FEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Systematic erasure code over GF(2^8): a block of k data symbols is sent as
+ * is, followed by m parity symbols, and any k of the k + m symbols restore the
+ * block. Parity row j is sum_i c(j, i) * data_i with the Cauchy coefficients
+ * c(j, i) = 1 / (x_j + y_i), so every square submatrix is invertible.
+ * Symbols of one block have the same length, shorter ones are zero padded.
+ */
+
+#define HALOW_FEC_K_MAX     8
+#define HALOW_FEC_M_MAX     4
+
+typedef struct {
+    uint8_t  k;
+    uint8_t  m;
+    uint16_t sym_len;
+    uint32_t enc_us;        // one block, all m parity symbols
+    uint32_t dec_us;        // one block with m data symbols erased
+    uint32_t enc_kbps;      // data bytes per second, KiB/s
+    uint32_t dec_kbps;
+    bool     ok;            // decoded symbols match the originals
+} halow_fec_bench_t;
+
+void halow_fec_init(void);
+
+/* parity ^= c(row, idx) * sym, parity starts zeroed */
+void halow_fec_encode(uint8_t *parity, uint32_t row, uint32_t idx, const uint8_t *sym, uint32_t len);
+
+/*
+ * Restores the data symbols missing from `have` (bit i: data[i] holds symbol
+ * i) using the parity rows in `par_have`. Every data[] entry, present or not,
+ * points to len bytes. The parity buffers are used as scratch.
+ * Returns the number of symbols restored, -1 when there is not enough parity.
+ */
+int32_t halow_fec_decode(uint8_t *const data[], uint32_t k, uint32_t have,
+                         uint8_t *const parity[], uint32_t par_have, uint32_t len);
+
+/* Encodes and decodes k = HALOW_FEC_K_MAX blocks for m = 1, 2, 4. Returns number of entries filled. */
+int32_t halow_fec_bench(halow_fec_bench_t *res, uint32_t max);
+
+#endif // __HALOW_FEC_H_
@@ -7,9 +7,9 @@ typedef struct {
     // LBT control
     uint8_t  lbt_enabled;                 // 0 = disabled, 1 = enabled
 
-    // Noise sampling
-    uint16_t noise_short_window_samples;  // Short-term window size (samples)
-    uint16_t noise_long_window_samples;   // Long-term window size (samples)
+    // Noise sampling, ~4.4k samples/s: bursts of HALOW_LBT_SAMPLER_BATCH, then >= 1 ms sleep
+    uint16_t noise_short_window_samples;  // Short-term window size (samples), 256 ~ 58 ms
+    uint16_t noise_long_window_samples;   // Long-term window size (short averages), 256 ~ 15 s
     uint8_t  noise_long_low_percent;      // Lowest X% of long-term samples used as background reference
 
     // Noise thresholds
@@ -31,14 +31,20 @@ typedef struct {
     uint16_t util_bucket_capacity_ms;     // Maximum accumulated TX airtime (burst size)
 } halow_lbt_config_t;
 
+// Blocks until the airtime limiter allows airtime_us more on-air time and charges it
+void halow_lbt_wait_tx_allowed(uint32_t airtime_us);
+// Blocks until listen-before-talk considers the channel free
+void halow_lbt_wait_channel_clear(void);
 // Call on tx complete for reset timer
-void halow_lbt_wait_tx_allowed(void);
 void halow_lbt_set_tx_as_active(void);
 void halow_lbt_set_tx_as_deactive(void);
+// Adds the on-air time of a completed frame to the airtime statistics
+void halow_lbt_airtime_charge(uint32_t airtime_us);
 float halow_lbt_ch_util_get(void);
 float halow_lbt_airtime_get(void);
 int8_t halow_lbt_background_short_dbm_get( void );
 int8_t halow_lbt_background_long_dbm_get( void );
+float halow_lbt_sampler_load_get( void );
 void halow_lbt_config_save( const halow_lbt_config_t *cfg );
 void halow_lbt_config_apply( const halow_lbt_config_t *cfg );
 void halow_lbt_config_load( halow_lbt_config_t *cfg );
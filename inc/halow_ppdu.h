@@ -0,0 +1,24 @@
+#ifndef __HALOW_PPDU_H_
+#define __HALOW_PPDU_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    HALOW_PREAMBLE_S1G_1M = 0,      // 1 MHz PPDU
+    HALOW_PREAMBLE_S1G_SHORT,       // >= 2 MHz, SU
+    HALOW_PREAMBLE_S1G_LONG,        // >= 2 MHz, MU/beamformed SU
+} halow_preamble_t;
+
+typedef struct {
+    uint8_t          mcs;           // 0..7, 10
+    uint8_t          bandwidth;     // 1, 2, 4, 8 MHz
+    uint8_t          nss;           // Spatial streams, 1..4
+    halow_preamble_t preamble;
+    bool             short_gi;      // Data symbols only, preamble always uses long GI
+} halow_ppdu_param_t;
+
+// On-air duration of a PPDU carrying psdu_len bytes (MPDU including FCS)
+uint32_t halow_ppdu_duration_us(const halow_ppdu_param_t *p, uint32_t psdu_len);
+
+#endif // __HALOW_PPDU_H_
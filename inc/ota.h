@@ -13,6 +13,23 @@ uint32_t ota_lfs_write( uint32_t off, const void *data, uint32_t len );
 uint32_t ota_lfs_end( void );
 int32_t ota_lfs_upgrade_from_tar( void );
 
+typedef struct {
+    bool     active;
+    bool     committed;
+    bool     programming;  // verify pass done, resend the tar to program fw.bin
+    uint32_t size;
+    uint32_t written;      // resume offset
+} ota_stream_status_t;
+
+/* Streaming tar: fw.bin to the OTA partition, other members to littlefs.
+ * With fw_size != 0 the tar is sent twice: a verify pass, then a program pass. */
+int32_t ota_stream_begin( uint32_t total_size, uint32_t expect_crc32,
+                          uint32_t fw_size, uint32_t fw_crc32 );
+int32_t ota_stream_write( uint32_t off, const void *data, uint32_t len );
+int32_t ota_stream_end( void );
+bool ota_stream_take_committed( void );
+void ota_stream_status( ota_stream_status_t *st );
+
 int32_t ota_reset_to_default(void);
 int32_t ota_write_firmware_from_file( void );
 
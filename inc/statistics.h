@@ -1,6 +1,8 @@
 #ifndef __STATISTICS_H__
 #define __STATISTICS_H__
 
+#include "halow.h"
+
 typedef struct{
     uint64_t rx_bytes;
     uint64_t tx_bytes;
@@ -14,10 +16,26 @@ typedef struct{
     float ch_util;
 } statistics_radio_t;
 
+/* Rolling link quality of one sender, averages are EWMA in 1/16 units */
+typedef struct {
+    uint8_t  addr[6];
+    uint32_t frames;
+    uint64_t bytes;
+    uint32_t age_ms;        // Since the last frame
+    int16_t  signal_avg;    // dBm * 16
+    int16_t  evm_avg;       // dB * 16
+    int32_t  freq_off_avg;  // LMAC units * 16
+    int8_t   signal_min;
+    int8_t   signal_max;
+    halow_rx_meta_t last;
+} statistics_link_t;
+
 void statistics_uptime_get(char* return_str, uint32_t max_len);
 void statistics_radio_register_rx_package(uint32_t len);
 void statistics_radio_register_tx_package(uint32_t len);
 void statistics_radio_reset(void);
+void statistics_link_register_rx(const halow_rx_meta_t *meta, uint32_t len);
+uint32_t statistics_link_get(statistics_link_t *out, uint32_t max);
 statistics_radio_t statistics_radio_get(void);
 int32_t statistics_init(void);
 
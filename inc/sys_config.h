@@ -14,7 +14,12 @@
 //#define TCPIP_MBOX_SIZE              32
 //#define DEFAULT_TCP_RECVMBOX_SIZE    32
 //#define DEFAULT_ACCEPTMBOX_SIZE      8
-//#define MEMP_NUM_TCP_PCB         16
+// modem clients + config page workers + one spare for TIME_WAIT/refused peers
+#define MEMP_NUM_TCP_PCB         (TCP_SERVER_MAX_CLIENTS + CONFIG_PAGE_HTTP_WORKERS + 2)   // + lwiperf, spare
+#define MEMP_NUM_TCP_PCB_LISTEN  3      // modem, web page, lwiperf (bridge mode)
+#define MEMP_NUM_UDP_PCB         6      // DHCP, DNS, TFTP, modem UDP + spare
+#define MEMP_NUM_SYS_TIMEOUT     12     // lwIP timers + bridge FDB ageing
+#define LWIP_NUM_NETIF_CLIENT_DATA 1    // bridgeif port lookup
 //#define MEMP_NUM_TCP_PCB_LISTEN  16
 //#define DEFAULT_RAW_RECVMBOX_SIZE 8
 //#define MEMP_NUM_NETBUF 8
@@ -74,10 +79,18 @@
 #define HALOW_CONFIG_BANDWIDTH_DEF    (1)
 #define HALOW_CONFIG_MCS_DEF          (0)
 #define HALOW_CONFIG_SPOWER_EN_DEF    (false)
+#define HALOW_CONFIG_AGG_MAX_DEF      (0)       // aggregate payload bytes, 0: off (older firmware cannot split)
+#define HALOW_CONFIG_AGG_HOLD_MS_DEF  (5)
+#define HALOW_CONFIG_FEC_K_DEF        (0)       // data frames per block, 0: off (older firmware cannot decode)
+#define HALOW_CONFIG_FEC_M_DEF        (0)       // parity frames per block, 0: adaptive
+#define HALOW_CONFIG_FEC_HOLD_MS_DEF  (50)
+#define HALOW_FEC_PAYLOAD_MAX         (HALOW_MTU)   // larger frames are sent without FEC
+#define HALOW_FEC_RX_PEERS            (2)       // senders decoded at once, ~6 KiB each
+#define HALOW_TX_WAIT_MS              (1000)    // longest a sending task waits for TX queue space
 
 #define HALOW_LBT_CONFIG_EN_DEF                 (true)
-#define HALOW_LBT_CONFIG_NSWS_DEF               (256)
-#define HALOW_LBT_CONFIG_NLWS_DEF               (256)
+#define HALOW_LBT_CONFIG_NSWS_DEF               (256)     // ~58 ms at the sampler's ~4.4k samples/s
+#define HALOW_LBT_CONFIG_NLWS_DEF               (256)     // short averages, ~15 s
 #define HALOW_LBT_CONFIG_NLLP_DEF               (20)
 #define HALOW_LBT_CONFIG_NRO_DEF                (10)
 #define HALOW_LBT_CONFIG_NAB_DEF                (-75)
@@ -89,6 +102,7 @@
 #define HALOW_LBT_CONFIG_UTIL_MAX_DEF           (50)
 #define HALOW_LBT_CONFIG_UTIL_REFILL_MS_DEF     (1000)
 #define HALOW_LBT_CONFIG_UTIL_BUCKET_MS_DEF     (200)
+#define HALOW_LBT_MAX_DEFER_MS                  (1000)  // Give up deferring to a busy channel after this
 
 #define TCP_SERVER_PORT               (8001)
 #define TCP_SERVER_MTU                (TCP_MSS)
@@ -97,17 +111,47 @@
 #define TCP_SERVER_CONFIG_PORT_DEF                  (8001)
 #define TCP_SERVER_CONFIG_WHITELIST_IP_DEF          PP_HTONL(LWIP_MAKEU32(0, 0, 0, 0))
 #define TCP_SERVER_CONFIG_WHITELIST_MASK_DEF        PP_HTONL(LWIP_MAKEU32(0, 0, 0, 0))
+#define TCP_SERVER_CONFIG_RX_META_DEF               (false)
+#define TCP_SERVER_CONFIG_SLOW_POLICY_DEF           TCP_SERVER_SLOW_DROP
+
+#define TCP_SERVER_MAX_CLIENTS        (3)
+#define TCP_SERVER_CLIENT_TX_RING     (4*1024)        // radio -> client queue, per client
+
+#define UDP_SERVER_CONFIG_ENABLED_DEF               (false)
+#define UDP_SERVER_CONFIG_PORT_DEF                  (8002)
+#define UDP_SERVER_CONFIG_MCAST_IP_DEF              PP_HTONL(LWIP_MAKEU32(0, 0, 0, 0))
+#define UDP_SERVER_CONFIG_MCAST_PORT_DEF            (8003)
+#define UDP_SERVER_CONFIG_SEQ_DEF                   (false)
+
+#define UDP_SERVER_MAX_PEERS          (4)             // unicast listeners, least recent is evicted
+
+#define HALOW_BRIDGE_CONFIG_ENABLED_DEF             (false)
+#define HALOW_BRIDGE_CONFIG_BCAST_PPS_DEF           (20)
+#define HALOW_BRIDGE_CONFIG_QUEUE_MS_DEF            (200)
+
+#define HALOW_BRIDGE_FDB_ENTRIES      (32)            // learned Ethernet addresses
+#define HALOW_BRIDGE_TXQ_RING         (12*1024)       // Ethernet -> radio queue memory
 
 #define OTA_FAL_PART_NAME "ota_slot0"
 
 #define CONFIG_PAGE_TASK_PRIO    (3)
-#define CONFIG_PAGE_TASK_STACK   (10*1024)
+#define CONFIG_PAGE_TASK_STACK   (2*1024)       // listener, only accepts
+#define CONFIG_PAGE_HTTP_WORKERS (3)
+#define CONFIG_PAGE_WORKER_STACK (6*1024)       // request and API buffers come from the heap while in use
 
 #define STATISTICS_TASK_PRIO    (2)
 #define STATISTICS_TASK_STACK   (2*1024)
+#define STATISTICS_LINK_PEERS       (8)     // senders tracked, least recent is evicted
+#define STATISTICS_LINK_EWMA_SHIFT  (3)     // new sample weight 1/8
+
+#define HALOW_TX_TASK_PRIO            (21)
+#define HALOW_TX_TASK_STACK           (2*1024)       // LBT waits, lmac_tx, aggregation and FEC encode
 
 #define HALOW_LBT_LISTEN_TASK_PRIO    (OS_TASK_PRIORITY_IDLE)
 #define HALOW_LBT_LISTEN_TASK_STACK   (2*1024)
+#define HALOW_LBT_SAMPLE_TIME_US      (100)     // One noise sample averages bknoise over this time
+#define HALOW_LBT_SAMPLER_BATCH       (8)       // Samples taken per wakeup, outside the context lock
+#define HALOW_LBT_SAMPLER_DUTY_PERCENT (50)     // Max share of CPU time spent busy-polling bknoise
 
 // #define ANT_CTRL_PIN PB_1 // 网桥用PB1来做双天线选择
 
@@ -4,19 +4,50 @@
 #include <stddef.h>
 
 #include "lwip/ip4_addr.h"
+#include "halow.h"
 
-typedef int32_t (*tcp_server_rx_cb_t)(const uint8_t *data, uint32_t len);
+/* One frame from a client, as pieces of the received pbufs */
+typedef int32_t (*tcp_server_rx_cb_t)(const halow_iov_t *iov, uint32_t cnt);
+
+/* What happens to a client whose radio -> TCP queue is full */
+typedef enum {
+    TCP_SERVER_SLOW_DROP = 0,   // Frames are dropped for that client only
+    TCP_SERVER_SLOW_CLOSE,      // The client is disconnected
+} tcp_server_slow_policy_t;
 
 typedef struct {
     bool enabled;
     uint16_t port;
     ip4_addr_t whitelist_ip;
     ip4_addr_t whitelist_mask;
+    bool rx_meta;               // Precede RX frames with a KISS link metrics frame
+    uint8_t slow_policy;        // tcp_server_slow_policy_t
 } tcp_server_config_t;
 
+typedef struct {
+    ip4_addr_t addr;
+    uint16_t port;
+    uint8_t policy;             // tcp_server_slow_policy_t
+    uint32_t tx_frames;         // Radio frames queued to this client
+    uint32_t tx_drops;          // Radio frames dropped, client queue full
+    uint32_t tx_queued;         // Bytes waiting in the client queue
+    uint32_t rx_frames;         // Frames from this client handed to the radio
+} tcp_server_client_info_t;
+
+typedef struct {
+    uint32_t frames;            // Frames queued towards at least one client
+    uint32_t meta_frames;       // KISS RX metadata frames queued
+    uint32_t drop_full;         // Client queue full, counted per client
+    uint32_t drop_no_client;
+    uint32_t wakeup_fail;       // tcpip callback queue saturated
+    uint32_t tcp_writes;        // Drains that produced output
+    uint64_t tcp_bytes;
+} tcp_server_tx_stat_t;
+
 int32_t tcp_server_init(tcp_server_rx_cb_t cb);
-int32_t tcp_server_send(const uint8_t *data, uint32_t len);
+int32_t tcp_server_send_rx(const uint8_t *data, uint32_t len, const halow_rx_meta_t *meta);
 void tcp_server_config_load(tcp_server_config_t *cfg);
 void tcp_server_config_save(const tcp_server_config_t *cfg);
 void tcp_server_config_apply(const tcp_server_config_t *cfg);
-bool tcp_server_get_client_info(ip4_addr_t* addr, uint16_t* port);
+uint32_t tcp_server_get_clients(tcp_server_client_info_t *out, uint32_t max);
+tcp_server_tx_stat_t tcp_server_tx_stat_get(void);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "lwip/ip4_addr.h"
+
+/*
+ * Datagram transport for the modem: one UDP datagram is one radio frame in
+ * each direction, no framing. Received radio frames go to the multicast group
+ * when one is configured, otherwise to every host that sent a datagram within
+ * UDP_SERVER_PEER_TIMEOUT_MS. An empty datagram registers (keeps alive) the
+ * sender without transmitting anything.
+ *
+ * With `seq` enabled every datagram starts with a big endian u16 sequence
+ * number: the device tracks it per sender (loss, duplicates, reordering) and
+ * numbers the frames it delivers.
+ */
+
+typedef int32_t (*udp_server_rx_cb_t)(const uint8_t *data, uint32_t len);
+
+typedef struct {
+    bool enabled;
+    uint16_t port;
+    ip4_addr_t mcast_ip;        // 0.0.0.0: unicast to the active senders
+    uint16_t mcast_port;
+    bool seq;
+} udp_server_config_t;
+
+typedef struct {
+    ip4_addr_t addr;
+    uint16_t port;
+    uint32_t age_ms;            // Since the last datagram
+    uint32_t frames;            // Datagrams handed to the radio
+    uint32_t lost;              // Sequence gaps
+    uint32_t dup;               // Repeated sequence, dropped
+    uint32_t late;              // Older than the newest sequence, delivered
+} udp_server_peer_info_t;
+
+typedef struct {
+    uint32_t rx_frames;         // Host -> radio
+    uint32_t rx_drop_full;
+    uint32_t rx_drop_size;
+    uint32_t tx_frames;         // Radio -> host
+    uint32_t tx_drop_full;
+    uint32_t tx_drop_no_peer;
+    uint32_t tx_send_err;
+    uint32_t wakeup_fail;
+} udp_server_stat_t;
+
+int32_t udp_server_init(udp_server_rx_cb_t cb);
+int32_t udp_server_send(const uint8_t *data, uint32_t len);
+void udp_server_config_load(udp_server_config_t *cfg);
+void udp_server_config_save(const udp_server_config_t *cfg);
+void udp_server_config_apply(const udp_server_config_t *cfg);
+uint32_t udp_server_get_peers(udp_server_peer_info_t *out, uint32_t max);
+udp_server_stat_t udp_server_stat_get(void);
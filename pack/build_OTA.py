@@ -31,7 +31,7 @@ def main():
     fw_dst = fs_dir / "fw.bin"
     shutil.copyfile(bin_path, fw_dst)
 
-    # 2) pack_www: собрать ../web_configurator/www → _filesystem/_firmware/index.html
+    # 2) pack_www: собрать ../web_configurator/www → _filesystem/www/index.html (+ index.html.gz, index.html.gz.etag)
     www_src = (script_dir / "../web_configurator/www").resolve()
     firmware_www_dir = fs_dir / "www"
     firmware_www_dir.mkdir(parents=True, exist_ok=True)
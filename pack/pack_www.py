@@ -5,6 +5,8 @@ from __future__ import annotations
 
 import argparse
 import base64
+import gzip
+import hashlib
 import mimetypes
 import re
 from pathlib import Path
@@ -230,6 +232,22 @@ def build_single_html(www_dir: Path, out_html: Path, obfuscate_js: bool) -> None
     out_html.write_text(html + "\n", encoding="utf-8")
 
 
+def write_gzip_asset(src: Path) -> Path:
+    """Write <src>.gz plus <src>.gz.etag (content hash) for the firmware httpd."""
+    raw = src.read_bytes()
+    # mtime=0 keeps the archive, and so the ETag, stable across rebuilds
+    gz = gzip.compress(raw, compresslevel=9, mtime=0)
+
+    gz_path = src.with_name(src.name + ".gz")
+    gz_path.write_bytes(gz)
+
+    etag = hashlib.sha256(gz).hexdigest()[:20]
+    gz_path.with_name(gz_path.name + ".etag").write_text(etag, encoding="ascii")
+
+    print(f"gzip: {len(raw)} -> {len(gz)} bytes, etag {etag}")
+    return gz_path
+
+
 def main() -> int:
     ap = argparse.ArgumentParser(
         description="Pack ./www into single obfuscated out/index.html (inline CSS/JS/images)."
@@ -237,6 +255,7 @@ def main() -> int:
     ap.add_argument("--www", type=Path, default=Path("www"), help="Input www dir (default: ./www)")
     ap.add_argument("--out", type=Path, default=Path("out") / "index.html", help="Output HTML (default: ./out/index.html)")
     ap.add_argument("--no-obfuscate", action="store_true", help="Disable JS base64 wrapper obfuscation (still minifies).")
+    ap.add_argument("--no-gzip", action="store_true", help="Do not emit <out>.gz and <out>.gz.etag next to the HTML.")
     args = ap.parse_args()
 
     www_dir = args.www.resolve()
@@ -246,6 +265,8 @@ def main() -> int:
         raise FileNotFoundError(f"www dir not found: {www_dir}")
 
     build_single_html(www_dir, out_html, obfuscate_js=(not args.no_obfuscate))
+    if not args.no_gzip:
+        write_gzip_asset(out_html)
     print(f"OK: {out_html}")
     return 0
 
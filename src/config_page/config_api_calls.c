@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "cJSON.h"
 #include "lwip/netif.h"
@@ -12,15 +13,20 @@
 
 #include "config_page/config_api_calls.h"
 #include "config_page/config_api_dispatch.h"
+#include "config_page/json_writer.h"
 
 #include "halow.h"
 #include "halow_lbt.h"
+#include "halow_fec.h"
 #include "net_ip.h"
 #include "tcp_server.h"
+#include "udp_server.h"
+#include "halow_bridge.h"
 #include "utils.h"
 #include "device.h"
 #include "statistics.h"
 #include "hal/spi_nor.h"
+#include "fal_norflash_port.h"
 
 /* -------------------------------------------------------------------------- */
 /* Change version                                                             */
@@ -100,10 +106,9 @@ static bool json_get_string( const cJSON *o, const char *k, char *out, size_t ou
     return true;
 }
 
-static int32_t api_err( cJSON *out, int32_t rc, const char *msg ){
+static int32_t api_err( json_writer_t *out, int32_t rc, const char *msg ){
     if (out != NULL && msg != NULL) {
-        (void)cJSON_DeleteItemFromObject(out, "err");
-        (void)cJSON_AddStringToObject(out, "err", msg);
+        json_add_str(out, "err", msg);
     }
     return rc;
 }
@@ -112,14 +117,14 @@ static int32_t api_err( cJSON *out, int32_t rc, const char *msg ){
 /* /api/heartbeat                                                             */
 /* -------------------------------------------------------------------------- */
 
-int32_t web_api_heartbeat_get( const cJSON *in, cJSON *out ){
+int32_t web_api_heartbeat_get( const cJSON *in, json_writer_t *out ){
     (void)in;
 
     if (out == NULL) {
         return WEB_API_RC_BAD_REQUEST;
     }
 
-    (void)cJSON_AddNumberToObject(out, "version", (double)web_api_change_version());
+    json_add_int(out, "version", web_api_change_version());
     return WEB_API_RC_OK;
 }
 
@@ -127,14 +132,14 @@ int32_t web_api_heartbeat_get( const cJSON *in, cJSON *out ){
 /* /api/ok                                                                    */
 /* -------------------------------------------------------------------------- */
 
-int32_t web_api_ok_get( const cJSON *in, cJSON *out ){
+int32_t web_api_ok_get( const cJSON *in, json_writer_t *out ){
     (void)in;
 
     if (out == NULL) {
         return WEB_API_RC_BAD_REQUEST;
     }
 
-    (void)cJSON_AddBoolToObject(out, "ok", 1);
+    json_add_bool(out, "ok", true);
     return WEB_API_RC_OK;
 }
 
@@ -142,7 +147,7 @@ int32_t web_api_ok_get( const cJSON *in, cJSON *out ){
 /* /api/halow_cfg                                                             */
 /* -------------------------------------------------------------------------- */
 
-int32_t web_api_halow_cfg_get( const cJSON *in, cJSON *out ){
+int32_t web_api_halow_cfg_get( const cJSON *in, json_writer_t *out ){
     halow_config_t cfg;
 
     (void)in;
@@ -155,18 +160,23 @@ int32_t web_api_halow_cfg_get( const cJSON *in, cJSON *out ){
 
     char bndw[16];
     (void)snprintf(bndw, sizeof(bndw), "%d MHz", (int)cfg.bandwidth);
-    (void)cJSON_AddStringToObject(out, "bandwidth",    bndw);
-    (void)cJSON_AddNumberToObject(out, "central_freq", ((double)cfg.central_freq) / 10.0);
-    (void)cJSON_AddBoolToObject(out,   "super_power",  (cfg.rf_super_power != 0) ? 1 : 0);
-    (void)cJSON_AddNumberToObject(out, "power_dbm",    (double)cfg.rf_power);
+    json_add_str(out, "bandwidth",    bndw);
+    json_add_num(out, "central_freq", ((double)cfg.central_freq) / 10.0, 6);
+    json_add_bool(out, "super_power",  (cfg.rf_super_power != 0));
+    json_add_int(out, "power_dbm",    cfg.rf_power);
     char mcs[8];
     (void)snprintf(mcs, sizeof(mcs), "MCS%d", (int)cfg.mcs);
-    (void)cJSON_AddStringToObject(out, "mcs_index", mcs);
+    json_add_str(out, "mcs_index", mcs);
+    json_add_int(out, "agg_max", cfg.agg_max);
+    json_add_int(out, "agg_hold_ms", cfg.agg_hold_ms);
+    json_add_int(out, "fec_k", cfg.fec_k);
+    json_add_int(out, "fec_m", cfg.fec_m);
+    json_add_int(out, "fec_hold_ms", cfg.fec_hold_ms);
 
     return WEB_API_RC_OK;
 }
 
-int32_t web_api_halow_cfg_post( const cJSON *in, cJSON *out ){
+int32_t web_api_halow_cfg_post( const cJSON *in, json_writer_t *out ){
     halow_config_t cfg;
     bool b;
     int i;
@@ -216,6 +226,36 @@ int32_t web_api_halow_cfg_post( const cJSON *in, cJSON *out ){
         }
     }
 
+    if (json_get_int(in, "agg_max", &i)) {
+        if (i >= 0 && i <= 65535) {
+            cfg.agg_max = (uint16_t)i;
+        }
+    }
+
+    if (json_get_int(in, "agg_hold_ms", &i)) {
+        if (i >= 0 && i <= 255) {
+            cfg.agg_hold_ms = (uint8_t)i;
+        }
+    }
+
+    if (json_get_int(in, "fec_k", &i)) {
+        if (i >= 0 && i <= 255) {
+            cfg.fec_k = (uint8_t)i;
+        }
+    }
+
+    if (json_get_int(in, "fec_m", &i)) {
+        if (i >= 0 && i <= 255) {
+            cfg.fec_m = (uint8_t)i;
+        }
+    }
+
+    if (json_get_int(in, "fec_hold_ms", &i)) {
+        if (i >= 0 && i <= 255) {
+            cfg.fec_hold_ms = (uint8_t)i;
+        }
+    }
+
     halow_config_apply(&cfg);
     halow_config_save(&cfg);
 
@@ -228,7 +268,7 @@ int32_t web_api_halow_cfg_post( const cJSON *in, cJSON *out ){
 /* /api/net_cfg                                                               */
 /* -------------------------------------------------------------------------- */
 
-int32_t web_api_net_cfg_get( const cJSON *in, cJSON *out ){
+int32_t web_api_net_cfg_get( const cJSON *in, json_writer_t *out ){
     net_ip_config_t cfg;
     char ip[16];
     char gw[16];
@@ -250,15 +290,15 @@ int32_t web_api_net_cfg_get( const cJSON *in, cJSON *out ){
     ip4addr_ntoa_r(&cfg.gw,   gw,   sizeof(gw));
     ip4addr_ntoa_r(&cfg.mask, mask, sizeof(mask));
 
-    (void)cJSON_AddBoolToObject(out, "dhcp", (cfg.mode == NET_IP_MODE_DHCP) ? 1 : 0);
-    (void)cJSON_AddStringToObject(out, "ip_address", ip);
-    (void)cJSON_AddStringToObject(out, "gw_address", gw);
-    (void)cJSON_AddStringToObject(out, "netmask", mask);
+    json_add_bool(out, "dhcp", (cfg.mode == NET_IP_MODE_DHCP));
+    json_add_str(out, "ip_address", ip);
+    json_add_str(out, "gw_address", gw);
+    json_add_str(out, "netmask", mask);
 
     return WEB_API_RC_OK;
 }
 
-int32_t web_api_net_cfg_post( const cJSON *in, cJSON *out ){
+int32_t web_api_net_cfg_post( const cJSON *in, json_writer_t *out ){
     net_ip_config_t cfg;
     bool dhcp = false;
     char ip[16];
@@ -305,12 +345,14 @@ int32_t web_api_net_cfg_post( const cJSON *in, cJSON *out ){
 /* /api/tcp_server_cfg                                                        */
 /* -------------------------------------------------------------------------- */
 
-int32_t web_api_tcp_server_cfg_get( const cJSON *in, cJSON *out ){
+int32_t web_api_tcp_server_cfg_get( const cJSON *in, json_writer_t *out ){
     tcp_server_config_t cfg;
-    ip4_addr_t client_addr;
-    uint16_t client_port;
+    tcp_server_client_info_t clients[TCP_SERVER_MAX_CLIENTS];
+    uint32_t n;
+    uint32_t i;
     char whitelist[32];
-    char connected[32];
+    char connected[TCP_SERVER_MAX_CLIENTS * 24];
+    size_t len = 0;
 
     (void)in;
 
@@ -323,27 +365,57 @@ int32_t web_api_tcp_server_cfg_get( const cJSON *in, cJSON *out ){
     utils_ip_mask_to_cidr(whitelist, sizeof(whitelist),
                           &cfg.whitelist_ip, &cfg.whitelist_mask);
 
-    if (tcp_server_get_client_info(&client_addr, &client_port)) {
+    n = tcp_server_get_clients(clients, TCP_SERVER_MAX_CLIENTS);
+
+    connected[0] = 0;
+    for (i = 0; i < n; i++) {
         char ipbuf[16];
-        ip4addr_ntoa_r(&client_addr, ipbuf, sizeof(ipbuf));
-        snprintf(connected, sizeof(connected), "%s:%u", ipbuf, (unsigned)client_port);
-    } else {
+        ip4addr_ntoa_r(&clients[i].addr, ipbuf, sizeof(ipbuf));
+        len += (size_t)snprintf(connected + len, sizeof(connected) - len, "%s%s:%u",
+                                (i != 0) ? ", " : "", ipbuf, (unsigned)clients[i].port);
+        if (len >= sizeof(connected)) {
+            break;
+        }
+    }
+    if (n == 0) {
         snprintf(connected, sizeof(connected), "no connection");
     }
 
-    (void)cJSON_AddBoolToObject(out, "enable", cfg.enabled ? 1 : 0);
-    (void)cJSON_AddNumberToObject(out, "port", (double)cfg.port);
-    (void)cJSON_AddStringToObject(out, "whitelist", whitelist);
-    (void)cJSON_AddStringToObject(out, "connected", connected);
+    json_add_bool(out, "enable", cfg.enabled);
+    json_add_int(out, "port", cfg.port);
+    json_add_str(out, "whitelist", whitelist);
+    json_add_bool(out, "rx_meta", cfg.rx_meta);
+    json_add_str(out, "slow_policy", (cfg.slow_policy == TCP_SERVER_SLOW_CLOSE) ? "close" : "drop");
+    json_add_str(out, "connected", connected);
+    json_add_int(out, "max_clients", TCP_SERVER_MAX_CLIENTS);
+
+    json_arr_begin(out, "clients");
+    for (i = 0; i < n; i++) {
+        char ipbuf[16];
+
+        ip4addr_ntoa_r(&clients[i].addr, ipbuf, sizeof(ipbuf));
+        json_obj_begin(out, NULL);
+        json_add_str(out, "ip", ipbuf);
+        json_add_int(out, "port", clients[i].port);
+        json_add_str(out, "policy", (clients[i].policy == TCP_SERVER_SLOW_CLOSE) ? "close" : "drop");
+        json_add_int(out, "tx_frames", clients[i].tx_frames);
+        json_add_int(out, "tx_drops", clients[i].tx_drops);
+        json_add_int(out, "tx_queued", clients[i].tx_queued);
+        json_add_int(out, "rx_frames", clients[i].rx_frames);
+        json_obj_end(out);
+    }
+    json_arr_end(out);
 
     return WEB_API_RC_OK;
 }
 
-int32_t web_api_tcp_server_cfg_post( const cJSON *in, cJSON *out ){
+int32_t web_api_tcp_server_cfg_post( const cJSON *in, json_writer_t *out ){
     tcp_server_config_t cfg;
     bool enable = false;
+    bool rx_meta;
     int port = 0;
     char whitelist[32];
+    char slow_policy[8];
     ip4_addr_t ip;
     ip4_addr_t mask;
 
@@ -361,6 +433,20 @@ int32_t web_api_tcp_server_cfg_post( const cJSON *in, cJSON *out ){
 
     cfg.enabled = enable ? true : false;
 
+    if (json_get_bool(in, "rx_meta", &rx_meta)) {
+        cfg.rx_meta = rx_meta;
+    }
+
+    if (json_get_string(in, "slow_policy", slow_policy, sizeof(slow_policy))) {
+        if (strcmp(slow_policy, "close") == 0) {
+            cfg.slow_policy = TCP_SERVER_SLOW_CLOSE;
+        } else if (strcmp(slow_policy, "drop") == 0) {
+            cfg.slow_policy = TCP_SERVER_SLOW_DROP;
+        } else {
+            return api_err(out, WEB_API_RC_BAD_REQUEST, "bad slow_policy");
+        }
+    }
+
     if (port >= 1 && port <= 65535) {
         cfg.port = (uint16_t)port;
     }
@@ -381,6 +467,193 @@ int32_t web_api_tcp_server_cfg_post( const cJSON *in, cJSON *out ){
     return web_api_tcp_server_cfg_get(NULL, out);
 }
 
+/* -------------------------------------------------------------------------- */
+/* /api/udp_server_cfg                                                        */
+/* -------------------------------------------------------------------------- */
+
+int32_t web_api_udp_server_cfg_get( const cJSON *in, json_writer_t *out ){
+    udp_server_config_t cfg;
+    udp_server_peer_info_t peers[UDP_SERVER_MAX_PEERS];
+    uint32_t n;
+    uint32_t i;
+    char ipbuf[16];
+
+    (void)in;
+
+    if (out == NULL) {
+        return WEB_API_RC_BAD_REQUEST;
+    }
+
+    udp_server_config_load(&cfg);
+
+    if (cfg.mcast_ip.addr != 0) {
+        ip4addr_ntoa_r(&cfg.mcast_ip, ipbuf, sizeof(ipbuf));
+    } else {
+        ipbuf[0] = 0;
+    }
+
+    json_add_bool(out, "enable", cfg.enabled);
+    json_add_int(out, "port", cfg.port);
+    json_add_str(out, "mcast", ipbuf);
+    json_add_int(out, "mcast_port", cfg.mcast_port);
+    json_add_bool(out, "seq", cfg.seq);
+
+    n = udp_server_get_peers(peers, UDP_SERVER_MAX_PEERS);
+    json_arr_begin(out, "peers");
+    for (i = 0; i < n; i++) {
+        ip4addr_ntoa_r(&peers[i].addr, ipbuf, sizeof(ipbuf));
+        json_obj_begin(out, NULL);
+        json_add_str(out, "ip", ipbuf);
+        json_add_int(out, "port", peers[i].port);
+        json_add_int(out, "age_ms", peers[i].age_ms);
+        json_add_int(out, "frames", peers[i].frames);
+        json_add_int(out, "lost", peers[i].lost);
+        json_add_int(out, "dup", peers[i].dup);
+        json_add_int(out, "late", peers[i].late);
+        json_obj_end(out);
+    }
+    json_arr_end(out);
+
+    return WEB_API_RC_OK;
+}
+
+int32_t web_api_udp_server_cfg_post( const cJSON *in, json_writer_t *out ){
+    udp_server_config_t cfg;
+    bool enable = false;
+    bool seq;
+    int port = 0;
+    int mcast_port = 0;
+    char mcast[16];
+    ip4_addr_t ip;
+
+    if (in == NULL || !cJSON_IsObject(in) || out == NULL) {
+        return api_err(out, WEB_API_RC_BAD_REQUEST, "bad json");
+    }
+
+    (void)json_get_bool(in, "enable", &enable);
+    (void)json_get_int(in, "port", &port);
+    (void)json_get_int(in, "mcast_port", &mcast_port);
+
+    udp_server_config_load(&cfg);
+
+    cfg.enabled = enable ? true : false;
+
+    if (port >= 1 && port <= 65535) {
+        cfg.port = (uint16_t)port;
+    }
+    if (mcast_port >= 1 && mcast_port <= 65535) {
+        cfg.mcast_port = (uint16_t)mcast_port;
+    }
+    if (json_get_bool(in, "seq", &seq)) {
+        cfg.seq = seq;
+    }
+    if (json_get_string(in, "mcast", mcast, sizeof(mcast))) {
+        if (mcast[0] == 0) {
+            ip4_addr_set_u32(&cfg.mcast_ip, PP_HTONL(0u));
+        } else if (ip4addr_aton(mcast, &ip) && ip4_addr_ismulticast(&ip)) {
+            cfg.mcast_ip = ip;
+        } else {
+            return api_err(out, WEB_API_RC_BAD_REQUEST, "bad multicast group");
+        }
+    }
+
+    udp_server_config_apply(&cfg);
+    udp_server_config_save(&cfg);
+
+    web_api_notify_change();
+
+    return web_api_udp_server_cfg_get(NULL, out);
+}
+
+/* -------------------------------------------------------------------------- */
+/* /api/bridge_cfg                                                            */
+/* -------------------------------------------------------------------------- */
+
+int32_t web_api_bridge_cfg_get( const cJSON *in, json_writer_t *out ){
+    halow_bridge_config_t cfg;
+    halow_bridge_stat_t stat;
+    halow_bridge_iperf_t iperf;
+    char ipbuf[16];
+
+    (void)in;
+
+    if (out == NULL) {
+        return WEB_API_RC_BAD_REQUEST;
+    }
+
+    halow_bridge_config_load(&cfg);
+    stat  = halow_bridge_stat_get();
+    iperf = halow_bridge_iperf_get();
+
+    json_add_bool(out, "enable", cfg.enabled);
+    json_add_bool(out, "active", halow_bridge_active());
+    json_add_int(out, "bcast_pps", cfg.bcast_pps);
+    json_add_int(out, "queue_ms", cfg.queue_ms);
+
+    json_obj_begin(out, "stat");
+    json_add_int(out, "tx_frames", stat.tx_frames);
+    json_add_int(out, "tx_bytes", stat.tx_bytes);
+    json_add_int(out, "rx_frames", stat.rx_frames);
+    json_add_int(out, "rx_bytes", stat.rx_bytes);
+    json_add_int(out, "drop_bcast", stat.drop_bcast);
+    json_add_int(out, "drop_airtime", stat.drop_airtime);
+    json_add_int(out, "drop_full", stat.drop_full);
+    json_add_int(out, "drop_late", stat.drop_late);
+    json_add_int(out, "drop_size", stat.drop_size);
+    json_add_int(out, "rx_drop", stat.rx_drop);
+    json_add_int(out, "queued_us", stat.queued_us);
+    json_obj_end(out);
+
+    if (iperf.valid) {
+        ip4addr_ntoa_r(&iperf.remote, ipbuf, sizeof(ipbuf));
+        json_obj_begin(out, "iperf");
+        json_add_str(out, "remote", ipbuf);
+        json_add_bool(out, "ok", iperf.ok);
+        json_add_int(out, "bytes", iperf.bytes);
+        json_add_int(out, "ms", iperf.ms);
+        json_add_int(out, "kbps", iperf.kbps);
+        json_obj_end(out);
+    } else {
+        json_add_null(out, "iperf");
+    }
+
+    return WEB_API_RC_OK;
+}
+
+int32_t web_api_bridge_cfg_post( const cJSON *in, json_writer_t *out ){
+    halow_bridge_config_t cfg;
+    bool enable;
+    int bcast_pps = -1;
+    int queue_ms = 0;
+
+    if (in == NULL || !cJSON_IsObject(in) || out == NULL) {
+        return api_err(out, WEB_API_RC_BAD_REQUEST, "bad json");
+    }
+
+    (void)json_get_int(in, "bcast_pps", &bcast_pps);
+    (void)json_get_int(in, "queue_ms", &queue_ms);
+
+    halow_bridge_config_load(&cfg);
+
+    if (json_get_bool(in, "enable", &enable)) {
+        cfg.enabled = enable;
+    }
+    if (bcast_pps >= 0 && bcast_pps <= 65535) {
+        cfg.bcast_pps = (uint16_t)bcast_pps;
+    }
+    if (queue_ms >= 1 && queue_ms <= 65535) {
+        cfg.queue_ms = (uint16_t)queue_ms;
+    }
+
+    /* rate and queue apply at once, the mode after a reboot */
+    halow_bridge_config_apply(&cfg);
+    halow_bridge_config_save(&cfg);
+
+    web_api_notify_change();
+
+    return web_api_bridge_cfg_get(NULL, out);
+}
+
 /* -------------------------------------------------------------------------- */
 /* /api/lbt_cfg (placeholders)                                                */
 /* -------------------------------------------------------------------------- */
@@ -402,7 +675,7 @@ int32_t web_api_tcp_server_cfg_post( const cJSON *in, cJSON *out ){
 //  uwin  - util window ms (u32)
 //  uburst- util burst ms (u16)
 
-int32_t web_api_lbt_cfg_get( const cJSON *in, cJSON *out ){
+int32_t web_api_lbt_cfg_get( const cJSON *in, json_writer_t *out ){
     halow_lbt_config_t cfg;
 
     (void)in;
@@ -413,30 +686,30 @@ int32_t web_api_lbt_cfg_get( const cJSON *in, cJSON *out ){
 
     halow_lbt_config_load(&cfg);
 
-    (void)cJSON_AddBoolToObject(out,   "en",    (cfg.lbt_enabled != 0) ? 1 : 0);
+    json_add_bool(out, "en",    (cfg.lbt_enabled != 0));
 
-    (void)cJSON_AddNumberToObject(out, "sw",    (double)cfg.noise_short_window_samples);
-    (void)cJSON_AddNumberToObject(out, "lw",    (double)cfg.noise_long_window_samples);
-    (void)cJSON_AddNumberToObject(out, "lp",    (double)cfg.noise_long_low_percent);
+    json_add_int(out, "sw",    cfg.noise_short_window_samples);
+    json_add_int(out, "lw",    cfg.noise_long_window_samples);
+    json_add_int(out, "lp",    cfg.noise_long_low_percent);
 
-    (void)cJSON_AddNumberToObject(out, "roff",  (double)cfg.noise_relative_offset_dbm);
-    (void)cJSON_AddNumberToObject(out, "abusy", (double)cfg.noise_absolute_busy_dbm);
+    json_add_int(out, "roff",  cfg.noise_relative_offset_dbm);
+    json_add_int(out, "abusy", cfg.noise_absolute_busy_dbm);
 
-    (void)cJSON_AddNumberToObject(out, "txgr",  (double)cfg.tx_skip_check_time_us);
-    (void)cJSON_AddNumberToObject(out, "txmax", (double)cfg.tx_max_continuous_time_ms);
+    json_add_int(out, "txgr",  cfg.tx_skip_check_time_us);
+    json_add_int(out, "txmax", cfg.tx_max_continuous_time_ms);
 
-    (void)cJSON_AddNumberToObject(out, "bmin",  (double)cfg.backoff_random_min_us);
-    (void)cJSON_AddNumberToObject(out, "bmax",  (double)cfg.backoff_random_max_us);
+    json_add_int(out, "bmin",  cfg.backoff_random_min_us);
+    json_add_int(out, "bmax",  cfg.backoff_random_max_us);
 
-    (void)cJSON_AddBoolToObject(out,   "uen",   (cfg.util_enabled != 0) ? 1 : 0);
-    (void)cJSON_AddNumberToObject(out, "umax",  (double)cfg.util_max_percent);
-    (void)cJSON_AddNumberToObject(out, "uwin",  (double)cfg.util_refill_window_ms);
-    (void)cJSON_AddNumberToObject(out, "uburst",(double)cfg.util_bucket_capacity_ms);
+    json_add_bool(out, "uen",   (cfg.util_enabled != 0));
+    json_add_int(out, "umax",  cfg.util_max_percent);
+    json_add_int(out, "uwin",  cfg.util_refill_window_ms);
+    json_add_int(out, "uburst",cfg.util_bucket_capacity_ms);
 
     return WEB_API_RC_OK;
 }
 
-int32_t web_api_lbt_cfg_post( const cJSON *in, cJSON *out ){
+int32_t web_api_lbt_cfg_post( const cJSON *in, json_writer_t *out ){
     halow_lbt_config_t cfg;
     bool b;
     int v;
@@ -479,7 +752,7 @@ int32_t web_api_lbt_cfg_post( const cJSON *in, cJSON *out ){
 /* /api/dev_stat + /api/radio_stat (placeholders)                             */
 /* -------------------------------------------------------------------------- */
 
-int32_t web_api_dev_stat_get( const cJSON *in, cJSON *out ){
+int32_t web_api_dev_stat_get( const cJSON *in, json_writer_t *out ){
     char s[64];
     const char *hostname = "";
     struct netif *nif;
@@ -491,7 +764,7 @@ int32_t web_api_dev_stat_get( const cJSON *in, cJSON *out ){
     }
 
     statistics_uptime_get(s, sizeof(s));
-    (void)cJSON_AddStringToObject(out, "uptime", s);
+    json_add_str(out, "uptime", s);
 
     nif = netif_default;
     if (nif != NULL) {
@@ -503,9 +776,9 @@ int32_t web_api_dev_stat_get( const cJSON *in, cJSON *out ){
         s[0] = '\0';
     }
 
-    (void)cJSON_AddStringToObject(out, "hostname", hostname);
-    (void)cJSON_AddStringToObject(out, "ip", s);
-    (void)cJSON_AddStringToObject(out, "ver", FW_FULL_VERSION);
+    json_add_str(out, "hostname", hostname);
+    json_add_str(out, "ip", s);
+    json_add_str(out, "ver", FW_FULL_VERSION);
 
     if (nif != NULL) {
         snprintf(s, sizeof(s),
@@ -520,15 +793,19 @@ int32_t web_api_dev_stat_get( const cJSON *in, cJSON *out ){
         s[0] = '\0';
     }
 
-    (void)cJSON_AddStringToObject(out, "mac", s);
+    json_add_str(out, "mac", s);
     snprintf(s, sizeof(s), "%d Mbit", flash0.size * 8 / 1024 / 1024);
-    (void)cJSON_AddStringToObject(out, "flashs", s);
+    json_add_str(out, "flashs", s);
+    json_add_str(out, "flash_read",
+                                  fal_norflash_read_mode_name(fal_norflash_read_mode_get()));
 
     return WEB_API_RC_OK;
 }
 
-int32_t web_api_radio_stat_get( const cJSON *in, cJSON *out ){
+int32_t web_api_radio_stat_get( const cJSON *in, json_writer_t *out ){
     statistics_radio_t st;
+    halow_agg_stat_t agg;
+    halow_fec_stat_t fec;
     double v;
     char buf[32];
 
@@ -549,7 +826,7 @@ int32_t web_api_radio_stat_get( const cJSON *in, cJSON *out ){
     } else {
         snprintf(buf, sizeof(buf), "%.2f GiB", v / (1024.0 * 1024.0));
     }
-    (void)cJSON_AddStringToObject(out, "rx_bytes", buf);
+    json_add_str(out, "rx_bytes", buf);
 
     /* -------- TX bytes -------- */
     v = (double)st.tx_bytes / 1024.0;   /* KiB */
@@ -560,53 +837,117 @@ int32_t web_api_radio_stat_get( const cJSON *in, cJSON *out ){
     } else {
         snprintf(buf, sizeof(buf), "%.2f GiB", v / (1024.0 * 1024.0));
     }
-    (void)cJSON_AddStringToObject(out, "tx_bytes", buf);
+    json_add_str(out, "tx_bytes", buf);
 
     /* -------- packets -------- */
-    (void)cJSON_AddNumberToObject(out, "rx_packets", (double)st.rx_packets);
-    (void)cJSON_AddNumberToObject(out, "tx_packets", (double)st.tx_packets);
+    json_add_int(out, "rx_packets", st.rx_packets);
+    json_add_int(out, "tx_packets", st.tx_packets);
 
     /* -------- speed (kbit/s) -------- */
     v = (double)st.rx_bitps / 1000.0;
     snprintf(buf, sizeof(buf), "%.2f kbit/s", v);
-    (void)cJSON_AddStringToObject(out, "rx_speed", buf);
+    json_add_str(out, "rx_speed", buf);
 
     v = (double)st.tx_bitps / 1000.0;
     snprintf(buf, sizeof(buf), "%.2f kbit/s", v);
-    (void)cJSON_AddStringToObject(out, "tx_speed", buf);
+    json_add_str(out, "tx_speed", buf);
 
     (void)snprintf(buf, sizeof(buf), "%.1f %%", (double)(st.airtime*100.0f));
-    (void)cJSON_AddStringToObject(out, "airtime", buf);
+    json_add_str(out, "airtime", buf);
 
     (void)snprintf(buf, sizeof(buf), "%.1f %%", (double)(st.ch_util*100.0f));
-    (void)cJSON_AddStringToObject(out, "ch_util", buf);
+    json_add_str(out, "ch_util", buf);
 
     (void)snprintf(buf, sizeof(buf), "%.1f dBm", (double)st.bkgnd_noise_dbm);
-    (void)cJSON_AddStringToObject(out, "bg_pwr_dbm", buf);
+    json_add_str(out, "bg_pwr_dbm", buf);
     
     (void)snprintf(buf, sizeof(buf), "%.1f dBm", (double)st.bkgnd_noise_dbm_now);
-    (void)cJSON_AddStringToObject(out, "bg_pwr_now_dbm", buf);
+    json_add_str(out, "bg_pwr_now_dbm", buf);
+
+    agg = halow_agg_stat_get();
+    json_add_int(out, "agg_tx", agg.tx_aggregates);
+    json_add_int(out, "agg_tx_frames", agg.tx_subframes);
+    json_add_int(out, "agg_rx", agg.rx_aggregates);
+    json_add_int(out, "agg_rx_frames", agg.rx_subframes);
+    json_add_int(out, "agg_rx_err", agg.rx_errors);
+
+    fec = halow_fec_stat_get();
+    json_add_int(out, "fec_tx_blocks", fec.tx_blocks);
+    json_add_int(out, "fec_tx_parity", fec.tx_parity);
+    json_add_int(out, "fec_parity_now", fec.parity_now);
+    json_add_int(out, "fec_rx_blocks", fec.rx_blocks);
+    json_add_int(out, "fec_rx_lost", fec.rx_lost);
+    json_add_int(out, "fec_rx_recovered", fec.rx_recovered);
+    json_add_int(out, "fec_rx_unrecovered", fec.rx_unrecovered);
+    json_add_int(out, "fec_rx_err", fec.rx_errors);
+    (void)snprintf(buf, sizeof(buf), "%.1f %%", (double)fec.loss_permille / 10.0);
+    json_add_str(out, "rx_loss", buf);
 
     return WEB_API_RC_OK;
 }
 
-int32_t web_api_radio_stat_post( const cJSON *in, cJSON *out ){
+int32_t web_api_radio_stat_post( const cJSON *in, json_writer_t *out ){
     statistics_radio_reset();
     web_api_notify_change();
     return web_api_lbt_cfg_get(NULL, out);
 }
 
-int32_t web_api_online_ota_get( const cJSON *in, cJSON *out ){
+/*
+ * /api/link_stat: rolling link quality per sender heard since the last stat
+ * reset. Averages are EWMA, rssi/evm in dB, foff in LMAC units.
+ */
+int32_t web_api_link_stat_get( const cJSON *in, json_writer_t *out ){
+    statistics_link_t links[STATISTICS_LINK_PEERS];
+    uint32_t n;
+    uint32_t i;
+
+    (void)in;
+
+    if (out == NULL) {
+        return WEB_API_RC_BAD_REQUEST;
+    }
+
+    n = statistics_link_get(links, STATISTICS_LINK_PEERS);
+
+    json_arr_begin(out, "peers");
+    for (i = 0; i < n; i++) {
+        const statistics_link_t *l = &links[i];
+        char addr[18];
+
+        snprintf(addr, sizeof(addr), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 l->addr[0], l->addr[1], l->addr[2],
+                 l->addr[3], l->addr[4], l->addr[5]);
+
+        json_obj_begin(out, NULL);
+        json_add_str(out, "addr", addr);
+        json_add_int(out, "frames", l->frames);
+        json_add_int(out, "bytes", (int64_t)l->bytes);
+        json_add_int(out, "age_ms", l->age_ms);
+        json_add_num(out, "rssi", (double)l->signal_avg / 16.0, 3);
+        json_add_int(out, "rssi_min", l->signal_min);
+        json_add_int(out, "rssi_max", l->signal_max);
+        json_add_num(out, "evm", (double)l->evm_avg / 16.0, 3);
+        json_add_num(out, "foff", (double)l->freq_off_avg / 16.0, 4);
+        json_add_int(out, "rssi_last", l->last.signal);
+        json_add_int(out, "evm_last", l->last.evm);
+        json_add_int(out, "mcs", l->last.mcs);
+        json_add_int(out, "bw", l->last.bw);
+        json_obj_end(out);
+    }
+    json_arr_end(out);
+
+    return WEB_API_RC_OK;
+}
+
+int32_t web_api_online_ota_get( const cJSON *in, json_writer_t *out ){
     return 0;
 }
 
-int32_t web_api_online_ota_post( const cJSON *in, cJSON *out ){
+int32_t web_api_online_ota_post( const cJSON *in, json_writer_t *out ){
     return 0;
 }
 
-int32_t web_api_stat_get( const cJSON *in, cJSON *out ){
-    cJSON *dev   = NULL;
-    cJSON *radio = NULL;
+int32_t web_api_stat_get( const cJSON *in, json_writer_t *out ){
     int32_t rc;
 
     (void)in;
@@ -615,43 +956,107 @@ int32_t web_api_stat_get( const cJSON *in, cJSON *out ){
         return WEB_API_RC_BAD_REQUEST;
     }
 
-    dev   = cJSON_CreateObject();
-    radio = cJSON_CreateObject();
+    json_obj_begin(out, "device");
+    rc = web_api_dev_stat_get(NULL, out);
+    json_obj_end(out);
+    if (rc != WEB_API_RC_OK) {
+        return rc;
+    }
+
+    json_obj_begin(out, "radio");
+    rc = web_api_radio_stat_get(NULL, out);
+    json_obj_end(out);
+    return rc;
+}
+
+/* Member `key` filled by a getter, stops at the first failing one */
+static int32_t api_sub_obj( json_writer_t *out, const char *key,
+                            int32_t (*get)( const cJSON *in, json_writer_t *out ) ){
+    int32_t rc;
+
+    json_obj_begin(out, key);
+    rc = get(NULL, out);
+    json_obj_end(out);
+    return rc;
+}
+
+int32_t web_api_all_get( const cJSON *in, json_writer_t *out ){
+    int32_t rc;
 
-    if (!dev || !radio) {
-        rc = WEB_API_RC_INTERNAL;
-        goto fail;
+    (void)in;
+
+    if (out == NULL) {
+        return WEB_API_RC_BAD_REQUEST;
     }
 
-    rc = web_api_dev_stat_get(NULL, dev);
-    if (rc != WEB_API_RC_OK) goto fail;
+    json_add_int(out, "ver", web_api_change_version());
 
-    rc = web_api_radio_stat_get(NULL, radio);
-    if (rc != WEB_API_RC_OK) goto fail;
+    rc = api_sub_obj(out, "halow", web_api_halow_cfg_get);
+    if (rc != WEB_API_RC_OK) return rc;
 
-    cJSON_AddItemToObject(out, "device", dev);    dev = NULL;
-    cJSON_AddItemToObject(out, "radio",  radio);  radio = NULL;
+    rc = api_sub_obj(out, "net", web_api_net_cfg_get);
+    if (rc != WEB_API_RC_OK) return rc;
 
-    return WEB_API_RC_OK;
+    rc = api_sub_obj(out, "tcp", web_api_tcp_server_cfg_get);
+    if (rc != WEB_API_RC_OK) return rc;
 
-fail:
-    cJSON_Delete(dev);
-    cJSON_Delete(radio);
-    return rc;
-}
+    rc = api_sub_obj(out, "udp", web_api_udp_server_cfg_get);
+    if (rc != WEB_API_RC_OK) return rc;
 
-int32_t web_api_all_get( const cJSON *in, cJSON *out ){
-    cJSON *halow = NULL;
-    cJSON *net   = NULL;
-    cJSON *tcp   = NULL;
-    cJSON *lbt   = NULL;
-    cJSON *ota   = NULL;
+    rc = api_sub_obj(out, "bridge", web_api_bridge_cfg_get);
+    if (rc != WEB_API_RC_OK) return rc;
 
-    cJSON *stat  = NULL;
-    cJSON *dev   = NULL;
-    cJSON *radio = NULL;
+    rc = api_sub_obj(out, "lbt", web_api_lbt_cfg_get);
+    if (rc != WEB_API_RC_OK) return rc;
 
-    int32_t rc;
+    rc = api_sub_obj(out, "ota", web_api_online_ota_get);
+    if (rc != WEB_API_RC_OK) return rc;
+
+    return api_sub_obj(out, "stat", web_api_stat_get);
+}
+
+/*
+ * /api/json_bench: cost of one /api/get_all response.
+ *   writer - handlers straight into a static buffer (the live path), no heap
+ *   cjson  - the same handlers in json_writer tree mode, i.e. a cJSON tree
+ *            built with cJSON_AddItemTo* as the tree based handlers did, then
+ *            printed to a heap string and freed
+ * The global cJSON hooks are left alone (other workers parse requests at the
+ * same time), allocations are counted from the finished tree: one per node,
+ * key and string value, plus the printed string. The print buffer growing on
+ * the way is not counted. Values are per iteration.
+ */
+
+#define API_JSON_BENCH_ITERS    (20)
+#define API_JSON_BENCH_DOC_MAX  (3072)
+
+static void api_bench_tree_cost( const cJSON *item, uint32_t *allocs, uint32_t *bytes ){
+    for (; item != NULL; item = item->next) {
+        *allocs += 1;
+        *bytes  += (uint32_t)sizeof(cJSON);
+        if ((item->string != NULL) && !(item->type & cJSON_StringIsConst)) {
+            *allocs += 1;
+            *bytes  += (uint32_t)strlen(item->string) + 1;
+        }
+        if (cJSON_IsString(item) && (item->valuestring != NULL)) {
+            *allocs += 1;
+            *bytes  += (uint32_t)strlen(item->valuestring) + 1;
+        }
+        api_bench_tree_cost(item->child, allocs, bytes);
+    }
+}
+
+int32_t web_api_json_bench_get( const cJSON *in, json_writer_t *out ){
+    static char doc[API_JSON_BENCH_DOC_MAX];
+    cJSON *stack[JSON_WRITER_MAX_DEPTH];
+    json_writer_t jw;
+    int64_t t0;
+    int64_t w_us;
+    int64_t c_us;
+    uint32_t c_allocs = 0;
+    uint32_t c_bytes = 0;
+    int32_t len = -1;
+    int32_t i;
 
     (void)in;
 
@@ -659,71 +1064,130 @@ int32_t web_api_all_get( const cJSON *in, cJSON *out ){
         return WEB_API_RC_BAD_REQUEST;
     }
 
-    (void)cJSON_AddNumberToObject(out, "ver", (double)web_api_change_version());
+    t0 = get_time_us();
+    for (i = 0; i < API_JSON_BENCH_ITERS; i++) {
+        json_writer_init(&jw, doc, sizeof(doc), NULL, NULL);
+        json_obj_begin(&jw, NULL);
+        (void)web_api_all_get(NULL, &jw);
+        json_obj_end(&jw);
+        len = json_writer_finish(&jw);
+    }
+    w_us = get_time_us() - t0;
 
-    halow = cJSON_CreateObject();
-    net   = cJSON_CreateObject();
-    tcp   = cJSON_CreateObject();
-    lbt   = cJSON_CreateObject();
-    ota   = cJSON_CreateObject();
+    if (len <= 0) {
+        return WEB_API_RC_INTERNAL;
+    }
 
-    stat  = cJSON_CreateObject();
-    dev   = cJSON_CreateObject();
-    radio = cJSON_CreateObject();
+    t0 = get_time_us();
+    for (i = 0; i < API_JSON_BENCH_ITERS; i++) {
+        char *str;
+
+        json_writer_init_tree(&jw, stack);
+        json_obj_begin(&jw, NULL);
+        (void)web_api_all_get(NULL, &jw);
+        json_obj_end(&jw);
+        if ((json_writer_finish(&jw) != 0) || (stack[0] == NULL)) {
+            cJSON_Delete(stack[0]);
+            return WEB_API_RC_INTERNAL;
+        }
 
-    if (!halow || !net || !tcp || !lbt || !ota || !stat || !dev || !radio) {
-        rc = WEB_API_RC_INTERNAL;
-        goto fail;
+        str = cJSON_PrintUnformatted(stack[0]);
+        if (i == 0) {
+            api_bench_tree_cost(stack[0], &c_allocs, &c_bytes);
+            if (str != NULL) {
+                c_allocs += 1;
+                c_bytes  += (uint32_t)strlen(str) + 1;
+            }
+        }
+        cJSON_free(str);
+        cJSON_Delete(stack[0]);
     }
+    c_us = get_time_us() - t0;
 
-    rc = web_api_halow_cfg_get(NULL, halow);
-    if (rc != WEB_API_RC_OK) goto fail;
-
-    rc = web_api_net_cfg_get(NULL, net);
-    if (rc != WEB_API_RC_OK) goto fail;
+    json_add_int(out, "iters", API_JSON_BENCH_ITERS);
+    json_add_int(out, "bytes", len);
 
-    rc = web_api_tcp_server_cfg_get(NULL, tcp);
-    if (rc != WEB_API_RC_OK) goto fail;
+    json_obj_begin(out, "writer");
+    json_add_int(out, "us",          w_us / API_JSON_BENCH_ITERS);
+    json_add_int(out, "allocs",      0);
+    json_add_int(out, "alloc_bytes", 0);
+    json_obj_end(out);
 
-    rc = web_api_lbt_cfg_get(NULL, lbt);
-    if (rc != WEB_API_RC_OK) goto fail;
+    json_obj_begin(out, "cjson");
+    json_add_int(out, "us",          c_us / API_JSON_BENCH_ITERS);
+    json_add_int(out, "allocs",      c_allocs);
+    json_add_int(out, "alloc_bytes", c_bytes);
+    json_obj_end(out);
 
-    rc = web_api_online_ota_get(NULL, ota);
-    if (rc != WEB_API_RC_OK) goto fail;
+    return WEB_API_RC_OK;
+}
 
-    rc = web_api_dev_stat_get(NULL, dev);
-    if (rc != WEB_API_RC_OK) goto fail;
+int32_t web_api_flash_bench_get( const cJSON *in, json_writer_t *out ){
+    fal_norflash_bench_t res[4];
+    int32_t n;
 
-    rc = web_api_radio_stat_get(NULL, radio);
-    if (rc != WEB_API_RC_OK) goto fail;
+    (void)in;
 
-    cJSON_AddItemToObject(stat, "device", dev);    dev = NULL;
-    cJSON_AddItemToObject(stat, "radio",  radio);  radio = NULL;
+    if (out == NULL) {
+        return WEB_API_RC_BAD_REQUEST;
+    }
 
-    cJSON_AddItemToObject(out, "halow", halow);   halow = NULL;
-    cJSON_AddItemToObject(out, "net",   net);     net   = NULL;
-    cJSON_AddItemToObject(out, "tcp",   tcp);     tcp   = NULL;
-    cJSON_AddItemToObject(out, "lbt",   lbt);     lbt   = NULL;
-    cJSON_AddItemToObject(out, "ota",   ota);     ota   = NULL;
+    n = fal_norflash_bench(res, sizeof(res) / sizeof(res[0]));
+    if (n <= 0) {
+        return WEB_API_RC_INTERNAL;
+    }
 
-    cJSON_AddItemToObject(out, "stat",  stat);    stat  = NULL;
+    json_arr_begin(out, "modes");
+    for (int32_t i = 0; i < n; i++) {
+        json_obj_begin(out, NULL);
+        json_add_str(out,  "mode",    fal_norflash_read_mode_name(res[i].mode));
+        json_add_bool(out, "dma",     res[i].dma);
+        json_add_int(out,  "bytes",   res[i].bytes);
+        json_add_int(out,  "time_us", res[i].time_us);
+        json_add_num(out,  "mbps",    (double)res[i].kbps / 1024.0, 6);
+        json_add_num(out,  "model_mbps", (double)res[i].model_kbps / 1024.0, 6);
+        json_obj_end(out);
+    }
+    json_arr_end(out);
 
     return WEB_API_RC_OK;
+}
 
-fail:
-    cJSON_Delete(halow);
-    cJSON_Delete(net);
-    cJSON_Delete(tcp);
-    cJSON_Delete(lbt);
-    cJSON_Delete(ota);
+/* /api/fec_bench: FEC codec throughput on this core, k = 8 blocks of 512 byte symbols */
+int32_t web_api_fec_bench_get( const cJSON *in, json_writer_t *out ){
+    halow_fec_bench_t res[3];
+    int32_t n;
 
-    cJSON_Delete(stat);
-    cJSON_Delete(dev);
-    cJSON_Delete(radio);
-    return rc;
+    (void)in;
+
+    if (out == NULL) {
+        return WEB_API_RC_BAD_REQUEST;
+    }
+
+    n = halow_fec_bench(res, sizeof(res) / sizeof(res[0]));
+    if (n <= 0) {
+        return WEB_API_RC_INTERNAL;
+    }
+
+    json_arr_begin(out, "codes");
+    for (int32_t i = 0; i < n; i++) {
+        json_obj_begin(out, NULL);
+        json_add_int(out,  "k",        res[i].k);
+        json_add_int(out,  "m",        res[i].m);
+        json_add_int(out,  "sym_len",  res[i].sym_len);
+        json_add_int(out,  "enc_us",   res[i].enc_us);
+        json_add_int(out,  "dec_us",   res[i].dec_us);
+        json_add_num(out,  "enc_mbps", (double)res[i].enc_kbps / 1024.0, 6);
+        json_add_num(out,  "dec_mbps", (double)res[i].dec_kbps / 1024.0, 6);
+        json_add_bool(out, "ok",       res[i].ok);
+        json_obj_end(out);
+    }
+    json_arr_end(out);
+
+    return WEB_API_RC_OK;
 }
 
-int32_t web_api_reboot_post( const cJSON *in, cJSON *out ){
+int32_t web_api_reboot_post( const cJSON *in, json_writer_t *out ){
     device_reboot();
     return 0;
 }
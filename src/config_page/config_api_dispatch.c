@@ -8,7 +8,7 @@
 #include "config_page/config_api_dispatch.h"
 #include "config_page/config_api_calls.h"
 
-typedef int32_t (*web_api_cb_t)( const cJSON *in, cJSON *out );
+typedef int32_t (*web_api_cb_t)( const cJSON *in, json_writer_t *out );
 
 typedef struct {
     const char  *endpoint;   /* part after "/api/" */
@@ -74,15 +74,22 @@ static const web_api_route_t s_api_routes[] = {
     //{ "stat_reset",  web_api_stat_reset,  NULL },
     { "get_stat",   web_api_stat_get,       NULL },
     { "get_all",    web_api_all_get,        NULL },
+    { "link_stat",  web_api_link_stat_get,  NULL },
     { "halow_cfg",  NULL,                   web_api_halow_cfg_post },
     { "lbt_cfg",    NULL,                   web_api_lbt_cfg_post },
     { "net_cfg",    NULL,                   web_api_net_cfg_post },
     { "tcp_server_cfg",    NULL,            web_api_tcp_server_cfg_post },
+    { "udp_server_cfg",    NULL,            web_api_udp_server_cfg_post },
+    { "bridge_cfg",        NULL,            web_api_bridge_cfg_post },
 
     { "ota_begin",  NULL,                   web_api_ota_begin_post },
     { "ota_chunk",  NULL,                   web_api_ota_chunk_post },
     { "ota_end",    NULL,                   web_api_ota_end_post },
+    { "ota_status", web_api_ota_status_get, NULL },
     { "ota_write",  NULL,                   web_api_ota_write_post },
+    { "flash_bench", web_api_flash_bench_get, NULL },
+    { "json_bench", web_api_json_bench_get, NULL },
+    { "fec_bench", web_api_fec_bench_get, NULL },
     { "reboot",     NULL,                   web_api_reboot_post },
     { "reset_stat",  NULL,                  web_api_radio_stat_post },
 };
@@ -103,40 +110,35 @@ static const web_api_route_t *api_find_route( const char *endpoint ){
     return NULL;
 }
 
-static void api_set_err( cJSON *out, const char *msg ){
+static void api_set_err( json_writer_t *out, const char *msg ){
     if (out == NULL || msg == NULL) {
         return;
     }
-    /* overwrite is OK */
-    (void)cJSON_DeleteItemFromObject(out, "err");
-    (void)cJSON_AddStringToObject(out, "err", msg);
+    json_add_str(out, "err", msg);
 }
 
 int32_t web_api_dispatch( const char *method,
                           const char *uri,
                           const cJSON *in_json,
-                          cJSON *out_json ){
+                          json_writer_t *out ){
     char ep[64];
     const char *endpoint;
     const web_api_route_t *r;
     web_api_cb_t cb;
 
-    if (method == NULL || uri == NULL || out_json == NULL) {
-        return WEB_API_RC_BAD_REQUEST;
-    }
-    if (!cJSON_IsObject(out_json)) {
+    if (method == NULL || uri == NULL || out == NULL) {
         return WEB_API_RC_BAD_REQUEST;
     }
 
     endpoint = api_uri_to_endpoint(uri, ep, sizeof(ep));
     if (endpoint == NULL) {
-        api_set_err(out_json, "bad uri");
+        api_set_err(out, "bad uri");
         return WEB_API_RC_BAD_REQUEST;
     }
 
     r = api_find_route(endpoint);
     if (r == NULL) {
-        api_set_err(out_json, "api not found");
+        api_set_err(out, "api not found");
         return WEB_API_RC_NOT_FOUND;
     }
 
@@ -147,14 +149,14 @@ int32_t web_api_dispatch( const char *method,
     } else if (strcmp(method, "POST") == 0) {
         cb = r->post_cb;
     } else {
-        api_set_err(out_json, "method not allowed");
+        api_set_err(out, "method not allowed");
         return WEB_API_RC_METHOD_NOT_ALLOWED;
     }
 
     if (cb == NULL) {
-        api_set_err(out_json, "method not allowed");
+        api_set_err(out, "method not allowed");
         return WEB_API_RC_METHOD_NOT_ALLOWED;
     }
 
-    return cb(in_json, out_json);
+    return cb(in_json, out);
 }
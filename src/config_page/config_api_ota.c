@@ -13,19 +13,6 @@
 
 #define OTA_TMP_BIN_MAX    2048
 
-static uint32_t crc32_update_u8( uint32_t crc, const uint8_t *p, uint32_t n ){
-    uint32_t c = crc ^ 0xFFFFFFFFu;
-
-    while (n--) {
-        c ^= (uint32_t)(*p++);
-        for (uint32_t k = 0; k < 8; k++) {
-            c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
-        }
-    }
-
-    return c ^ 0xFFFFFFFFu;
-}
-
 static int8_t b64_inv( char c ){
     if (c >= 'A' && c <= 'Z') { return (int8_t)(c - 'A'); }
     if (c >= 'a' && c <= 'z') { return (int8_t)(c - 'a' + 26); }
@@ -74,11 +61,15 @@ static int32_t b64_decode( const char *in, uint8_t *out, uint32_t out_max, uint3
     return 0;
 }
 
-int32_t web_api_ota_begin_post( const cJSON *in, cJSON *out ){
+int32_t web_api_ota_begin_post( const cJSON *in, json_writer_t *out ){
     const cJSON *j_size;
     const cJSON *j_crc;
+    const cJSON *j_fw_size;
+    const cJSON *j_fw_crc;
     uint32_t size;
     uint32_t crc;
+    uint32_t fw_size = 0;
+    uint32_t fw_crc = 0;
 
     if (in == NULL) { 
         return -1; 
@@ -93,13 +84,21 @@ int32_t web_api_ota_begin_post( const cJSON *in, cJSON *out ){
     size = (uint32_t)j_size->valuedouble;
     crc  = (uint32_t)j_crc->valuedouble;
 
-    if (ota_lfs_begin(size, crc) != 0) {
+    /* optional, required when the tar carries fw.bin */
+    j_fw_size = cJSON_GetObjectItemCaseSensitive((cJSON *)in, "fw_size");
+    j_fw_crc  = cJSON_GetObjectItemCaseSensitive((cJSON *)in, "fw_crc32");
+    if (cJSON_IsNumber(j_fw_size) && cJSON_IsNumber(j_fw_crc)) {
+        fw_size = (uint32_t)j_fw_size->valuedouble;
+        fw_crc  = (uint32_t)j_fw_crc->valuedouble;
+    }
+
+    if (ota_stream_begin(size, crc, fw_size, fw_crc) != 0) {
         return -1; 
     }
     return 0;
 }
 
-int32_t web_api_ota_chunk_post( const cJSON *in, cJSON *out ){
+int32_t web_api_ota_chunk_post( const cJSON *in, json_writer_t *out ){
     const cJSON *j_off;
     const cJSON *j_b64;
     uint32_t off;
@@ -141,7 +140,7 @@ int32_t web_api_ota_chunk_post( const cJSON *in, cJSON *out ){
         return -5;
     }
 
-    if (ota_lfs_write(off, tmp, n) != 0) {
+    if (ota_stream_write(off, tmp, n) != 0) {
         os_free(tmp);
         return -6;
     }
@@ -150,14 +149,46 @@ int32_t web_api_ota_chunk_post( const cJSON *in, cJSON *out ){
     return 0;
 }
 
-int32_t web_api_ota_end_post( const cJSON *in, cJSON *out ){
-    if (ota_lfs_end() != 0) { 
+int32_t web_api_ota_status_get( const cJSON *in, json_writer_t *out ){
+    ota_stream_status_t st;
+
+    (void)in;
+
+    if (out == NULL) {
+        return -1;
+    }
+
+    ota_stream_status(&st);
+    json_add_bool(out, "active", st.active);
+    json_add_bool(out, "done", st.committed);
+    json_add_bool(out, "program", st.programming);
+    json_add_int(out, "size", st.size);
+    json_add_int(out, "written", st.written);
+    return 0;
+}
+
+int32_t web_api_ota_end_post( const cJSON *in, json_writer_t *out ){
+    ota_stream_status_t st;
+
+    (void)in;
+
+    if (ota_stream_end() != 0) { 
         return -1; 
     }
+
+    /* "program": the verify pass is done, send the chunks again */
+    ota_stream_status(&st);
+    json_add_bool(out, "program", st.programming && !st.committed);
+    json_add_bool(out, "done", st.committed);
     return 0;
 }
 
-int32_t web_api_ota_write_post( const cJSON *in, cJSON *out ){
+int32_t web_api_ota_write_post( const cJSON *in, json_writer_t *out ){
+    /* streamed upload is already unpacked and in place, a newer staged /ota.tar wins */
+    if (ota_stream_take_committed()) {
+        return 0;
+    }
+
     if(ota_lfs_upgrade_from_tar() != 0){
         return -1;
     }
@@ -4,6 +4,7 @@
 #include "lwip/api.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "lwip/tcp.h"
 #include "osal/task.h"
 
 #include "lib/littlefs/lfs.h"
@@ -18,6 +19,12 @@
 #include "cJSON.h"
 
 #include "config_page/config_api_dispatch.h"
+#include "config_page/json_writer.h"
+#include "ota.h"
+#include "statistics.h"
+#include "halow_lbt.h"
+#include "utils.h"
+#include "crc32.h"
 
 /* extern lfs */
 extern lfs_t g_lfs;
@@ -25,16 +32,42 @@ extern lfs_t g_lfs;
 #define HTTP_PORT        80
 #define HTTP_REQ_MAX     4096
 #define HTTP_FILE_CHUNK  1024
+#define HTTP_ASSET_CACHE 4      // static files with a known ETag
+#define HTTP_API_OUT_MAX 3072   // largest API response (/api/get_all ~2 KB with all clients and peers)
+
+#ifndef CONFIG_PAGE_HTTP_WORKERS
+#define CONFIG_PAGE_HTTP_WORKERS (3)
+#endif
+#ifndef CONFIG_PAGE_WORKER_STACK
+#define CONFIG_PAGE_WORKER_STACK (6*1024)
+#endif
+
+#define HTTP_STAT_STREAM_URI    "/api/stat_stream"
+#define HTTP_STAT_STREAM_HZ_DEF (5)
+#define HTTP_STAT_STREAM_HZ_MAX (10)
+#define HTTP_STAT_STREAM_PING_S (5)
+/* keep a worker free for everything else */
+#define HTTP_STAT_STREAM_MAX    (CONFIG_PAGE_HTTP_WORKERS - 1)
+
+#define HTTP_ACCEPT_QUEUE       (8)
+#define HTTP_KEEPALIVE_IDLE_MS  (15000)
+#define HTTP_KEEPALIVE_MAX_REQ  (100)
+
+#define HTTP_OTA_UPLOAD_URI        "/api/ota_upload"
+#define HTTP_OTA_CRC_HDR           "X-OTA-CRC32:"
+#define HTTP_OTA_FW_HDR            "X-OTA-FW:"
+/* a peer silent this long mid upload is gone, the session waits for a resume */
+#define HTTP_OTA_RECV_TIMEOUT_MS   (10000)
 
 #define WWW_DIR          "www"
 
 #define HTTP_CT_TEXT     "text/plain"
 #define HTTP_CT_JSON     "application/json"
 
-#define HTTP_JSON_ERR_OOM         "{\"ok\":false,\"rc\":-500,\"err\":\"oom\"}\n"
 #define HTTP_JSON_ERR_EMPTY_BODY  "{\"ok\":false,\"rc\":-400,\"err\":\"empty body\"}\n"
 #define HTTP_JSON_ERR_BAD_JSON    "{\"ok\":false,\"rc\":-400,\"err\":\"bad json\"}\n"
-#define HTTP_JSON_ERR_API_OOM     "{\"error\":\"oom\"}\n"
+#define HTTP_JSON_ERR_TOO_LARGE   "{\"error\":\"response too large\",\"rc\":-500}\n"
+#define HTTP_JSON_ERR_NO_MEM      "{\"error\":\"out of memory\",\"rc\":-503}\n"
 
 #define HTTP_SEND_LITERAL(nc, code, ctype, lit) \
     http_send_raw((nc), (code), (ctype), (lit), (sizeof(lit) - 1))
@@ -54,7 +87,116 @@ extern lfs_t g_lfs;
 #define httpd_dbg(fmt, ...) do { } while (0)
 #endif
 
-static struct os_task g_http_task;
+/* -------------------------------------------------------------------------- */
+/* Connections                                                                */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * The listener only accepts and queues. Each worker owns one connection at a
+ * time and serves requests on it (keep-alive, pipelined) until the peer closes
+ * or asks to, or stays idle for HTTP_KEEPALIVE_IDLE_MS (netconn receive
+ * timeout). A kept connection is closed after its response when another
+ * connection is waiting for a worker.
+ *
+ * Memory: the worker stacks are fixed (CONFIG_PAGE_HTTP_WORKERS *
+ * CONFIG_PAGE_WORKER_STACK, 18 KB). A connection holds a HTTP_REQ_MAX request
+ * buffer while served, an API call an HTTP_API_OUT_MAX response buffer while
+ * it is built and sent, both from the heap: nothing when idle, at most
+ * 3 * (4 + 3) KB with every worker busy.
+ */
+
+typedef struct {
+    struct os_task      task;
+    char                name[12];
+    struct netconn     *nc;
+    bool                keep_alive;     // current response leaves nc open
+    int                 len;            // bytes buffered in buf
+    char               *buf;            // HTTP_REQ_MAX + 1, only while serving nc
+} http_worker_t;
+
+static struct os_task      g_http_task;
+static http_worker_t       g_http_workers[CONFIG_PAGE_HTTP_WORKERS];
+
+/* g_lfs, the OTA stream and API handlers are not reentrant */
+static struct os_mutex     g_http_lock;
+
+static struct os_mutex     g_http_q_lock;
+static struct os_semaphore g_http_q_sem;
+static struct netconn     *g_http_q[HTTP_ACCEPT_QUEUE];
+static uint32_t            g_http_q_head;
+static uint32_t            g_http_q_tail;
+static volatile uint32_t   g_http_q_len;
+
+static void http_lock( void ){
+    (void)os_mutex_lock(&g_http_lock, osWaitForever);
+}
+
+static void http_unlock( void ){
+    (void)os_mutex_unlock(&g_http_lock);
+}
+
+static http_worker_t *http_worker_of( struct netconn *nc ){
+    int i;
+
+    if (nc == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < CONFIG_PAGE_HTTP_WORKERS; i++) {
+        if (g_http_workers[i].nc == nc) {
+            return &g_http_workers[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *http_conn_hdr( struct netconn *nc ){
+    http_worker_t *w = http_worker_of(nc);
+    return (w != NULL && w->keep_alive) ? "keep-alive" : "close";
+}
+
+static void http_conn_force_close( struct netconn *nc ){
+    http_worker_t *w = http_worker_of(nc);
+    if (w != NULL) {
+        w->keep_alive = false;
+    }
+}
+
+static bool http_queue_push( struct netconn *nc ){
+    bool ok = false;
+
+    (void)os_mutex_lock(&g_http_q_lock, osWaitForever);
+    if (g_http_q_len < HTTP_ACCEPT_QUEUE) {
+        g_http_q[g_http_q_tail] = nc;
+        g_http_q_tail = (g_http_q_tail + 1u) % HTTP_ACCEPT_QUEUE;
+        g_http_q_len++;
+        ok = true;
+    }
+    (void)os_mutex_unlock(&g_http_q_lock);
+
+    if (!ok) {
+        return false;
+    }
+
+    (void)os_sema_up(&g_http_q_sem);
+    return true;
+}
+
+static struct netconn *http_queue_pop( void ){
+    struct netconn *nc = NULL;
+
+    (void)os_sema_down(&g_http_q_sem, osWaitForever);
+
+    (void)os_mutex_lock(&g_http_q_lock, osWaitForever);
+    if (g_http_q_len > 0) {
+        nc = g_http_q[g_http_q_head];
+        g_http_q_head = (g_http_q_head + 1u) % HTTP_ACCEPT_QUEUE;
+        g_http_q_len--;
+    }
+    (void)os_mutex_unlock(&g_http_q_lock);
+
+    return nc;
+}
+
 /* -------------------------------------------------------------------------- */
 /* MIME types                                                                 */
 /* -------------------------------------------------------------------------- */
@@ -126,11 +268,12 @@ static void http_send_raw( struct netconn *nc,
              "HTTP/1.1 %d\r\n"
              "Content-Type: %s\r\n"
              "Cache-Control: no-cache\r\n"
-             "Connection: close\r\n"
+             "Connection: %s\r\n"
              "Content-Length: %u\r\n"
              "\r\n",
              code,
              content_type,
+             http_conn_hdr(nc),
              (unsigned)body_len);
 
     (void)netconn_write(nc, hdr, strlen(hdr), NETCONN_COPY);
@@ -146,24 +289,6 @@ static void http_send_text( struct netconn *nc, int code, const char *text ){
     http_send_raw(nc, code, HTTP_CT_TEXT, text, strlen(text));
 }
 
-static void http_send_json_cjson( struct netconn *nc, int code, cJSON *root ){
-    char *s;
-
-    if (root == NULL) {
-        HTTP_SEND_JSON_LITERAL(nc, 500, HTTP_JSON_ERR_OOM);
-        return;
-    }
-
-    s = cJSON_PrintUnformatted(root);
-    if (s == NULL) {
-        HTTP_SEND_JSON_LITERAL(nc, 500, HTTP_JSON_ERR_OOM);
-        return;
-    }
-
-    http_send_raw(nc, code, HTTP_CT_JSON, s, strlen(s));
-    cJSON_free(s);
-}
-
 /* -------------------------------------------------------------------------- */
 /* HTTP parsing                                                               */
 /* -------------------------------------------------------------------------- */
@@ -275,21 +400,106 @@ static int http_find_content_length( const char *hdr_start, const char *hdr_end
 }
 
 
-static int http_recv_request( struct netconn *nc, char *buf, int buf_sz ){
-    int total = 0;
+/* Value of header `name` (with trailing ':'), leading blanks skipped */
+static bool http_find_header( const char *hdr_start, const char *hdr_end, const char *name,
+                              const char **val, int *val_len ){
+    const char *p = hdr_start;
+    int n = (int)strlen(name);
+
+    if (hdr_start == NULL || hdr_end == NULL || val == NULL || val_len == NULL) {
+        return false;
+    }
+
+    while (p < hdr_end) {
+        const char *line_end = strstr(p, "\r\n");
+        if (line_end == NULL || line_end > hdr_end) {
+            line_end = hdr_end;
+        }
+
+        if ((line_end - p) >= n && http_line_starts_with_ci(p, name, n)) {
+            const char *v = p + n;
+            while (v < line_end && (*v == ' ' || *v == '\t')) { v++; }
+            *val     = v;
+            *val_len = (int)(line_end - v);
+            return true;
+        }
+
+        if (line_end == hdr_end) {
+            break;
+        }
+        p = line_end + 2;
+    }
+
+    return false;
+}
+
+/* HTTP/1.1 keeps the connection unless asked not to, HTTP/1.0 only on request */
+static bool http_wants_keep_alive( const char *req, const char *hdr_end ){
+    const char *eol = strstr(req, "\r\n");
+    const char *v;
+    int n;
+    bool http10 = (eol != NULL && (eol - req) >= 8 && memcmp(eol - 8, "HTTP/1.0", 8) == 0);
+
+    if (http_find_header(req, hdr_end, "Connection:", &v, &n)) {
+        if (n >= 5 && http_line_starts_with_ci(v, "close", 5)) {
+            return false;
+        }
+        if (n >= 10 && http_line_starts_with_ci(v, "keep-alive", 10)) {
+            return true;
+        }
+    }
+    return !http10;
+}
+
+/*
+ * Reads until the whole request is buffered or buf is full. The first `have`
+ * bytes of buf are left over from the previous (pipelined) request. A netbuf
+ * that did not fit is handed back in *rest (first *rest_used bytes already
+ * copied) so a streaming body reader can continue from it; the caller deletes
+ * it.
+ */
+static int http_recv_request( struct netconn *nc, char *buf, int buf_sz, int have,
+                              struct netbuf **rest, int *rest_used ){
+    int total = have;
     char *hdr_end;
     int need_total = -1; /* unknown */
     int content_len = 0;
 
-    if (nc == NULL || buf == NULL || buf_sz <= 0) {
+    if (nc == NULL || buf == NULL || buf_sz <= 0 || rest == NULL || rest_used == NULL ||
+        have < 0 || have >= buf_sz) {
         return -1;
     }
 
-    while (total < buf_sz - 1) {
+    *rest      = NULL;
+    *rest_used = 0;
+    buf[total] = 0;
+
+    while (1) {
         struct netbuf *nb = NULL;
         void *data = NULL;
         u16_t len = 0;
         err_t err;
+        int used = 0;
+        int can;
+        bool more = false;
+
+        if (need_total < 0) {
+            hdr_end = strstr(buf, "\r\n\r\n");
+            if (hdr_end != NULL) {
+                const char *headers_start = buf;
+                const char *headers_end = hdr_end;
+                content_len = http_find_content_length(headers_start, headers_end);
+                need_total = (int)((hdr_end - buf) + 4 + content_len);
+            }
+        }
+
+        if (need_total >= 0 && total >= need_total) {
+            break;
+        }
+        can = (buf_sz - 1) - total;
+        if (can <= 0) {
+            break;
+        }
 
         err = netconn_recv(nc, &nb);
         if (err != ERR_OK || nb == NULL) {
@@ -297,48 +507,43 @@ static int http_recv_request( struct netconn *nc, char *buf, int buf_sz ){
             break;
         }
 
-        if (((buf_sz - 1) - total) > 0) {
-            int can = (buf_sz - 1) - total;
+        netbuf_first(nb);
+        do {
+            netbuf_data(nb, &data, &len);
+            if (data == NULL || len == 0) {
+                break;
+            }
 
-            netbuf_first(nb);
-            do {
-                netbuf_data(nb, &data, &len);
-                if (data == NULL || len == 0) {
-                    break;
+            {
+                int take = can;
+                if ((int)len < take) {
+                    take = (int)len;
                 }
-
-                {
-                    int take = can;
-                    if ((int)len < take) {
-                        take = (int)len;
-                    }
-                    memcpy(buf + total, data, (size_t)take);
-                    total += take;
-                    can -= take;
-                    buf[total] = 0;
+                memcpy(buf + total, data, (size_t)take);
+                total += take;
+                used  += take;
+                can -= take;
+                buf[total] = 0;
+                if (take < (int)len) {
+                    more = true;
                 }
+            }
 
-                if (can <= 0) {
-                    break;
-                }
-            } while (netbuf_next(nb) != 0);
-        }
-
-        netbuf_delete(nb);
-
-        if (need_total < 0) {
-            hdr_end = strstr(buf, "\r\n\r\n");
-            if (hdr_end != NULL) {
-                const char *headers_start = buf;
-                const char *headers_end = hdr_end;
-                content_len = http_find_content_length(headers_start, headers_end);
-                need_total = (int)((hdr_end - buf) + 4 + content_len);
+            if (can <= 0) {
+                break;
             }
+        } while (netbuf_next(nb) != -1);
+
+        if (!more && can <= 0 && netbuf_next(nb) != -1) {
+            more = true;
         }
 
-        if (need_total >= 0 && total >= need_total) {
+        if (more) {
+            *rest      = nb;
+            *rest_used = used;
             break;
         }
+        netbuf_delete(nb);
     }
 
     return total;
@@ -348,10 +553,170 @@ static int http_recv_request( struct netconn *nc, char *buf, int buf_sz ){
 /* Static files                                                               */
 /* -------------------------------------------------------------------------- */
 
-static void http_serve_file( struct netconn *nc, const char *uri ){
-    char path[256];
+/*
+ * Static files are served with a strong ETag and revalidated with
+ * If-None-Match, so a cached page costs no flash reads. pack_www.py stores
+ * "<file>.gz" next to the plain file plus "<file>.gz.etag" holding the hash;
+ * the .gz is sent to clients accepting gzip. Files without a sidecar get a
+ * CRC based tag computed once. Lookups are cached in RAM until an OTA call
+ * may have replaced www.
+ */
+
+typedef struct {
+    uint32_t   gen;
+    bool       gz;              // entry describes "<path>.gz"
+    lfs_soff_t size;
+    char       path[64];
+    char       etag[40];        // quoted
+} http_asset_t;
+
+static http_asset_t g_http_assets[HTTP_ASSET_CACHE];
+static uint32_t     g_http_asset_next;
+static uint32_t     g_http_asset_gen = 1;   // 0 marks an unused entry
+
+static void http_assets_changed( void ){
+    http_lock();
+    g_http_asset_gen++;
+    if (g_http_asset_gen == 0) {
+        g_http_asset_gen = 1;
+    }
+    http_unlock();
+}
+
+static bool http_asset_etag_sidecar( const char *fpath, char *etag, size_t etag_sz ){
+    char spath[80];
+    char tag[32];
+    lfs_file_t f;
+    lfs_ssize_t n;
+
+    (void)snprintf(spath, sizeof(spath), "%s.etag", fpath);
+    if (lfs_file_open(&g_lfs, &f, spath, LFS_O_RDONLY) < 0) {
+        return false;
+    }
+    n = lfs_file_read(&g_lfs, &f, tag, sizeof(tag) - 1);
+    (void)lfs_file_close(&g_lfs, &f);
+
+    while (n > 0 && isspace((unsigned char)tag[n - 1])) {
+        n--;
+    }
+    if (n <= 0) {
+        return false;
+    }
+    tag[n] = 0;
+
+    (void)snprintf(etag, etag_sz, "\"%s\"", tag);
+    return true;
+}
+
+static bool http_asset_etag_crc( const char *fpath, lfs_soff_t size, char *etag, size_t etag_sz ){
+    uint8_t chunk[256];
+    lfs_file_t f;
+    lfs_ssize_t n;
+    uint32_t crc = 0;
+
+    if (lfs_file_open(&g_lfs, &f, fpath, LFS_O_RDONLY) < 0) {
+        return false;
+    }
+    while ((n = lfs_file_read(&g_lfs, &f, chunk, sizeof(chunk))) > 0) {
+        crc = crc32_update(crc, chunk, (uint32_t)n);
+    }
+    (void)lfs_file_close(&g_lfs, &f);
+
+    if (n < 0) {
+        return false;
+    }
+    (void)snprintf(etag, etag_sz, "\"%08lx-%lx\"", (unsigned long)crc, (unsigned long)size);
+    return true;
+}
+
+/* call with g_http_lock held */
+static bool http_asset_get( const char *path, bool gz, http_asset_t *out ){
+    char fpath[80];
+    struct lfs_info info;
+    http_asset_t *a;
+    uint32_t i;
+
+    for (i = 0; i < HTTP_ASSET_CACHE; i++) {
+        a = &g_http_assets[i];
+        if (a->gen == g_http_asset_gen && a->gz == gz && strcmp(a->path, path) == 0) {
+            *out = *a;
+            return true;
+        }
+    }
+
+    if (strlen(path) >= sizeof(a->path)) {
+        return false;
+    }
+    (void)snprintf(fpath, sizeof(fpath), "%s%s", path, gz ? ".gz" : "");
+    if (lfs_stat(&g_lfs, fpath, &info) < 0 || info.type != LFS_TYPE_REG) {
+        return false;
+    }
+
+    a = &g_http_assets[g_http_asset_next];
+    g_http_asset_next = (g_http_asset_next + 1u) % HTTP_ASSET_CACHE;
+
+    a->gen  = 0;
+    a->gz   = gz;
+    a->size = (lfs_soff_t)info.size;
+    strcpy(a->path, path);
+    if (!http_asset_etag_sidecar(fpath, a->etag, sizeof(a->etag)) &&
+        !http_asset_etag_crc(fpath, a->size, a->etag, sizeof(a->etag))) {
+        return false;
+    }
+    a->gen = g_http_asset_gen;
+
+    *out = *a;
+    return true;
+}
+
+/* If-None-Match: list of (possibly weak) tags or "*" */
+static bool http_etag_matches( const char *hdr_start, const char *hdr_end, const char *etag ){
+    const char *v;
+    int n;
+    size_t tl = strlen(etag);
+
+    if (!http_find_header(hdr_start, hdr_end, "If-None-Match:", &v, &n)) {
+        return false;
+    }
+    if (n >= 1 && v[0] == '*') {
+        return true;
+    }
+    while (n >= (int)tl) {
+        if (memcmp(v, etag, tl) == 0) {
+            return true;
+        }
+        v++;
+        n--;
+    }
+    return false;
+}
+
+static bool http_accepts_gzip( const char *hdr_start, const char *hdr_end ){
+    const char *v;
+    int n;
+
+    if (!http_find_header(hdr_start, hdr_end, "Accept-Encoding:", &v, &n)) {
+        return false;
+    }
+    while (n >= 4) {
+        if (http_line_starts_with_ci(v, "gzip", 4)) {
+            return true;
+        }
+        v++;
+        n--;
+    }
+    return false;
+}
+
+static void http_serve_file( struct netconn *nc, const char *uri,
+                             const char *hdr_start, const char *hdr_end ){
+    char path[64];
+    char fpath[80];
+    http_asset_t a;
     lfs_file_t f;
     lfs_ssize_t r;
+    lfs_soff_t size;
+    bool found;
     int rc;
 
     if (nc == NULL || uri == NULL) {
@@ -367,39 +732,100 @@ static void http_serve_file( struct netconn *nc, const char *uri ){
         snprintf(path, sizeof(path), "%s/index.html", WWW_DIR);
     } else {
         while (*uri == '/') { uri++; }
-        snprintf(path, sizeof(path), "%s/%s", WWW_DIR, uri);
+        if (snprintf(path, sizeof(path), "%s/%s", WWW_DIR, uri) >= (int)sizeof(path)) {
+            http_send_text(nc, 404, "not found\n");
+            return;
+        }
     }
 
-    rc = lfs_file_open(&g_lfs, &f, path, LFS_O_RDONLY);
+    http_lock();
+    found = (http_accepts_gzip(hdr_start, hdr_end) && http_asset_get(path, true, &a)) ||
+            http_asset_get(path, false, &a);
+    http_unlock();
+    if (!found) {
+        http_send_text(nc, 404, "not found\n");
+        return;
+    }
+
+    if (http_etag_matches(hdr_start, hdr_end, a.etag)) {
+        char hdr[192];
+        snprintf(hdr, sizeof(hdr),
+                 "HTTP/1.1 304\r\n"
+                 "ETag: %s\r\n"
+                 "Cache-Control: no-cache\r\n"
+                 "Vary: Accept-Encoding\r\n"
+                 "Connection: %s\r\n"
+                 "\r\n",
+                 a.etag,
+                 http_conn_hdr(nc));
+        (void)netconn_write(nc, hdr, strlen(hdr), NETCONN_COPY);
+        return;
+    }
+
+    (void)snprintf(fpath, sizeof(fpath), "%s%s", path, a.gz ? ".gz" : "");
+
+    http_lock();
+    rc = lfs_file_open(&g_lfs, &f, fpath, LFS_O_RDONLY);
+    size = (rc < 0) ? -1 : lfs_file_size(&g_lfs, &f);
+    if (rc >= 0 && size < 0) {
+        (void)lfs_file_close(&g_lfs, &f);
+    }
+    http_unlock();
     if (rc < 0) {
         http_send_text(nc, 404, "not found\n");
         return;
     }
+    if (size < 0) {
+        http_send_text(nc, 500, "fs error\n");
+        return;
+    }
 
     {
-        char hdr[256];
+        char hdr[384];
         snprintf(hdr, sizeof(hdr),
                  "HTTP/1.1 200\r\n"
                  "Content-Type: %s\r\n"
+                 "%s"
+                 "Content-Length: %ld\r\n"
+                 "ETag: %s\r\n"
                  "Cache-Control: no-cache\r\n"
-                 "Connection: close\r\n"
+                 "Vary: Accept-Encoding\r\n"
+                 "Connection: %s\r\n"
                  "\r\n",
-                 http_content_type(path));
-        (void)netconn_write(nc, hdr, strlen(hdr), NETCONN_COPY);
+                 http_content_type(path),
+                 a.gz ? "Content-Encoding: gzip\r\n" : "",
+                 (long)size,
+                 a.etag,
+                 http_conn_hdr(nc));
+        (void)netconn_write(nc, hdr, strlen(hdr), NETCONN_COPY | NETCONN_MORE);
     }
 
     {
         uint8_t chunk[HTTP_FILE_CHUNK];
-        while (1) {
+        lfs_soff_t left = size;
+
+        while (left > 0) {
+            /* lock per chunk only, a slow client must not stall other workers */
+            http_lock();
             r = lfs_file_read(&g_lfs, &f, chunk, sizeof(chunk));
+            http_unlock();
             if (r <= 0) {
+                /* body shorter than announced */
+                http_conn_force_close(nc);
                 break;
             }
-            (void)netconn_write(nc, chunk, (size_t)r, NETCONN_COPY);
+            if (r > left) {
+                r = (lfs_ssize_t)left;
+            }
+            left -= r;
+            (void)netconn_write(nc, chunk, (size_t)r,
+                                (left > 0) ? (NETCONN_COPY | NETCONN_MORE) : NETCONN_COPY);
         }
     }
 
+    http_lock();
     (void)lfs_file_close(&g_lfs, &f);
+    http_unlock();
 }
 
 /* -------------------------------------------------------------------------- */
@@ -427,9 +853,11 @@ static void http_handle_api( struct netconn *nc,
                              const char *uri,
                              const char *body,
                              int body_len ){
+    json_writer_t jw;
     cJSON *req = NULL;
-    cJSON *out = NULL;
+    char *out;
     int32_t rc;
+    int32_t n;
     int http_code;
 
     if (nc == NULL || method == NULL || uri == NULL) {
@@ -456,91 +884,555 @@ static void http_handle_api( struct netconn *nc,
         }
     }
 
-    out = cJSON_CreateObject();
+    /* only held for this response, idle workers keep no output buffer */
+    out = (char *)os_malloc(HTTP_API_OUT_MAX);
     if (out == NULL) {
         if (req) { cJSON_Delete(req); }
-        HTTP_SEND_JSON_LITERAL(nc, 500, HTTP_JSON_ERR_OOM);
+        HTTP_SEND_JSON_LITERAL(nc, 503, HTTP_JSON_ERR_NO_MEM);
         return;
     }
 
     /* API works ONLY with JSON objects. No ok/rc wrappers here. */
-    rc = web_api_dispatch(method, uri, req, out);
+    json_writer_init(&jw, out, HTTP_API_OUT_MAX, NULL, NULL);
+    json_obj_begin(&jw, NULL);
+
+    http_lock();
+    rc = web_api_dispatch(method, uri, req, &jw);
+    http_unlock();
+
+    if (strncmp(uri, "/api/ota_", 9) == 0) {
+        http_assets_changed();
+    }
+
+    json_obj_end(&jw);
+    n = json_writer_finish(&jw);
+
+    if (req) { cJSON_Delete(req); }
 
     http_code = http_map_api_rc_to_http(rc);
 
     if (rc != 0) {
         /* Keep error payload minimal, original UI usually expects plain JSON. */
-        cJSON_Delete(out);
-        out = cJSON_CreateObject();
-        if (out == NULL) {
-            if (req) { cJSON_Delete(req); }
-            HTTP_SEND_JSON_LITERAL(nc, 500, HTTP_JSON_ERR_API_OOM);
-            return;
-        }
+        const char *msg;
 
         if (rc == WEB_API_RC_NOT_FOUND) {
-            (void)cJSON_AddStringToObject(out, "error", "api not found");
+            msg = "api not found";
         } else if (rc == WEB_API_RC_METHOD_NOT_ALLOWED) {
-            (void)cJSON_AddStringToObject(out, "error", "method not allowed");
+            msg = "method not allowed";
         } else if (rc == WEB_API_RC_BAD_REQUEST) {
-            (void)cJSON_AddStringToObject(out, "error", "bad request");
+            msg = "bad request";
         } else {
-            (void)cJSON_AddStringToObject(out, "error", "internal error");
+            msg = "internal error";
         }
-        (void)cJSON_AddNumberToObject(out, "rc", (double)rc);
+
+        json_writer_reset(&jw);
+        json_obj_begin(&jw, NULL);
+        json_add_str(&jw, "error", msg);
+        json_add_int(&jw, "rc", rc);
+        json_obj_end(&jw);
+        n = json_writer_finish(&jw);
     }
 
-    http_send_json_cjson(nc, http_code, out);
+    if (n < 0) {
+        HTTP_SEND_JSON_LITERAL(nc, 500, HTTP_JSON_ERR_TOO_LARGE);
+    } else {
+        http_send_raw(nc, http_code, HTTP_CT_JSON, out, (size_t)n);
+    }
+    os_free(out);
+}
 
-    if (req) { cJSON_Delete(req); }
-    if (out) { cJSON_Delete(out); }
+/* -------------------------------------------------------------------------- */
+/* Binary OTA upload                                                          */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * PUT/POST /api/ota_upload, Content-Type: application/octet-stream
+ *   Content-Range: bytes <first>-<last>/<total>   (optional for a single shot)
+ *   X-OTA-CRC32: <hex>                            (required when first == 0)
+ *   X-OTA-FW: <fw.bin length> <fw.bin crc32 hex>  (required when the tar has fw.bin)
+ * The body goes straight into the OTA stream. A range starting at 0 opens a
+ * new session; any other range must start at or before the device offset
+ * reported by GET /api/ota_status (already stored bytes are skipped).
+ * A tar with fw.bin is sent twice: the reply to the end of the verify pass
+ * has "program":true and "written":0, the same upload then starts over.
+ */
+
+typedef struct {
+    uint32_t pos;       // stream offset of the next body byte
+    uint32_t left;      // body bytes still to read
+} http_ota_upload_t;
+
+static bool http_parse_content_range( const char *v, int n,
+                                      uint32_t *first, uint32_t *last, uint32_t *total ){
+    char tmp[64];
+    unsigned long a, b, t;
+
+    if (n <= 0 || n >= (int)sizeof(tmp)) {
+        return false;
+    }
+    memcpy(tmp, v, (size_t)n);
+    tmp[n] = 0;
+
+    if (sscanf(tmp, "bytes %lu-%lu/%lu", &a, &b, &t) != 3) {
+        return false;
+    }
+    if (a > b || b >= t) {
+        return false;
+    }
+
+    *first = (uint32_t)a;
+    *last  = (uint32_t)b;
+    *total = (uint32_t)t;
+    return true;
+}
+
+static int http_ota_upload_write( http_ota_upload_t *u, const uint8_t *p, uint32_t n ){
+    ota_stream_status_t st;
+
+    if (n > u->left) {
+        n = u->left;
+    }
+    u->left -= n;
+
+    ota_stream_status(&st);
+    if (!st.active) {
+        return -1;
+    }
+
+    /* resent bytes the device already has */
+    if (u->pos < st.written) {
+        uint32_t skip = st.written - u->pos;
+        if (skip >= n) {
+            u->pos += n;
+            return 0;
+        }
+        p      += skip;
+        n      -= skip;
+        u->pos += skip;
+    }
+
+    if (u->pos != st.written) {
+        return -2;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (ota_stream_write(u->pos, p, n) != 0) {
+        return -3;
+    }
+
+    u->pos += n;
+    return 0;
+}
+
+static int http_ota_upload_feed( http_ota_upload_t *u, const uint8_t *p, uint32_t n ){
+    int rc;
+
+    http_lock();
+    rc = http_ota_upload_write(u, p, n);
+    http_unlock();
+    return rc;
+}
+
+static int http_ota_upload_feed_netbuf( http_ota_upload_t *u, struct netbuf *nb, int skip ){
+    void *data;
+    u16_t len;
+
+    netbuf_first(nb);
+    do {
+        netbuf_data(nb, &data, &len);
+        if (data == NULL || len == 0) {
+            break;
+        }
+        if (skip >= (int)len) {
+            skip -= (int)len;
+            continue;
+        }
+        if (http_ota_upload_feed(u, (const uint8_t *)data + skip, (uint32_t)len - (uint32_t)skip) != 0) {
+            return -1;
+        }
+        skip = 0;
+    } while (u->left > 0 && netbuf_next(nb) != -1);
+
+    return 0;
+}
+
+static void http_ota_upload_reply( struct netconn *nc, int code, const char *err ){
+    ota_stream_status_t st;
+    char body[128];
+    int n;
+
+    http_lock();
+    ota_stream_status(&st);
+    http_unlock();
+    n = snprintf(body, sizeof(body),
+                 "{\"written\":%lu,\"size\":%lu,\"program\":%s,\"done\":%s%s%s%s}\n",
+                 (unsigned long)st.written, (unsigned long)st.size,
+                 st.programming ? "true" : "false",
+                 st.committed ? "true" : "false",
+                 err ? ",\"error\":\"" : "", err ? err : "", err ? "\"" : "");
+    http_send_raw(nc, code, HTTP_CT_JSON, body, (size_t)n);
+}
+
+static void http_handle_ota_upload( struct netconn *nc,
+                                    const char *hdr_start,
+                                    const char *hdr_end,
+                                    const uint8_t *body,
+                                    int body_have,
+                                    struct netbuf *rest,
+                                    int rest_used ){
+    http_ota_upload_t u;
+    ota_stream_status_t st;
+    uint32_t first, last, total;
+    const char *v;
+    int vlen;
+
+    netconn_set_recvtimeout(nc, HTTP_OTA_RECV_TIMEOUT_MS);
+
+    if (http_find_header(hdr_start, hdr_end, "Content-Range:", &v, &vlen)) {
+        if (!http_parse_content_range(v, vlen, &first, &last, &total)) {
+            http_ota_upload_reply(nc, 400, "bad range");
+            return;
+        }
+    } else {
+        int len = http_find_content_length(hdr_start, hdr_end);
+        if (len <= 0) {
+            http_ota_upload_reply(nc, 400, "no length");
+            return;
+        }
+        first = 0;
+        last  = (uint32_t)len - 1u;
+        total = (uint32_t)len;
+    }
+
+    if (first == 0) {
+        unsigned long crc;
+        unsigned long fw_size = 0;
+        unsigned long fw_crc = 0;
+        int32_t rc;
+
+        if (!http_find_header(hdr_start, hdr_end, HTTP_OTA_CRC_HDR, &v, &vlen) ||
+            sscanf(v, "%lx", &crc) != 1) {
+            http_ota_upload_reply(nc, 400, "no crc");
+            return;
+        }
+        if (http_find_header(hdr_start, hdr_end, HTTP_OTA_FW_HDR, &v, &vlen)) {
+            char tmp[32];
+
+            if (vlen <= 0 || vlen >= (int)sizeof(tmp)) {
+                http_ota_upload_reply(nc, 400, "bad fw");
+                return;
+            }
+            memcpy(tmp, v, (size_t)vlen);
+            tmp[vlen] = 0;
+            if (sscanf(tmp, "%lu %lx", &fw_size, &fw_crc) != 2) {
+                http_ota_upload_reply(nc, 400, "bad fw");
+                return;
+            }
+        }
+        http_lock();
+        rc = ota_stream_begin(total, (uint32_t)crc, (uint32_t)fw_size, (uint32_t)fw_crc);
+        http_unlock();
+        if (rc != 0) {
+            http_ota_upload_reply(nc, 400, "begin failed");
+            return;
+        }
+    }
+
+    http_lock();
+    ota_stream_status(&st);
+    http_unlock();
+    if (!st.active || st.size != total || first > st.written) {
+        http_ota_upload_reply(nc, 416, "resume from written");
+        return;
+    }
+
+    u.pos  = first;
+    u.left = last - first + 1u;
+
+    httpd_dbg("ota upload %lu-%lu/%lu at %lu", (unsigned long)first, (unsigned long)last,
+              (unsigned long)total, (unsigned long)st.written);
+
+    if (body_have > 0 && http_ota_upload_feed(&u, body, (uint32_t)body_have) != 0) {
+        http_ota_upload_reply(nc, 500, "write failed");
+        return;
+    }
+    if (rest != NULL && u.left > 0 && http_ota_upload_feed_netbuf(&u, rest, rest_used) != 0) {
+        http_ota_upload_reply(nc, 500, "write failed");
+        return;
+    }
+
+    while (u.left > 0) {
+        struct netbuf *nb = NULL;
+        int rc;
+
+        if (netconn_recv(nc, &nb) != ERR_OK || nb == NULL) {
+            if (nb) { netbuf_delete(nb); }
+            /* peer is gone; the session stays open for a resume */
+            return;
+        }
+        rc = http_ota_upload_feed_netbuf(&u, nb, 0);
+        netbuf_delete(nb);
+        if (rc != 0) {
+            http_ota_upload_reply(nc, 500, "write failed");
+            return;
+        }
+    }
+
+    {
+        int32_t rc = 0;
+
+        http_lock();
+        ota_stream_status(&st);
+        if (st.written == st.size) {
+            rc = ota_stream_end();
+        }
+        http_unlock();
+        if (st.written == st.size) {
+            http_assets_changed();
+        }
+        if (rc != 0) {
+            http_ota_upload_reply(nc, 500, "verify failed");
+            return;
+        }
+    }
+
+    http_ota_upload_reply(nc, 200, NULL);
 }
 
 /* -------------------------------------------------------------------------- */
-/* One connection                                                             */
+/* Statistics stream                                                          */
 /* -------------------------------------------------------------------------- */
 
-static void http_handle_one( struct netconn *nc ){
-    char buf[HTTP_REQ_MAX + 1];
+/*
+ * GET /api/stat_stream?hz=N  (text/event-stream, 1..10 Hz)
+ * Every tick sends one "data:" line with only the fields that changed since
+ * the previous event (the first event carries all of them):
+ *   up       uptime, s
+ *   rxb txb  radio bytes        rxp txp  radio packets
+ *   rxr txr  bit/s over the tick
+ *   nl ns    background noise long/short, dBm
+ *   at cu    airtime / channel utilisation, 0.1 %
+ * Nothing but a comment ping is sent while values do not change.
+ */
+
+typedef enum {
+    HTTP_SSE_UP = 0,
+    HTTP_SSE_RXB,
+    HTTP_SSE_TXB,
+    HTTP_SSE_RXP,
+    HTTP_SSE_TXP,
+    HTTP_SSE_RXR,
+    HTTP_SSE_TXR,
+    HTTP_SSE_NL,
+    HTTP_SSE_NS,
+    HTTP_SSE_AT,
+    HTTP_SSE_CU,
+    HTTP_SSE_FIELDS,
+} http_sse_field_t;
+
+static const char *const g_http_sse_names[HTTP_SSE_FIELDS] = {
+    "up", "rxb", "txb", "rxp", "txp", "rxr", "txr", "nl", "ns", "at", "cu",
+};
+
+static int g_http_sse_streams;     // under g_http_lock
+
+static void http_sse_sample( int64_t *v, const int64_t *prev, int64_t dt_us ){
+    statistics_radio_t st = statistics_radio_get();
+    struct timespec tm;
+
+    os_systime(&tm);
+
+    v[HTTP_SSE_UP]  = (int64_t)tm.tv_sec;
+    v[HTTP_SSE_RXB] = (int64_t)st.rx_bytes;
+    v[HTTP_SSE_TXB] = (int64_t)st.tx_bytes;
+    v[HTTP_SSE_RXP] = (int64_t)st.rx_packets;
+    v[HTTP_SSE_TXP] = (int64_t)st.tx_packets;
+    v[HTTP_SSE_RXR] = 0;
+    v[HTTP_SSE_TXR] = 0;
+    if (prev != NULL && dt_us > 0) {
+        v[HTTP_SSE_RXR] = (v[HTTP_SSE_RXB] - prev[HTTP_SSE_RXB]) * 8 * 1000000 / dt_us;
+        v[HTTP_SSE_TXR] = (v[HTTP_SSE_TXB] - prev[HTTP_SSE_TXB]) * 8 * 1000000 / dt_us;
+    }
+    /* live LBT values, the statistics task only refreshes them once a second */
+    v[HTTP_SSE_NL]  = halow_lbt_background_long_dbm_get();
+    v[HTTP_SSE_NS]  = halow_lbt_background_short_dbm_get();
+    v[HTTP_SSE_AT]  = (int64_t)(halow_lbt_airtime_get() * 1000.0f + 0.5f);
+    v[HTTP_SSE_CU]  = (int64_t)(halow_lbt_ch_util_get() * 1000.0f + 0.5f);
+}
+
+/* true while the peer has not closed; request bytes it sends are dropped */
+static bool http_sse_peer_open( struct netconn *nc ){
+    struct netbuf *nb = NULL;
+    err_t err;
+
+    netconn_set_nonblocking(nc, 1);
+    err = netconn_recv(nc, &nb);
+    netconn_set_nonblocking(nc, 0);
+
+    if (nb != NULL) {
+        netbuf_delete(nb);
+    }
+    return (err == ERR_OK || err == ERR_WOULDBLOCK);
+}
+
+static void http_handle_stat_stream( struct netconn *nc, const char *query ){
+    static const char hdr[] =
+        "HTTP/1.1 200\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "retry: 2000\n\n";
+    char line[HTTP_SSE_FIELDS * 28 + 16];
+    json_writer_t jw;
+    int64_t cur[HTTP_SSE_FIELDS];
+    int64_t last[HTTP_SSE_FIELDS];
+    int64_t t_prev;
+    uint32_t period_ms;
+    uint32_t idle_ms = 0;
+    const char *hz_arg;
+    int hz = HTTP_STAT_STREAM_HZ_DEF;
+    bool first = true;
+    bool slot;
+
+    http_conn_force_close(nc);
+
+    hz_arg = (query != NULL) ? strstr(query, "hz=") : NULL;
+    if (hz_arg != NULL) {
+        hz = atoi(hz_arg + 3);
+    }
+    if (hz < 1) {
+        hz = 1;
+    }
+    if (hz > HTTP_STAT_STREAM_HZ_MAX) {
+        hz = HTTP_STAT_STREAM_HZ_MAX;
+    }
+    period_ms = 1000u / (uint32_t)hz;
+
+    http_lock();
+    slot = (g_http_sse_streams < HTTP_STAT_STREAM_MAX);
+    if (slot) {
+        g_http_sse_streams++;
+    }
+    http_unlock();
+    if (!slot) {
+        http_send_text(nc, 503, "too many streams\n");
+        return;
+    }
+
+    httpd_dbg("stat stream %d Hz", hz);
+
+    if (netconn_write(nc, hdr, sizeof(hdr) - 1, NETCONN_NOCOPY) != ERR_OK) {
+        goto done;
+    }
+
+    t_prev = get_time_us();
+    http_sse_sample(last, NULL, 0);
+
+    /* "data:" + JSON object + "\n\n" */
+    memcpy(line, "data:", 5);
+
+    while (http_sse_peer_open(nc)) {
+        int64_t t_now = get_time_us();
+        int32_t n;
+        bool changed = false;
+        int i;
+
+        http_sse_sample(cur, last, t_now - t_prev);
+        t_prev = t_now;
+
+        json_writer_init(&jw, line + 5, sizeof(line) - 5 - 2, NULL, NULL);
+        json_obj_begin(&jw, NULL);
+        for (i = 0; i < HTTP_SSE_FIELDS; i++) {
+            if (!first && cur[i] == last[i]) {
+                continue;
+            }
+            json_add_int(&jw, g_http_sse_names[i], cur[i]);
+            last[i] = cur[i];
+            changed = true;
+        }
+        json_obj_end(&jw);
+        n = json_writer_finish(&jw);
+
+        if (changed && n > 0) {
+            memcpy(line + 5 + n, "\n\n", 2);
+            idle_ms = 0;
+            first = false;
+            if (netconn_write(nc, line, (size_t)n + 5 + 2, NETCONN_COPY) != ERR_OK) {
+                break;
+            }
+        } else {
+            idle_ms += period_ms;
+            if (idle_ms >= HTTP_STAT_STREAM_PING_S * 1000u) {
+                idle_ms = 0;
+                if (netconn_write(nc, ":\n\n", 3, NETCONN_NOCOPY) != ERR_OK) {
+                    break;
+                }
+            }
+        }
+
+        os_sleep_ms(period_ms);
+    }
+
+done:
+    http_lock();
+    g_http_sse_streams--;
+    http_unlock();
+    httpd_dbg("stat stream closed");
+}
+
+/* -------------------------------------------------------------------------- */
+/* One request                                                                */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Serves the request at the head of w->buf. Returns true if the connection
+ * stays open; bytes of a pipelined next request are moved to the buf head.
+ */
+static bool http_handle_request( http_worker_t *w, int served ){
+    struct netconn *nc = w->nc;
+    char *buf = w->buf;
     int n;
     char method[8];
     char uri[128];
+    const char *query = "";
     char *hdr_end;
     int header_len;
     int content_len;
     const char *body;
     int body_len;
+    int used = 0;
+    bool keep = false;
+    struct netbuf *rest = NULL;
+    int rest_used = 0;
 
-    if (nc == NULL) {
-        return;
-    }
-
-    memset(buf, 0, sizeof(buf));
     memset(method, 0, sizeof(method));
     memset(uri, 0, sizeof(uri));
+    w->keep_alive = false;
 
-    n = http_recv_request(nc, buf, sizeof(buf));
+    n = http_recv_request(nc, buf, HTTP_REQ_MAX + 1, w->len, &rest, &rest_used);
     if (n <= 0) {
-        return;
+        goto out;
     }
     buf[n] = 0;
 
     hdr_end = strstr(buf, "\r\n\r\n");
     if (hdr_end == NULL) {
         http_send_text(nc, 400, "bad request\n");
-        return;
+        goto out;
     }
 
     if (!http_parse_request_line(buf, method, sizeof(method), uri, sizeof(uri))) {
         http_send_text(nc, 400, "bad request\n");
-        return;
+        goto out;
     }
 
     {
         char *q;
 
         q = strchr(uri, '?');
-        if (q) { *q = 0; }
+        if (q) { *q = 0; query = q + 1; }
         q = strchr(uri, '#');
         if (q) { *q = 0; }
     }
@@ -555,28 +1447,99 @@ static void http_handle_one( struct netconn *nc ){
         body_len = content_len;
     }
 
+    /* streamed body, may be far larger than buf; closes the connection */
+    if (strcmp(uri, HTTP_OTA_UPLOAD_URI) == 0 &&
+        (strcmp(method, "PUT") == 0 || strcmp(method, "POST") == 0)) {
+        http_handle_ota_upload(nc, buf, hdr_end, (const uint8_t *)body, body_len, rest, rest_used);
+        goto out;
+    }
+
     if (content_len > 0 && body_len < content_len) {
-        http_send_text(nc, 400, "incomplete body\n");
-        return;
+        http_send_text(nc, (rest != NULL) ? 413 : 400,
+                       (rest != NULL) ? "payload too large\n" : "incomplete body\n");
+        goto out;
     }
     if (content_len > (HTTP_REQ_MAX - header_len)) {
         http_send_text(nc, 413, "payload too large\n");
-        return;
+        goto out;
     }
 
-    httpd_dbg("%s %s body=%d", method, uri, body_len);
+    w->keep_alive = (rest == NULL) &&
+                    (served + 1 < HTTP_KEEPALIVE_MAX_REQ) &&
+                    http_wants_keep_alive(buf, hdr_end);
+    used = header_len + body_len;
 
-    if (strncmp(uri, "/api/", 5) == 0) {
+    httpd_dbg("%s %s body=%d keep=%d", method, uri, body_len, (int)w->keep_alive);
+
+    if (strcmp(uri, HTTP_STAT_STREAM_URI) == 0 && strcmp(method, "GET") == 0) {
+        http_handle_stat_stream(nc, query);
+    } else if (strncmp(uri, "/api/", 5) == 0) {
         http_handle_api(nc, method, uri, body, body_len);
-        return;
+    } else {
+        http_serve_file(nc, uri, buf, hdr_end);
     }
 
-    http_serve_file(nc, uri);
+    keep = w->keep_alive;
+
+out:
+    if (keep && used < n) {
+        memmove(buf, buf + used, (size_t)(n - used));
+        w->len = n - used;
+    } else {
+        w->len = 0;
+    }
+    buf[w->len] = 0;
+
+    if (rest != NULL) {
+        netbuf_delete(rest);
+    }
+    return keep;
 }
 
 /* -------------------------------------------------------------------------- */
-/* Server task                                                                */
+/* Tasks                                                                      */
 /* -------------------------------------------------------------------------- */
+
+static void http_worker_task( void *arg ){
+    http_worker_t *w = (http_worker_t *)arg;
+
+    while (1) {
+        struct netconn *nc = http_queue_pop();
+        int served = 0;
+
+        if (nc == NULL) {
+            continue;
+        }
+
+        w->len = 0;
+        w->nc  = nc;
+        w->keep_alive = false;
+
+        /* per connection, idle workers keep no request buffer */
+        w->buf = (char *)os_malloc(HTTP_REQ_MAX + 1);
+        if (w->buf == NULL) {
+            http_send_text(nc, 503, "out of memory\n");
+        } else {
+            w->buf[0] = 0;
+            netconn_set_recvtimeout(nc, HTTP_KEEPALIVE_IDLE_MS);
+
+            while (http_handle_request(w, served)) {
+                served++;
+                /* nothing pipelined and someone is queued: make room */
+                if (w->len == 0 && g_http_q_len > 0) {
+                    break;
+                }
+            }
+            os_free(w->buf);
+            w->buf = NULL;
+        }
+
+        w->nc = NULL;
+        netconn_close(nc);
+        netconn_delete(nc);
+    }
+}
+
 static void http_server_task( void *arg ){
     struct netconn *listen_nc = NULL;
 
@@ -605,30 +1568,55 @@ static void http_server_task( void *arg ){
             continue;
         }
 
-        http_handle_one(client);
-        netconn_close(client);
-        netconn_delete(client);
+        if (!http_queue_push(client)) {
+            http_send_text(client, 503, "busy\n");
+            netconn_close(client);
+            netconn_delete(client);
+        }
     }
 }
 
-int32_t config_page_init( void ){
+static int32_t http_task_start( struct os_task *task, const char *name,
+                                void (*func)(void *), void *arg, int32_t stack ){
     int32_t ret;
-    lfs_mkdir(&g_lfs, WWW_DIR);
-    ret = os_task_init((const uint8 *)"httpd", &g_http_task, http_server_task, 0);
+
+    ret = os_task_init((const uint8 *)name, task, (os_task_func_t)func, (uint32)arg);
     if (ret != 0) {
         return ret;
     }
 
-    ret = os_task_set_stacksize(&g_http_task, CONFIG_PAGE_TASK_STACK);
+    ret = os_task_set_stacksize(task, stack);
     if (ret != 0) {
         return ret;
     }
 
-    ret = os_task_set_priority(&g_http_task, CONFIG_PAGE_TASK_PRIO);
+    ret = os_task_set_priority(task, CONFIG_PAGE_TASK_PRIO);
     if (ret != 0) {
         return ret;
     }
 
-    ret = os_task_run(&g_http_task);
-    return ret;
+    return os_task_run(task);
+}
+
+int32_t config_page_init( void ){
+    int32_t ret;
+    int i;
+
+    lfs_mkdir(&g_lfs, WWW_DIR);
+
+    os_mutex_init(&g_http_lock);
+    os_mutex_init(&g_http_q_lock);
+    os_sema_init(&g_http_q_sem, 0);
+
+    for (i = 0; i < CONFIG_PAGE_HTTP_WORKERS; i++) {
+        http_worker_t *w = &g_http_workers[i];
+
+        snprintf(w->name, sizeof(w->name), "httpd%d", i);
+        ret = http_task_start(&w->task, w->name, http_worker_task, w, CONFIG_PAGE_WORKER_STACK);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return http_task_start(&g_http_task, "httpd", http_server_task, NULL, CONFIG_PAGE_TASK_STACK);
 }
@@ -0,0 +1,314 @@
+#include "config_page/json_writer.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "cJSON.h"
+
+static void jw_flush( json_writer_t *jw ){
+    if (jw->len == 0 || jw->flush_cb == NULL) {
+        return;
+    }
+    if (jw->flush_cb(jw->flush_arg, jw->buf, jw->len) != 0) {
+        jw->overflow = true;
+    }
+    jw->len = 0;
+}
+
+static void jw_put( json_writer_t *jw, const char *s, uint32_t n ){
+    while (n > 0 && !jw->overflow) {
+        uint32_t room = jw->size - jw->len;
+        uint32_t take = (n < room) ? n : room;
+
+        memcpy(jw->buf + jw->len, s, take);
+        jw->len   += take;
+        jw->total += take;
+        s += take;
+        n -= take;
+
+        if (n > 0) {
+            if (jw->flush_cb == NULL) {
+                jw->overflow = true;
+                return;
+            }
+            jw_flush(jw);
+        }
+    }
+}
+
+static void jw_putc( json_writer_t *jw, char c ){
+    if (jw->len < jw->size) {
+        jw->buf[jw->len++] = c;
+        jw->total++;
+        return;
+    }
+    jw_put(jw, &c, 1);
+}
+
+static void jw_put_str( json_writer_t *jw, const char *s ){
+    static const char hex[] = "0123456789abcdef";
+    const char *run = s;
+
+    jw_putc(jw, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        char esc[6];
+        uint32_t n = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        jw_put(jw, run, (uint32_t)(s - run));
+        run = s + 1;
+
+        esc[0] = '\\';
+        switch (c) {
+        case '"':  esc[1] = '"';  break;
+        case '\\': esc[1] = '\\'; break;
+        case '\n': esc[1] = 'n';  break;
+        case '\r': esc[1] = 'r';  break;
+        case '\t': esc[1] = 't';  break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0x0F];
+            n = 6;
+            break;
+        }
+        jw_put(jw, esc, n);
+    }
+    jw_put(jw, run, (uint32_t)(s - run));
+    jw_putc(jw, '"');
+}
+
+/* separator and key for the next value at the current depth */
+static void jw_member( json_writer_t *jw, const char *key ){
+    uint16_t bit = (uint16_t)(1u << jw->depth);
+
+    if (jw->first & bit) {
+        jw->first &= (uint16_t)~bit;
+    } else if (jw->depth > 0) {
+        jw_putc(jw, ',');
+    }
+
+    if (key != NULL) {
+        jw_put_str(jw, key);
+        jw_putc(jw, ':');
+    }
+}
+
+/* Tree mode: attach item to the container open at the current depth */
+static void jw_tree_add( json_writer_t *jw, const char *key, cJSON *item ){
+    cJSON *parent = jw->tree[jw->depth];
+
+    if (item == NULL) {
+        jw->overflow = true;
+        return;
+    }
+    if (jw->overflow || ((jw->depth == 0) && (parent != NULL))) {
+        cJSON_Delete(item);
+        jw->overflow = true;
+        return;
+    }
+    if (jw->depth == 0) {
+        jw->tree[0] = item;                 // root
+    } else if (key != NULL) {
+        cJSON_AddItemToObject(parent, key, item);
+    } else {
+        cJSON_AddItemToArray(parent, item);
+    }
+}
+
+static void jw_open( json_writer_t *jw, const char *key, char c ){
+    if (jw->tree != NULL) {
+        cJSON *item = NULL;
+
+        if (jw->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+            jw->overflow = true;
+            return;
+        }
+        if (!jw->overflow) {
+            item = (c == '{') ? cJSON_CreateObject() : cJSON_CreateArray();
+            jw_tree_add(jw, key, item);
+        }
+        jw->depth++;
+        jw->tree[jw->depth] = jw->overflow ? NULL : item;
+        return;
+    }
+
+    jw_member(jw, key);
+    jw_putc(jw, c);
+
+    if (jw->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        jw->overflow = true;
+        return;
+    }
+    jw->depth++;
+    jw->first |= (uint16_t)(1u << jw->depth);
+}
+
+static void jw_close( json_writer_t *jw, char c ){
+    if (jw->depth > 0) {
+        jw->depth--;
+    }
+    if (jw->tree != NULL) {
+        return;
+    }
+    jw_putc(jw, c);
+}
+
+void json_writer_init( json_writer_t *jw, char *buf, uint32_t size,
+                       json_writer_flush_cb flush_cb, void *flush_arg ){
+    if (jw == NULL) {
+        return;
+    }
+
+    jw->buf       = buf;
+    jw->size      = (buf != NULL) ? size : 0;
+    jw->flush_cb  = flush_cb;
+    jw->flush_arg = flush_arg;
+    jw->tree      = NULL;
+    json_writer_reset(jw);
+}
+
+void json_writer_init_tree( json_writer_t *jw, struct cJSON **stack ){
+    if ((jw == NULL) || (stack == NULL)) {
+        return;
+    }
+
+    memset(jw, 0, sizeof(*jw));
+    memset(stack, 0, JSON_WRITER_MAX_DEPTH * sizeof(stack[0]));
+    jw->tree  = stack;
+    jw->first = 1u;
+}
+
+void json_writer_reset( json_writer_t *jw ){
+    if (jw == NULL) {
+        return;
+    }
+
+    jw->len      = 0;
+    jw->total    = 0;
+    jw->first    = 1u;
+    jw->depth    = 0;
+    jw->overflow = (jw->size == 0) && (jw->tree == NULL);
+}
+
+int32_t json_writer_finish( json_writer_t *jw ){
+    if (jw == NULL) {
+        return -1;
+    }
+
+    if (jw->tree != NULL) {
+        return jw->overflow ? -1 : 0;
+    }
+    jw_flush(jw);
+    return jw->overflow ? -1 : (int32_t)jw->total;
+}
+
+void json_obj_begin( json_writer_t *jw, const char *key ){
+    jw_open(jw, key, '{');
+}
+
+void json_obj_end( json_writer_t *jw ){
+    jw_close(jw, '}');
+}
+
+void json_arr_begin( json_writer_t *jw, const char *key ){
+    jw_open(jw, key, '[');
+}
+
+void json_arr_end( json_writer_t *jw ){
+    jw_close(jw, ']');
+}
+
+void json_add_str( json_writer_t *jw, const char *key, const char *s ){
+    if (jw->tree != NULL) {
+        jw_tree_add(jw, key, (s != NULL) ? cJSON_CreateString(s) : cJSON_CreateNull());
+        return;
+    }
+    jw_member(jw, key);
+    if (s == NULL) {
+        jw_put(jw, "null", 4);
+        return;
+    }
+    jw_put_str(jw, s);
+}
+
+void json_add_int( json_writer_t *jw, const char *key, int64_t v ){
+    char tmp[21];
+    int n = (int)sizeof(tmp);
+    uint64_t u = (v < 0) ? ((uint64_t)(-(v + 1)) + 1u) : (uint64_t)v;
+
+    if (jw->tree != NULL) {
+        jw_tree_add(jw, key, cJSON_CreateNumber((double)v));
+        return;
+    }
+
+    do {
+        tmp[--n] = (char)('0' + (u % 10u));
+        u /= 10u;
+    } while (u != 0u);
+    if (v < 0) {
+        tmp[--n] = '-';
+    }
+
+    jw_member(jw, key);
+    jw_put(jw, tmp + n, (uint32_t)(sizeof(tmp) - (size_t)n));
+}
+
+void json_add_bool( json_writer_t *jw, const char *key, bool v ){
+    if (jw->tree != NULL) {
+        jw_tree_add(jw, key, cJSON_CreateBool(v));
+        return;
+    }
+    jw_member(jw, key);
+    if (v) {
+        jw_put(jw, "true", 4);
+    } else {
+        jw_put(jw, "false", 5);
+    }
+}
+
+void json_add_null( json_writer_t *jw, const char *key ){
+    if (jw->tree != NULL) {
+        jw_tree_add(jw, key, cJSON_CreateNull());
+        return;
+    }
+    jw_member(jw, key);
+    jw_put(jw, "null", 4);
+}
+
+void json_add_num( json_writer_t *jw, const char *key, double v, int prec ){
+    char tmp[32];
+    int n;
+
+    /* JSON has no NaN/Inf */
+    if (v != v || v > 1e308 || v < -1e308) {
+        json_add_null(jw, key);
+        return;
+    }
+    if (jw->tree != NULL) {
+        jw_tree_add(jw, key, cJSON_CreateNumber(v));
+        return;
+    }
+    if (v < 9.2e18 && v > -9.2e18 && v == (double)(int64_t)v) {
+        json_add_int(jw, key, (int64_t)v);
+        return;
+    }
+
+    if (prec <= 0 || prec > 17) {
+        prec = 15;
+    }
+    n = snprintf(tmp, sizeof(tmp), "%.*g", prec, v);
+    if (n <= 0 || n >= (int)sizeof(tmp)) {
+        json_add_null(jw, key);
+        return;
+    }
+
+    jw_member(jw, key);
+    jw_put(jw, tmp, (uint32_t)n);
+}
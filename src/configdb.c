@@ -3,6 +3,7 @@
 #include "lib/flashdb/flashdb.h"
 #include "lib/fal/fal.h"
 #include "osal/mutex.h"
+#include "fal_norflash_port.h"
 #include <string.h>
 
 //#define CONFIGDB_DEBUG
@@ -61,11 +62,14 @@ static fdb_kvdb_t configdb_grab(void){
 }
 
 static void configdb_release(void){
+    /* KV updates are coalesced in the flash sector cache, commit them now */
+    (void)fal_norflash_flush();
     os_mutex_unlock(&g_cfg_db_access_mutex);
 }
 
 int32_t configdb_init(void){
     int32_t res = (int32_t)fdb_kvdb_init(&g_cfg_db, "cfg", "fdb_kvdb1", NULL, 0);
+    (void)fal_norflash_flush();
     if (res != FDB_NO_ERR) {
         return -2;
     }
@@ -0,0 +1,283 @@
+#include "deframer.h"
+
+#include <string.h>
+
+//#define DEFRAMER_DEBUG
+
+#ifdef DEFRAMER_DEBUG
+#include "basic_include.h"
+#define dfr_debug(fmt, ...)  os_printf("[DFR] " fmt "\r\n", ##__VA_ARGS__)
+#else
+#define dfr_debug(fmt, ...)  do { } while (0)
+#endif
+
+void deframer_init(deframer_t *d, deframer_mode_t mode, uint8_t *buf, uint32_t buf_size,
+                   uint32_t raw_max, deframer_frame_cb frame_cb, deframer_cmd_cb cmd_cb, void *arg){
+    if (d == NULL) {
+        return;
+    }
+
+    memset(d, 0, sizeof(*d));
+    d->mode_cfg = mode;
+    d->buf      = buf;
+    d->buf_size = buf_size;
+    d->raw_max  = ((raw_max == 0) || (raw_max > buf_size)) ? buf_size : raw_max;
+    d->frame_cb = frame_cb;
+    d->cmd_cb   = cmd_cb;
+    d->cb_arg   = arg;
+    deframer_reset(d);
+}
+
+void deframer_reset(deframer_t *d){
+    if (d == NULL) {
+        return;
+    }
+
+    d->mode    = d->mode_cfg;
+    d->synced  = false;
+    d->discard = false;
+    d->buf_len = 0;
+}
+
+/* Pieces of the open frame that still point into the segments being fed */
+typedef struct {
+    deframer_seg_t seg[DEFRAMER_SEGS_MAX];
+    uint32_t cnt;
+    uint32_t len;
+} deframer_open_t;
+
+static uint8_t deframer_byte_at(const deframer_seg_t *seg, uint32_t cnt, uint32_t off){
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (off < seg[i].len) {
+            return seg[i].data[off];
+        }
+        off -= seg[i].len;
+    }
+    return 0;
+}
+
+/* Command frames are rare, their payload is made contiguous in buf */
+static const uint8_t *deframer_flatten(deframer_t *d, const deframer_seg_t *seg, uint32_t cnt){
+    uint32_t off = 0;
+
+    if (cnt == 1) {
+        return seg[0].data;
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (seg[i].data != d->buf + off) {
+            memcpy(d->buf + off, seg[i].data, seg[i].len);
+        }
+        off += seg[i].len;
+    }
+    return d->buf;
+}
+
+static void deframer_emit(deframer_t *d, const deframer_seg_t *seg, uint32_t cnt, uint32_t len){
+    uint8_t cmd;
+
+    /* delimiter + delimiter: empty frame or inter-frame padding */
+    if (len <= 2u) {
+        return;
+    }
+
+    if (len > d->buf_size) {
+        d->dropped++;
+        dfr_debug("drop oversized frame len=%u", (unsigned)len);
+        return;
+    }
+
+    if (d->mode != DEFRAMER_MODE_KISS) {
+        d->frames++;
+        if (d->frame_cb != NULL) {
+            d->frame_cb(d->cb_arg, seg, cnt, len);
+        }
+        return;
+    }
+
+    cmd = deframer_byte_at(seg, cnt, 1);
+    if (cmd == DEFRAMER_KISS_FESC) {
+        d->dropped++;
+        return;
+    }
+
+    if ((cmd & DEFRAMER_KISS_CMD_MASK) == DEFRAMER_KISS_CMD_DATA) {
+        d->frames++;
+        if (d->frame_cb != NULL) {
+            d->frame_cb(d->cb_arg, seg, cnt, len);
+        }
+        return;
+    }
+
+    d->commands++;
+    if (d->cmd_cb != NULL) {
+        d->cmd_cb(d->cb_arg, cmd, deframer_flatten(d, seg, cnt) + 2, len - 3u);
+    }
+}
+
+static void deframer_overflow(deframer_t *d, deframer_open_t *o){
+    d->discard = true;
+    d->buf_len = 0;
+    o->cnt     = 0;
+    o->len     = 0;
+    d->dropped++;
+    dfr_debug("drop frame, assembly buffer overflow");
+}
+
+/* Copies the held pieces into buf before their segments go away */
+static void deframer_spill(deframer_t *d, deframer_open_t *o){
+    for (uint32_t i = 0; i < o->cnt; i++) {
+        memcpy(d->buf + d->buf_len, o->seg[i].data, o->seg[i].len);
+        d->buf_len += o->seg[i].len;
+    }
+    o->cnt = 0;
+    o->len = 0;
+}
+
+/* Middle or tail of the open frame: kept by reference while there is room */
+static void deframer_hold(deframer_t *d, deframer_open_t *o, const uint8_t *data, uint32_t len){
+    if ((d->buf == NULL) || (d->buf_len + o->len + len > d->buf_size)) {
+        deframer_overflow(d, o);
+        return;
+    }
+    if (o->cnt == DEFRAMER_SEGS_MAX) {
+        deframer_spill(d, o);
+    }
+    o->seg[o->cnt].data = data;
+    o->seg[o->cnt].len  = len;
+    o->cnt++;
+    o->len += len;
+}
+
+/* Closing piece of a frame whose head arrived in an earlier segment */
+static void deframer_close(deframer_t *d, deframer_open_t *o, const uint8_t *data, uint32_t len){
+    deframer_seg_t seg[DEFRAMER_FRAME_SEGS_MAX];
+    uint32_t cnt = 0;
+    uint32_t total = d->buf_len + o->len + len;
+
+    if ((d->buf == NULL) || (total > d->buf_size)) {
+        deframer_overflow(d, o);
+        d->discard = false;
+        return;
+    }
+    if (d->buf_len > 0) {
+        seg[cnt].data = d->buf;
+        seg[cnt].len  = d->buf_len;
+        cnt++;
+    }
+    for (uint32_t i = 0; i < o->cnt; i++) {
+        seg[cnt++] = o->seg[i];
+    }
+    seg[cnt].data = data;
+    seg[cnt].len  = len;
+    cnt++;
+
+    deframer_emit(d, seg, cnt, total);
+    d->buf_len = 0;
+    o->cnt     = 0;
+    o->len     = 0;
+}
+
+static void deframer_feed_raw(deframer_t *d, const uint8_t *data, uint32_t len){
+    uint32_t off = 0;
+
+    while (off < len) {
+        deframer_seg_t seg;
+
+        seg.data = data + off;
+        seg.len  = len - off;
+        if (seg.len > d->raw_max) {
+            seg.len = d->raw_max;
+        }
+        d->frames++;
+        if (d->frame_cb != NULL) {
+            d->frame_cb(d->cb_arg, &seg, 1, seg.len);
+        }
+        off += seg.len;
+    }
+}
+
+static void deframer_feed_one(deframer_t *d, deframer_open_t *o, const uint8_t *data, uint32_t len){
+    const uint8_t *p;
+    uint32_t pos;
+    uint32_t start;
+    uint8_t delim;
+
+    if (d->mode == DEFRAMER_MODE_AUTO) {
+        if (data[0] == DEFRAMER_KISS_FEND) {
+            d->mode = DEFRAMER_MODE_KISS;
+        } else if (data[0] == DEFRAMER_HDLC_FLAG) {
+            d->mode = DEFRAMER_MODE_HDLC;
+        } else {
+            d->mode = DEFRAMER_MODE_RAW;
+        }
+        dfr_debug("auto mode -> %d", (int)d->mode);
+    }
+
+    if (d->mode == DEFRAMER_MODE_RAW) {
+        deframer_feed_raw(d, data, len);
+        return;
+    }
+
+    delim = (d->mode == DEFRAMER_MODE_KISS) ? DEFRAMER_KISS_FEND : DEFRAMER_HDLC_FLAG;
+    pos   = 0;
+    start = 0;
+
+    while (pos < len) {
+        uint32_t idx;
+
+        p = (const uint8_t *)memchr(data + pos, delim, len - pos);
+        if (p == NULL) {
+            break;
+        }
+        idx = (uint32_t)(p - data);
+
+        if (!d->synced) {
+            d->synced  = true;
+        } else if (d->discard) {
+            d->discard = false;
+            d->buf_len = 0;
+        } else if ((d->buf_len > 0) || (o->cnt > 0)) {
+            /* frame head arrived in an earlier segment */
+            deframer_close(d, o, data + start, idx - start + 1u);
+        } else {
+            deframer_seg_t seg;
+
+            seg.data = data + start;
+            seg.len  = idx - start + 1u;
+            deframer_emit(d, &seg, 1, seg.len);
+        }
+
+        /* closing delimiter doubles as the opening one of the next frame */
+        start = idx;
+        pos   = idx + 1u;
+    }
+
+    if (d->synced && !d->discard) {
+        deframer_hold(d, o, data + start, len - start);
+    }
+}
+
+void deframer_feed_segs(deframer_t *d, const deframer_seg_t *seg, uint32_t cnt){
+    deframer_open_t o;
+
+    if ((d == NULL) || (seg == NULL) || (d->buf_size == 0)) {
+        return;
+    }
+
+    o.cnt = 0;
+    o.len = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        if ((seg[i].data != NULL) && (seg[i].len != 0)) {
+            deframer_feed_one(d, &o, seg[i].data, seg[i].len);
+        }
+    }
+    deframer_spill(d, &o);
+}
+
+void deframer_feed(deframer_t *d, const uint8_t *data, uint32_t len){
+    deframer_seg_t seg;
+
+    seg.data = data;
+    seg.len  = len;
+    deframer_feed_segs(d, &seg, 1);
+}
@@ -49,6 +49,7 @@
 #include "dev/spi/hgspi_dw.h"
 #include "dev/crc/hg_crc.h"
 #include "dev/sysaes/hg_sysaes.h"
+#include "fal_norflash_port.h"
 
 extern const struct hgwphy_ah_cfg nphyahcfg;
 extern union _dpd_ram dpd_ram;
@@ -254,6 +255,7 @@ struct gpio_device *gpio_get(uint32 pin) {
 }
 
 void device_reboot(void){
+    (void)fal_norflash_flush();
     mcu_watchdog_timeout(1);
     disable_irq();
     while(1){}
@@ -7,11 +7,17 @@
 #include "lib/lmac/hgic.h"
 #include "lib/skb/skb.h"
 #include "lib/skb/skbuff.h"
+#include "lib/skb/skb_list.h"
 #include "osal/semaphore.h"
+#include "osal/mutex.h"
+#include "osal/task.h"
 #include "osal/string.h"
 #include "halow_lbt.h"
+#include "halow_ppdu.h"
+#include "halow_fec.h"
 #include "configdb.h"
 #include "sys_config.h"
+#include "utils.h"
 
 #define HALOW_CONFIG_PREFIX             CONFIGDB_ADD_MODULE("halow")
 #define HALOW_CONFIG_ADD_CONFIG(name)   HALOW_CONFIG_PREFIX "." name
@@ -21,6 +27,11 @@
 #define HALOW_CONFIG_BANDWIDTH_NAME     HALOW_CONFIG_ADD_CONFIG("band")
 #define HALOW_CONFIG_MCS_NAME           HALOW_CONFIG_ADD_CONFIG("mcs")
 #define HALOW_CONFIG_SPOWER_EN_NAME     HALOW_CONFIG_ADD_CONFIG("spwr")
+#define HALOW_CONFIG_AGG_MAX_NAME       HALOW_CONFIG_ADD_CONFIG("agg_max")
+#define HALOW_CONFIG_AGG_HOLD_NAME      HALOW_CONFIG_ADD_CONFIG("agg_hold")
+#define HALOW_CONFIG_FEC_K_NAME         HALOW_CONFIG_ADD_CONFIG("fec_k")
+#define HALOW_CONFIG_FEC_M_NAME         HALOW_CONFIG_ADD_CONFIG("fec_m")
+#define HALOW_CONFIG_FEC_HOLD_NAME      HALOW_CONFIG_ADD_CONFIG("fec_hold")
 
 /* ===== Wi-Fi HaLow fixed config ===== */
 
@@ -33,6 +44,9 @@
 #define HALOW_ANT_AUTO_EN       0
 #define HALOW_ANT_SEL           0
 
+/* PHY */
+#define HALOW_TX_SHORT_GI       0
+
 /* Aggregation */
 #define HALOW_TX_AGGCNT         1
 #define HALOW_RX_AGGCNT         1
@@ -64,6 +78,62 @@
 #define HALOW_DBG_LEVEL         0
 #define TX_BUFFER_SIZE          (4*1024)
 
+/* TX queue between callers of halow_tx() and the LMAC */
+#ifndef HALOW_TXQ_MAX_FRAMES
+#define HALOW_TXQ_MAX_FRAMES    32
+#endif
+
+#ifndef HALOW_TXQ_MAX_BYTES
+#define HALOW_TXQ_MAX_BYTES     (16*1024)
+#endif
+
+/* What halow_tx() does on a full queue, halow_tx_iov_wait() waits first */
+#ifndef HALOW_TXQ_POLICY
+#define HALOW_TXQ_POLICY        HALOW_TXQ_POLICY_DROP_NEW
+#endif
+
+/*
+ * Software aggregation. LMAC aggregation (HALOW_TX_AGGCNT) stays at 1, all
+ * our frames are broadcast without a block ack session. Instead the TX task packs
+ * queued frames into one data frame as sub-frames of a big endian u16 length
+ * and the payload, marked by a reserved addr3. Receivers always split them.
+ */
+#define HALOW_AGG_SUBHDR_LEN    2
+#define HALOW_AGG_MAX_LIMIT     1600
+#define HALOW_AGG_MIN           64
+#define HALOW_AGG_HOLD_MAX_MS   50
+
+/*
+ * Forward error correction. With fec_k set, frames up to HALOW_FEC_PAYLOAD_MAX
+ * go out in blocks of fec_k data frames followed by m parity frames, all marked
+ * by a reserved addr3 and a header of block id, index (bit 7: parity), k (parity
+ * frames only) and flags. A block that does not fill up within fec_hold_ms is
+ * closed with what it has. The coded symbol of a data frame is a big endian u16
+ * of its payload length (bit 15: the payload is an aggregate) and the payload.
+ * Receivers deliver data frames as they come, keep the block per sender and
+ * restore the lost ones once enough parity is in. Receivers always decode.
+ * The coding buffers are heap allocated while in use: the TX parity once
+ * fec_k is set (freed when it is cleared), the RX blocks on the first FEC
+ * frame heard (freed after HALOW_FEC_RX_FREE_MS without one).
+ */
+#define HALOW_FEC_HDR_LEN       4
+#define HALOW_FEC_SYM_HDR_LEN   2
+#define HALOW_FEC_SYM_MAX       (HALOW_FEC_SYM_HDR_LEN + HALOW_FEC_PAYLOAD_MAX)
+#define HALOW_FEC_IDX_PARITY    0x80
+#define HALOW_FEC_FLAG_AGG      0x01
+#define HALOW_FEC_SYM_AGG       0x8000
+#define HALOW_FEC_HOLD_MAX_MS   200
+#define HALOW_FEC_RX_STALE_MS   1000        /* an idle sender's block id may have wrapped */
+#define HALOW_FEC_RX_FREE_MS    10000
+
+/* Loss estimate for adaptive parity: 802.11 sequence gaps of the senders we hear */
+#ifndef HALOW_LOSS_PEERS
+#define HALOW_LOSS_PEERS        4
+#endif
+#define HALOW_LOSS_GAP_MAX      64          /* larger jumps are a restart, not loss */
+#define HALOW_LOSS_WINDOW       64          /* frames per loss sample */
+#define HALOW_LOSS_EWMA_SHIFT   3
+
 //#define HALOW_DEBUG
 #ifdef HALOW_DEBUG
 #define halow_debug(fmt, ...)  os_printf("[HALW] " fmt "\r\n", ##__VA_ARGS__)
@@ -76,10 +146,83 @@
 static struct lmac_ops *g_ops = NULL;
 static halow_rx_cb g_rx_cb;
 static uint16_t g_seq;
+static struct ieee80211_hdr g_tx_hdr;
+static halow_config_t g_cfg_active = {
+    .central_freq   = HALOW_CONFIG_CENTRAL_FREQ_DEF,
+    .bandwidth      = HALOW_CONFIG_BANDWIDTH_DEF,
+    .mcs            = HALOW_CONFIG_MCS_DEF,
+    .rf_power       = HALOW_CONFIG_POWER_DEF,
+    .rf_super_power = HALOW_CONFIG_SPOWER_EN_DEF,
+    .agg_max        = HALOW_CONFIG_AGG_MAX_DEF,
+    .agg_hold_ms    = HALOW_CONFIG_AGG_HOLD_MS_DEF,
+    .fec_k          = HALOW_CONFIG_FEC_K_DEF,
+    .fec_m          = HALOW_CONFIG_FEC_M_DEF,
+    .fec_hold_ms    = HALOW_CONFIG_FEC_HOLD_MS_DEF,
+};
+
+/* Locally administered, never a real BSSID: plain frames carry the broadcast one */
+static const uint8_t g_agg_addr3[6] = { 0x02, 'R', 'N', 'A', 'G', 'G' };
+static halow_agg_stat_t g_agg_stat;
+
+static const uint8_t g_fec_addr3[6] = { 0x02, 'R', 'N', 'F', 'E', 'C' };
+static halow_fec_stat_t g_fec_stat;
+
+/* TX task only */
+typedef struct {
+    bool open;
+    uint8_t block;
+    uint8_t k;
+    uint8_t m;
+    uint8_t cnt;
+    uint16_t len;                   // Longest symbol so far, the parity length
+    int64_t deadline;
+    uint8_t (*parity)[HALOW_FEC_SYM_MAX];  // HALOW_FEC_M_MAX rows, NULL while FEC is off
+} halow_fec_tx_t;
+
+/* LMAC RX context only */
+typedef struct {
+    bool used;
+    bool done;                      // Complete or restored
+    uint8_t src[6];
+    uint8_t block;
+    uint8_t k;                      // From the parity frames, 0: none seen yet
+    uint8_t have;                   // Data frames received
+    uint8_t par_have;               // Parity frames received
+    uint16_t par_len;
+    uint16_t len[HALOW_FEC_K_MAX];
+    int64_t last_ms;
+    uint8_t data[HALOW_FEC_K_MAX][HALOW_FEC_SYM_MAX];
+    uint8_t parity[HALOW_FEC_M_MAX][HALOW_FEC_SYM_MAX];
+} halow_fec_rx_t;
+
+typedef struct {
+    bool used;
+    uint8_t src[6];
+    uint16_t seq;
+} halow_loss_peer_t;
+
+static halow_fec_tx_t g_fec_tx;
+static halow_fec_rx_t *g_fec_rx;            // HALOW_FEC_RX_PEERS blocks, NULL until FEC is heard
+static int64_t g_fec_rx_last_ms;
+static halow_loss_peer_t g_loss_peer[HALOW_LOSS_PEERS];
+static uint32_t g_loss_next;
+static uint32_t g_loss_rx;
+static uint32_t g_loss_lost;
+static int32_t g_loss_pm;
 
 static uint32_t g_tx_vacated_bytes = TX_BUFFER_SIZE;
 static struct os_semaphore g_tx_vacated_sem;
 
+static struct os_task g_tx_task;
+static struct os_mutex g_txq_lock;
+static struct os_semaphore g_txq_sem;
+static struct os_semaphore g_txq_space_sem;
+static struct skb_list g_txq;
+static uint32_t g_txq_bytes;
+static halow_txq_stat_t g_txq_stat;
+
+static int32_t halow_tx_task_init(void);
+
 // Disable broadcast
 int32_t __wrap_lmac_send_bss_announcement(void){
     return 0;
@@ -89,6 +232,287 @@ static inline void mac_bcast(uint8_t mac[6]) {
     memset(mac, 0xff, 6);
 }
 
+/* Every TX frame is a broadcast data frame, only seq_ctrl changes per frame.
+ * addr2 carries our own address once halow_set_addr() is called, so receivers
+ * can tell senders apart. */
+static void halow_tx_hdr_init(void) {
+    memset(&g_tx_hdr, 0, sizeof(g_tx_hdr));
+    g_tx_hdr.frame_control = (uint16_t)(WLAN_FTYPE_DATA | WLAN_STYPE_DATA);
+    mac_bcast(g_tx_hdr.addr1);
+    mac_bcast(g_tx_hdr.addr2);
+    mac_bcast(g_tx_hdr.addr3);
+}
+
+static void halow_agg_split(const halow_rx_meta_t *meta, const uint8_t *p, int32_t len){
+    g_agg_stat.rx_aggregates++;
+
+    while (len >= HALOW_AGG_SUBHDR_LEN) {
+        int32_t n = (int32_t)(((uint32_t)p[0] << 8) | p[1]);
+
+        p   += HALOW_AGG_SUBHDR_LEN;
+        len -= HALOW_AGG_SUBHDR_LEN;
+        if ((n == 0) || (n > len)) {
+            halow_debug("rx: bad sub-frame len=%ld left=%ld", (long)n, (long)len);
+            g_agg_stat.rx_errors++;
+            return;
+        }
+        g_agg_stat.rx_subframes++;
+        g_rx_cb(meta, p, n);
+        p   += n;
+        len -= n;
+    }
+    if (len != 0) {
+        g_agg_stat.rx_errors++;
+    }
+}
+
+static uint32_t halow_bits(uint32_t v){
+    uint32_t n = 0;
+
+    while (v) {
+        v &= v - 1U;
+        n++;
+    }
+    return n;
+}
+
+static void halow_loss_track(const uint8_t src[6], uint16_t seq_ctrl){
+    uint16_t seq = (uint16_t)((seq_ctrl >> 4) & 0x0fff);
+    halow_loss_peer_t *p = NULL;
+    uint32_t gap;
+
+    for (uint32_t i = 0; i < HALOW_LOSS_PEERS; i++) {
+        if (g_loss_peer[i].used && (memcmp(g_loss_peer[i].src, src, 6) == 0)) {
+            p = &g_loss_peer[i];
+            break;
+        }
+    }
+    if (p == NULL) {
+        p = &g_loss_peer[g_loss_next];
+        g_loss_next = (g_loss_next + 1U) % HALOW_LOSS_PEERS;
+        p->used = true;
+        memcpy(p->src, src, 6);
+        p->seq = seq;
+        return;
+    }
+
+    gap = (uint32_t)(seq - p->seq - 1U) & 0x0fff;
+    p->seq = seq;
+    if (gap >= HALOW_LOSS_GAP_MAX) {
+        return;
+    }
+    g_loss_rx++;
+    g_loss_lost += gap;
+    if ((g_loss_rx + g_loss_lost) >= HALOW_LOSS_WINDOW) {
+        int32_t sample = (int32_t)(g_loss_lost * 1000U / (g_loss_rx + g_loss_lost));
+
+        g_loss_pm  += (sample - g_loss_pm) / (1 << HALOW_LOSS_EWMA_SHIFT);
+        g_loss_rx   = 0;
+        g_loss_lost = 0;
+    }
+}
+
+static void halow_fec_deliver(const halow_rx_meta_t *meta, const uint8_t *p, int32_t len, bool agg){
+    if (agg) {
+        halow_agg_split(meta, p, len);
+    } else {
+        g_rx_cb(meta, p, len);
+    }
+}
+
+static void halow_fec_rx_close(halow_fec_rx_t *b){
+    uint32_t lost;
+
+    if (!b->used || (b->k == 0)) {
+        return;                     // no parity seen, the block size is unknown
+    }
+    lost = b->k - halow_bits(b->have & ((1UL << b->k) - 1U));
+    g_fec_stat.rx_blocks++;
+    g_fec_stat.rx_lost += lost;
+    if (!b->done) {
+        g_fec_stat.rx_unrecovered += lost;
+    }
+}
+
+/* Block buffer of `src` switched to `block`, the least recently used sender is evicted */
+static halow_fec_rx_t *halow_fec_rx_block(const uint8_t src[6], uint8_t block){
+    halow_fec_rx_t *b = NULL;
+    int64_t now = get_time_ms();
+
+    for (uint32_t i = 0; i < HALOW_FEC_RX_PEERS; i++) {
+        if (g_fec_rx[i].used && (memcmp(g_fec_rx[i].src, src, 6) == 0)) {
+            b = &g_fec_rx[i];
+            break;
+        }
+    }
+    if (b == NULL) {
+        b = &g_fec_rx[0];
+        for (uint32_t i = 0; i < HALOW_FEC_RX_PEERS; i++) {
+            if (!g_fec_rx[i].used) {
+                b = &g_fec_rx[i];
+                break;
+            }
+            if (g_fec_rx[i].last_ms < b->last_ms) {
+                b = &g_fec_rx[i];
+            }
+        }
+        halow_fec_rx_close(b);
+        b->used = false;
+    }
+    if (!b->used || (b->block != block) || ((now - b->last_ms) > HALOW_FEC_RX_STALE_MS)) {
+        halow_fec_rx_close(b);
+        b->used     = true;
+        b->done     = false;
+        b->block    = block;
+        b->k        = 0;
+        b->have     = 0;
+        b->par_have = 0;
+        b->par_len  = 0;
+        memcpy(b->src, src, 6);
+    }
+    b->last_ms = now;
+    return b;
+}
+
+static void halow_fec_rx_try(const halow_rx_meta_t *meta, halow_fec_rx_t *b){
+    uint8_t *data[HALOW_FEC_K_MAX];
+    uint8_t *parity[HALOW_FEC_M_MAX];
+    uint32_t have;
+    uint32_t miss;
+
+    if (b->done || (b->k == 0)) {
+        return;
+    }
+    have = b->have & ((1UL << b->k) - 1U);
+    miss = b->k - halow_bits(have);
+    if (miss == 0) {
+        b->done = true;
+        return;
+    }
+    if (halow_bits(b->par_have) < miss) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < b->k; i++) {
+        if ((have & (1UL << i)) && (b->len[i] < b->par_len)) {
+            memset(&b->data[i][b->len[i]], 0, b->par_len - b->len[i]);
+        }
+        data[i] = b->data[i];
+    }
+    for (uint32_t j = 0; j < HALOW_FEC_M_MAX; j++) {
+        parity[j] = b->parity[j];
+    }
+    b->done = true;
+    if (halow_fec_decode(data, b->k, have, parity, b->par_have, b->par_len) < 0) {
+        g_fec_stat.rx_errors++;
+        return;
+    }
+
+    for (uint32_t i = 0; i < b->k; i++) {
+        uint32_t v;
+        uint32_t n;
+
+        if (have & (1UL << i)) {
+            continue;
+        }
+        v = ((uint32_t)b->data[i][0] << 8) | b->data[i][1];
+        n = v & ~(uint32_t)HALOW_FEC_SYM_AGG;
+        if ((n == 0) || (n + HALOW_FEC_SYM_HDR_LEN > b->par_len)) {
+            halow_debug("fec: bad restored len=%lu", (unsigned long)n);
+            g_fec_stat.rx_errors++;
+            continue;
+        }
+        g_fec_stat.rx_recovered++;
+        halow_fec_deliver(meta, &b->data[i][HALOW_FEC_SYM_HDR_LEN], (int32_t)n,
+                          (v & HALOW_FEC_SYM_AGG) != 0);
+    }
+}
+
+/* Releases the RX blocks once no FEC frame was heard for a while */
+static void halow_fec_rx_idle(void){
+    if ((g_fec_rx == NULL) || ((get_time_ms() - g_fec_rx_last_ms) < HALOW_FEC_RX_FREE_MS)) {
+        return;
+    }
+    for (uint32_t i = 0; i < HALOW_FEC_RX_PEERS; i++) {
+        halow_fec_rx_close(&g_fec_rx[i]);
+    }
+    os_free(g_fec_rx);
+    g_fec_rx = NULL;
+}
+
+static void halow_fec_rx(const halow_rx_meta_t *meta, const uint8_t *p, int32_t len){
+    halow_fec_rx_t *b;
+    uint32_t idx;
+    uint32_t n;
+
+    if (len <= HALOW_FEC_HDR_LEN) {
+        g_fec_stat.rx_errors++;
+        return;
+    }
+    idx = p[1] & ~HALOW_FEC_IDX_PARITY;
+    n   = (uint32_t)len - HALOW_FEC_HDR_LEN;
+
+    if (g_fec_rx == NULL) {
+        g_fec_rx = (halow_fec_rx_t *)os_zalloc(HALOW_FEC_RX_PEERS * sizeof(*g_fec_rx));
+    }
+    g_fec_rx_last_ms = get_time_ms();
+
+    if ((p[1] & HALOW_FEC_IDX_PARITY) == 0) {
+        bool agg = (p[3] & HALOW_FEC_FLAG_AGG) != 0;
+
+        if ((idx >= HALOW_FEC_K_MAX) || (n > HALOW_FEC_PAYLOAD_MAX)) {
+            g_fec_stat.rx_errors++;
+            return;
+        }
+        if (g_fec_rx == NULL) {
+            /* out of memory: no recovery, the data still goes up */
+            halow_fec_deliver(meta, p + HALOW_FEC_HDR_LEN, (int32_t)n, agg);
+            return;
+        }
+        b = halow_fec_rx_block(meta->src, p[0]);
+        if (b->have & (1UL << idx)) {
+            return;
+        }
+        halow_fec_deliver(meta, p + HALOW_FEC_HDR_LEN, (int32_t)n, agg);
+
+        b->data[idx][0] = (uint8_t)((n >> 8) | (agg ? (HALOW_FEC_SYM_AGG >> 8) : 0));
+        b->data[idx][1] = (uint8_t)n;
+        memcpy(&b->data[idx][HALOW_FEC_SYM_HDR_LEN], p + HALOW_FEC_HDR_LEN, n);
+        b->len[idx] = (uint16_t)(n + HALOW_FEC_SYM_HDR_LEN);
+        b->have    |= (uint8_t)(1U << idx);
+    } else {
+        if ((idx >= HALOW_FEC_M_MAX) || (p[2] == 0) || (p[2] > HALOW_FEC_K_MAX) ||
+            (n > HALOW_FEC_SYM_MAX)) {
+            g_fec_stat.rx_errors++;
+            return;
+        }
+        if (g_fec_rx == NULL) {
+            return;
+        }
+        b = halow_fec_rx_block(meta->src, p[0]);
+        if (b->par_have & (1UL << idx)) {
+            return;
+        }
+        if ((b->par_have != 0) && ((b->par_len != n) || (b->k != p[2]))) {
+            g_fec_stat.rx_errors++;
+            return;
+        }
+        memcpy(b->parity[idx], p + HALOW_FEC_HDR_LEN, n);
+        b->par_len   = (uint16_t)n;
+        b->k         = p[2];
+        b->par_have |= (uint8_t)(1U << idx);
+    }
+
+    /* A data frame longer than the parity cannot be part of this block */
+    for (uint32_t i = 0; (b->par_have != 0) && (i < HALOW_FEC_K_MAX); i++) {
+        if ((b->have & (1UL << i)) && (b->len[i] > b->par_len)) {
+            g_fec_stat.rx_errors++;
+            b->done = true;
+        }
+    }
+    halow_fec_rx_try(meta, b);
+}
+
 static int32_t halow_lmac_rx(struct lmac_ops *ops,
                              struct hgic_rx_info *info,
                              uint8_t *data,
@@ -111,33 +535,82 @@ static int32_t halow_lmac_rx(struct lmac_ops *ops,
 
     const uint8_t *payload = data + sizeof(*hdr);
     int32_t payload_len    = len - (int32_t)sizeof(*hdr);
+    halow_rx_meta_t meta;
 
     if (payload_len <= 0 || !g_rx_cb) {
         halow_debug("rx: no payload or cb=NULL");
         return 0;
     }
 
-    g_rx_cb(info, payload, payload_len);
+    memcpy(meta.src, hdr->addr2, sizeof(meta.src));
+    if (info != NULL) {
+        meta.signal   = info->signal;
+        meta.evm      = info->evm;
+        meta.freq_off = info->freq_off;
+        meta.mcs      = info->mcs;
+        meta.bw       = info->bw;
+    } else {
+        meta.signal   = 0;
+        meta.evm      = 0;
+        meta.freq_off = 0;
+        meta.mcs      = 0;
+        meta.bw       = 0;
+    }
+
+    halow_loss_track(hdr->addr2, hdr->seq_ctrl);
+
+    if (memcmp(hdr->addr3, g_fec_addr3, sizeof(g_fec_addr3)) == 0) {
+        halow_fec_rx(&meta, payload, payload_len);
+        return 0;
+    }
+
+    halow_fec_rx_idle();
+    if (memcmp(hdr->addr3, g_agg_addr3, sizeof(g_agg_addr3)) == 0) {
+        halow_agg_split(&meta, payload, payload_len);
+    } else {
+        g_rx_cb(&meta, payload, payload_len);
+    }
 
     return 0;
 }
 
+/* Gives the bytes taken by halow_get_tx_vacanted_bytes() back and frees the frame */
+static void halow_tx_release(struct sk_buff *skb){
+    g_tx_vacated_bytes += skb->len;
+    if(g_tx_vacated_bytes == TX_BUFFER_SIZE){
+        halow_lbt_set_tx_as_deactive();
+    }
+    os_sema_up(&g_tx_vacated_sem);
+    kfree_skb(skb);
+}
+
 static int32_t halow_lmac_tx_status_callback(struct lmac_ops *ops, struct sk_buff *skb) {
     (void)ops;
     if (skb) {
-        g_tx_vacated_bytes += skb->len;
-        if(g_tx_vacated_bytes == TX_BUFFER_SIZE){
-            halow_lbt_set_tx_as_deactive();
-        }
-        os_sema_up(&g_tx_vacated_sem);
-        kfree_skb(skb);
+        halow_lbt_airtime_charge(halow_airtime_us(skb->len));
+        halow_tx_release(skb);
     }
     return 0;
 }
 
+#define HALOW_FCS_LEN           4
+
+/* On-air time of an MPDU of mpdu_len bytes (header + payload, FCS added here) at the active rate */
+uint32_t halow_airtime_us(uint32_t mpdu_len){
+    halow_ppdu_param_t p;
+
+    p.mcs       = g_cfg_active.mcs;
+    p.bandwidth = g_cfg_active.bandwidth;
+    p.nss       = 1;
+    p.preamble  = (p.bandwidth == 1) ? HALOW_PREAMBLE_S1G_1M : HALOW_PREAMBLE_S1G_SHORT;
+    p.short_gi  = HALOW_TX_SHORT_GI ? true : false;
+
+    return halow_ppdu_duration_us(&p, mpdu_len + HALOW_FCS_LEN);
+}
+
 int32_t get_mcs_val(uint8_t mcs){
     if((mcs <= 7) || (mcs == 10)){
-        return LMAC_RATE_DEF(LMAC_PHY_S1G, 1, mcs, 0);
+        return LMAC_RATE_DEF(LMAC_PHY_S1G, 1, mcs, HALOW_TX_SHORT_GI ? LMAC_RATE_SHORT_GI : 0);
     }
     return 0;
 }
@@ -173,6 +646,26 @@ static void halow_cfg_sanitize(halow_config_t *cfg){
     ){
         cfg->bandwidth = 1;
     }
+
+    if ((cfg->agg_max != 0) && (cfg->agg_max < HALOW_AGG_MIN)) {
+        cfg->agg_max = HALOW_AGG_MIN;
+    }
+    if (cfg->agg_max > HALOW_AGG_MAX_LIMIT) {
+        cfg->agg_max = HALOW_AGG_MAX_LIMIT;
+    }
+    if (cfg->agg_hold_ms > HALOW_AGG_HOLD_MAX_MS) {
+        cfg->agg_hold_ms = HALOW_AGG_HOLD_MAX_MS;
+    }
+
+    if (cfg->fec_k > HALOW_FEC_K_MAX) {
+        cfg->fec_k = HALOW_FEC_K_MAX;
+    }
+    if (cfg->fec_m > HALOW_FEC_M_MAX) {
+        cfg->fec_m = HALOW_FEC_M_MAX;
+    }
+    if (cfg->fec_hold_ms > HALOW_FEC_HOLD_MAX_MS) {
+        cfg->fec_hold_ms = HALOW_FEC_HOLD_MAX_MS;
+    }
 }
 
 void halow_config_save(const halow_config_t *cfg){
@@ -185,6 +678,11 @@ void halow_config_save(const halow_config_t *cfg){
     configdb_set_i8(HALOW_CONFIG_POWER_NAME, (int8_t*)&cfg->rf_power);
     configdb_set_i8(HALOW_CONFIG_MCS_NAME, (int8_t*)&cfg->mcs);
     configdb_set_i16(HALOW_CONFIG_CENTRAL_FREQ_NAME, (int16_t*)&cfg->central_freq);
+    configdb_set_i16(HALOW_CONFIG_AGG_MAX_NAME, (int16_t*)&cfg->agg_max);
+    configdb_set_i8(HALOW_CONFIG_AGG_HOLD_NAME, (int8_t*)&cfg->agg_hold_ms);
+    configdb_set_i8(HALOW_CONFIG_FEC_K_NAME, (int8_t*)&cfg->fec_k);
+    configdb_set_i8(HALOW_CONFIG_FEC_M_NAME, (int8_t*)&cfg->fec_m);
+    configdb_set_i8(HALOW_CONFIG_FEC_HOLD_NAME, (int8_t*)&cfg->fec_hold_ms);
 }
 
 static void halow_config_set_default(halow_config_t *cfg){
@@ -197,6 +695,11 @@ static void halow_config_set_default(halow_config_t *cfg){
     cfg->rf_power       = HALOW_CONFIG_POWER_DEF;
     cfg->mcs            = HALOW_CONFIG_MCS_DEF;
     cfg->central_freq   = HALOW_CONFIG_CENTRAL_FREQ_DEF;
+    cfg->agg_max        = HALOW_CONFIG_AGG_MAX_DEF;
+    cfg->agg_hold_ms    = HALOW_CONFIG_AGG_HOLD_MS_DEF;
+    cfg->fec_k          = HALOW_CONFIG_FEC_K_DEF;
+    cfg->fec_m          = HALOW_CONFIG_FEC_M_DEF;
+    cfg->fec_hold_ms    = HALOW_CONFIG_FEC_HOLD_MS_DEF;
 }
 
 void halow_config_load(halow_config_t *cfg){
@@ -208,6 +711,11 @@ void halow_config_load(halow_config_t *cfg){
     configdb_get_i8(HALOW_CONFIG_POWER_NAME, (int8_t*)&cfg->rf_power);
     configdb_get_i8(HALOW_CONFIG_MCS_NAME, (int8_t*)&cfg->mcs);
     configdb_get_i16(HALOW_CONFIG_CENTRAL_FREQ_NAME, (int16_t*)&cfg->central_freq);
+    configdb_get_i16(HALOW_CONFIG_AGG_MAX_NAME, (int16_t*)&cfg->agg_max);
+    configdb_get_i8(HALOW_CONFIG_AGG_HOLD_NAME, (int8_t*)&cfg->agg_hold_ms);
+    configdb_get_i8(HALOW_CONFIG_FEC_K_NAME, (int8_t*)&cfg->fec_k);
+    configdb_get_i8(HALOW_CONFIG_FEC_M_NAME, (int8_t*)&cfg->fec_m);
+    configdb_get_i8(HALOW_CONFIG_FEC_HOLD_NAME, (int8_t*)&cfg->fec_hold_ms);
 }
 
 void halow_config_apply(const halow_config_t *cfg){
@@ -221,6 +729,7 @@ void halow_config_apply(const halow_config_t *cfg){
     
     halow_cfg = *cfg;
     halow_cfg_sanitize(&halow_cfg);
+    g_cfg_active = halow_cfg;
     lmac_set_freq(g_ops, halow_cfg.central_freq);
     lmac_set_bss_bw(g_ops, halow_cfg.bandwidth);
 
@@ -302,6 +811,8 @@ bool halow_init(uint32_t rxbuf, uint32_t rxbuf_size,
     struct lmac_init_param p;
 
     os_sema_init(&g_tx_vacated_sem, 0);
+    halow_tx_hdr_init();
+    halow_fec_init();
     memset(&p, 0, sizeof(p));
     p.rxbuf          = rxbuf;
     p.rxbuf_size     = rxbuf_size;
@@ -333,6 +844,9 @@ bool halow_init(uint32_t rxbuf, uint32_t rxbuf_size,
     halow_config_save(&config); // Incorrect values should be removed from DB
     halow_config_apply(&config);
     halow_lbt_set_tx_as_deactive();
+    if (halow_tx_task_init() != 0) {
+        return false;
+    }
     return true;
 }
 
@@ -340,6 +854,12 @@ void halow_set_rx_cb(halow_rx_cb cb) {
     g_rx_cb = cb;
 }
 
+void halow_set_addr(const uint8_t addr[6]) {
+    if (addr) {
+        memcpy(g_tx_hdr.addr2, addr, sizeof(g_tx_hdr.addr2));
+    }
+}
+
 void halow_get_tx_vacanted_bytes(uint32_t bytes){
     while(1) {
         if (g_tx_vacated_bytes >= bytes) {
@@ -350,13 +870,422 @@ void halow_get_tx_vacanted_bytes(uint32_t bytes){
     }
 }
 
+static struct sk_buff *halow_txq_pop(void){
+    struct sk_buff *skb;
+
+    os_mutex_lock(&g_txq_lock, osWaitForever);
+    skb = skb_list_dequeue(&g_txq);
+    if (skb) {
+        g_txq_bytes -= skb->len;
+    }
+    os_mutex_unlock(&g_txq_lock);
+
+    if (skb) {
+        os_sema_up(&g_txq_space_sem);
+    }
+    return skb;
+}
+
+static inline bool halow_txq_has_space(uint32_t len){
+    return (skb_list_count(&g_txq) < HALOW_TXQ_MAX_FRAMES) &&
+           ((g_txq_bytes + len) <= HALOW_TXQ_MAX_BYTES);
+}
+
+/* Waits up to `wait_ms` for space, then applies HALOW_TXQ_POLICY */
+static int32_t halow_txq_push(struct sk_buff *skb, uint32_t wait_ms){
+    int64_t deadline = get_time_ms() + wait_ms;
+
+    while (1) {
+        struct sk_buff *old = NULL;
+        int64_t left = (wait_ms == osWaitForever) ? 100 : (deadline - get_time_ms());
+
+        os_mutex_lock(&g_txq_lock, osWaitForever);
+        if (halow_txq_has_space(skb->len)) {
+            skb_list_queue(&g_txq, skb);
+            g_txq_bytes += skb->len;
+            g_txq_stat.queued++;
+            if (g_txq_stat.max_frames < skb_list_count(&g_txq)) {
+                g_txq_stat.max_frames = skb_list_count(&g_txq);
+            }
+            os_mutex_unlock(&g_txq_lock);
+            os_sema_up(&g_txq_sem);
+            return 0;
+        }
+
+        if ((left <= 0) && (HALOW_TXQ_POLICY == HALOW_TXQ_POLICY_DROP_OLDEST)) {
+            old = skb_list_dequeue(&g_txq);
+            if (old) {
+                g_txq_bytes -= old->len;
+                g_txq_stat.dropped++;
+            }
+        }
+        os_mutex_unlock(&g_txq_lock);
+
+        if (old) {
+            kfree_skb(old);
+            continue;
+        }
+
+        if (left <= 0) {
+            g_txq_stat.dropped++;
+            kfree_skb(skb);
+            return -6;
+        }
+
+        /* Wait for the TX task to take a frame, re-check on timeout */
+        os_sema_down(&g_txq_space_sem, (left < 100) ? (int32)left : 100);
+    }
+}
+
+/* TX task: next queued frame that still fits into an aggregate of `used` payload bytes */
+static struct sk_buff *halow_txq_pop_fit(uint32_t used, uint32_t max, bool *more){
+    struct sk_buff *skb;
+
+    os_mutex_lock(&g_txq_lock, osWaitForever);
+    skb = skb_list_first(&g_txq);
+    *more = (skb != NULL);
+    if (skb && (used + HALOW_AGG_SUBHDR_LEN + skb->len - sizeof(struct ieee80211_hdr) <= max)) {
+        skb = skb_list_dequeue(&g_txq);
+        g_txq_bytes -= skb->len;
+    } else {
+        skb = NULL;
+    }
+    os_mutex_unlock(&g_txq_lock);
+
+    if (skb) {
+        os_sema_up(&g_txq_space_sem);
+    }
+    return skb;
+}
+
+static void halow_agg_put(struct sk_buff *agg, const struct sk_buff *skb){
+    uint32_t n = skb->len - sizeof(struct ieee80211_hdr);
+    uint8_t *p = (uint8_t *)skb_put(agg, HALOW_AGG_SUBHDR_LEN + n);
+
+    p[0] = (uint8_t)(n >> 8);
+    p[1] = (uint8_t)n;
+    memcpy(p + HALOW_AGG_SUBHDR_LEN, skb->data + sizeof(struct ieee80211_hdr), n);
+}
+
+/*
+ * Packs `first` and the frames queued behind it into one frame while they fit
+ * agg_max, a lone frame waits up to agg_hold_ms for company. Frames are taken
+ * in queue order only, so nothing is reordered. Returns `first` untouched when
+ * there is nothing to pack with it.
+ */
+static struct sk_buff *halow_agg_collect(struct sk_buff *first){
+    uint32_t max  = g_cfg_active.agg_max;
+    uint32_t hlen = sizeof(struct ieee80211_hdr);
+    uint32_t used;
+    uint32_t cnt = 1;
+    int64_t deadline;
+    struct sk_buff *agg;
+    struct ieee80211_hdr *hdr;
+
+    if (max == 0) {
+        return first;
+    }
+    if ((g_cfg_active.fec_k != 0) && (max > HALOW_FEC_PAYLOAD_MAX)) {
+        max = HALOW_FEC_PAYLOAD_MAX;    // keep aggregates inside FEC blocks
+    }
+    used = HALOW_AGG_SUBHDR_LEN + first->len - hlen;
+    if (used + HALOW_AGG_SUBHDR_LEN + 1 > max) {
+        return first;
+    }
+
+    agg = alloc_tx_skb((uint32_t)g_ops->headroom + hlen + max + (uint32_t)g_ops->tailroom);
+    if (!agg) {
+        return first;
+    }
+    skb_reserve(agg, (int)g_ops->headroom);
+    hdr = (struct ieee80211_hdr *)skb_put(agg, hlen);
+    memcpy(hdr, first->data, hlen);
+    memcpy(hdr->addr3, g_agg_addr3, sizeof(hdr->addr3));
+    halow_agg_put(agg, first);
+
+    deadline = get_time_ms() + g_cfg_active.agg_hold_ms;
+    while (1) {
+        bool more;
+        int64_t now;
+        struct sk_buff *skb = halow_txq_pop_fit(used, max, &more);
+
+        if (skb) {
+            halow_agg_put(agg, skb);
+            used += HALOW_AGG_SUBHDR_LEN + skb->len - hlen;
+            cnt++;
+            kfree_skb(skb);
+            continue;
+        }
+        if (more) {
+            break;                  // next frame does not fit, it starts the next aggregate
+        }
+        now = get_time_ms();
+        if (now >= deadline) {
+            break;
+        }
+        os_sema_down(&g_txq_sem, (uint32_t)(deadline - now));
+    }
+
+    if (cnt == 1) {
+        kfree_skb(agg);
+        return first;
+    }
+
+    agg->priority = first->priority;
+    agg->tx       = 1;
+    kfree_skb(first);
+    g_agg_stat.tx_aggregates++;
+    g_agg_stat.tx_subframes += cnt;
+    return agg;
+}
+
+static void halow_tx_send(struct sk_buff *skb){
+    struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)skb->data;
+    int32_t res;
+
+    /* Numbered as they go on air: a receiver sees a gap only for a lost frame */
+    g_seq++;
+    hdr->seq_ctrl = (uint16_t)((g_seq & 0x0fff) << 4);
+
+    halow_lbt_wait_tx_allowed(halow_airtime_us(skb->len));
+    halow_lbt_wait_channel_clear();
+    /* Released by halow_lmac_tx_status_callback() */
+    halow_get_tx_vacanted_bytes(skb->len);
+    res = lmac_tx(g_ops, skb);
+    if (res != 0) {
+        /* no tx_status for a rejected frame */
+        g_txq_stat.lmac_err++;
+        halow_debug("lmac_tx err=%ld", (long)res);
+        halow_tx_release(skb);
+        return;
+    }
+    halow_lbt_set_tx_as_active();
+}
+
+/* Parity frames per block: fec_m, or one plus twice the expected losses of a block */
+static uint8_t halow_fec_parity_cnt(uint32_t k){
+    uint32_t m = g_cfg_active.fec_m;
+
+    if (m == 0) {
+        uint32_t loss = (g_loss_pm > 0) ? (uint32_t)g_loss_pm : 0;
+
+        m = 1U + (2U * k * loss + 999U) / 1000U;
+    }
+    if (m > HALOW_FEC_M_MAX) {
+        m = HALOW_FEC_M_MAX;
+    }
+    return (uint8_t)m;
+}
+
+/* Moves the payload of `skb` into a data frame of the open FEC block and codes it */
+static struct sk_buff *halow_fec_wrap(struct sk_buff *skb){
+    uint32_t hlen = sizeof(struct ieee80211_hdr);
+    uint32_t n    = skb->len - hlen;
+    struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)skb->data;
+    bool agg = (memcmp(hdr->addr3, g_agg_addr3, sizeof(g_agg_addr3)) == 0);
+    struct sk_buff *out;
+    uint8_t sym[HALOW_FEC_SYM_HDR_LEN];
+    uint8_t *p;
+
+    if ((g_cfg_active.fec_k == 0) || (n > HALOW_FEC_PAYLOAD_MAX)) {
+        return skb;
+    }
+    if (g_fec_tx.parity == NULL) {
+        g_fec_tx.parity = os_malloc(HALOW_FEC_M_MAX * sizeof(*g_fec_tx.parity));
+        if (g_fec_tx.parity == NULL) {
+            return skb;
+        }
+    }
+    out = alloc_tx_skb((uint32_t)g_ops->headroom + hlen + HALOW_FEC_HDR_LEN + n + (uint32_t)g_ops->tailroom);
+    if (!out) {
+        return skb;
+    }
+
+    if (!g_fec_tx.open) {
+        g_fec_tx.open     = true;
+        g_fec_tx.k        = g_cfg_active.fec_k;
+        g_fec_tx.m        = halow_fec_parity_cnt(g_fec_tx.k);
+        g_fec_tx.cnt      = 0;
+        g_fec_tx.len      = 0;
+        g_fec_tx.deadline = get_time_ms() + g_cfg_active.fec_hold_ms;
+        memset(g_fec_tx.parity, 0, HALOW_FEC_M_MAX * sizeof(*g_fec_tx.parity));
+    }
+
+    skb_reserve(out, (int)g_ops->headroom);
+    hdr = (struct ieee80211_hdr *)skb_put(out, hlen);
+    memcpy(hdr, skb->data, hlen);
+    memcpy(hdr->addr3, g_fec_addr3, sizeof(hdr->addr3));
+    p = (uint8_t *)skb_put(out, HALOW_FEC_HDR_LEN + n);
+    p[0] = g_fec_tx.block;
+    p[1] = g_fec_tx.cnt;
+    p[2] = 0;
+    p[3] = agg ? HALOW_FEC_FLAG_AGG : 0;
+    memcpy(p + HALOW_FEC_HDR_LEN, skb->data + hlen, n);
+
+    sym[0] = (uint8_t)((n >> 8) | (agg ? (HALOW_FEC_SYM_AGG >> 8) : 0));
+    sym[1] = (uint8_t)n;
+    for (uint32_t j = 0; j < g_fec_tx.m; j++) {
+        halow_fec_encode(g_fec_tx.parity[j], j, g_fec_tx.cnt, sym, HALOW_FEC_SYM_HDR_LEN);
+        halow_fec_encode(&g_fec_tx.parity[j][HALOW_FEC_SYM_HDR_LEN], j, g_fec_tx.cnt,
+                         p + HALOW_FEC_HDR_LEN, n);
+    }
+    if (g_fec_tx.len < HALOW_FEC_SYM_HDR_LEN + n) {
+        g_fec_tx.len = (uint16_t)(HALOW_FEC_SYM_HDR_LEN + n);
+    }
+    g_fec_tx.cnt++;
+
+    out->priority = skb->priority;
+    out->tx       = 1;
+    kfree_skb(skb);
+    return out;
+}
+
+static void halow_fec_flush(void){
+    uint32_t hlen = sizeof(struct ieee80211_hdr);
+
+    for (uint32_t j = 0; j < g_fec_tx.m; j++) {
+        struct sk_buff *skb = alloc_tx_skb((uint32_t)g_ops->headroom + hlen + HALOW_FEC_HDR_LEN +
+                                           g_fec_tx.len + (uint32_t)g_ops->tailroom);
+        struct ieee80211_hdr *hdr;
+        uint8_t *p;
+
+        if (!skb) {
+            break;
+        }
+        skb_reserve(skb, (int)g_ops->headroom);
+        hdr = (struct ieee80211_hdr *)skb_put(skb, hlen);
+        *hdr = g_tx_hdr;
+        memcpy(hdr->addr3, g_fec_addr3, sizeof(hdr->addr3));
+        p = (uint8_t *)skb_put(skb, HALOW_FEC_HDR_LEN + g_fec_tx.len);
+        p[0] = g_fec_tx.block;
+        p[1] = (uint8_t)(HALOW_FEC_IDX_PARITY | j);
+        p[2] = g_fec_tx.cnt;
+        p[3] = 0;
+        memcpy(p + HALOW_FEC_HDR_LEN, g_fec_tx.parity[j], g_fec_tx.len);
+        skb->priority = 0;
+        skb->tx       = 1;
+        halow_tx_send(skb);
+        g_fec_stat.tx_parity++;
+    }
+    g_fec_stat.tx_blocks++;
+    g_fec_tx.block++;
+    g_fec_tx.open = false;
+}
+
+/* Closes the open block once it is full or its hold time is over, frees the parity once FEC is off */
+static void halow_fec_poll(void){
+    if (g_fec_tx.open &&
+        ((g_fec_tx.cnt >= g_fec_tx.k) || (get_time_ms() >= g_fec_tx.deadline))) {
+        halow_fec_flush();
+    }
+    if (!g_fec_tx.open && (g_fec_tx.parity != NULL) && (g_cfg_active.fec_k == 0)) {
+        os_free(g_fec_tx.parity);
+        g_fec_tx.parity = NULL;
+    }
+}
+
+static uint32_t halow_fec_wait_ms(void){
+    int64_t left;
+
+    if (!g_fec_tx.open) {
+        return osWaitForever;
+    }
+    left = g_fec_tx.deadline - get_time_ms();
+    return (left > 0) ? (uint32_t)left : 1U;
+}
+
+static void halow_tx_task(void *arg){
+    (void)arg;
+
+    while (1) {
+        struct sk_buff *skb = halow_txq_pop();
+        if (!skb) {
+            os_sema_down(&g_txq_sem, halow_fec_wait_ms());
+            halow_fec_poll();
+            continue;
+        }
+        skb = halow_agg_collect(skb);
+        skb = halow_fec_wrap(skb);
+        halow_tx_send(skb);
+        halow_fec_poll();
+    }
+}
+
+static int32_t halow_tx_task_init(void){
+    int32_t ret;
+
+    os_mutex_init(&g_txq_lock);
+    os_sema_init(&g_txq_sem, 0);
+    os_sema_init(&g_txq_space_sem, 0);
+    skb_list_init(&g_txq);
+    g_txq_bytes = 0;
+
+    ret = os_task_init((const uint8 *)"halow_tx", &g_tx_task, halow_tx_task, 0);
+    if (ret != 0) {
+        return ret;
+    }
+    (void)os_task_set_stacksize(&g_tx_task, HALOW_TX_TASK_STACK);
+    (void)os_task_set_priority(&g_tx_task, HALOW_TX_TASK_PRIO);
+    return os_task_run(&g_tx_task);
+}
+
+halow_txq_stat_t halow_txq_stat_get(void){
+    halow_txq_stat_t stat;
+
+    os_mutex_lock(&g_txq_lock, osWaitForever);
+    stat        = g_txq_stat;
+    stat.frames = skb_list_count(&g_txq);
+    stat.bytes  = g_txq_bytes;
+    os_mutex_unlock(&g_txq_lock);
+    return stat;
+}
+
+halow_agg_stat_t halow_agg_stat_get(void){
+    return g_agg_stat;
+}
+
+halow_fec_stat_t halow_fec_stat_get(void){
+    halow_fec_stat_t stat = g_fec_stat;
+
+    stat.loss_permille = (g_loss_pm > 0) ? (uint16_t)g_loss_pm : 0;
+    stat.parity_now    = (g_cfg_active.fec_k != 0) ? halow_fec_parity_cnt(g_cfg_active.fec_k) : 0;
+    return stat;
+}
+
 int32_t halow_tx(const uint8_t *data, uint32_t len) {
+    halow_iov_t iov;
+
+    iov.data = data;
+    iov.len  = len;
+    return halow_tx_iov(&iov, 1);
+}
+
+/* Never waits unless HALOW_TXQ_POLICY is backpressure, safe from the tcpip thread */
+int32_t halow_tx_iov(const halow_iov_t *iov, uint32_t cnt) {
+    return halow_tx_iov_wait(iov, cnt,
+        (HALOW_TXQ_POLICY == HALOW_TXQ_POLICY_BACKPRESSURE) ? osWaitForever : 0);
+}
+
+/*
+ * Payload is gathered straight from the caller's buffers: one copy per byte, header built in place.
+ * The frame is queued for the TX task. On a full queue the caller waits up to `wait_ms`
+ * for space, so only tasks of their own may pass a non-zero wait.
+ */
+int32_t halow_tx_iov_wait(const halow_iov_t *iov, uint32_t cnt, uint32_t wait_ms) {
+    uint32_t len = 0;
+
     if(g_ops == NULL){
         return -1;
     }
-    if(data == NULL){
+    if((iov == NULL) || (cnt == 0)){
         return -2;
     }
+    for(uint32_t i = 0; i < cnt; i++){
+        if((iov[i].data == NULL) && (iov[i].len != 0)){
+            return -2;
+        }
+        len += iov[i].len;
+    }
     if(len == 0){
         return -3;
     }
@@ -364,20 +1293,9 @@ int32_t halow_tx(const uint8_t *data, uint32_t len) {
         return -4;
     }
 
-    struct ieee80211_hdr hdr;
-    memset(&hdr, 0, sizeof(hdr));
-
-    hdr.frame_control = (uint16_t)(WLAN_FTYPE_DATA | WLAN_STYPE_DATA);
-    mac_bcast(hdr.addr1);
-    mac_bcast(hdr.addr2);
-    mac_bcast(hdr.addr3);
-
-    g_seq++;
-    hdr.seq_ctrl = (uint16_t)((g_seq & 0x0fff) << 4);
-
     uint32_t hr   = (uint32_t)g_ops->headroom;
     uint32_t tr   = (uint32_t)g_ops->tailroom;
-    uint32_t need = hr + sizeof(hdr) + (uint32_t)len + tr;
+    uint32_t need = hr + sizeof(struct ieee80211_hdr) + len + tr;
 
     struct sk_buff *skb = alloc_tx_skb(need);
     if (!skb) {
@@ -385,14 +1303,17 @@ int32_t halow_tx(const uint8_t *data, uint32_t len) {
     }
 
     skb_reserve(skb, (int)hr);
-    memcpy(skb_put(skb, sizeof(hdr)), &hdr, sizeof(hdr));
-    memcpy(skb_put(skb, len), data, (size_t)len);
+
+    struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)skb_put(skb, sizeof(*hdr));
+    *hdr = g_tx_hdr;
+
+    for(uint32_t i = 0; i < cnt; i++){
+        if(iov[i].len != 0){
+            memcpy(skb_put(skb, iov[i].len), iov[i].data, (size_t)iov[i].len);
+        }
+    }
 
     skb->priority = 0;
     skb->tx       = 1;
-    halow_lbt_wait_tx_allowed();
-    halow_get_tx_vacanted_bytes(skb->len);
-    int32_t res = lmac_tx(g_ops, skb);
-    halow_lbt_set_tx_as_active();
-    return res;
+    return halow_txq_push(skb, wait_ms);
 }
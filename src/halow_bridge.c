@@ -0,0 +1,482 @@
+#include "halow_bridge.h"
+
+#include <string.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/pbuf.h"
+#include "lwip/etharp.h"
+#include "lwip/netifapi.h"
+#include "lwip/apps/lwiperf.h"
+#include "netif/ethernet.h"
+#include "netif/bridgeif.h"
+#include "lib/lwrb/lwrb.h"
+#include "osal/semaphore.h"
+#include "osal/task.h"
+#include "halow.h"
+#include "configdb.h"
+#include "sys_config.h"
+#include "utils.h"
+
+//#define HALOW_BRIDGE_DEBUG
+
+#ifdef HALOW_BRIDGE_DEBUG
+#define hbr_debug(fmt, ...)  os_printf("[HBR] " fmt "\r\n", ##__VA_ARGS__)
+#else
+#define hbr_debug(fmt, ...)  do { } while (0)
+#endif
+
+#define HALOW_BRIDGE_CONFIG_PREFIX              CONFIGDB_ADD_MODULE("bridge")
+#define HALOW_BRIDGE_CONFIG_ADD_CONFIG(name)    HALOW_BRIDGE_CONFIG_PREFIX "." name
+
+#define HALOW_BRIDGE_CONFIG_ENABLED_NAME        HALOW_BRIDGE_CONFIG_ADD_CONFIG("enabled")
+#define HALOW_BRIDGE_CONFIG_BCAST_PPS_NAME      HALOW_BRIDGE_CONFIG_ADD_CONFIG("bc_pps")
+#define HALOW_BRIDGE_CONFIG_QUEUE_MS_NAME       HALOW_BRIDGE_CONFIG_ADD_CONFIG("q_ms")
+
+#ifndef HALOW_BRIDGE_FDB_ENTRIES
+#define HALOW_BRIDGE_FDB_ENTRIES        32
+#endif
+
+/* Ethernet -> radio queue: filled in the tcpip thread, emptied by the TX worker (radio TX may block) */
+#ifndef HALOW_BRIDGE_TXQ_RING
+#define HALOW_BRIDGE_TXQ_RING           (12 * 1024)
+#endif
+
+/* Group addressed frames that may go out back to back after an idle period */
+#ifndef HALOW_BRIDGE_BCAST_BURST
+#define HALOW_BRIDGE_BCAST_BURST        8
+#endif
+
+#ifndef HALOW_BRIDGE_TASK_STACK
+#define HALOW_BRIDGE_TASK_STACK         1024
+#endif
+
+#ifndef HALOW_BRIDGE_TASK_PRIO
+#define HALOW_BRIDGE_TASK_PRIO          20
+#endif
+
+#ifndef HALOW_BRIDGE_BARRIER
+#define HALOW_BRIDGE_BARRIER()          __sync_synchronize()
+#endif
+
+/* Untagged or 802.1Q tagged frame without FCS */
+#define HALOW_BRIDGE_FRAME_MAX          (SIZEOF_ETH_HDR + SIZEOF_VLAN_HDR + 1500)
+#define HALOW_BRIDGE_MAC_HDR_LEN        24      // 802.11 data header added by halow_tx()
+
+#define HALOW_BRIDGE_QUEUE_MS_MIN       20
+#define HALOW_BRIDGE_QUEUE_MS_MAX       5000
+#define HALOW_BRIDGE_BCAST_PPS_MAX      1000
+
+/* Ring record, followed by the frame */
+typedef struct {
+    uint16_t len;
+    uint16_t rsvd;
+    uint32_t air_us;
+    uint32_t enq_ms;
+} halow_bridge_rec_t;
+
+static halow_bridge_config_t g_cfg;
+static bool g_active;
+static halow_bridge_tx_cb_t g_tx_cb;
+static uint8_t g_mac[ETH_HWADDR_LEN];
+
+static struct netif g_br_netif;
+static struct netif g_port_netif;
+static struct netif *g_eth_netif;
+static bridgeif_initdata_t g_br_init;
+
+static lwrb_t g_txq_rb;
+/* Allocated when the bridge comes up, the mode is off by default */
+static uint8_t *g_txq_rb_data;          // HALOW_BRIDGE_TXQ_RING
+static uint8_t *g_frame_buf;            // HALOW_BRIDGE_FRAME_MAX
+/* Queued airtime is in - out: each side only writes its own counter */
+static volatile uint32_t g_air_in_us;
+static volatile uint32_t g_air_out_us;
+
+static uint32_t g_bc_tokens;            // 1/1000 frame
+static uint32_t g_bc_last_ms;
+
+static struct os_semaphore g_txq_sem;
+static struct os_task g_task;
+
+static halow_bridge_stat_t g_stat;
+static halow_bridge_iperf_t g_iperf;
+
+static void halow_bridge_cfg_sanitize(halow_bridge_config_t *cfg){
+    if (cfg->queue_ms < HALOW_BRIDGE_QUEUE_MS_MIN) {
+        cfg->queue_ms = HALOW_BRIDGE_QUEUE_MS_MIN;
+    }
+    if (cfg->queue_ms > HALOW_BRIDGE_QUEUE_MS_MAX) {
+        cfg->queue_ms = HALOW_BRIDGE_QUEUE_MS_MAX;
+    }
+    if (cfg->bcast_pps > HALOW_BRIDGE_BCAST_PPS_MAX) {
+        cfg->bcast_pps = HALOW_BRIDGE_BCAST_PPS_MAX;
+    }
+}
+
+void halow_bridge_config_load(halow_bridge_config_t *cfg){
+    int8_t enabled;
+    int16_t bcast_pps;
+    int16_t queue_ms;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    cfg->enabled   = HALOW_BRIDGE_CONFIG_ENABLED_DEF ? true : false;
+    cfg->bcast_pps = HALOW_BRIDGE_CONFIG_BCAST_PPS_DEF;
+    cfg->queue_ms  = HALOW_BRIDGE_CONFIG_QUEUE_MS_DEF;
+
+    if (configdb_get_i8(HALOW_BRIDGE_CONFIG_ENABLED_NAME, &enabled) == 0) {
+        cfg->enabled = enabled ? true : false;
+    }
+    if (configdb_get_i16(HALOW_BRIDGE_CONFIG_BCAST_PPS_NAME, &bcast_pps) == 0) {
+        cfg->bcast_pps = (uint16_t)bcast_pps;
+    }
+    if (configdb_get_i16(HALOW_BRIDGE_CONFIG_QUEUE_MS_NAME, &queue_ms) == 0) {
+        cfg->queue_ms = (uint16_t)queue_ms;
+    }
+    halow_bridge_cfg_sanitize(cfg);
+}
+
+void halow_bridge_config_save(const halow_bridge_config_t *cfg){
+    int8_t enabled;
+    int16_t bcast_pps;
+    int16_t queue_ms;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    enabled   = cfg->enabled ? 1 : 0;
+    bcast_pps = (int16_t)cfg->bcast_pps;
+    queue_ms  = (int16_t)cfg->queue_ms;
+
+    configdb_set_i8(HALOW_BRIDGE_CONFIG_ENABLED_NAME, &enabled);
+    configdb_set_i16(HALOW_BRIDGE_CONFIG_BCAST_PPS_NAME, &bcast_pps);
+    configdb_set_i16(HALOW_BRIDGE_CONFIG_QUEUE_MS_NAME, &queue_ms);
+}
+
+/* tcpip thread: token bucket for group addressed frames */
+static bool halow_bridge_bcast_take(uint32_t now){
+    uint32_t elapsed;
+
+    if (g_cfg.bcast_pps == 0) {
+        return true;
+    }
+
+    elapsed = now - g_bc_last_ms;
+    g_bc_last_ms = now;
+    if (elapsed > 1000u * HALOW_BRIDGE_BCAST_BURST) {
+        elapsed = 1000u * HALOW_BRIDGE_BCAST_BURST;
+    }
+    g_bc_tokens += elapsed * g_cfg.bcast_pps;
+    if (g_bc_tokens > 1000u * HALOW_BRIDGE_BCAST_BURST) {
+        g_bc_tokens = 1000u * HALOW_BRIDGE_BCAST_BURST;
+    }
+
+    if (g_bc_tokens < 1000u) {
+        return false;
+    }
+    g_bc_tokens -= 1000u;
+    return true;
+}
+
+/* tcpip thread: bridge -> radio port, never blocks */
+static err_t halow_bridge_port_output(struct netif *netif, struct pbuf *p){
+    halow_bridge_rec_t rec;
+    const uint8_t *dst;
+    uint32_t queued;
+    uint32_t now;
+    struct pbuf *q;
+    (void)netif;
+
+    if ((p->tot_len < SIZEOF_ETH_HDR) || (p->tot_len > HALOW_BRIDGE_FRAME_MAX) ||
+        (p->len < ETH_HWADDR_LEN)) {
+        g_stat.drop_size++;
+        return ERR_OK;
+    }
+
+    now = (uint32_t)get_time_ms();
+    dst = (const uint8_t *)p->payload;
+    if ((dst[0] & 1) && !halow_bridge_bcast_take(now)) {
+        g_stat.drop_bcast++;
+        return ERR_OK;
+    }
+
+    rec.len    = p->tot_len;
+    rec.rsvd   = 0;
+    rec.air_us = halow_airtime_us(HALOW_BRIDGE_MAC_HDR_LEN + rec.len);
+    rec.enq_ms = now;
+
+    /* one frame is always let in, whatever its airtime */
+    queued = g_air_in_us - g_air_out_us;
+    if ((queued != 0) && (queued + rec.air_us > 1000u * g_cfg.queue_ms)) {
+        g_stat.drop_airtime++;
+        return ERR_OK;
+    }
+    if (lwrb_get_free(&g_txq_rb) < sizeof(rec) + rec.len) {
+        g_stat.drop_full++;
+        return ERR_OK;
+    }
+
+    (void)lwrb_write(&g_txq_rb, &rec, sizeof(rec));
+    for (q = p; q != NULL; q = q->next) {
+        (void)lwrb_write(&g_txq_rb, q->payload, q->len);
+    }
+    g_air_in_us += rec.air_us;
+
+    HALOW_BRIDGE_BARRIER();
+    (void)os_sema_up(&g_txq_sem);
+    return ERR_OK;
+}
+
+static void halow_bridge_task(void *arg){
+    (void)arg;
+
+    while (1) {
+        halow_bridge_rec_t rec;
+
+        if (lwrb_peek(&g_txq_rb, 0, &rec, sizeof(rec)) != sizeof(rec)) {
+            (void)os_sema_down(&g_txq_sem, 1000);
+            continue;
+        }
+        HALOW_BRIDGE_BARRIER();
+        if (lwrb_get_full(&g_txq_rb) < (lwrb_sz_t)(sizeof(rec) + rec.len)) {
+            (void)os_sema_down(&g_txq_sem, 1);
+            continue;
+        }
+
+        lwrb_skip(&g_txq_rb, sizeof(rec));
+        (void)lwrb_read(&g_txq_rb, g_frame_buf, rec.len);
+
+        /* a frame this old only adds to the queue, TCP has retransmitted it by now */
+        if ((uint32_t)get_time_ms() - rec.enq_ms > 2u * g_cfg.queue_ms) {
+            g_stat.drop_late++;
+        } else if (g_tx_cb(g_frame_buf, rec.len) == 0) {
+            g_stat.tx_frames++;
+            g_stat.tx_bytes += rec.len;
+        }
+
+        HALOW_BRIDGE_BARRIER();
+        g_air_out_us += rec.air_us;
+    }
+}
+
+/* Radio RX context: one radio frame is one Ethernet frame */
+void halow_bridge_input(const uint8_t *data, int32_t len){
+    struct pbuf *p;
+
+    if (!g_active || (data == NULL)) {
+        return;
+    }
+    if ((len < SIZEOF_ETH_HDR) || (len > HALOW_BRIDGE_FRAME_MAX)) {
+        g_stat.drop_size++;
+        return;
+    }
+
+    p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_RAM);
+    if (p == NULL) {
+        g_stat.rx_drop++;
+        return;
+    }
+    (void)pbuf_take(p, data, (u16_t)len);
+
+    /* bridgeif port input, hands the frame over to the tcpip thread */
+    if (g_port_netif.input(p, &g_port_netif) != ERR_OK) {
+        pbuf_free(p);
+        g_stat.rx_drop++;
+        return;
+    }
+    g_stat.rx_frames++;
+    g_stat.rx_bytes += (uint32_t)len;
+}
+
+static err_t halow_bridge_port_init(struct netif *netif){
+    netif->name[0]    = 'h';
+    netif->name[1]    = '0';
+    netif->output     = etharp_output;
+    netif->linkoutput = halow_bridge_port_output;
+    netif->mtu        = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    memcpy(netif->hwaddr, g_mac, ETH_HWADDR_LEN);
+    /* bridgeif only takes Ethernet ports */
+    netif->flags      = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+    return ERR_OK;
+}
+
+/* tcpip thread */
+static err_t halow_bridge_attach(struct netif *br){
+    err_t err;
+
+    err = bridgeif_add_port(br, g_eth_netif);
+    if (err == ERR_OK) {
+        err = bridgeif_add_port(br, &g_port_netif);
+    }
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    netif_set_link_up(&g_port_netif);
+    netif_set_up(&g_port_netif);
+    netif_set_link_up(br);
+    netif_set_up(br);
+    return ERR_OK;
+}
+
+/* tcpip thread */
+static void halow_bridge_iperf_report(void *arg, enum lwiperf_report_type report_type,
+                                      const ip_addr_t *local_addr, u16_t local_port,
+                                      const ip_addr_t *remote_addr, u16_t remote_port,
+                                      u32_t bytes_transferred, u32_t ms_duration,
+                                      u32_t bandwidth_kbitpsec){
+    (void)arg;
+    (void)local_addr;
+    (void)local_port;
+    (void)remote_port;
+
+    g_iperf.valid = true;
+    g_iperf.ok    = (report_type == LWIPERF_TCP_DONE_SERVER) ? true : false;
+    g_iperf.bytes = bytes_transferred;
+    g_iperf.ms    = ms_duration;
+    g_iperf.kbps  = bandwidth_kbitpsec;
+    if ((remote_addr != NULL) && IP_IS_V4(remote_addr)) {
+        ip4_addr_copy(g_iperf.remote, *ip_2_ip4(remote_addr));
+    }
+    hbr_debug("iperf type=%d %lu bytes %lu ms %lu kbit/s", (int)report_type,
+              (unsigned long)bytes_transferred, (unsigned long)ms_duration,
+              (unsigned long)bandwidth_kbitpsec);
+}
+
+static void halow_bridge_iperf_start_cb(void *arg){
+    (void)arg;
+
+    if (lwiperf_start_tcp_server_default(halow_bridge_iperf_report, NULL) == NULL) {
+        hbr_debug("lwiperf start failed");
+    }
+}
+
+static void halow_bridge_apply_cb(void *arg){
+    halow_bridge_config_t *cfg = (halow_bridge_config_t *)arg;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    /* the mode itself is only read at boot */
+    g_cfg.bcast_pps = cfg->bcast_pps;
+    g_cfg.queue_ms  = cfg->queue_ms;
+    hbr_debug("APPLY bcast_pps=%u queue_ms=%u", (unsigned)g_cfg.bcast_pps, (unsigned)g_cfg.queue_ms);
+
+    os_free(cfg);
+}
+
+void halow_bridge_config_apply(const halow_bridge_config_t *cfg){
+    halow_bridge_config_t *copy;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    copy = (halow_bridge_config_t *)os_malloc(sizeof(*copy));
+    if (copy == NULL) {
+        hbr_debug("APPLY arg OOM");
+        return;
+    }
+
+    *copy = *cfg;
+    halow_bridge_cfg_sanitize(copy);
+
+    if (tcpip_try_callback(halow_bridge_apply_cb, copy) != ERR_OK) {
+        os_free(copy);
+        hbr_debug("APPLY tcpip_try_callback failed");
+        return;
+    }
+}
+
+bool halow_bridge_active(void){
+    return g_active;
+}
+
+halow_bridge_stat_t halow_bridge_stat_get(void){
+    halow_bridge_stat_t stat = g_stat;
+
+    stat.queued_us = g_air_in_us - g_air_out_us;
+    return stat;
+}
+
+halow_bridge_iperf_t halow_bridge_iperf_get(void){
+    return g_iperf;
+}
+
+static int32_t halow_bridge_task_init(void){
+    int32_t ret;
+
+    (void)os_sema_init(&g_txq_sem, 0);
+
+    ret = os_task_init((const uint8 *)"bridge", &g_task, halow_bridge_task, 0);
+    if (ret != 0) {
+        return ret;
+    }
+    (void)os_task_set_stacksize(&g_task, HALOW_BRIDGE_TASK_STACK);
+    (void)os_task_set_priority(&g_task, HALOW_BRIDGE_TASK_PRIO);
+    return os_task_run(&g_task);
+}
+
+struct netif *halow_bridge_init(struct netif *eth, const uint8_t mac[6], halow_bridge_tx_cb_t cb){
+    halow_bridge_config_t cfg;
+
+    halow_bridge_config_load(&cfg);
+    halow_bridge_config_save(&cfg);
+    g_cfg = cfg;
+
+    if (!cfg.enabled) {
+        return NULL;
+    }
+    if ((eth == NULL) || (mac == NULL) || (cb == NULL)) {
+        return NULL;
+    }
+
+    g_txq_rb_data = (uint8_t *)os_malloc(HALOW_BRIDGE_TXQ_RING + HALOW_BRIDGE_FRAME_MAX);
+    if (g_txq_rb_data == NULL) {
+        hbr_debug("queue OOM");
+        return NULL;
+    }
+    g_frame_buf = g_txq_rb_data + HALOW_BRIDGE_TXQ_RING;
+
+    g_tx_cb     = cb;
+    g_eth_netif = eth;
+    memcpy(g_mac, mac, sizeof(g_mac));
+    lwrb_init(&g_txq_rb, g_txq_rb_data, HALOW_BRIDGE_TXQ_RING);
+
+    if (halow_bridge_task_init() != 0) {
+        hbr_debug("task init failed");
+        return NULL;
+    }
+
+    g_br_init.max_ports               = 2;
+    g_br_init.max_fdb_dynamic_entries = HALOW_BRIDGE_FDB_ENTRIES;
+    g_br_init.max_fdb_static_entries  = 0;
+    memcpy(&g_br_init.ethaddr, mac, ETH_HWADDR_LEN);
+
+    /* bridgeif_input() runs in the tcpip thread already, so the bridge takes frames directly */
+    if (netifapi_netif_add(&g_br_netif, NULL, NULL, NULL, &g_br_init,
+                           bridgeif_init, ethernet_input) != ERR_OK) {
+        hbr_debug("bridge netif_add failed");
+        return NULL;
+    }
+    if (netifapi_netif_add(&g_port_netif, NULL, NULL, NULL, NULL,
+                           halow_bridge_port_init, tcpip_input) != ERR_OK) {
+        hbr_debug("port netif_add failed");
+        return NULL;
+    }
+    if (netifapi_netif_common(&g_br_netif, NULL, halow_bridge_attach) != ERR_OK) {
+        hbr_debug("attach failed");
+        return NULL;
+    }
+
+    g_active = true;
+    (void)tcpip_try_callback(halow_bridge_iperf_start_cb, NULL);
+    hbr_debug("bridge up, fdb=%u queue_ms=%u bcast_pps=%u", (unsigned)HALOW_BRIDGE_FDB_ENTRIES,
+              (unsigned)g_cfg.queue_ms, (unsigned)g_cfg.bcast_pps);
+    return &g_br_netif;
+}
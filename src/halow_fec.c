@@ -0,0 +1,286 @@
+#include "halow_fec.h"
+
+#include <string.h>
+
+#include "osal/string.h"
+#include "utils.h"
+
+#define HALOW_FEC_GF_POLY       0x11D       /* x^8 + x^4 + x^3 + x^2 + 1 */
+
+#define HALOW_FEC_BENCH_LEN     512
+#define HALOW_FEC_BENCH_ROUNDS  16
+
+static uint8_t g_gf_exp[512];               /* doubled, exp[log a + log b] needs no modulo */
+static uint8_t g_gf_log[256];
+static uint8_t g_coef[HALOW_FEC_M_MAX][HALOW_FEC_K_MAX];
+static bool g_ready;
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b){
+    if ((a == 0) || (b == 0)) {
+        return 0;
+    }
+    return g_gf_exp[(uint32_t)g_gf_log[a] + g_gf_log[b]];
+}
+
+static inline uint8_t gf_inv(uint8_t a){
+    return g_gf_exp[255U - g_gf_log[a]];
+}
+
+/*
+ * dst ^= c * src. The product is split by nibbles, two 16 entry tables per
+ * coefficient are cheap enough to build on every call.
+ */
+static void gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, uint32_t len){
+    uint8_t lo[16];
+    uint8_t hi[16];
+
+    if (c == 0) {
+        return;
+    }
+    if (c == 1) {
+        for (uint32_t n = 0; n < len; n++) {
+            dst[n] ^= src[n];
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+        lo[i] = gf_mul(c, (uint8_t)i);
+        hi[i] = gf_mul(c, (uint8_t)(i << 4));
+    }
+    for (uint32_t n = 0; n < len; n++) {
+        uint8_t s = src[n];
+        dst[n] ^= (uint8_t)(lo[s & 0x0F] ^ hi[s >> 4]);
+    }
+}
+
+void halow_fec_init(void){
+    uint32_t x = 1;
+
+    if (g_ready) {
+        return;
+    }
+    for (uint32_t i = 0; i < 255; i++) {
+        g_gf_exp[i]       = (uint8_t)x;
+        g_gf_exp[i + 255] = (uint8_t)x;
+        g_gf_log[x]       = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= HALOW_FEC_GF_POLY;
+        }
+    }
+    g_gf_exp[510] = g_gf_exp[0];
+    g_gf_exp[511] = g_gf_exp[1];
+
+    /* x_j = K_MAX + j and y_i = i never collide, so x_j + y_i is never zero */
+    for (uint32_t j = 0; j < HALOW_FEC_M_MAX; j++) {
+        for (uint32_t i = 0; i < HALOW_FEC_K_MAX; i++) {
+            g_coef[j][i] = gf_inv((uint8_t)((HALOW_FEC_K_MAX + j) ^ i));
+        }
+    }
+    g_ready = true;
+}
+
+void halow_fec_encode(uint8_t *parity, uint32_t row, uint32_t idx, const uint8_t *sym, uint32_t len){
+    if ((row >= HALOW_FEC_M_MAX) || (idx >= HALOW_FEC_K_MAX)) {
+        return;
+    }
+    gf_mul_add(parity, sym, g_coef[row][idx], len);
+}
+
+/* In place Gauss-Jordan inversion of the e x e matrix a into inv */
+static bool gf_invert(uint8_t a[HALOW_FEC_M_MAX][HALOW_FEC_M_MAX],
+                      uint8_t inv[HALOW_FEC_M_MAX][HALOW_FEC_M_MAX], uint32_t e){
+    for (uint32_t r = 0; r < e; r++) {
+        for (uint32_t c = 0; c < e; c++) {
+            inv[r][c] = (r == c) ? 1 : 0;
+        }
+    }
+
+    for (uint32_t col = 0; col < e; col++) {
+        uint32_t p = col;
+        uint8_t f;
+
+        while ((p < e) && (a[p][col] == 0)) {
+            p++;
+        }
+        if (p == e) {
+            return false;
+        }
+        if (p != col) {
+            for (uint32_t c = 0; c < e; c++) {
+                uint8_t t;
+                t = a[p][c];   a[p][c]   = a[col][c];   a[col][c]   = t;
+                t = inv[p][c]; inv[p][c] = inv[col][c]; inv[col][c] = t;
+            }
+        }
+
+        f = gf_inv(a[col][col]);
+        for (uint32_t c = 0; c < e; c++) {
+            a[col][c]   = gf_mul(a[col][c], f);
+            inv[col][c] = gf_mul(inv[col][c], f);
+        }
+
+        for (uint32_t r = 0; r < e; r++) {
+            if ((r == col) || (a[r][col] == 0)) {
+                continue;
+            }
+            f = a[r][col];
+            for (uint32_t c = 0; c < e; c++) {
+                a[r][c]   ^= gf_mul(a[col][c], f);
+                inv[r][c] ^= gf_mul(inv[col][c], f);
+            }
+        }
+    }
+    return true;
+}
+
+int32_t halow_fec_decode(uint8_t *const data[], uint32_t k, uint32_t have,
+                         uint8_t *const parity[], uint32_t par_have, uint32_t len){
+    uint8_t miss[HALOW_FEC_M_MAX];
+    uint8_t rows[HALOW_FEC_M_MAX];
+    uint8_t a[HALOW_FEC_M_MAX][HALOW_FEC_M_MAX];
+    uint8_t inv[HALOW_FEC_M_MAX][HALOW_FEC_M_MAX];
+    uint32_t e = 0;
+    uint32_t r = 0;
+
+    if ((k == 0) || (k > HALOW_FEC_K_MAX)) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < k; i++) {
+        if ((have & (1UL << i)) == 0) {
+            if (e == HALOW_FEC_M_MAX) {
+                return -1;
+            }
+            miss[e++] = (uint8_t)i;
+        }
+    }
+    if (e == 0) {
+        return 0;
+    }
+    for (uint32_t j = 0; (j < HALOW_FEC_M_MAX) && (r < e); j++) {
+        if (par_have & (1UL << j)) {
+            rows[r++] = (uint8_t)j;
+        }
+    }
+    if (r < e) {
+        return -1;
+    }
+
+    /* What is left of each parity row once the symbols we have are taken out */
+    for (r = 0; r < e; r++) {
+        for (uint32_t i = 0; i < k; i++) {
+            if (have & (1UL << i)) {
+                gf_mul_add(parity[rows[r]], data[i], g_coef[rows[r]][i], len);
+            }
+        }
+        for (uint32_t t = 0; t < e; t++) {
+            a[r][t] = g_coef[rows[r]][miss[t]];
+        }
+    }
+    if (!gf_invert(a, inv, e)) {
+        return -1;
+    }
+
+    for (uint32_t t = 0; t < e; t++) {
+        memset(data[miss[t]], 0, len);
+        for (r = 0; r < e; r++) {
+            gf_mul_add(data[miss[t]], parity[rows[r]], inv[t][r], len);
+        }
+    }
+    return (int32_t)e;
+}
+
+static uint32_t bench_kbps(uint32_t bytes, int64_t us){
+    if (us <= 0) {
+        us = 1;
+    }
+    return (uint32_t)(((uint64_t)bytes * 1000000ULL) / (uint64_t)us / 1024ULL);
+}
+
+int32_t halow_fec_bench(halow_fec_bench_t *res, uint32_t max){
+    static const uint8_t ms[] = { 1, 2, 4 };
+    const uint32_t k   = HALOW_FEC_K_MAX;
+    const uint32_t len = HALOW_FEC_BENCH_LEN;
+    uint8_t *buf;
+    uint8_t *data[HALOW_FEC_K_MAX];
+    uint8_t *parity[HALOW_FEC_M_MAX];
+    uint8_t *saved;
+    uint8_t *orig;
+    uint32_t seed = 0x2545F491UL;
+    uint32_t n = 0;
+
+    if ((res == NULL) || (max == 0)) {
+        return -1;
+    }
+    halow_fec_init();
+
+    /* data | parity | parity copy | erased originals */
+    buf = (uint8_t *)os_malloc((k + 3U * HALOW_FEC_M_MAX) * len);
+    if (buf == NULL) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < k; i++) {
+        data[i] = buf + i * len;
+    }
+    for (uint32_t j = 0; j < HALOW_FEC_M_MAX; j++) {
+        parity[j] = buf + (k + j) * len;
+    }
+    saved = buf + (k + HALOW_FEC_M_MAX) * len;
+    orig  = buf + (k + 2U * HALOW_FEC_M_MAX) * len;
+
+    for (uint32_t i = 0; i < k * len; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        buf[i] = (uint8_t)seed;
+    }
+    memcpy(orig, buf, HALOW_FEC_M_MAX * len);
+
+    for (uint32_t v = 0; (v < sizeof(ms)) && (n < max); v++) {
+        uint32_t m = ms[v];
+        uint32_t have = ((1UL << k) - 1U) & ~((1UL << m) - 1U);   /* first m data symbols erased */
+        int64_t t0;
+        int64_t enc_us;
+        int64_t dec_us = 0;
+        bool ok = true;
+
+        t0 = get_time_us();
+        for (uint32_t r = 0; r < HALOW_FEC_BENCH_ROUNDS; r++) {
+            memset(parity[0], 0, m * len);
+            for (uint32_t i = 0; i < k; i++) {
+                for (uint32_t j = 0; j < m; j++) {
+                    halow_fec_encode(parity[j], j, i, data[i], len);
+                }
+            }
+        }
+        enc_us = get_time_us() - t0;
+        memcpy(saved, parity[0], m * len);
+
+        for (uint32_t r = 0; r < HALOW_FEC_BENCH_ROUNDS; r++) {
+            memcpy(parity[0], saved, m * len);
+            memset(data[0], 0, m * len);
+            t0 = get_time_us();
+            if (halow_fec_decode(data, k, have, parity, (1UL << m) - 1U, len) != (int32_t)m) {
+                ok = false;
+            }
+            dec_us += get_time_us() - t0;
+        }
+        if (memcmp(data[0], orig, m * len) != 0) {
+            ok = false;
+        }
+        memcpy(data[0], orig, m * len);
+
+        res[n].k        = (uint8_t)k;
+        res[n].m        = (uint8_t)m;
+        res[n].sym_len  = (uint16_t)len;
+        res[n].enc_us   = (uint32_t)(enc_us / HALOW_FEC_BENCH_ROUNDS);
+        res[n].dec_us   = (uint32_t)(dec_us / HALOW_FEC_BENCH_ROUNDS);
+        res[n].enc_kbps = bench_kbps(k * len * HALOW_FEC_BENCH_ROUNDS, enc_us);
+        res[n].dec_kbps = bench_kbps(k * len * HALOW_FEC_BENCH_ROUNDS, dec_us);
+        res[n].ok       = ok;
+        n++;
+    }
+
+    os_free(buf);
+    return (int32_t)n;
+}
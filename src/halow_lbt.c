@@ -42,12 +42,22 @@
 #define HALOW_LBT_AIRTIME_ACCUMULATOR_BUF   10
 #define HALOW_LBT_AIRTIME_UPDATE_PERIOD_MS  100
 
+/* One bin per int8 dBm value of the long window */
+#define HALOW_LBT_HIST_BINS                 256
+#define HALOW_LBT_HIST_IDX(v)               ((uint8_t)((int)(v) + 128))
+
 #ifdef HALOW_LBT_DEBUG
 #define hlbt_debug(fmt, ...)  os_printf("[HLBT] " fmt "\r\n", ##__VA_ARGS__)
 #else
 #define hlbt_debug(fmt, ...)  do { } while (0)
 #endif
 
+/* Most recent raw sample, used by the channel access gate */
+typedef struct {
+    int8_t  dbm;
+    int64_t ts_us;
+} halow_lbt_sample_t;
+
 typedef struct {
     halow_lbt_config_t cfg;
 
@@ -56,10 +66,11 @@ typedef struct {
 
     int8_t        noise_short;
     int8_t        noise_floor;
-    uint32_t      noise_floor_ts_ms;
 
-    int64_t       last_tx_us;
-    int64_t       last_lbt_us;
+    int64_t       last_tx_us;           // End of our last TX burst
+    int64_t       last_lbt_us;          // Last channel check
+    int64_t       burst_start_us;       // Start of the current continuous TX burst, 0 = none
+    halow_lbt_sample_t last_sample;
 
     uint16_t      short_n;
     uint16_t      long_n;
@@ -68,19 +79,36 @@ typedef struct {
 
     int8_t       *short_samples;
     int8_t       *long_rb_data;
-    int8_t       *tmp_sort;
+    uint16_t      long_hist[HALOW_LBT_HIST_BINS];
 
     int64_t       time_last_cycle_update_us;
-    int64_t       airtime_time_last_tx_started;
-    int32_t       airtime_time_tx_from_last_cycle_update_us;
+    int32_t       airtime_time_tx_from_last_cycle_update_us;    // Sum of PPDU durations completed in this cycle
     bool          airtime_tx_active;
     float         airtime_rb[HALOW_LBT_AIRTIME_ACCUMULATOR_BUF];
     int8_t        airtime_rb_idx;
 
+    int64_t       sampler_busy_us;
+
+    int64_t       bucket_tokens_us;     // Airtime we may still spend, negative = debt
+    int64_t       bucket_last_us;
+
     lwrb_t        long_rb;
 } halow_lbt_ctx_t;
 
+/*
+ * Lock-free copy for readers that only need the noise levels. Each value is a
+ * single byte, so a load is atomic; readers never wait for the idle priority
+ * LBT task.
+ */
+typedef struct {
+    volatile int8_t   noise_short;
+    volatile int8_t   noise_floor;
+} halow_lbt_pub_t;
+
+
 static halow_lbt_ctx_t *g_lbt_ctx;
+static halow_lbt_pub_t g_lbt_pub;
+static volatile float g_lbt_sampler_load;
 static struct os_task g_lbt_task;
 static struct os_mutex g_lbt_ctx_mutex;
 
@@ -134,13 +162,26 @@ static void halow_lbt_rand_init_from_bknoise( void ){
     os_srand(seed);
 }
 
+/* Samples >= from_dbm in the long window */
+static uint32_t halow_lbt_hist_count_from( const halow_lbt_ctx_t *ctx, int from_dbm ){
+    uint32_t cnt = 0;
+
+    if (from_dbm < -128) {
+        from_dbm = -128;
+    }
+    for (int v = from_dbm; v <= 127; v++) {
+        cnt += ctx->long_hist[HALOW_LBT_HIST_IDX(v)];
+    }
+    return cnt;
+}
+
 float halow_lbt_ch_util_get(void){
     halow_lbt_ctx_t *ctx;
     uint32_t busy;
     lwrb_sz_t n;
-    int8_t floor;
     int rel_thr;
     int abs_thr;
+    int busy_from;
 
     busy = 0;
     if(g_lbt_ctx_mutex.hdl == NULL){
@@ -154,24 +195,21 @@ float halow_lbt_ch_util_get(void){
         return 0.0f;
     }
 
-    n = (lwrb_sz_t)ctx->long_n;
+    n = lwrb_get_full(&ctx->long_rb);
     if (n == 0) {
         (void)os_mutex_unlock(&g_lbt_ctx_mutex);
         return 0.0f;
     }
 
-    floor   = halow_lbt_background_long_dbm_get();
-    rel_thr = (int)floor + (int)ctx->cfg.noise_relative_offset_dbm;
+    rel_thr = (int)ctx->noise_floor + (int)ctx->cfg.noise_relative_offset_dbm;
     abs_thr = (int)ctx->cfg.noise_absolute_busy_dbm;
 
-    (void)lwrb_peek(&ctx->long_rb, 0, ctx->tmp_sort, n);
-
-    for (lwrb_sz_t i = 0; i < n; i++){
-        int v = (int)ctx->tmp_sort[i];
-        if (v >= abs_thr || v > rel_thr){
-            busy++;
-        }
+    /* busy: v >= abs_thr || v > rel_thr */
+    busy_from = abs_thr;
+    if (rel_thr + 1 < busy_from) {
+        busy_from = rel_thr + 1;
     }
+    busy = halow_lbt_hist_count_from(ctx, busy_from);
 
     (void)os_mutex_unlock(&g_lbt_ctx_mutex);
 
@@ -183,27 +221,6 @@ float halow_lbt_ch_util_get(void){
     return ch_util;
 }
 
-static float halow_lbt_airtime_max_percentage(void){
-    if(g_lbt_ctx_mutex.hdl == NULL){
-        return 0.0f;
-    }
-    os_mutex_lock(&g_lbt_ctx_mutex, 100);
-
-    if (g_lbt_ctx == NULL) {
-        os_mutex_unlock(&g_lbt_ctx_mutex);
-        return 0.0f;
-    }
-    float max_airtime = 1.0f;
-    if(g_lbt_ctx->cfg.util_enabled){
-        max_airtime = ((float)g_lbt_ctx->cfg.util_max_percent)/100.0f;
-    }
-    if(max_airtime < 0.01f){
-        max_airtime = 0.01f;
-    }
-    os_mutex_unlock(&g_lbt_ctx_mutex);
-    return max_airtime;
-}
-
 float halow_lbt_airtime_get(void){
     if(g_lbt_ctx_mutex.hdl == NULL){
         return 0.0f;
@@ -223,31 +240,16 @@ float halow_lbt_airtime_get(void){
     return airtime;
 }
 
-int8_t halow_lbt_noise_dbm_now( int64_t sample_time_us ){
-    if(g_lbt_ctx_mutex.hdl == NULL){
-        return 0.0f;
-    }
-    int64_t time_start = get_time_us();
-    int64_t time_end = time_start + sample_time_us;
-
-    ah_rfdigicali_config_hw_bknoise(384, 1);
-    ah_rfdigicali_bknoise_valid_pd_clr();
-    lmac_bknoise_calc_en();
-
-    int64_t acc = 0;
-    uint32_t cnt = 0;
-    while (get_time_us() < time_end) {
-        if (ah_rfdigicali_bknoise_valid_pd_get() == 0) {
-            os_sleep_us(10);
-            continue;
-        }
-        int32_t v = lmac_bknoise_get();
-        lmac_bknoise_calc_en();
-        acc += (int8_t)v;
-        cnt++;
+/* Sleeps at least `us`: waits of 1 ms and more are rounded up to whole ticks, callers re-check */
+static void halow_lbt_sleep_us( int64_t us ){
+    if (us >= 1000) {
+        os_sleep_ms((int)((us + 999) / 1000));
+    } else if (us > 0) {
+        os_sleep_us((int)us);
     }
-    lmac_bknoise_calc_dis();
+}
 
+static int8_t halow_lbt_noise_avg( int64_t acc, uint32_t cnt ){
     if (cnt == 0) {
         return (int8_t)-128;
     }
@@ -261,106 +263,149 @@ int8_t halow_lbt_noise_dbm_now( int64_t sample_time_us ){
     return (int8_t)avg;
 }
 
-static int cmp_i8( const void *a, const void *b ){
-    int ia = (int)*(const int8_t *)a;
-    int ib = (int)*(const int8_t *)b;
-    return (ia > ib) - (ia < ib);
+/* Fills out[] with n averages of sample_time_us each; bknoise HW is set up once per batch. No locks held. */
+static void halow_lbt_noise_batch( int8_t *out, uint32_t n, int64_t sample_time_us ){
+    ah_rfdigicali_config_hw_bknoise(384, 1);
+    ah_rfdigicali_bknoise_valid_pd_clr();
+    lmac_bknoise_calc_en();
+
+    for (uint32_t i = 0; i < n; i++) {
+        int64_t time_end = get_time_us() + sample_time_us;
+        int64_t acc = 0;
+        uint32_t cnt = 0;
+
+        while (get_time_us() < time_end) {
+            if (ah_rfdigicali_bknoise_valid_pd_get() == 0) {
+                os_sleep_us(10);
+                continue;
+            }
+            int32_t v = lmac_bknoise_get();
+            lmac_bknoise_calc_en();
+            acc += (int8_t)v;
+            cnt++;
+        }
+        out[i] = halow_lbt_noise_avg(acc, cnt);
+    }
+
+    lmac_bknoise_calc_dis();
 }
 
-static int8_t noise_pxx_from_rb( halow_lbt_ctx_t *ctx ){
-    lwrb_sz_t n;
+int8_t halow_lbt_noise_dbm_now( int64_t sample_time_us ){
+    int8_t v;
+
+    halow_lbt_noise_batch(&v, 1, sample_time_us);
+    return v;
+}
+
+/* Lowest floor_pct percent of the long window, walked over the histogram instead of sorting */
+static int8_t noise_pxx_from_hist( const halow_lbt_ctx_t *ctx ){
+    uint32_t n;
     uint8_t pct;
     uint32_t k;
-    lwrb_sz_t idx;
-    int8_t r;
+    uint32_t acc;
 
     if (ctx == NULL) {
         return 0;
     }
 
-    n = (lwrb_sz_t)ctx->long_n;
+    n = (uint32_t)lwrb_get_full(&ctx->long_rb);
     if (n == 0) {
         return 0;
     }
 
-    (void)lwrb_peek(&ctx->long_rb, 0, ctx->tmp_sort, n);
-
-    qsort(ctx->tmp_sort, (size_t)n, sizeof(ctx->tmp_sort[0]), cmp_i8);
-
     pct = ctx->floor_pct;
     if (pct > 100u) {
         pct = 100u;
     }
 
-    k = ((((uint32_t)n) * (uint32_t)pct) + 99u) / 100u;
+    k = ((n * (uint32_t)pct) + 99u) / 100u;
     if (k == 0u) {
         k = 1u;
     }
 
-    idx = (lwrb_sz_t)(k - 1u);
-    if (idx >= n) {
-        idx = n - 1;
+    acc = 0;
+    for (int v = -128; v <= 127; v++) {
+        acc += ctx->long_hist[HALOW_LBT_HIST_IDX(v)];
+        if (acc >= k) {
+            return (int8_t)v;
+        }
     }
-
-    r = ctx->tmp_sort[idx];
-    return r;
+    return 127;
 }
 
-int8_t halow_lbt_background_short_dbm_get( void ){
-    if(g_lbt_ctx_mutex.hdl == NULL){
-        return 0.0f;
+static void halow_lbt_long_push( halow_lbt_ctx_t *ctx, int8_t v ){
+    if (lwrb_get_free(&ctx->long_rb) == 0) {
+        int8_t evict;
+        if (lwrb_read(&ctx->long_rb, &evict, (lwrb_sz_t)sizeof(evict)) == sizeof(evict)) {
+            ctx->long_hist[HALOW_LBT_HIST_IDX(evict)]--;
+        }
     }
-    halow_lbt_ctx_t *ctx;
-    int8_t v = 0;
 
-    (void)os_mutex_lock(&g_lbt_ctx_mutex, -1);
-    ctx = g_lbt_ctx;
-    if (ctx != NULL) {
-        v = ctx->noise_short;
+    if (lwrb_write(&ctx->long_rb, &v, (lwrb_sz_t)sizeof(v)) == sizeof(v)) {
+        ctx->long_hist[HALOW_LBT_HIST_IDX(v)]++;
     }
-    (void)os_mutex_unlock(&g_lbt_ctx_mutex);
 
-    return v;
+    ctx->noise_floor = noise_pxx_from_hist(ctx);
 }
 
-int8_t halow_lbt_background_long_dbm_get( void ){
-    if(g_lbt_ctx_mutex.hdl == NULL){
-        return 0.0f;
-    }
-    halow_lbt_ctx_t *ctx;
-    int64_t now;
-    uint64_t ts;
-    int8_t floor;
+/* Only the LBT task publishes */
+static void halow_lbt_publish( int8_t noise_short, int8_t noise_floor ){
+    g_lbt_pub.noise_short = noise_short;
+    g_lbt_pub.noise_floor = noise_floor;
+}
 
-    now = get_time_ms();
+int8_t halow_lbt_background_short_dbm_get( void ){
+    return g_lbt_pub.noise_short;
+}
 
-    (void)os_mutex_lock(&g_lbt_ctx_mutex, -1);
+int8_t halow_lbt_background_long_dbm_get( void ){
+    return g_lbt_pub.noise_floor;
+}
 
-    ctx = g_lbt_ctx;
-    if (ctx == NULL) {
-        (void)os_mutex_unlock(&g_lbt_ctx_mutex);
-        return 0;
-    }
+float halow_lbt_sampler_load_get( void ){
+    return g_lbt_sampler_load;
+}
 
-    ts = ctx->noise_floor_ts_ms;
-    floor = ctx->noise_floor;
+static void halow_lbt_airtime_cycle_update( halow_lbt_ctx_t *ctx ){
+    int64_t now_us  = get_time_us();
+    int64_t last_us = ctx->time_last_cycle_update_us;
+    int64_t cycle_us = now_us - last_us;
+    int32_t airtime_us = ctx->airtime_time_tx_from_last_cycle_update_us;
 
-    if ((uint64_t)now - ts >= 100u) {
-        floor = noise_pxx_from_rb(ctx);
-        ctx->noise_floor = floor;
-        ctx->noise_floor_ts_ms = (uint64_t)now;
+    float current_airtime = (float)airtime_us / (float)cycle_us;
+    ctx->airtime_rb[ctx->airtime_rb_idx++] = current_airtime;
+    if(ctx->airtime_rb_idx >= HALOW_LBT_AIRTIME_ACCUMULATOR_BUF){
+        ctx->airtime_rb_idx = 0;
     }
 
-    (void)os_mutex_unlock(&g_lbt_ctx_mutex);
-    return floor;
-}
+    ctx->airtime_time_tx_from_last_cycle_update_us = 0;
+    ctx->time_last_cycle_update_us = now_us;
 
+    g_lbt_sampler_load = (float)ctx->sampler_busy_us / (float)cycle_us;
+    ctx->sampler_busy_us = 0;
+}
 
+/*
+ * Samples a batch of bknoise readings without the context lock, then takes the lock only to fold
+ * the batch into the windows. Sleeps between batches so sampling uses at most
+ * HALOW_LBT_SAMPLER_DUTY_PERCENT of the CPU. The sleep is at least one tick, so with the default
+ * batch of 8 x 100 us the rate is about 4.4k samples/s, not the 10k/s of continuous sampling:
+ * the noise windows, counted in samples, span about 2.3 times longer than that would suggest.
+ */
 void halow_lbt_task( void *arg ){
     (void)arg;
+    int8_t batch[HALOW_LBT_SAMPLER_BATCH];
+    int64_t airtime_cycle_timetamp = 0;
 
     while (1) {
         halow_lbt_ctx_t *ctx;
+        int64_t t0_us;
+        int64_t busy_us;
+        uint32_t sleep_ms;
+
+        t0_us = get_time_us();
+        halow_lbt_noise_batch(batch, HALOW_LBT_SAMPLER_BATCH, HALOW_LBT_SAMPLE_TIME_US);
+        busy_us = get_time_us() - t0_us;
 
         (void)os_mutex_lock(&g_lbt_ctx_mutex, -1);
         ctx = g_lbt_ctx;
@@ -370,74 +415,52 @@ void halow_lbt_task( void *arg ){
             continue;
         }
 
-        int8_t noise_dbm = halow_lbt_noise_dbm_now(100);
+        ctx->last_sample.dbm   = batch[HALOW_LBT_SAMPLER_BATCH - 1];
+        ctx->last_sample.ts_us = t0_us + busy_us;
 
-        ctx->short_samples[ctx->short_i++] = noise_dbm;
-        ctx->short_sum += noise_dbm;
+        for (uint32_t i = 0; i < HALOW_LBT_SAMPLER_BATCH; i++) {
+            ctx->short_samples[ctx->short_i++] = batch[i];
+            ctx->short_sum += batch[i];
 
-        if (ctx->short_i >= ctx->short_n) {
-            int8_t short_avg = (int8_t)(ctx->short_sum / (int32_t)ctx->short_n);
+            if (ctx->short_i >= ctx->short_n) {
+                int8_t short_avg = (int8_t)(ctx->short_sum / (int32_t)ctx->short_n);
 
-            ctx->noise_short = short_avg;
+                ctx->noise_short = short_avg;
+                halow_lbt_long_push(ctx, short_avg);
+                halow_lbt_publish(ctx->noise_short, ctx->noise_floor);
 
-            if (lwrb_get_free(&ctx->long_rb) == 0) {
-                int8_t evict;
-                (void)lwrb_read(&ctx->long_rb, &evict, (lwrb_sz_t)sizeof(evict));
+                ctx->short_i = 0;
+                ctx->short_sum = 0;
             }
-
-            (void)lwrb_write(&ctx->long_rb, &short_avg, (lwrb_sz_t)sizeof(short_avg));
-
-            ctx->short_i = 0;
-            ctx->short_sum = 0;
         }
+        ctx->sampler_busy_us += busy_us;
 
-        
         int64_t current_time_ms = get_time_ms();
-        static int64_t airtime_cycle_timetamp;
         if((current_time_ms - airtime_cycle_timetamp) >= HALOW_LBT_AIRTIME_UPDATE_PERIOD_MS){
             airtime_cycle_timetamp = current_time_ms;
-            // Airtime
-            int64_t now_us  = get_time_us();
-            int64_t last_us = ctx->time_last_cycle_update_us;
-            int64_t cycle_us = now_us - last_us;
-            int32_t airtime_us = ctx->airtime_time_tx_from_last_cycle_update_us;
-
-            if (ctx->airtime_tx_active) {
-                int64_t start_us = ctx->airtime_time_last_tx_started;
-
-                int64_t dt = now_us - start_us;
-                int64_t acc = (int64_t)airtime_us + dt;
-                
-                airtime_us = (int32_t)acc;
-                ctx->airtime_time_last_tx_started = now_us;
-            } else {
-                ctx->airtime_time_last_tx_started = 0;
-            }
+            halow_lbt_airtime_cycle_update(ctx);
+        }
 
-            float current_airtime = (float)airtime_us / (float)cycle_us;
-            ctx->airtime_rb[ctx->airtime_rb_idx++] = current_airtime;
-            if(ctx->airtime_rb_idx >= HALOW_LBT_AIRTIME_ACCUMULATOR_BUF){
-                ctx->airtime_rb_idx = 0;
-            }
+        (void)os_mutex_unlock(&g_lbt_ctx_mutex);
 
-            ctx->airtime_time_tx_from_last_cycle_update_us = 0;
-            ctx->time_last_cycle_update_us = now_us;
-        }
 #ifdef HALOW_LBT_DEBUG
         static uint16_t dbg_tick;
         if (++dbg_tick >= 1000) {
             dbg_tick = 0;
             hlbt_debug(
-                "ccur=%d floor=%d util=%.1f%% airtime=%.1f%%",
+                "ccur=%d floor=%d util=%.1f%% airtime=%.1f%% load=%.1f%%",
                 (int32_t)halow_lbt_background_short_dbm_get(),
                 (int32_t)halow_lbt_background_long_dbm_get(),
                 halow_lbt_ch_util_get() * 100.0f,
-                halow_lbt_airtime_get() * 100.0f
+                halow_lbt_airtime_get() * 100.0f,
+                halow_lbt_sampler_load_get() * 100.0f
             );
         }
 #endif
 
-        (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+        sleep_ms = (uint32_t)((busy_us * (100 - HALOW_LBT_SAMPLER_DUTY_PERCENT)) /
+                              (HALOW_LBT_SAMPLER_DUTY_PERCENT * 1000));
+        os_sleep_ms(sleep_ms ? sleep_ms : 1);
     }
 }
 
@@ -469,21 +492,22 @@ static halow_lbt_ctx_t *halow_lbt_ctx_alloc( const halow_lbt_config_t *cfg ){
     ctx->floor_pct = pct;
 
     ctx->short_samples = (int8_t *)os_malloc(ctx->short_n);
-    ctx->long_rb_data  = (int8_t *)os_malloc(ctx->long_n);
-    ctx->tmp_sort      = (int8_t *)os_malloc(ctx->long_n);
+    /* lwrb keeps one byte free to tell full from empty */
+    ctx->long_rb_data  = (int8_t *)os_malloc((uint32_t)ctx->long_n + 1u);
 
     if (ctx->short_samples == NULL ||
-        ctx->long_rb_data  == NULL ||
-        ctx->tmp_sort      == NULL) {
+        ctx->long_rb_data  == NULL) {
 
         os_free(ctx->short_samples);
         os_free(ctx->long_rb_data);
-        os_free(ctx->tmp_sort);
         os_free(ctx);
         return NULL;
     }
 
-    lwrb_init(&ctx->long_rb, ctx->long_rb_data, (lwrb_sz_t)ctx->long_n);
+    lwrb_init(&ctx->long_rb, ctx->long_rb_data, (lwrb_sz_t)ctx->long_n + 1u);
+
+    ctx->bucket_tokens_us = (int64_t)cfg->util_bucket_capacity_ms * 1000;
+    ctx->bucket_last_us   = get_time_us();
 
     return ctx;
 }
@@ -495,7 +519,6 @@ static void halow_lbt_ctx_free( halow_lbt_ctx_t *ctx ){
 
     os_free(ctx->short_samples);
     os_free(ctx->long_rb_data);
-    os_free(ctx->tmp_sort);
     os_free(ctx);
 }
 
@@ -513,7 +536,6 @@ void halow_lbt_set_tx_as_active( void ){
 
     if (!g_lbt_ctx->airtime_tx_active) {
         g_lbt_ctx->airtime_tx_active = true;
-        g_lbt_ctx->airtime_time_last_tx_started = get_time_us();
         hlbt_debug("SET TX");
     }
 
@@ -535,24 +557,31 @@ void halow_lbt_set_tx_as_deactive( void ){
 
     if (g_lbt_ctx->airtime_tx_active) {
         hlbt_debug("RESET TX");
-        int64_t now_us = get_time_us();
-        int64_t start_us = g_lbt_ctx->airtime_time_last_tx_started;
+        g_lbt_ctx->airtime_tx_active = false;
+        g_lbt_ctx->last_tx_us = get_time_us();
+    }
 
-        if (start_us == 0) {
-            start_us = g_lbt_ctx->time_last_cycle_update_us;
-        }
+    os_mutex_unlock(&g_lbt_ctx_mutex);
+}
 
-        int64_t dt = now_us - start_us;
-        if (dt > 0) {
-            int64_t acc = (int64_t)g_lbt_ctx->airtime_time_tx_from_last_cycle_update_us + dt;
-            if (acc > INT32_MAX) { acc = INT32_MAX; }
-            g_lbt_ctx->airtime_time_tx_from_last_cycle_update_us = (int32_t)acc;
-        }
+/* Called on TX complete with the frame's PPDU duration */
+void halow_lbt_airtime_charge( uint32_t airtime_us ){
+    /* only touched from the tx_status path, keeps airtime when the lock is contended */
+    static uint32_t pending_us;
 
-        g_lbt_ctx->airtime_time_last_tx_started = 0;
-        g_lbt_ctx->airtime_tx_active = false;
+    pending_us += airtime_us;
+    if (g_lbt_ctx_mutex.hdl == NULL) {
+        return;
     }
-
+    if (os_mutex_lock(&g_lbt_ctx_mutex, 10) != 0) {
+        return;
+    }
+    if (g_lbt_ctx != NULL) {
+        int64_t acc = (int64_t)g_lbt_ctx->airtime_time_tx_from_last_cycle_update_us + pending_us;
+        if (acc > INT32_MAX) { acc = INT32_MAX; }
+        g_lbt_ctx->airtime_time_tx_from_last_cycle_update_us = (int32_t)acc;
+    }
+    pending_us = 0;
     os_mutex_unlock(&g_lbt_ctx_mutex);
 }
 
@@ -666,9 +695,187 @@ void halow_lbt_config_load( halow_lbt_config_t *cfg ){
     configdb_get_i16(HALOW_LBT_CONFIG_UTIL_BUCKET_MS_NAME, (int16_t*)&cfg->util_bucket_capacity_ms);
 }
 
-void halow_lbt_wait_tx_allowed(void){
-    while (halow_lbt_airtime_get() > halow_lbt_airtime_max_percentage()){
-        os_sleep_ms(HALOW_LBT_AIRTIME_UPDATE_PERIOD_MS);
+/*
+ * Token bucket in airtime microseconds. util_max_percent of every util_refill_window_ms is added
+ * continuously, up to util_bucket_capacity_ms of burst.
+ */
+static void halow_lbt_bucket_refill( halow_lbt_ctx_t *ctx, int64_t now_us ){
+    int64_t window_us;
+    int64_t quota_us;
+    int64_t cap_us;
+    int64_t dt;
+
+    window_us = (int64_t)ctx->cfg.util_refill_window_ms * 1000;
+    if (window_us < 1000) {
+        window_us = 1000;
+    }
+    quota_us = (window_us * (int64_t)ctx->cfg.util_max_percent) / 100;
+    if (quota_us < window_us / 100) {
+        quota_us = window_us / 100;
+    }
+    cap_us = (int64_t)ctx->cfg.util_bucket_capacity_ms * 1000;
+
+    dt = now_us - ctx->bucket_last_us;
+    ctx->bucket_last_us = now_us;
+    if (dt <= 0) {
+        return;
+    }
+
+    ctx->bucket_tokens_us += (dt * quota_us) / window_us;
+    if (ctx->bucket_tokens_us > cap_us) {
+        ctx->bucket_tokens_us = cap_us;
+    }
+}
+
+/* Time until the bucket holds need_us, 0 if it already does */
+static int64_t halow_lbt_bucket_wait_us( const halow_lbt_ctx_t *ctx, int64_t need_us ){
+    int64_t window_us;
+    int64_t quota_us;
+    int64_t deficit;
+
+    deficit = need_us - ctx->bucket_tokens_us;
+    if (deficit <= 0) {
+        return 0;
+    }
+
+    window_us = (int64_t)ctx->cfg.util_refill_window_ms * 1000;
+    if (window_us < 1000) {
+        window_us = 1000;
+    }
+    quota_us = (window_us * (int64_t)ctx->cfg.util_max_percent) / 100;
+    if (quota_us < window_us / 100) {
+        quota_us = window_us / 100;
+    }
+    return ((deficit * window_us) + quota_us - 1) / quota_us;
+}
+
+/*
+ * Blocks until airtime_us may be spent and charges it. A frame longer than the bucket runs into debt.
+ * A waiter sleeps until the deficit is refilled, rounded up to the 1 ms tick, and checks the bucket
+ * again, so it is released within a millisecond of enough tokens being there.
+ */
+void halow_lbt_wait_tx_allowed( uint32_t airtime_us ){
+    while (1) {
+        halow_lbt_ctx_t *ctx;
+        int64_t need_us;
+        int64_t wait_us;
+
+        if (g_lbt_ctx_mutex.hdl == NULL) {
+            return;
+        }
+        (void)os_mutex_lock(&g_lbt_ctx_mutex, -1);
+        ctx = g_lbt_ctx;
+        if ((ctx == NULL) || !ctx->cfg.util_enabled) {
+            (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+            return;
+        }
+
+        halow_lbt_bucket_refill(ctx, get_time_us());
+
+        need_us = (int64_t)airtime_us;
+        if (need_us > (int64_t)ctx->cfg.util_bucket_capacity_ms * 1000) {
+            need_us = (int64_t)ctx->cfg.util_bucket_capacity_ms * 1000;
+        }
+
+        wait_us = halow_lbt_bucket_wait_us(ctx, need_us);
+        if (wait_us == 0) {
+            ctx->bucket_tokens_us -= (int64_t)airtime_us;
+            (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+            return;
+        }
+        (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+
+        halow_lbt_sleep_us(wait_us);
+    }
+}
+
+static int64_t halow_lbt_backoff_us( const halow_lbt_ctx_t *ctx ){
+    uint32_t lo = ctx->cfg.backoff_random_min_us;
+    uint32_t hi = ctx->cfg.backoff_random_max_us;
+
+    if (hi <= lo) {
+        return (int64_t)lo;
+    }
+    return (int64_t)(lo + ((uint32_t)os_rand() % (hi - lo + 1u)));
+}
+
+static bool halow_lbt_channel_busy( const halow_lbt_ctx_t *ctx, int8_t dbm ){
+    int rel_thr = (int)ctx->noise_floor + (int)ctx->cfg.noise_relative_offset_dbm;
+    int abs_thr = (int)ctx->cfg.noise_absolute_busy_dbm;
+
+    return ((int)dbm >= abs_thr) || ((int)dbm > rel_thr);
+}
+
+/*
+ * Listen before talk. Right after our own TX (tx_skip_check_time_us) the check is skipped, so a
+ * burst keeps the channel, but only for tx_max_continuous_time_ms; then the channel is released for a
+ * random backoff and must be sensed idle again. A busy channel defers by a random backoff
+ * (backoff_random_min_us..max_us). After HALOW_LBT_MAX_DEFER_MS we transmit anyway, also when no
+ * sample newer than our own TX turns up (sampler starved or the TX never completed).
+ */
+void halow_lbt_wait_channel_clear( void ){
+    int64_t t_start_us = get_time_us();
+    bool force_check = false;
+
+    while (1) {
+        halow_lbt_ctx_t *ctx;
+        int64_t now_us;
+        int64_t wait_us;
+        bool own_tx;
+        bool deferred;
+
+        if (g_lbt_ctx_mutex.hdl == NULL) {
+            return;
+        }
+        (void)os_mutex_lock(&g_lbt_ctx_mutex, -1);
+        ctx = g_lbt_ctx;
+        if ((ctx == NULL) || !ctx->cfg.lbt_enabled) {
+            (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+            return;
+        }
+
+        now_us = get_time_us();
+        deferred = (now_us - t_start_us) >= (int64_t)HALOW_LBT_MAX_DEFER_MS * 1000;
+        own_tx = ctx->airtime_tx_active ||
+                 ((ctx->last_tx_us != 0) &&
+                  ((now_us - ctx->last_tx_us) < (int64_t)ctx->cfg.tx_skip_check_time_us));
+
+        if (own_tx && !force_check) {
+            int64_t burst_max_us = (int64_t)ctx->cfg.tx_max_continuous_time_ms * 1000;
+
+            if (ctx->burst_start_us == 0) {
+                ctx->burst_start_us = now_us;
+            }
+            if ((burst_max_us == 0) || ((now_us - ctx->burst_start_us) < burst_max_us)) {
+                (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+                return;
+            }
+            /* burst limit reached: let others in */
+            hlbt_debug("burst limit");
+            ctx->burst_start_us = 0;
+            force_check = true;
+            wait_us = halow_lbt_backoff_us(ctx);
+        } else if (ctx->airtime_tx_active || (ctx->last_sample.ts_us <= ctx->last_tx_us)) {
+            /* our own signal is still in the newest sample */
+            if (deferred) {
+                ctx->burst_start_us = now_us;
+                (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+                return;
+            }
+            wait_us = 1000;
+        } else {
+            ctx->last_lbt_us = now_us;
+            if (!halow_lbt_channel_busy(ctx, ctx->last_sample.dbm) || deferred) {
+                ctx->burst_start_us = now_us;
+                (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+                return;
+            }
+            hlbt_debug("busy %d dBm, backoff", (int)ctx->last_sample.dbm);
+            wait_us = halow_lbt_backoff_us(ctx);
+        }
+        (void)os_mutex_unlock(&g_lbt_ctx_mutex);
+
+        halow_lbt_sleep_us(wait_us);
     }
 }
 
@@ -0,0 +1,67 @@
+#include "halow_ppdu.h"
+
+#include <stddef.h>
+
+#define HALOW_PPDU_SYM_US           40      /* 32 us + 8 us long GI */
+#define HALOW_PPDU_SYM_SGI_US       36      /* 32 us + 4 us short GI */
+#define HALOW_PPDU_SERVICE_BITS     8
+#define HALOW_PPDU_TAIL_BITS        6
+
+/* Data bits per symbol, 1 SS, 1 MHz (24 data subcarriers), MCS0..7 */
+static const uint16_t g_ndbps_1m[8] = { 12, 24, 36, 48, 72, 96, 108, 120 };
+
+/* Data subcarriers per bandwidth, relative to the 24 of 1 MHz */
+static uint32_t halow_ppdu_nsd(uint8_t bandwidth){
+    switch (bandwidth) {
+        case 2:  return 52;
+        case 4:  return 108;
+        case 8:  return 234;
+        default: return 24;
+    }
+}
+
+static uint32_t halow_ppdu_nltf(uint8_t nss){
+    return (nss <= 2) ? (nss ? nss : 1) : 4;
+}
+
+static uint32_t halow_ppdu_preamble_us(const halow_ppdu_param_t *p){
+    uint32_t nltf = halow_ppdu_nltf(p->nss);
+
+    switch (p->preamble) {
+        case HALOW_PREAMBLE_S1G_SHORT:
+            /* STF 2 + LTF1 2 + SIG 2 + LTF2..N */
+            return (6 + (nltf - 1)) * HALOW_PPDU_SYM_US;
+        case HALOW_PREAMBLE_S1G_LONG:
+            /* STF 2 + LTF1 2 + SIG-A 2 + D-STF 1 + D-LTF N + SIG-B 1 */
+            return (8 + nltf) * HALOW_PPDU_SYM_US;
+        case HALOW_PREAMBLE_S1G_1M:
+        default:
+            /* STF 4 + LTF1 4 + SIG 6 + LTF2..N */
+            return (14 + (nltf - 1)) * HALOW_PPDU_SYM_US;
+    }
+}
+
+uint32_t halow_ppdu_duration_us(const halow_ppdu_param_t *p, uint32_t psdu_len){
+    uint32_t ndbps;
+    uint32_t nsym;
+    uint32_t bits;
+    uint8_t nss;
+
+    if (p == NULL) {
+        return 0;
+    }
+
+    nss = p->nss ? p->nss : 1;
+    if (p->mcs == 10) {
+        /* BPSK 1/2 with 2x repetition, 1 MHz / 1 SS only */
+        ndbps = 6;
+    } else {
+        ndbps = (uint32_t)g_ndbps_1m[p->mcs & 7] * halow_ppdu_nsd(p->bandwidth) / 24 * nss;
+    }
+
+    bits = HALOW_PPDU_SERVICE_BITS + 8 * psdu_len + HALOW_PPDU_TAIL_BITS;
+    nsym = (bits + ndbps - 1) / ndbps;
+
+    return halow_ppdu_preamble_us(p) +
+           nsym * (p->short_gi ? HALOW_PPDU_SYM_SGI_US : HALOW_PPDU_SYM_US);
+}
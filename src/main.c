@@ -35,6 +35,8 @@
 #include "net_ip.h"
 #include "ota.h"
 #include "statistics.h"
+#include "udp_server.h"
+#include "halow_bridge.h"
 #include "indication.h"
 #ifdef MULTI_WAKEUP
 #include "lib/common/sleep_api.h"
@@ -51,28 +53,60 @@ uint8 g_mac[6];
 
 //extern void lmac_transceive_statics(uint8 en);
 
-static void halow_rx_handler(struct hgic_rx_info *info,
+static void halow_rx_handler(const halow_rx_meta_t *meta,
                              const uint8 *data,
                              int32 len) {
-    (void)info;
-
     if (!data || len <= 0) {
         return;
     }
     //os_printf("RX: %db\n", len);
     statistics_radio_register_rx_package(len);
-    tcp_server_send(data, len);
+    statistics_link_register_rx(meta, len);
+    if (halow_bridge_active()) {
+        halow_bridge_input(data, len);
+        return;
+    }
+    tcp_server_send_rx(data, len, meta);
+    udp_server_send(data, len);
+}
+
+/*
+ * Callers are the TCP server RX task, the UDP server task and the bridge
+ * task, never the tcpip thread, so they wait for TX queue space instead of
+ * dropping. The wait is bounded so a stuck radio cannot wedge them.
+ */
+static int32_t halow_send_iov(const halow_iov_t *iov, uint32_t cnt){
+    uint32_t len = 0;
+    int32_t res = halow_tx_iov_wait(iov, cnt, HALOW_TX_WAIT_MS);
+    if(res != 0){
+        return res;
+    }
+    for(uint32_t i = 0; i < cnt; i++){
+        len += iov[i].len;
+    }
+    statistics_radio_register_tx_package(len);
+    return 0;
+}
+
+static int32_t halow_send(const uint8_t* data, uint32_t len){
+    halow_iov_t iov;
+
+    iov.data = data;
+    iov.len  = len;
+    return halow_send_iov(&iov, 1);
 }
 
 __init static void sys_network_init(void) {
     struct netdev *ndev;
     struct netif  *nif;
+    struct netif  *br;
     static char hostname[sizeof("RNode-Halow-XXXXXX")];
 
     tcpip_init(NULL, NULL);
     sock_monitor_init();
 
     sysctrl_efuse_mac_addr_calc(g_mac);
+    halow_set_addr(g_mac);
     ndev = (struct netdev *)dev_get(HG_GMAC_DEVID);
     netdev_set_macaddr(ndev, g_mac);
     if (ndev) {
@@ -80,6 +114,14 @@ __init static void sys_network_init(void) {
         lwip_netif_set_default(ndev);
         
         nif = netif_find("e0");
+        /* Bridge mode: the IP stack moves to the bridge, e0 becomes one of its ports */
+        br = halow_bridge_init(nif, g_mac, halow_send);
+        if (br) {
+            // Pass frames for every destination, not only our own address
+            netdev_ioctl(ndev, NETDEV_IOCTL_ENABLE_WIFIBRIDGE, 1, 0);
+            netif_set_default(br);
+            nif = br;
+        }
         if (nif) {
             snprintf(hostname,sizeof(hostname),"RNode-Halow-%02X%02X%02X",nif->hwaddr[3],nif->hwaddr[4],nif->hwaddr[5]);
             nif->hostname = hostname;
@@ -105,7 +147,7 @@ sysevt_hdl_res sys_event_hdl(uint32 event_id, uint32 data, uint32 priv) {
     ip4_addr_t ip;
     switch (event_id) {
         case SYS_EVENT(SYS_EVENT_NETWORK, SYSEVT_LWIP_DHCPC_DONE):
-            nif = netif_find("e0");
+            nif = netif_default;
             ip = *netif_ip4_addr(nif);
 
             hgprintf("DHCP new ip assign: %u.%u.%u.%u\r\n",
@@ -118,19 +160,27 @@ sysevt_hdl_res sys_event_hdl(uint32 event_id, uint32 data, uint32 priv) {
     return SYSEVT_CONTINUE;
 }
 
-int32_t tcp_to_halow_send(const uint8_t* data, uint32_t len){
+int32_t host_to_halow_send(const uint8_t* data, uint32_t len){
     if(data == NULL){
         return -100;
     }
     if(len == 0){
         return -200;
     }
-    int32_t res = halow_tx(data, len);
-    if(res != 0){
-        return res;
+    if(halow_bridge_active()){
+        return -300;
     }
-    statistics_radio_register_tx_package(len);  
-    return 0;
+    return halow_send(data, len);
+}
+
+int32_t host_to_halow_send_iov(const halow_iov_t *iov, uint32_t cnt){
+    if((iov == NULL) || (cnt == 0)){
+        return -100;
+    }
+    if(halow_bridge_active()){
+        return -300;
+    }
+    return halow_send_iov(iov, cnt);
 }
 
 void assert_printf(char *msg, int line, char *file){
@@ -168,7 +218,8 @@ __init int main(void) {
     tftp_server_init();
     net_ip_init();
     statistics_init();
-    tcp_server_init(tcp_to_halow_send);
+    tcp_server_init(host_to_halow_send_iov);
+    udp_server_init(host_to_halow_send);
     OS_WORK_INIT(&main_wk, sys_blink_loop,0);
     os_run_work_delay(&main_wk, 1000);
     sysheap_collect_init(&sram_heap, (uint32)&__sinit, (uint32)&__einit); // delete init code from heap
@@ -22,6 +22,7 @@
 #include "basic_include.h"
 #include "sys_config.h"
 #include "device.h"
+#include "fal_norflash_port.h"
 
 extern lfs_t g_lfs;
 
@@ -124,6 +125,10 @@ int32_t _libota_write_fw_ah( uint32_t tot_len, uint32_t off, const uint8_t *data
         return -9;
     }
 
+    if ((uint32_t)off + (uint32_t)len == tot_len) {
+        (void)fal_norflash_flush();
+    }
+
     return 0;
 }
 
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 
 #include "ota.h"
+#include "crc32.h"
 
 #include "lib/littlefs/lfs.h"
 
@@ -17,33 +18,29 @@ extern lfs_t g_lfs;
 #define otafs_dbg(fmt, ...) do { } while (0)
 #endif
 
+/* CRC is accumulated while chunks arrive; set to 1 to also re-read the stored file */
+#ifndef OTA_LFS_VERIFY_READBACK
+#define OTA_LFS_VERIFY_READBACK     0
+#endif
+
 typedef struct {
     bool active;
     uint32_t size;
     uint32_t expect_crc32;
+    uint32_t written;
+    uint32_t crc32;
     lfs_file_t file;
 } ota_lfs_ctx_t;
 
 static ota_lfs_ctx_t s_ota;
 
-static uint32_t crc32_update_u8( uint32_t crc, const uint8_t *p, uint32_t n ){
-    uint32_t c = crc ^ 0xFFFFFFFFu;
-
-    while (n--) {
-        c ^= (uint32_t)(*p++);
-        for (uint32_t k = 0; k < 8u; k++) {
-            c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
-        }
-    }
-
-    return c ^ 0xFFFFFFFFu;
-}
-
+#if OTA_LFS_VERIFY_READBACK
 static uint32_t crc32_file_u32( const char *path, uint32_t nbytes, uint32_t *out_crc32 ){
     lfs_file_t f;
     uint8_t buf[1024];
     uint32_t left;
     uint32_t crc;
+    crc32_stream_t cs;
 
     if (out_crc32 == NULL) {
         otafs_dbg("crc32_file: out_crc32 == NULL");
@@ -56,7 +53,7 @@ static uint32_t crc32_file_u32( const char *path, uint32_t nbytes, uint32_t *out
     }
 
     left = nbytes;
-    crc  = 0;
+    crc32_stream_begin(&cs);
 
     while (left) {
         uint32_t chunk = (left > (uint32_t)sizeof(buf)) ? (uint32_t)sizeof(buf) : left;
@@ -64,20 +61,23 @@ static uint32_t crc32_file_u32( const char *path, uint32_t nbytes, uint32_t *out
 
         if (rr != (lfs_ssize_t)chunk) {
             otafs_dbg("crc32_file: read fail (rr=%ld)", (long)rr);
+            (void)crc32_stream_end(&cs);
             (void)lfs_file_close(&g_lfs, &f);
             return -3;
         }
 
-        crc = crc32_update_u8(crc, buf, chunk);
+        crc32_stream_update(&cs, buf, chunk);
         left -= chunk;
     }
 
+    crc = crc32_stream_end(&cs);
     (void)lfs_file_close(&g_lfs, &f);
     *out_crc32 = crc;
 
     otafs_dbg("crc32_file: done crc=0x%08lX", (unsigned long)crc);
     return 0;
 }
+#endif
 
 static uint32_t ota_lfs_abort( void ){
     if (s_ota.active) {
@@ -112,6 +112,8 @@ uint32_t ota_lfs_begin( uint32_t total_size, uint32_t expect_crc32 ){
     s_ota.active       = true;
     s_ota.size         = total_size;
     s_ota.expect_crc32 = expect_crc32;
+    s_ota.written      = 0;
+    s_ota.crc32        = 0;
 
     otafs_dbg("begin: file opened");
     return 0;
@@ -123,11 +125,26 @@ uint32_t ota_lfs_write( uint32_t off, const void *data, uint32_t len ){
         return -1;
     }
 
+    /* retried request whose reply got lost: already stored */
+    if ((off < s_ota.written) && (off + len == s_ota.written)) {
+        otafs_dbg("write: duplicate off=%lu", (unsigned long)off);
+        return 0;
+    }
+
+    /* inline CRC needs the stream in order */
+    if (off != s_ota.written) {
+        otafs_dbg("write: off=%lu expected=%lu", (unsigned long)off, (unsigned long)s_ota.written);
+        return -3;
+    }
+
     if (lfs_file_write(&g_lfs, &s_ota.file, data, (lfs_size_t)len) != (lfs_ssize_t)len) {
         otafs_dbg("write: write fail len=%lu", (unsigned long)len);
         return -2;
     }
 
+    s_ota.crc32    = crc32_update(s_ota.crc32, data, len);
+    s_ota.written += len;
+
     otafs_dbg("write: off=%lu len=%lu",
             (unsigned long)off,
             (unsigned long)len);
@@ -158,11 +175,16 @@ uint32_t ota_lfs_end( void ){
         return -2;
     }
 
+#if OTA_LFS_VERIFY_READBACK
     res = crc32_file_u32(OTA_TAR_FILE_PATH, s_ota.size, &calculated_crc32);
     if (res != 0) {
         otafs_dbg("end: crc calc fail (%ld)", (long)res);
         return -3;
     }
+#else
+    (void)res;
+    calculated_crc32 = s_ota.crc32;
+#endif
 
     otafs_dbg("end: crc calc=0x%08lX expect=0x%08lX",
             (unsigned long)calculated_crc32,
@@ -3,7 +3,11 @@
 #include <string.h>
 
 #include "ota.h"
+#include "crc32.h"
+#include "sys_config.h"
+#include "fal_norflash_port.h"
 #include "lib/littlefs/lfs.h"
+#include "lib/fal/fal.h"
 
 extern lfs_t g_lfs;
 
@@ -17,6 +21,9 @@ extern lfs_t g_lfs;
 
 #define OTA_UNPACK_TAR_BLK         (512u)
 #define OTA_UNPACK_PATH_MAX        (256u)
+#define OTA_STREAM_STAGE_DIR       "/.ota"
+#define OTA_STREAM_FW_NAME         "fw.bin"
+#define OTA_STREAM_VERIFY_CHUNK    (1024u)
 
 static int32_t ota_file_exists( const char *path ){
     lfs_file_t f;
@@ -131,6 +138,597 @@ static int32_t rm_rf_except( const char *path, const char *keep_fullpath ){
 }
 
 
+/* -------------------------------------------------------------------------- */
+/* Streaming unpack                                                           */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * The tar arrives chunk by chunk and is unpacked on the fly, in two passes
+ * when it carries fw.bin. The OTA FAL partition holds the running image and
+ * there is no spare region large enough to stage a new one, so:
+ *
+ *   verify   every file but fw.bin is written below OTA_STREAM_STAGE_DIR,
+ *            fw.bin is only checksummed, per erase block and as a whole.
+ *            ota_stream_end() checks the stream CRC and the fw.bin length and
+ *            CRC declared in ota_stream_begin(); nothing touched the flash yet.
+ *   program  the same tar is sent again from offset 0. fw.bin is collected one
+ *            erase block at a time and a block is erased and programmed only
+ *            when its CRC equals the one recorded by the verify pass. A bad
+ *            block or a failed end check rewinds to offset 0 of this pass.
+ *
+ * Staged files are moved into place only after the programmed image read
+ * back with the declared CRC. A tar without fw.bin is committed after the
+ * verify pass.
+ */
+
+typedef enum {
+    OTA_TAR_HDR = 0,
+    OTA_TAR_DATA,
+    OTA_TAR_PAD,
+    OTA_TAR_END,
+    OTA_TAR_ERR,
+} ota_tar_state_t;
+
+typedef enum {
+    OTA_SINK_SKIP = 0,
+    OTA_SINK_FW,
+    OTA_SINK_FILE,
+} ota_sink_t;
+
+typedef struct {
+    bool            active;
+    bool            committed;
+    bool            pending;        // Committed, not yet taken by ota_stream_take_committed()
+    bool            programming;    // Verify pass done, fw.bin goes to flash
+    uint32_t        size;
+    uint32_t        expect_crc32;
+    uint32_t        written;
+    uint32_t        crc32;
+
+    ota_tar_state_t state;
+    uint8_t         hdr[OTA_UNPACK_TAR_BLK];
+    uint32_t        hdr_len;
+    ota_sink_t      sink;
+    uint32_t        left;
+    uint32_t        pad;
+
+    lfs_file_t      file;
+    bool            file_open;
+
+    const struct fal_partition *part;
+    uint32_t        erase_size;
+    uint32_t        fw_size;        // Declared length of fw.bin, 0 if none
+    uint32_t        fw_expect_crc32;
+    uint32_t        fw_off;
+    uint32_t        fw_crc32;
+    bool            fw_seen;
+    uint32_t       *blk_crc;        // Per erase block CRC from the verify pass
+    uint8_t        *blk;            // Program pass: block being collected
+    uint32_t        blk_len;
+
+    char            path[OTA_UNPACK_PATH_MAX];
+} ota_stream_ctx_t;
+
+static ota_stream_ctx_t s_ots;
+
+static bool tar_hdr_chksum_ok( const uint8_t *h ){
+    uint32_t sum = 0;
+    uint32_t want = oct_u32((const char *)&h[148], 8);
+
+    for (uint32_t i = 0; i < OTA_UNPACK_TAR_BLK; i++) {
+        sum += (i >= 148u && i < 156u) ? (uint32_t)' ' : (uint32_t)h[i];
+    }
+    return sum == want;
+}
+
+/* "prefix/name" without leading "./" or "/", rejects ".." components */
+static int32_t tar_hdr_name( const uint8_t *h, char *out, size_t out_sz ){
+    const char *name = (const char *)&h[0];
+    const char *p;
+    int n;
+
+    if (memcmp(&h[257], "ustar", 5) == 0 && h[345] != 0) {
+        n = snprintf(out, out_sz, "%.*s/%.*s", 155, (const char *)&h[345], 100, name);
+    } else {
+        n = snprintf(out, out_sz, "%.*s", 100, name);
+    }
+    if (n <= 0 || (size_t)n >= out_sz) {
+        return -1;
+    }
+
+    p = out;
+    while (*p == '/' || (p[0] == '.' && p[1] == '/')) {
+        p += (*p == '/') ? 1 : 2;
+    }
+    memmove(out, p, strlen(p) + 1);
+
+    n = (int)strlen(out);
+    while (n > 0 && out[n - 1] == '/') {
+        out[--n] = '\0';
+    }
+
+    for (p = out; *p; ) {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0')) {
+            return -2;
+        }
+        p = strchr(p, '/');
+        if (p == NULL) {
+            break;
+        }
+        p++;
+    }
+
+    return 0;
+}
+
+static void ota_stream_close_file( void ){
+    if (s_ots.file_open) {
+        (void)lfs_file_close(&g_lfs, &s_ots.file);
+        s_ots.file_open = false;
+    }
+}
+
+static int32_t ota_stream_member_begin( void ){
+    char name[OTA_UNPACK_PATH_MAX - sizeof(OTA_STREAM_STAGE_DIR) - 1];
+    char typeflag = (char)s_ots.hdr[156];
+    uint32_t size = oct_u32((const char *)&s_ots.hdr[124], 12);
+
+    if (blk_zero(s_ots.hdr)) {
+        s_ots.state = OTA_TAR_END;
+        return 0;
+    }
+    if (!tar_hdr_chksum_ok(s_ots.hdr)) {
+        otau_dbg("stream: bad header checksum");
+        return -1;
+    }
+    if (tar_hdr_name(s_ots.hdr, name, sizeof(name)) != 0) {
+        otau_dbg("stream: bad member name");
+        return -2;
+    }
+
+    s_ots.sink  = OTA_SINK_SKIP;
+    s_ots.left  = size;
+    s_ots.pad   = (OTA_UNPACK_TAR_BLK - (size % OTA_UNPACK_TAR_BLK)) & (OTA_UNPACK_TAR_BLK - 1);
+    (void)snprintf(s_ots.path, sizeof(s_ots.path), "%s/%s", OTA_STREAM_STAGE_DIR, name);
+
+    if (name[0] == '\0') {
+        /* "./" entry */
+    } else if (typeflag == '5') {
+        if (!s_ots.programming) {
+            (void)ensure_parent_dirs(s_ots.path);
+            (void)ensure_dir(s_ots.path);
+            otau_dbg("stream: dir  %s", s_ots.path);
+        }
+    } else if (typeflag != '0' && typeflag != '\0') {
+        otau_dbg("stream: skip %s type=%c (%lu)", name, typeflag, (unsigned long)size);
+    } else if (strcmp(name, OTA_STREAM_FW_NAME) == 0) {
+        /* only the image whose length was declared up front */
+        if (s_ots.fw_seen || size == 0 || size != s_ots.fw_size) {
+            otau_dbg("stream: fw rejected (%lu, declared %lu)",
+                     (unsigned long)size, (unsigned long)s_ots.fw_size);
+            return -3;
+        }
+        s_ots.sink     = OTA_SINK_FW;
+        s_ots.fw_seen  = true;
+        s_ots.fw_off   = 0;
+        s_ots.fw_crc32 = 0;
+        s_ots.blk_len  = 0;
+        otau_dbg("stream: fw   %s (%lu)", name, (unsigned long)size);
+    } else if (!s_ots.programming) {
+        if (ensure_parent_dirs(s_ots.path) < 0) {
+            return -4;
+        }
+        if (lfs_file_open(&g_lfs, &s_ots.file, s_ots.path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0) {
+            otau_dbg("stream: open fail %s", s_ots.path);
+            return -5;
+        }
+        s_ots.file_open = true;
+        s_ots.sink      = OTA_SINK_FILE;
+        otau_dbg("stream: file %s (%lu)", s_ots.path, (unsigned long)size);
+    }
+
+    s_ots.state = OTA_TAR_DATA;
+    return 0;
+}
+
+/* Verify pass: checksum fw.bin, split at erase block boundaries */
+static void ota_stream_fw_sum( const uint8_t *data, uint32_t len ){
+    while (len) {
+        uint32_t idx = s_ots.fw_off / s_ots.erase_size;
+        uint32_t n   = s_ots.erase_size - (s_ots.fw_off % s_ots.erase_size);
+
+        n = (n > len) ? len : n;
+        s_ots.blk_crc[idx] = crc32_update(s_ots.blk_crc[idx], data, n);
+        s_ots.fw_crc32     = crc32_update(s_ots.fw_crc32, data, n);
+        s_ots.fw_off      += n;
+        data += n;
+        len  -= n;
+    }
+}
+
+/* Program pass: erase and write the collected block if it matches the verify pass */
+static int32_t ota_stream_fw_program( void ){
+    uint32_t idx = s_ots.fw_off / s_ots.erase_size;
+
+    if (crc32_update(0, s_ots.blk, s_ots.blk_len) != s_ots.blk_crc[idx]) {
+        otau_dbg("stream: fw block %lu differs from the verify pass", (unsigned long)idx);
+        return -1;
+    }
+    if (fal_partition_erase(s_ots.part, s_ots.fw_off, s_ots.erase_size) < 0) {
+        return -2;
+    }
+    if (fal_partition_write(s_ots.part, s_ots.fw_off, s_ots.blk, s_ots.blk_len) != (int)s_ots.blk_len) {
+        return -3;
+    }
+
+    s_ots.fw_crc32 = crc32_update(s_ots.fw_crc32, s_ots.blk, s_ots.blk_len);
+    s_ots.fw_off  += s_ots.blk_len;
+    s_ots.blk_len  = 0;
+    return 0;
+}
+
+static int32_t ota_stream_fw_write( const uint8_t *data, uint32_t len ){
+    if (!s_ots.programming) {
+        ota_stream_fw_sum(data, len);
+        return 0;
+    }
+
+    while (len) {
+        uint32_t n = s_ots.erase_size - s_ots.blk_len;
+
+        n = (n > len) ? len : n;
+        memcpy(&s_ots.blk[s_ots.blk_len], data, n);
+        s_ots.blk_len += n;
+        data += n;
+        len  -= n;
+
+        if (s_ots.blk_len == s_ots.erase_size || s_ots.fw_off + s_ots.blk_len == s_ots.fw_size) {
+            if (ota_stream_fw_program() != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int32_t ota_stream_feed( const uint8_t *data, uint32_t len ){
+    while (len) {
+        uint32_t n;
+
+        switch (s_ots.state) {
+            case OTA_TAR_HDR:
+                n = OTA_UNPACK_TAR_BLK - s_ots.hdr_len;
+                n = (n > len) ? len : n;
+                memcpy(&s_ots.hdr[s_ots.hdr_len], data, n);
+                s_ots.hdr_len += n;
+                if (s_ots.hdr_len == OTA_UNPACK_TAR_BLK) {
+                    s_ots.hdr_len = 0;
+                    if (ota_stream_member_begin() != 0) {
+                        return -1;
+                    }
+                }
+                break;
+
+            case OTA_TAR_DATA:
+                n = (s_ots.left > len) ? len : s_ots.left;
+                if (s_ots.sink == OTA_SINK_FW) {
+                    if (ota_stream_fw_write(data, n) != 0) {
+                        otau_dbg("stream: fw write fail off=%lu", (unsigned long)s_ots.fw_off);
+                        return -2;
+                    }
+                } else if (s_ots.sink == OTA_SINK_FILE) {
+                    if (lfs_file_write(&g_lfs, &s_ots.file, data, (lfs_size_t)n) != (lfs_ssize_t)n) {
+                        otau_dbg("stream: file write fail %s", s_ots.path);
+                        return -3;
+                    }
+                }
+                s_ots.left -= n;
+                break;
+
+            case OTA_TAR_PAD:
+                n = (s_ots.pad > len) ? len : s_ots.pad;
+                s_ots.pad -= n;
+                break;
+
+            default:
+                /* end-of-archive blocks and record padding */
+                return (s_ots.state == OTA_TAR_END) ? 0 : -4;
+        }
+
+        data += n;
+        len  -= n;
+
+        if (s_ots.state == OTA_TAR_DATA && s_ots.left == 0) {
+            ota_stream_close_file();
+            s_ots.state = OTA_TAR_PAD;
+        }
+        if (s_ots.state == OTA_TAR_PAD && s_ots.pad == 0) {
+            s_ots.state = OTA_TAR_HDR;
+        }
+    }
+
+    return 0;
+}
+
+static int32_t ota_stream_fw_verify( void ){
+    uint8_t buf[OTA_STREAM_VERIFY_CHUNK];
+    crc32_stream_t cs;
+    uint32_t off = 0;
+    uint32_t crc;
+
+    crc32_stream_begin(&cs);
+    while (off < s_ots.fw_off) {
+        uint32_t n = s_ots.fw_off - off;
+        n = (n > sizeof(buf)) ? (uint32_t)sizeof(buf) : n;
+        if (fal_partition_read(s_ots.part, off, buf, n) != (int)n) {
+            (void)crc32_stream_end(&cs);
+            return -1;
+        }
+        crc32_stream_update(&cs, buf, n);
+        off += n;
+    }
+    crc = crc32_stream_end(&cs);
+
+    otau_dbg("stream: fw readback crc=0x%08lX expect=0x%08lX",
+             (unsigned long)crc, (unsigned long)s_ots.fw_expect_crc32);
+    return (crc == s_ots.fw_expect_crc32) ? 0 : -2;
+}
+
+/* Move every staged top level entry over the live one */
+static int32_t ota_stream_commit_files( void ){
+    char src[OTA_UNPACK_PATH_MAX];
+    char dst[OTA_UNPACK_PATH_MAX];
+
+    while (1) {
+        lfs_dir_t dir;
+        struct lfs_info info;
+        bool found = false;
+
+        if (lfs_dir_open(&g_lfs, &dir, OTA_STREAM_STAGE_DIR) < 0) {
+            return 0;
+        }
+        while (lfs_dir_read(&g_lfs, &dir, &info) > 0) {
+            if (strcmp(info.name, ".") && strcmp(info.name, "..")) {
+                found = true;
+                break;
+            }
+        }
+        (void)lfs_dir_close(&g_lfs, &dir);
+
+        if (!found) {
+            break;
+        }
+
+        (void)snprintf(src, sizeof(src), "%s/%s", OTA_STREAM_STAGE_DIR, info.name);
+        (void)snprintf(dst, sizeof(dst), "/%s", info.name);
+
+        if (rm_rf_except(dst, NULL) < 0) {
+            return -1;
+        }
+        if (lfs_rename(&g_lfs, src, dst) < 0) {
+            otau_dbg("stream: rename fail %s", src);
+            return -2;
+        }
+        otau_dbg("stream: commit %s", dst);
+    }
+
+    (void)lfs_remove(&g_lfs, OTA_STREAM_STAGE_DIR);
+    return 0;
+}
+
+static void ota_stream_abort( void ){
+    ota_stream_close_file();
+    if (s_ots.blk_crc != NULL) {
+        os_free(s_ots.blk_crc);
+        s_ots.blk_crc = NULL;
+    }
+    if (s_ots.blk != NULL) {
+        os_free(s_ots.blk);
+        s_ots.blk = NULL;
+    }
+    s_ots.active = false;
+}
+
+/* Back to offset 0 of the current pass, the per block CRCs are kept */
+static void ota_stream_rewind( void ){
+    ota_stream_close_file();
+    s_ots.written  = 0;
+    s_ots.crc32    = 0;
+    s_ots.state    = OTA_TAR_HDR;
+    s_ots.hdr_len  = 0;
+    s_ots.sink     = OTA_SINK_SKIP;
+    s_ots.left     = 0;
+    s_ots.pad      = 0;
+    s_ots.fw_off   = 0;
+    s_ots.fw_crc32 = 0;
+    s_ots.fw_seen  = false;
+    s_ots.blk_len  = 0;
+}
+
+static int32_t ota_stream_commit( void ){
+    if (ota_stream_commit_files() != 0) {
+        return -1;
+    }
+
+    /* an /ota.tar staged before this upload is older than what is now in place */
+    (void)lfs_remove(&g_lfs, OTA_TAR_FILE_PATH);
+    ota_stream_abort();
+    s_ots.committed = true;
+    s_ots.pending   = true;
+    otau_dbg("stream: done fw=%lu", (unsigned long)s_ots.fw_off);
+    return 0;
+}
+
+int32_t ota_stream_begin( uint32_t total_size, uint32_t expect_crc32,
+                          uint32_t fw_size, uint32_t fw_crc32 ){
+    const struct fal_flash_dev *fdev;
+    uint32_t blocks;
+
+    otau_dbg("stream: begin size=%lu crc=0x%08lX fw=%lu/0x%08lX",
+             (unsigned long)total_size, (unsigned long)expect_crc32,
+             (unsigned long)fw_size, (unsigned long)fw_crc32);
+
+    if (total_size == 0 || (total_size % OTA_UNPACK_TAR_BLK) != 0 || fw_size >= total_size) {
+        return -1;
+    }
+
+    /* the same package starting its program pass (again) */
+    if (s_ots.active && s_ots.programming &&
+        s_ots.size == total_size && s_ots.expect_crc32 == expect_crc32 &&
+        s_ots.fw_size == fw_size && s_ots.fw_expect_crc32 == fw_crc32) {
+        ota_stream_rewind();
+        return 0;
+    }
+
+    ota_stream_abort();
+    memset(&s_ots, 0, sizeof(s_ots));
+
+    s_ots.part = fal_partition_find(OTA_FAL_PART_NAME);
+    if (s_ots.part == NULL) {
+        return -2;
+    }
+    if (fw_size > (uint32_t)s_ots.part->len) {
+        return -3;
+    }
+    fdev = fal_flash_device_find(s_ots.part->flash_name);
+    s_ots.erase_size = (fdev != NULL && fdev->blk_size) ? fdev->blk_size : 4096u;
+
+    if (fw_size != 0) {
+        blocks = (fw_size + s_ots.erase_size - 1u) / s_ots.erase_size;
+        s_ots.blk_crc = (uint32_t *)os_malloc(blocks * sizeof(uint32_t));
+        if (s_ots.blk_crc == NULL) {
+            return -4;
+        }
+        memset(s_ots.blk_crc, 0, blocks * sizeof(uint32_t));
+    }
+
+    /* leftovers of an interrupted upload */
+    (void)rm_rf_except(OTA_STREAM_STAGE_DIR, NULL);
+    (void)ensure_dir(OTA_STREAM_STAGE_DIR);
+
+    s_ots.size            = total_size;
+    s_ots.expect_crc32    = expect_crc32;
+    s_ots.fw_size         = fw_size;
+    s_ots.fw_expect_crc32 = fw_crc32;
+    s_ots.state           = OTA_TAR_HDR;
+    s_ots.active          = true;
+    return 0;
+}
+
+int32_t ota_stream_write( uint32_t off, const void *data, uint32_t len ){
+    if (!s_ots.active) {
+        return -1;
+    }
+    if (data == NULL || len == 0) {
+        return -2;
+    }
+
+    /* retried request whose reply got lost: already consumed */
+    if (off < s_ots.written && off + len == s_ots.written) {
+        return 0;
+    }
+    if (off != s_ots.written || off + len > s_ots.size) {
+        otau_dbg("stream: off=%lu expected=%lu", (unsigned long)off, (unsigned long)s_ots.written);
+        return -3;
+    }
+
+    s_ots.crc32    = crc32_update(s_ots.crc32, data, len);
+    s_ots.written += len;
+
+    if (ota_stream_feed((const uint8_t *)data, len) != 0) {
+        if (s_ots.programming) {
+            /* the partition is already partly rewritten, keep the session for a retry */
+            ota_stream_rewind();
+        } else {
+            s_ots.state = OTA_TAR_ERR;
+            ota_stream_abort();
+        }
+        return -4;
+    }
+    return 0;
+}
+
+int32_t ota_stream_end( void ){
+    int32_t rc = 0;
+
+    if (!s_ots.active) {
+        return -1;
+    }
+    ota_stream_close_file();
+
+    if (s_ots.written != s_ots.size) {
+        otau_dbg("stream: short %lu/%lu", (unsigned long)s_ots.written, (unsigned long)s_ots.size);
+        rc = -2;
+    } else if (s_ots.crc32 != s_ots.expect_crc32) {
+        otau_dbg("stream: crc 0x%08lX != 0x%08lX",
+                 (unsigned long)s_ots.crc32, (unsigned long)s_ots.expect_crc32);
+        rc = -3;
+    } else if (s_ots.state != OTA_TAR_END) {
+        otau_dbg("stream: archive truncated");
+        rc = -4;
+    } else if (s_ots.fw_off != s_ots.fw_size || (s_ots.fw_size != 0 && !s_ots.fw_seen)) {
+        otau_dbg("stream: fw %lu/%lu", (unsigned long)s_ots.fw_off, (unsigned long)s_ots.fw_size);
+        rc = -5;
+    }
+
+    if (!s_ots.programming) {
+        if (rc == 0 && s_ots.fw_crc32 != s_ots.fw_expect_crc32) {
+            otau_dbg("stream: fw crc 0x%08lX != 0x%08lX",
+                     (unsigned long)s_ots.fw_crc32, (unsigned long)s_ots.fw_expect_crc32);
+            rc = -6;
+        }
+        if (rc != 0) {
+            ota_stream_abort();
+            return rc;
+        }
+        if (s_ots.fw_size == 0) {
+            return (ota_stream_commit() == 0) ? 0 : -7;
+        }
+
+        s_ots.blk = (uint8_t *)os_malloc(s_ots.erase_size);
+        if (s_ots.blk == NULL) {
+            ota_stream_abort();
+            return -8;
+        }
+        otau_dbg("stream: verified, waiting for the program pass");
+        s_ots.programming = true;
+        ota_stream_rewind();
+        return 0;
+    }
+
+    if (rc == 0) {
+        (void)fal_norflash_flush();
+        if (ota_stream_fw_verify() != 0) {
+            rc = -9;
+        } else if (ota_stream_commit() != 0) {
+            rc = -7;
+        }
+    }
+    if (rc != 0) {
+        ota_stream_rewind();
+    }
+    return rc;
+}
+
+/* True once per committed stream, false when an /ota.tar was staged after it */
+bool ota_stream_take_committed( void ){
+    bool pending = s_ots.pending;
+
+    s_ots.pending = false;
+    return pending && (ota_file_exists(OTA_TAR_FILE_PATH) != 0);
+}
+
+void ota_stream_status( ota_stream_status_t *st ){
+    if (st == NULL) {
+        return;
+    }
+    st->active      = s_ots.active;
+    st->committed   = s_ots.committed;
+    st->programming = s_ots.programming;
+    st->size        = s_ots.size;
+    st->written     = s_ots.written;
+}
+
 static int32_t fs_wipe_keep_ota( void ){
     return rm_rf_except("/", OTA_TAR_FILE_PATH);
 }
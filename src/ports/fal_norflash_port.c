@@ -2,9 +2,18 @@
 #include <lib/fal/fal.h>
 #include <lib/fal/fal_def.h>
 
+#include "hal/spi.h"
 #include "hal/spi_nor.h"
+#include "hal/dma.h"
+#include "dev/spi/hgspi_dw.h"
+#include "devid.h"
+#include "osal/mutex.h"
+#include "fal_norflash_port.h"
+#include "utils.h"
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
 
 extern struct spi_nor_flash flash0;
 #define FLASH_START_ADDR   0U
@@ -20,6 +29,23 @@ extern struct spi_nor_flash flash0;
 #define ALIGN_UP(x,a)     (((x)+(a)-1U)/(a)*(a))
 #define ALIGN_DOWN(x,a)   ((x)/(a)*(a))
 
+#define FAL_NOR_SECT_CACHE_SIZE   (4U * 1024U)
+
+/* reads of at least this many bytes go through the SPI DMA channels */
+#ifndef FAL_NOR_DMA_READ_MIN
+#define FAL_NOR_DMA_READ_MIN      128U
+#endif
+
+/* quad output needs IO2/IO3 routed to the flash and sets its QE bit */
+#ifndef FAL_NOR_QUAD_READ
+#define FAL_NOR_QUAD_READ         0
+#endif
+
+#define FAL_NOR_PROBE_ADDR        0U
+#define FAL_NOR_PROBE_LEN         256U
+#define FAL_NOR_BENCH_LEN         (4U * 1024U)
+#define FAL_NOR_BENCH_ROUNDS      16U
+
 static int init(void);
 static int read(long offset, uint8_t *buf, size_t size);
 static int write(long offset, const uint8_t *buf, size_t size);
@@ -33,7 +59,177 @@ static inline uint32_t page_size(void){
     return flash0.page_size ? flash0.page_size : 256U;
 }
 
-extern struct spi_nor_flash flash0;
+/*
+ * Single sector write-back cache.
+ *
+ * Writes are merged into an image of the sector they hit and only reach the
+ * flash when a write moves to another sector or fal_norflash_flush() is
+ * called. If every write only cleared bits (NOR program semantics) the dirty
+ * range is programmed in place, otherwise the sector is erased once and
+ * reprogrammed. Reads are served from the image so callers always see their
+ * own writes.
+ */
+static struct {
+    struct os_mutex lock;
+    bool            lock_ready;
+    bool            valid;
+    bool            dirty;
+    bool            erase;          // some write set a bit, program needs an erase
+    uint32_t        addr;
+    uint32_t        dirty_lo;
+    uint32_t        dirty_hi;
+    uint8_t         buf[FAL_NOR_SECT_CACHE_SIZE];
+} g_sect_cache;
+
+static fal_norflash_stat_t g_sect_stat;
+
+static struct dma_device *g_spi_dma;
+static fal_norflash_read_mode_t g_read_mode = FAL_NOR_READ_NORMAL;
+static struct spi_nor_bus g_quad_bus;
+
+static int not_blank(const uint8_t *p, uint32_t len){
+    for (uint32_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Manufacturers whose parts all implement 0x3B (dual output) and 0x6B (quad output) reads */
+static bool jedec_vendor_multi_io(uint8_t vendor){
+    switch (vendor) {
+        case 0xEF:  // Winbond
+        case 0xC8:  // GigaDevice
+        case 0xC2:  // Macronix
+        case 0x20:  // XMC / Micron
+        case 0x85:  // Puya
+        case 0x68:  // Boya
+        case 0x0B:  // XTX
+        case 0x5E:  // Zbit
+        case 0x1C:  // EON
+        case 0x9D:  // ISSI
+        case 0xA1:  // Fudan
+            return true;
+        default:
+            return false;
+    }
+}
+
+static const struct spi_nor_bus *read_mode_bus(fal_norflash_read_mode_t mode){
+    switch (mode) {
+        case FAL_NOR_READ_DUAL:
+            return spi_nor_bus_get(SPI_NOR_DUAL_SPI_MODE);
+        case FAL_NOR_READ_QUAD:
+            return &g_quad_bus;
+        default:
+            return spi_nor_bus_get(SPI_NOR_NORMAL_SPI_MODE);
+    }
+}
+
+static uint32_t read_mode_wire(fal_norflash_read_mode_t mode){
+    switch (mode) {
+        case FAL_NOR_READ_DUAL:
+            return SPI_WIRE_DUAL_MODE;
+        case FAL_NOR_READ_QUAD:
+            return SPI_WIRE_QUAD_MODE;
+        default:
+            return SPI_WIRE_NORMAL_MODE;
+    }
+}
+
+const char *fal_norflash_read_mode_name(fal_norflash_read_mode_t mode){
+    switch (mode) {
+        case FAL_NOR_READ_DUAL: return "dual";
+        case FAL_NOR_READ_QUAD: return "quad";
+        default:                return "single";
+    }
+}
+
+fal_norflash_read_mode_t fal_norflash_read_mode_get(void){
+    return g_read_mode;
+}
+
+/* flash must be opened by the caller */
+static void spi_read_with(const struct spi_nor_bus *bus, uint32_t addr, uint8_t *buf,
+                          uint32_t size, bool dma){
+    if (dma) {
+        spi_ioctl(flash0.spidev, HGSPI_DMAC_USE, (uint32)g_spi_dma, 0);
+    }
+    bus->read(&flash0, addr, buf, size);
+    if (dma) {
+        spi_ioctl(flash0.spidev, HGSPI_DMAC_USE, 0, 0);
+    }
+}
+
+void fal_norflash_spi_read(uint32_t addr, uint8_t *buf, uint32_t size){
+    bool dma = (g_spi_dma != NULL) && (size >= FAL_NOR_DMA_READ_MIN);
+
+    spi_read_with(flash0.bus, addr, buf, size, dma);
+}
+
+/* flash must be opened by the caller; sect_cache buffer is borrowed as scratch */
+static bool probe_read_mode(fal_norflash_read_mode_t mode, const uint8_t *ref){
+    uint8_t *tmp = g_sect_cache.buf;
+
+    /* controller driver refuses wire modes it cannot drive */
+    if (spi_ioctl(flash0.spidev, SPI_WIRE_MODE_SET, read_mode_wire(mode), 0) != RET_OK) {
+        spi_ioctl(flash0.spidev, SPI_WIRE_MODE_SET, SPI_WIRE_NORMAL_MODE, 0);
+        fal_port_dbg("read mode %s: not supported by SPI controller",
+                     fal_norflash_read_mode_name(mode));
+        return false;
+    }
+    spi_ioctl(flash0.spidev, SPI_WIRE_MODE_SET, SPI_WIRE_NORMAL_MODE, 0);
+
+    if (mode == FAL_NOR_READ_QUAD) {
+        /* single wire program/erase, only the read opcode differs */
+        g_quad_bus      = *spi_nor_bus_get(SPI_NOR_NORMAL_SPI_MODE);
+        g_quad_bus.read = spi_nor_bus_get(SPI_NOR_QUAD_SPI_MODE)->read;
+        spi_nor_bus_get(SPI_NOR_QUAD_SPI_MODE)->open(&flash0);  // sets QE once
+    }
+
+    memset(tmp, 0, FAL_NOR_PROBE_LEN);
+    spi_read_with(read_mode_bus(mode), FAL_NOR_PROBE_ADDR, tmp, FAL_NOR_PROBE_LEN, false);
+    if (memcmp(tmp, ref, FAL_NOR_PROBE_LEN) != 0) {
+        fal_port_dbg("read mode %s: readback mismatch", fal_norflash_read_mode_name(mode));
+        return false;
+    }
+    return true;
+}
+
+/* flash must be opened by the caller */
+static void probe_read_modes(uint8_t vendor){
+    uint8_t *ref = &g_sect_cache.buf[FAL_NOR_PROBE_LEN];
+
+    g_spi_dma   = (struct dma_device *)dev_get(HG_DMAC_DEVID);
+    g_read_mode = FAL_NOR_READ_NORMAL;
+
+    if (!jedec_vendor_multi_io(vendor)) {
+        fal_port_dbg("vendor 0x%02X: single wire reads", vendor);
+        return;
+    }
+
+    spi_read_with(read_mode_bus(FAL_NOR_READ_NORMAL), FAL_NOR_PROBE_ADDR, ref,
+                  FAL_NOR_PROBE_LEN, false);
+    /* blank probe area cannot tell a working bus from floating lines */
+    if (!not_blank(ref, FAL_NOR_PROBE_LEN)) {
+        fal_port_dbg("probe area blank, keep single wire reads");
+        return;
+    }
+
+#if FAL_NOR_QUAD_READ
+    if (probe_read_mode(FAL_NOR_READ_QUAD, ref)) {
+        g_read_mode = FAL_NOR_READ_QUAD;
+    } else
+#endif
+    if (probe_read_mode(FAL_NOR_READ_DUAL, ref)) {
+        g_read_mode = FAL_NOR_READ_DUAL;
+    }
+
+    flash0.bus = read_mode_bus(g_read_mode);
+    fal_port_dbg("read mode: %s, dma=%d", fal_norflash_read_mode_name(g_read_mode),
+                 g_spi_dma != NULL);
+}
 
 static uint32_t spi_nor_size_from_jedec(uint32_t jedec_id){
     uint8_t cap = jedec_id & 0xFF;
@@ -80,38 +276,21 @@ static int init(void){
     nor_flash0.len      = flash0.size;
     nor_flash0.blk_size = flash0.sector_size;
 
-    spi_nor_close(&flash0);
-    return 0;
-}
+    probe_read_modes(jedec[0]);
 
-static int read(long offset, uint8_t *buf, size_t size){
-    uint32_t addr = (uint32_t)offset + FLASH_START_ADDR;
-    fal_port_dbg("read: addr=0x%08X size=%u", addr, size);
-    if (!buf || !size) {
-        fal_port_dbg("read buff NULL");
-        return 0;
-    }
-    if (addr + size > FLASH_END_ADDR) {
-        fal_port_dbg("read outside sector!");
-        return -1;
+    if (!g_sect_cache.lock_ready) {
+        if (os_mutex_init(&g_sect_cache.lock) == 0) {
+            g_sect_cache.lock_ready = true;
+        }
     }
+    g_sect_cache.valid = false;
+    g_sect_cache.dirty = false;
 
-    spi_nor_open(&flash0);
-    spi_nor_read(&flash0, addr, buf, (uint32_t)size);
     spi_nor_close(&flash0);
-
-    return (int)size;
-}
-
-static int need_erase(const uint8_t *p, uint32_t len){
-    for (uint32_t i = 0; i < len; i++) {
-        if (p[i] != 0xFF) {
-            return 1;
-        }
-    }
     return 0;
 }
 
+
 static void program_pages(uint32_t addr, const uint8_t *buf, uint32_t size){
     fal_port_dbg("program_pages: addr=0x%08X size=%u", addr, size);
     uint32_t page = page_size();
@@ -123,8 +302,11 @@ static void program_pages(uint32_t addr, const uint8_t *buf, uint32_t size){
             chunk = size;
         }
 
-        fal_port_dbg("  write page chunk: addr=0x%08X size=%u", addr, chunk);
-        spi_nor_write(&flash0, addr, (uint8_t *)buf, chunk);
+        /* all 0xFF: programming would not change the cells */
+        if (not_blank(buf, chunk)) {
+            fal_port_dbg("  write page chunk: addr=0x%08X size=%u", addr, chunk);
+            spi_nor_write(&flash0, addr, (uint8_t *)buf, chunk);
+        }
 
         addr += chunk;
         buf  += chunk;
@@ -132,37 +314,250 @@ static void program_pages(uint32_t addr, const uint8_t *buf, uint32_t size){
     }
 }
 
+
+static void sect_cache_lock(void){
+    if (g_sect_cache.lock_ready) {
+        os_mutex_lock(&g_sect_cache.lock, osWaitForever);
+    }
+}
+
+static void sect_cache_unlock(void){
+    if (g_sect_cache.lock_ready) {
+        os_mutex_unlock(&g_sect_cache.lock);
+    }
+}
+
+/* caller holds the lock and has the flash opened */
+static void sect_cache_writeback(void){
+    if (!g_sect_cache.valid || !g_sect_cache.dirty) {
+        return;
+    }
+
+    if (g_sect_cache.erase) {
+        fal_port_dbg("flush: erase+program sect=0x%08X", g_sect_cache.addr);
+        spi_nor_sector_erase(&flash0, g_sect_cache.addr);
+        program_pages(g_sect_cache.addr, g_sect_cache.buf, sector_size());
+        g_sect_stat.erases++;
+    } else {
+        fal_port_dbg("flush: program sect=0x%08X [%u..%u)", g_sect_cache.addr,
+                     g_sect_cache.dirty_lo, g_sect_cache.dirty_hi);
+        program_pages(g_sect_cache.addr + g_sect_cache.dirty_lo,
+                      &g_sect_cache.buf[g_sect_cache.dirty_lo],
+                      g_sect_cache.dirty_hi - g_sect_cache.dirty_lo);
+        g_sect_stat.erase_skips++;
+    }
+
+    g_sect_stat.flushes++;
+    g_sect_cache.dirty = false;
+    g_sect_cache.erase = false;
+}
+
+/* caller holds the lock and has the flash opened */
+static int sect_cache_load(uint32_t sector_addr){
+    if (sector_size() != sizeof(g_sect_cache.buf)) {
+        fal_port_dbg("sector size mismatch");
+        return -2;
+    }
+    if (g_sect_cache.valid && (g_sect_cache.addr == sector_addr)) {
+        return 0;
+    }
+
+    sect_cache_writeback();
+
+    fal_norflash_spi_read(sector_addr, g_sect_cache.buf, sizeof(g_sect_cache.buf));
+    g_sect_cache.addr  = sector_addr;
+    g_sect_cache.valid = true;
+    g_sect_cache.dirty = false;
+    g_sect_cache.erase = false;
+    g_sect_stat.loads++;
+    return 0;
+}
+
+/* Ideal throughput for one read command: opcode + 3 address + 1 dummy byte on one wire */
+static uint32_t bench_model_bps(fal_norflash_read_mode_t mode, uint32_t len){
+    uint32_t wires  = (mode == FAL_NOR_READ_QUAD) ? 4U : ((mode == FAL_NOR_READ_DUAL) ? 2U : 1U);
+    uint64_t clocks = (uint64_t)5U * 8U + ((uint64_t)len * 8U + wires - 1U) / wires;
+    uint64_t t_ns   = clocks * 1000000000ULL / flash0.spi_config.clk;
+
+    return (uint32_t)(((uint64_t)len * 1000000000ULL) / t_ns);
+}
+
+int32_t fal_norflash_bench(fal_norflash_bench_t *res, uint32_t max){
+    uint32_t n = 0;
+
+    if ((res == NULL) || (max == 0)) {
+        return -1;
+    }
+
+    sect_cache_lock();
+    spi_nor_open(&flash0);
+
+    for (uint32_t i = 0; i < 4U; i++) {
+        fal_norflash_read_mode_t mode = (i < 2U) ? FAL_NOR_READ_NORMAL : g_read_mode;
+        bool dma = (i & 1U) != 0;
+        int64_t t0;
+        int64_t dt;
+
+        if (n >= max) {
+            break;
+        }
+        if ((i >= 2U) && (g_read_mode == FAL_NOR_READ_NORMAL)) {
+            break;
+        }
+        if (dma && (g_spi_dma == NULL)) {
+            continue;
+        }
+
+        /* the sector image doubles as the read buffer, write it back first */
+        sect_cache_writeback();
+        g_sect_cache.valid = false;
+
+        t0 = get_time_us();
+        for (uint32_t r = 0; r < FAL_NOR_BENCH_ROUNDS; r++) {
+            spi_read_with(read_mode_bus(mode), r * FAL_NOR_BENCH_LEN,
+                          g_sect_cache.buf, FAL_NOR_BENCH_LEN, dma);
+        }
+        dt = get_time_us() - t0;
+        if (dt <= 0) {
+            dt = 1;
+        }
+
+        res[n].mode       = mode;
+        res[n].dma        = dma;
+        res[n].bytes      = FAL_NOR_BENCH_ROUNDS * FAL_NOR_BENCH_LEN;
+        res[n].time_us    = (uint32_t)dt;
+        res[n].kbps       = (uint32_t)(((uint64_t)res[n].bytes * 1000000ULL) / (uint64_t)dt / 1024ULL);
+        res[n].model_kbps = bench_model_bps(mode, FAL_NOR_BENCH_LEN) / 1024U;
+        n++;
+    }
+
+    spi_nor_close(&flash0);
+    sect_cache_unlock();
+    return (int32_t)n;
+}
+
+int32_t fal_norflash_flush(void){
+    sect_cache_lock();
+    if (g_sect_cache.valid && g_sect_cache.dirty) {
+        spi_nor_open(&flash0);
+        sect_cache_writeback();
+        spi_nor_close(&flash0);
+    }
+    sect_cache_unlock();
+    return 0;
+}
+
+void fal_norflash_stat_get(fal_norflash_stat_t *stat){
+    if (stat == NULL) {
+        return;
+    }
+    sect_cache_lock();
+    *stat = g_sect_stat;
+    sect_cache_unlock();
+}
+
+static int read(long offset, uint8_t *buf, size_t size){
+    uint32_t addr = (uint32_t)offset + FLASH_START_ADDR;
+    uint32_t end  = addr + (uint32_t)size;
+    fal_port_dbg("read: addr=0x%08X size=%u", addr, size);
+    if (!buf || !size) {
+        fal_port_dbg("read buff NULL");
+        return 0;
+    }
+    if (end > FLASH_END_ADDR) {
+        fal_port_dbg("read outside sector!");
+        return -1;
+    }
+
+    sect_cache_lock();
+
+    if (g_sect_cache.valid) {
+        uint32_t c_lo = g_sect_cache.addr;
+        uint32_t c_hi = c_lo + sizeof(g_sect_cache.buf);
+
+        if ((addr >= c_lo) && (end <= c_hi)) {
+            memcpy(buf, &g_sect_cache.buf[addr - c_lo], size);
+            sect_cache_unlock();
+            return (int)size;
+        }
+
+        spi_nor_open(&flash0);
+        fal_norflash_spi_read(addr, buf, (uint32_t)size);
+        spi_nor_close(&flash0);
+
+        /* overlay the cached image, it may hold unflushed data */
+        if ((addr < c_hi) && (end > c_lo)) {
+            uint32_t lo = (addr > c_lo) ? addr : c_lo;
+            uint32_t hi = (end < c_hi) ? end : c_hi;
+            memcpy(&buf[lo - addr], &g_sect_cache.buf[lo - c_lo], hi - lo);
+        }
+
+        sect_cache_unlock();
+        return (int)size;
+    }
+
+    spi_nor_open(&flash0);
+    fal_norflash_spi_read(addr, buf, (uint32_t)size);
+    spi_nor_close(&flash0);
+
+    sect_cache_unlock();
+    return (int)size;
+}
+
 static int write_one_sector(uint32_t sector_addr, uint32_t addr,
                             const uint8_t *buf, uint32_t size){
     fal_port_dbg("write_one_sector: sect=0x%08X addr=0x%08X size=%u",
               sector_addr, addr, size);
     uint32_t sect = sector_size();
     uint32_t off  = addr - sector_addr;
+    uint32_t lo   = sect;
+    uint32_t hi   = 0;
+    int rc;
 
-    static uint8_t sect_buf[4U * 1024U];
-
-    if (sect != sizeof(sect_buf)) {
-        fal_port_dbg("sector size mismatch");
-        return -2;
-    }
     if (off + size > sect) {
         fal_port_dbg("write outside sector!");
         return -1;
     }
 
-    spi_nor_read(&flash0, sector_addr, sect_buf, sect);
-
-    if (!need_erase(&sect_buf[off], size)) {
-        program_pages(addr, buf, size);
-        return (int)size;
+    rc = sect_cache_load(sector_addr);
+    if (rc < 0) {
+        return rc;
     }
 
     for (uint32_t i = 0; i < size; i++) {
-        sect_buf[off + i] = buf[i];
+        uint8_t old = g_sect_cache.buf[off + i];
+        uint8_t val = buf[i];
+
+        if (old == val) {
+            continue;
+        }
+        /* NOR programming can only clear bits */
+        if ((old & val) != val) {
+            g_sect_cache.erase = true;
+        }
+        g_sect_cache.buf[off + i] = val;
+        if (off + i < lo) {
+            lo = off + i;
+        }
+        hi = off + i + 1U;
     }
 
-    spi_nor_sector_erase(&flash0, sector_addr);
-    program_pages(sector_addr, sect_buf, sect);
+    if (hi == 0) {
+        return (int)size;
+    }
+
+    if (!g_sect_cache.dirty) {
+        g_sect_cache.dirty    = true;
+        g_sect_cache.dirty_lo = lo;
+        g_sect_cache.dirty_hi = hi;
+    } else {
+        if (lo < g_sect_cache.dirty_lo) {
+            g_sect_cache.dirty_lo = lo;
+        }
+        if (hi > g_sect_cache.dirty_hi) {
+            g_sect_cache.dirty_hi = hi;
+        }
+    }
 
     return (int)size;
 }
@@ -181,6 +576,7 @@ static int write(long offset, const uint8_t *buf, size_t size){
         return -1;
     }
 
+    sect_cache_lock();
     spi_nor_open(&flash0);
 
     uint32_t cur = addr;
@@ -192,6 +588,7 @@ static int write(long offset, const uint8_t *buf, size_t size){
         int rc = write_one_sector(sector_addr, cur, buf, chunk);
         if (rc < 0) {
             spi_nor_close(&flash0);
+            sect_cache_unlock();
             return rc;
         }
 
@@ -199,7 +596,10 @@ static int write(long offset, const uint8_t *buf, size_t size){
         buf += chunk;
     }
 
+    g_sect_stat.writes++;
+
     spi_nor_close(&flash0);
+    sect_cache_unlock();
     return (int)size;
 }
 
@@ -222,6 +622,15 @@ static int erase(long offset, size_t size){
     uint32_t cur = ALIGN_DOWN(addr, sect);
     uint32_t end_up = ALIGN_UP(end, sect);
 
+    sect_cache_lock();
+
+    /* erased sector content supersedes anything still cached for it */
+    if (g_sect_cache.valid && (g_sect_cache.addr >= cur) && (g_sect_cache.addr < end_up)) {
+        g_sect_cache.valid = false;
+        g_sect_cache.dirty = false;
+        g_sect_cache.erase = false;
+    }
+
     spi_nor_open(&flash0);
 
     while (cur < end_up) {
@@ -231,6 +640,7 @@ static int erase(long offset, size_t size){
     }
 
     spi_nor_close(&flash0);
+    sect_cache_unlock();
     return (int)size;
 }
 
@@ -24,6 +24,7 @@
 #include "littelfs_port.h"
 
 #include "hal/spi_nor.h"
+#include "fal_norflash_port.h"
 
 extern struct spi_nor_flash flash0;
 
@@ -91,7 +92,7 @@ static int lfs_bd_read (const struct lfs_config *c,
         return LFS_ERR_IO;
     }
 
-    spi_nor_read(&flash0, addr, (uint8_t *)buffer, (uint32_t)size);
+    fal_norflash_spi_read(addr, (uint8_t *)buffer, (uint32_t)size);
 
     lfs_flash_close();
     return 0;
@@ -1,6 +1,7 @@
 #include "basic_include.h"
 #include "statistics.h"
 #include "halow_lbt.h"
+#include "utils.h"
 #include <string.h>
 #include <time.h>
 
@@ -16,6 +17,23 @@ volatile statistics_radio_t g_stat_radio;
 
 static struct os_task g_stat_task;
 
+/*
+ * Per-sender link table. The RX path is the only writer; readers copy a slot
+ * under its sequence counter and retry while it is odd or changed, so the RX
+ * path never waits. A reset bumps the epoch instead of touching the slots.
+ */
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t          epoch;
+    int64_t           last_ms;
+    statistics_link_t link;
+} statistics_link_slot_t;
+
+#define STATISTICS_LINK_READ_TRIES  (4)
+
+static statistics_link_slot_t g_link[STATISTICS_LINK_PEERS];
+static volatile uint32_t g_link_epoch = 1;
+
 void statistics_radio_register_rx_package(uint32_t len){
     g_stat_radio.rx_packets++;
     g_stat_radio.rx_bytes += len;
@@ -35,6 +53,127 @@ void statistics_radio_reset(void){
     g_stat_radio.tx_bytes = 0;
     g_stat_radio.rx_packets = 0;
     g_stat_radio.tx_packets = 0;
+    g_link_epoch++;
+}
+
+static inline int32_t statistics_ewma(int32_t avg, int32_t sample){
+    return avg + (((sample << 4) - avg) >> STATISTICS_LINK_EWMA_SHIFT);
+}
+
+static statistics_link_slot_t *statistics_link_slot(const uint8_t addr[6], uint32_t epoch){
+    statistics_link_slot_t *victim = NULL;
+    uint32_t i;
+
+    for (i = 0; i < STATISTICS_LINK_PEERS; i++) {
+        statistics_link_slot_t *sl = &g_link[i];
+
+        if (sl->epoch != epoch) {
+            if ((victim == NULL) || (victim->epoch == epoch)) {
+                victim = sl;
+            }
+            continue;
+        }
+        if (memcmp(sl->link.addr, addr, 6) == 0) {
+            return sl;
+        }
+        if ((victim == NULL) ||
+            ((victim->epoch == epoch) && (sl->last_ms < victim->last_ms))) {
+            victim = sl;
+        }
+    }
+
+    /* free or least recently heard slot, restarted for the new sender */
+    victim->seq++;
+    __sync_synchronize();
+    memset(&victim->link, 0, sizeof(victim->link));
+    memcpy(victim->link.addr, addr, 6);
+    victim->epoch = epoch;
+    __sync_synchronize();
+    victim->seq++;
+    return victim;
+}
+
+/* RX path only: single writer, never blocks */
+void statistics_link_register_rx(const halow_rx_meta_t *meta, uint32_t len){
+    statistics_link_slot_t *sl;
+    statistics_link_t *l;
+
+    if (meta == NULL) {
+        return;
+    }
+
+    sl = statistics_link_slot(meta->src, g_link_epoch);
+    l  = &sl->link;
+
+    sl->seq++;
+    __sync_synchronize();
+
+    if (l->frames == 0) {
+        l->signal_avg   = (int16_t)(meta->signal * 16);
+        l->evm_avg      = (int16_t)(meta->evm * 16);
+        l->freq_off_avg = (int32_t)meta->freq_off * 16;
+        l->signal_min   = meta->signal;
+        l->signal_max   = meta->signal;
+    } else {
+        l->signal_avg   = (int16_t)statistics_ewma(l->signal_avg, meta->signal);
+        l->evm_avg      = (int16_t)statistics_ewma(l->evm_avg, meta->evm);
+        l->freq_off_avg = statistics_ewma(l->freq_off_avg, meta->freq_off);
+        if (meta->signal < l->signal_min) {
+            l->signal_min = meta->signal;
+        }
+        if (meta->signal > l->signal_max) {
+            l->signal_max = meta->signal;
+        }
+    }
+    l->frames++;
+    l->bytes += len;
+    l->last   = *meta;
+    sl->last_ms = get_time_ms();
+
+    __sync_synchronize();
+    sl->seq++;
+}
+
+/* Copies up to `max` senders heard since the last reset, returns the count */
+uint32_t statistics_link_get(statistics_link_t *out, uint32_t max){
+    uint32_t epoch = g_link_epoch;
+    int64_t now = get_time_ms();
+    uint32_t n = 0;
+    uint32_t i;
+
+    if (out == NULL) {
+        return 0;
+    }
+
+    for (i = 0; (i < STATISTICS_LINK_PEERS) && (n < max); i++) {
+        statistics_link_slot_t *sl = &g_link[i];
+        uint32_t tries;
+
+        for (tries = 0; tries < STATISTICS_LINK_READ_TRIES; tries++) {
+            uint32_t seq = sl->seq;
+            uint32_t sl_epoch;
+            int64_t last_ms;
+
+            if (seq & 1u) {
+                continue;
+            }
+            __sync_synchronize();
+            out[n]   = sl->link;
+            sl_epoch = sl->epoch;
+            last_ms  = sl->last_ms;
+            __sync_synchronize();
+            if (seq != sl->seq) {
+                continue;
+            }
+
+            if ((sl_epoch == epoch) && (out[n].frames != 0)) {
+                out[n].age_ms = (now > last_ms) ? (uint32_t)(now - last_ms) : 0;
+                n++;
+            }
+            break;
+        }
+    }
+    return n;
 }
 
 void statistics_uptime_get(char* return_str, uint32_t max_len){
@@ -6,6 +6,8 @@
 #include "configdb.h"
 #include "lwip/ip4_addr.h"
 #include "lwip/ip_addr.h"
+#include "lib/lwrb/lwrb.h"
+#include "deframer.h"
 #include <string.h>
 
 //#define TCP_SERVER_DEBUG
@@ -24,22 +26,13 @@
 #define TCP_SERVER_CONFIG_ENABLED_NAME              TCP_SERVER_CONFIG_ADD_CONFIG("enabled")
 #define TCP_SERVER_CONFIG_WHITELIST_IP_NAME         TCP_SERVER_CONFIG_ADD_CONFIG("wlst_ip")
 #define TCP_SERVER_CONFIG_WHITELIST_MASK_NAME       TCP_SERVER_CONFIG_ADD_CONFIG("wlst_mask")
+#define TCP_SERVER_CONFIG_RX_META_NAME              TCP_SERVER_CONFIG_ADD_CONFIG("rx_meta")
+#define TCP_SERVER_CONFIG_SLOW_POLICY_NAME          TCP_SERVER_CONFIG_ADD_CONFIG("slow_pol")
 #endif
 
-struct tcp_tx_package {
-    struct tcp_pcb* pcb;
-    uint16_t len;
-    uint8_t data[0];
-};
-
-static struct os_semaphore g_rxq_sem;
-static struct os_semaphore g_yield_sem;
-static struct tcp_pcb* g_listen_pcb;
-static struct tcp_pcb* g_client_pcb;
-static uint32_t g_client_gen;
-static tcp_server_config_t g_cfg;
-static tcp_server_rx_cb_t g_rx_cb;
-static uint8_t* g_rx_pkg_buf;
+#ifndef TCP_SERVER_MAX_CLIENTS
+#define TCP_SERVER_MAX_CLIENTS               3
+#endif
 
 /* RX worker: process long g_rx_cb() outside tcpip thread and call tcp_recved() only after processing. */
 #ifndef TCP_SERVER_RX_QUEUE_LEN
@@ -54,33 +47,103 @@ static uint8_t* g_rx_pkg_buf;
 #define TCP_SERVER_RX_TASK_PRIO              20
 #endif
 
+/* Deficit round robin between clients: bytes a client may hand to the radio per round */
+#ifndef TCP_SERVER_DRR_QUANTUM
+#define TCP_SERVER_DRR_QUANTUM               HALOW_MTU
+#endif
+
+/* Largest frame accepted from the host: HALOW_MTU payload with every byte escaped plus delimiters */
+#ifndef TCP_SERVER_FRAME_MAX
+#define TCP_SERVER_FRAME_MAX                 (2 * HALOW_MTU + 3)
+#endif
+
+#ifndef TCP_SERVER_FRAMING_MODE
+#define TCP_SERVER_FRAMING_MODE              DEFRAMER_MODE_AUTO
+#endif
+
+/* Radio RX -> TCP ring of every client: written by the LMAC RX context, drained by the tcpip thread */
+#ifndef TCP_SERVER_CLIENT_TX_RING
+#define TCP_SERVER_CLIENT_TX_RING            (4 * 1024)
+#endif
+
+/*
+ * KISS command frame sent right before an RX data frame when rx_meta is on.
+ * The low nibble is not CMD_DATA, so KISS hosts that do not know it drop it.
+ * Payload before escaping, multi-byte fields big endian:
+ *   [0] version  [1] signal dBm (s8)  [2] EVM dB (s8)  [3..4] freq offset (s16)
+ *   [5] MCS  [6] bandwidth MHz  [7..12] sender address  [13..14] data length
+ */
+#ifndef TCP_SERVER_KISS_CMD_RX_META
+#define TCP_SERVER_KISS_CMD_RX_META          0x2E
+#endif
+
+#define TCP_SERVER_RX_META_VER               1
+#define TCP_SERVER_RX_META_LEN               15
+#define TCP_SERVER_RX_META_FRAME_MAX         (2 * TCP_SERVER_RX_META_LEN + 3)
+
 #ifndef TCP_SERVER_BARRIER
 #define TCP_SERVER_BARRIER()                 __sync_synchronize()
 #endif
 
 typedef struct {
-    struct tcp_pcb *pcb;
     struct pbuf *p;
     uint32_t gen;
 } tcp_server_rx_job_t;
 
+/*
+ * One modem session. pcb/gen are owned by the tcpip thread; a slot is free
+ * while pcb is NULL. gen changes on every open and close so late jobs and
+ * callbacks of a previous connection are recognised and dropped.
+ */
 typedef struct {
-    struct tcp_pcb *pcb;
+    struct tcp_pcb *volatile pcb;
+    volatile uint32_t gen;
+    ip4_addr_t addr;
+    uint16_t port;
+    uint8_t policy;
+    volatile bool kill;                 // slow consumer, closed by the next drain
+
+    /* radio -> client */
+    lwrb_t tx_rb;
+    uint8_t tx_rb_data[TCP_SERVER_CLIENT_TX_RING];
+    uint32_t tx_frames;
+    uint32_t tx_drops;
+
+    /* client -> radio: tcpip thread pushes, RX worker pops */
+    volatile uint32_t rxq_wr;
+    volatile uint32_t rxq_rd;
+    tcp_server_rx_job_t rxq[TCP_SERVER_RX_QUEUE_LEN];
+    int32_t deficit;
+    deframer_t deframer;
+    uint8_t *frame_buf;
+    uint32_t deframer_gen;
+    uint32_t rx_frames;
+} tcp_server_client_t;
+
+typedef struct {
+    tcp_server_client_t *c;
     struct pbuf *p;
     uint16_t len;
     uint32_t gen;
 } tcp_server_rx_done_t;
 
+static struct os_semaphore g_rxq_sem;
+static struct os_semaphore g_yield_sem;
+static struct tcp_pcb* g_listen_pcb;
+static tcp_server_config_t g_cfg;
+static tcp_server_rx_cb_t g_rx_cb;
+static tcp_server_client_t g_clients[TCP_SERVER_MAX_CLIENTS];
+
+static volatile uint32_t g_tx_drain_pending;
+static tcp_server_tx_stat_t g_tx_stat;
+
 static struct os_task g_tcps_rx_task;
 static bool g_tcps_rx_task_started;
-static volatile uint32_t g_rxq_wr;
-static volatile uint32_t g_rxq_rd;
-static tcp_server_rx_job_t g_rxq[TCP_SERVER_RX_QUEUE_LEN];
 
 static void tcp_server_rx_task( void *arg );
 static int32_t tcp_server_rx_worker_init( void );
-static bool tcp_server_rxq_push( struct tcp_pcb *pcb, struct pbuf *p, uint32_t gen );
-static bool tcp_server_rxq_pop( tcp_server_rx_job_t *out );
+static bool tcp_server_rxq_push( tcp_server_client_t *c, struct pbuf *p, uint32_t gen );
+static bool tcp_server_rxq_pop( tcp_server_client_t *c, tcp_server_rx_job_t *out );
 static void tcp_server_rx_done_cb( void *arg );
 static void tcp_server_pbuf_free_cb( void *arg );
 
@@ -99,12 +162,14 @@ static inline void tcp_server_config_debug_print( const char *tag,
     ip4addr_ntoa_r((const ip4_addr_t *)&cfg->whitelist_ip,   ipbuf,   sizeof(ipbuf));
     ip4addr_ntoa_r((const ip4_addr_t *)&cfg->whitelist_mask, maskbuf, sizeof(maskbuf));
 
-    tcps_debug("%s en=%d port=%u wlst_ip=%s wlst_mask=%s",
+    tcps_debug("%s en=%d port=%u wlst_ip=%s wlst_mask=%s meta=%d slow=%u",
                tag ? tag : "CFG",
                cfg->enabled ? 1 : 0,
                (unsigned)cfg->port,
                ipbuf,
-               maskbuf);
+               maskbuf,
+               cfg->rx_meta ? 1 : 0,
+               (unsigned)cfg->slow_policy);
 }
 #else
 #define tcp_server_config_debug_print(tag, cfg) do { } while (0)
@@ -112,6 +177,8 @@ static inline void tcp_server_config_debug_print( const char *tag,
 
 void tcp_server_config_load(tcp_server_config_t *cfg){
     int8_t enabled;
+    int8_t rx_meta;
+    int8_t slow_policy;
     int16_t port;
     int32_t ip;
     int32_t mask;
@@ -124,6 +191,8 @@ void tcp_server_config_load(tcp_server_config_t *cfg){
     cfg->port = TCP_SERVER_CONFIG_PORT_DEF;
     cfg->whitelist_ip.addr = (uint32_t)TCP_SERVER_CONFIG_WHITELIST_IP_DEF;
     cfg->whitelist_mask.addr = (uint32_t)TCP_SERVER_CONFIG_WHITELIST_MASK_DEF;
+    cfg->rx_meta = TCP_SERVER_CONFIG_RX_META_DEF ? true : false;
+    cfg->slow_policy = (uint8_t)TCP_SERVER_CONFIG_SLOW_POLICY_DEF;
 
     if (configdb_get_i8(TCP_SERVER_CONFIG_ENABLED_NAME, &enabled) == 0) {
         cfg->enabled = enabled ? true : false;
@@ -137,12 +206,20 @@ void tcp_server_config_load(tcp_server_config_t *cfg){
     if (configdb_get_i32(TCP_SERVER_CONFIG_WHITELIST_MASK_NAME, &mask) == 0) {
         cfg->whitelist_mask.addr = (uint32_t)mask;
     }
+    if (configdb_get_i8(TCP_SERVER_CONFIG_RX_META_NAME, &rx_meta) == 0) {
+        cfg->rx_meta = rx_meta ? true : false;
+    }
+    if (configdb_get_i8(TCP_SERVER_CONFIG_SLOW_POLICY_NAME, &slow_policy) == 0) {
+        cfg->slow_policy = (slow_policy == TCP_SERVER_SLOW_CLOSE) ? TCP_SERVER_SLOW_CLOSE : TCP_SERVER_SLOW_DROP;
+    }
 
     tcp_server_config_debug_print("LOAD", cfg);
 }
 
 void tcp_server_config_save(const tcp_server_config_t *cfg){
     int8_t enabled;
+    int8_t rx_meta;
+    int8_t slow_policy;
     int16_t port;
     int32_t ip;
     int32_t mask;
@@ -157,41 +234,53 @@ void tcp_server_config_save(const tcp_server_config_t *cfg){
     port = (int16_t)cfg->port;
     ip = (int32_t)cfg->whitelist_ip.addr;
     mask = (int32_t)cfg->whitelist_mask.addr;
+    rx_meta = cfg->rx_meta ? 1 : 0;
+    slow_policy = (int8_t)cfg->slow_policy;
 
     configdb_set_i8(TCP_SERVER_CONFIG_ENABLED_NAME, &enabled);
     configdb_set_i16(TCP_SERVER_CONFIG_PORT_NAME, &port);
     configdb_set_i32(TCP_SERVER_CONFIG_WHITELIST_IP_NAME, &ip);
     configdb_set_i32(TCP_SERVER_CONFIG_WHITELIST_MASK_NAME, &mask);
+    configdb_set_i8(TCP_SERVER_CONFIG_RX_META_NAME, &rx_meta);
+    configdb_set_i8(TCP_SERVER_CONFIG_SLOW_POLICY_NAME, &slow_policy);
 }
 
-static bool tcp_server_rxq_push( struct tcp_pcb *pcb, struct pbuf *p, uint32_t gen ){
-    uint32_t wr = (uint32_t)g_rxq_wr;
+static bool tcp_server_rxq_push( tcp_server_client_t *c, struct pbuf *p, uint32_t gen ){
+    uint32_t wr = (uint32_t)c->rxq_wr;
     uint32_t next = wr + 1U;
     if (next >= TCP_SERVER_RX_QUEUE_LEN) {
         next = 0U;
     }
-    if (next == (uint32_t)g_rxq_rd) {
+    if (next == (uint32_t)c->rxq_rd) {
         return false;
     }
 
-    g_rxq[wr].pcb = pcb;
-    g_rxq[wr].p = p;
-    g_rxq[wr].gen = gen;
+    c->rxq[wr].p = p;
+    c->rxq[wr].gen = gen;
     TCP_SERVER_BARRIER();
-    g_rxq_wr = next;
+    c->rxq_wr = next;
 
     (void)os_sema_up(&g_rxq_sem);
     return true;
 }
 
-static bool tcp_server_rxq_pop( tcp_server_rx_job_t *out ){
-    uint32_t rd = (uint32_t)g_rxq_rd;
-    if (rd == (uint32_t)g_rxq_wr) {
+static tcp_server_rx_job_t *tcp_server_rxq_peek( tcp_server_client_t *c ){
+    uint32_t rd = (uint32_t)c->rxq_rd;
+    if (rd == (uint32_t)c->rxq_wr) {
+        return NULL;
+    }
+    TCP_SERVER_BARRIER();
+    return &c->rxq[rd];
+}
+
+static bool tcp_server_rxq_pop( tcp_server_client_t *c, tcp_server_rx_job_t *out ){
+    uint32_t rd = (uint32_t)c->rxq_rd;
+    if (rd == (uint32_t)c->rxq_wr) {
         return false;
     }
 
     if (out != NULL) {
-        *out = g_rxq[rd];
+        *out = c->rxq[rd];
     }
 
     TCP_SERVER_BARRIER();
@@ -199,7 +288,7 @@ static bool tcp_server_rxq_pop( tcp_server_rx_job_t *out ){
     if (rd >= TCP_SERVER_RX_QUEUE_LEN) {
         rd = 0U;
     }
-    g_rxq_rd = rd;
+    c->rxq_rd = rd;
     return true;
 }
 
@@ -218,8 +307,9 @@ static void tcp_server_rx_done_cb( void *arg ){
     }
 
     if (j->p != NULL) {
-        if ((j->gen == g_client_gen) && (j->pcb == g_client_pcb) && (j->pcb != NULL)) {
-            tcp_recved(j->pcb, (u16_t)j->len);
+        struct tcp_pcb *pcb = j->c->pcb;
+        if ((j->gen == j->c->gen) && (pcb != NULL)) {
+            tcp_recved(pcb, (u16_t)j->len);
         }
         pbuf_free(j->p);
     }
@@ -227,83 +317,137 @@ static void tcp_server_rx_done_cb( void *arg ){
     os_free(j);
 }
 
-static void tcp_server_rx_task( void *arg ){
+/* Frames spanning pbufs arrive as pieces of the pbuf payloads, halow_tx_iov() gathers them into the skb */
+static void tcp_server_frame_cb( void *arg, const deframer_seg_t *seg, uint32_t cnt, uint32_t len ){
+    tcp_server_client_t *c = (tcp_server_client_t *)arg;
+    halow_iov_t iov[DEFRAMER_FRAME_SEGS_MAX];
+    uint32_t i;
+
+    (void)len;
+    if ((g_rx_cb == NULL) || (cnt > DEFRAMER_FRAME_SEGS_MAX)) {
+        return;
+    }
+    for (i = 0; i < cnt; i++) {
+        iov[i].data = seg[i].data;
+        iov[i].len  = seg[i].len;
+    }
+    if (g_rx_cb(iov, cnt) == 0) {
+        c->rx_frames++;
+    }
+}
+
+/* KISS command frames (TXDELAY, P, SlotTime, ...) are consumed by the modem: LBT owns channel access */
+static void tcp_server_kiss_cmd_cb( void *arg, uint8_t cmd, const uint8_t *data, uint32_t len ){
     (void)arg;
+    (void)data;
+    (void)len;
 
-    while (1) {
-        uint32_t off;
-        uint32_t tot;
-        tcp_server_rx_job_t job;
+    tcps_debug("KISS cmd=0x%02X len=%u ignored", (unsigned)cmd, (unsigned)len);
+}
 
-        if (!tcp_server_rxq_pop(&job)) {
-            (void)os_sema_down(&g_rxq_sem, 1000);
-            continue;
-        }
+/* Hand the pbuf back to the tcpip thread, opening the window only if its connection is still alive */
+static void tcp_server_rx_job_done( tcp_server_client_t *c, const tcp_server_rx_job_t *job ){
+    tcp_server_rx_done_t *done = (tcp_server_rx_done_t *)os_malloc(sizeof(*done));
 
-        if (job.p == NULL) {
-            continue;
+    if (done == NULL) {
+        /* worst-case: free without updating rcv window */
+        while (tcpip_try_callback(tcp_server_pbuf_free_cb, job->p) != ERR_OK) {
+            os_sema_down(&g_yield_sem, 1);
         }
+        return;
+    }
 
-        /* connection changed - just drop queued data */
-        if (job.gen != g_client_gen) {
-            while (tcpip_try_callback(tcp_server_pbuf_free_cb, job.p) != ERR_OK) {
-                os_sema_down(&g_yield_sem, 1);
-            }
-            continue;
+    done->c = c;
+    done->p = job->p;
+    done->len = (uint16_t)job->p->tot_len;
+    done->gen = job->gen;
+
+    while (tcpip_try_callback(tcp_server_rx_done_cb, done) != ERR_OK) {
+        os_sema_down(&g_yield_sem, 1);
+    }
+}
+
+static void tcp_server_rx_job_run( tcp_server_client_t *c, const tcp_server_rx_job_t *job ){
+    deframer_seg_t seg[DEFRAMER_SEGS_MAX];
+    uint32_t cnt;
+    struct pbuf *q;
+
+    /* connection changed - just drop queued data */
+    if (job->gen != c->gen) {
+        while (tcpip_try_callback(tcp_server_pbuf_free_cb, job->p) != ERR_OK) {
+            os_sema_down(&g_yield_sem, 1);
         }
+        return;
+    }
 
-        if (g_rx_cb == NULL || g_rx_pkg_buf == NULL) {
-            tcp_server_rx_done_t *done = (tcp_server_rx_done_t *)os_malloc(sizeof(*done));
-            if (done == NULL) {
-                while (tcpip_try_callback(tcp_server_pbuf_free_cb, job.p) != ERR_OK) {
-                    os_sema_down(&g_yield_sem, 1);
-                }
-                continue;
-            }
-            done->pcb = job.pcb;
-            done->p = job.p;
-            done->len = (uint16_t)job.p->tot_len;
-            done->gen = job.gen;
+    if (g_rx_cb != NULL && c->frame_buf != NULL) {
+        /* new connection - drop partial frame of the previous one */
+        if (job->gen != c->deframer_gen) {
+            deframer_reset(&c->deframer);
+            c->deframer_gen = job->gen;
+        }
 
-            while (tcpip_try_callback(tcp_server_rx_done_cb, done) != ERR_OK) {
-                os_sema_down(&g_yield_sem, 1);
+        /* The chain stays alive until the job is done, so frames spanning its pbufs are not copied */
+        q = job->p;
+        while (q != NULL) {
+            for (cnt = 0; (q != NULL) && (cnt < DEFRAMER_SEGS_MAX); q = q->next) {
+                seg[cnt].data = (const uint8_t *)q->payload;
+                seg[cnt].len  = (uint32_t)q->len;
+                cnt++;
             }
-            continue;
+            deframer_feed_segs(&c->deframer, seg, cnt);
         }
+    }
 
-        off = 0U;
-        tot = (uint32_t)job.p->tot_len;
+    tcp_server_rx_job_done(c, job);
+}
 
-        while (off < tot) {
-            uint32_t chunk = tot - off;
-            if (chunk > HALOW_MTU) {
-                chunk = HALOW_MTU;
-            }
+/*
+ * Deficit round robin over the client queues: every round a client with
+ * pending data earns TCP_SERVER_DRR_QUANTUM bytes and spends them on whole
+ * received segments, so a client streaming large bursts cannot starve the
+ * others of radio time. g_rx_cb() waits for TX queue space, which is what
+ * turns the processing order into the airtime share.
+ */
+static void tcp_server_rx_task( void *arg ){
+    uint32_t i;
 
-            pbuf_copy_partial(job.p, g_rx_pkg_buf, (u16_t)chunk, (u16_t)off);
-            g_rx_cb(g_rx_pkg_buf, chunk);
-            off += chunk;
-        }
+    (void)arg;
 
-        {
-            tcp_server_rx_done_t *done = (tcp_server_rx_done_t *)os_malloc(sizeof(*done));
-            if (done == NULL) {
-                /* worst-case: free without updating rcv window */
-                while (tcpip_try_callback(tcp_server_pbuf_free_cb, job.p) != ERR_OK) {
-                    os_sema_down(&g_yield_sem, 1);
-                }
+    while (1) {
+        bool pending = false;
+
+        for (i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+            tcp_server_client_t *c = &g_clients[i];
+            tcp_server_rx_job_t *head = tcp_server_rxq_peek(c);
+            tcp_server_rx_job_t job;
+
+            if (head == NULL) {
+                c->deficit = 0;
                 continue;
             }
 
-            done->pcb = job.pcb;
-            done->p = job.p;
-            done->len = (uint16_t)job.p->tot_len;
-            done->gen = job.gen;
+            c->deficit += TCP_SERVER_DRR_QUANTUM;
+            while ((head != NULL) &&
+                   ((head->p == NULL) || ((int32_t)head->p->tot_len <= c->deficit))) {
+                (void)tcp_server_rxq_pop(c, &job);
+                if (job.p != NULL) {
+                    c->deficit -= (int32_t)job.p->tot_len;
+                    tcp_server_rx_job_run(c, &job);
+                }
+                head = tcp_server_rxq_peek(c);
+            }
 
-            while (tcpip_try_callback(tcp_server_rx_done_cb, done) != ERR_OK) {
-                os_sema_down(&g_yield_sem, 1);
+            if (head == NULL) {
+                c->deficit = 0;
+            } else {
+                pending = true;
             }
         }
+
+        if (!pending) {
+            (void)os_sema_down(&g_rxq_sem, 1000);
+        }
     }
 }
 
@@ -314,9 +458,6 @@ static int32_t tcp_server_rx_worker_init( void ){
         return 0;
     }
 
-    g_rxq_wr = 0;
-    g_rxq_rd = 0;
-
     (void)os_sema_init(&g_rxq_sem, 0);
     (void)os_sema_init(&g_yield_sem, 0);
 
@@ -340,10 +481,34 @@ static int32_t tcp_server_rx_worker_init( void ){
     return ret;
 }
 
+/* tcpip thread: detach and free the slot, returns ERR_ABRT if the pcb had to be aborted */
+static err_t tcp_server_client_close( tcp_server_client_t *c, bool abort ){
+    struct tcp_pcb *pcb = c->pcb;
+
+    if (pcb == NULL) {
+        return ERR_OK;
+    }
+
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err (pcb, NULL);
+
+    c->pcb = NULL;
+    c->gen++;
+
+    if (!abort && (tcp_close(pcb) == ERR_OK)) {
+        return ERR_OK;
+    }
+    tcp_abort(pcb);
+    return ERR_ABRT;
+}
+
 static void tcp_server_apply_cb(void *arg){
     tcp_server_config_t *cfg = (tcp_server_config_t *)arg;
     struct tcp_pcb *pcb;
     err_t err;
+    uint32_t i;
 
     if (cfg == NULL) {
         return;
@@ -355,13 +520,8 @@ static void tcp_server_apply_cb(void *arg){
         g_listen_pcb = NULL;
     }
 
-    if (g_client_pcb != NULL) {
-        g_client_gen++;
-        tcp_arg(g_client_pcb, NULL);
-        tcp_recv(g_client_pcb, NULL);
-        tcp_err (g_client_pcb, NULL);
-        tcp_abort(g_client_pcb);
-        g_client_pcb = NULL;
+    for (i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        (void)tcp_server_client_close(&g_clients[i], true);
     }
 
     g_cfg = *cfg;
@@ -423,46 +583,106 @@ void tcp_server_config_apply(const tcp_server_config_t *cfg){
     }
 }
 
-bool tcp_server_get_client_info( ip4_addr_t *addr, uint16_t *port ){
-    if (g_client_pcb == NULL) {
-        return false;
-    }
+uint32_t tcp_server_get_clients( tcp_server_client_info_t *out, uint32_t max ){
+    uint32_t n = 0;
+    uint32_t i;
 
-    if (addr != NULL) {
-        *addr = *ip_2_ip4(&g_client_pcb->remote_ip);
-    }
-    if (port != NULL) {
-        *port = g_client_pcb->remote_port;
+    for (i = 0; (i < TCP_SERVER_MAX_CLIENTS) && (n < max); i++) {
+        tcp_server_client_t *c = &g_clients[i];
+
+        if (c->pcb == NULL) {
+            continue;
+        }
+        if (out != NULL) {
+            out[n].addr      = c->addr;
+            out[n].port      = c->port;
+            out[n].policy    = c->policy;
+            out[n].tx_frames = c->tx_frames;
+            out[n].tx_drops  = c->tx_drops;
+            out[n].tx_queued = (uint32_t)lwrb_get_full(&c->tx_rb);
+            out[n].rx_frames = c->rx_frames;
+        }
+        n++;
     }
-    return true;
+    return n;
 }
 
-static void tcp_server_send_callback(void *arg){
-    struct tcp_tx_package* j = (struct tcp_tx_package*)arg;
+/* tcpip thread: push everything queued since the last wakeup with as few tcp_write calls as the ring wrap allows */
+static void tcp_server_tx_drain( tcp_server_client_t *c ){
+    struct tcp_pcb *pcb = c->pcb;
+    bool written = false;
 
-    if (j == NULL) {
+    if (pcb == NULL) {
+        lwrb_skip(&c->tx_rb, lwrb_get_full(&c->tx_rb));
         return;
     }
-    if (j->pcb == NULL) {
-        goto end;
-    }
-    if(j->pcb != g_client_pcb){
-        goto end;
-    }
-    if (tcp_sndbuf(j->pcb) < j->len) {
-        goto end;
+
+    if (c->kill) {
+        tcps_debug("client %u too slow, closing", (unsigned)(c - g_clients));
+        (void)tcp_server_client_close(c, true);
+        lwrb_skip(&c->tx_rb, lwrb_get_full(&c->tx_rb));
+        return;
     }
-    if (tcp_sndqueuelen(j->pcb) >= TCP_SND_QUEUELEN) {
-        goto end;
+
+    while (1) {
+        lwrb_sz_t n = lwrb_get_linear_block_read_length(&c->tx_rb);
+        u16_t room = tcp_sndbuf(pcb);
+
+        if ((n == 0) || (room == 0)) {
+            break;
+        }
+        if (tcp_sndqueuelen(pcb) >= TCP_SND_QUEUELEN) {
+            break;
+        }
+        if (n > room) {
+            n = room;
+        }
+        if (tcp_write(pcb, lwrb_get_linear_block_read_address(&c->tx_rb), (u16_t)n, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            break;
+        }
+        lwrb_skip(&c->tx_rb, n);
+        g_tx_stat.tcp_bytes += n;
+        written = true;
     }
-    if (tcp_write(j->pcb, j->data, j->len, TCP_WRITE_FLAG_COPY) == ERR_OK) {
-        int32_t res = tcp_output(j->pcb);
+
+    if (written) {
+        g_tx_stat.tcp_writes++;
+        int32_t res = tcp_output(pcb);
         if(res != ERR_OK){
             tcps_debug("Output err=%d", res);
         }
     }
-end:
-    os_free(j);
+}
+
+static void tcp_server_tx_drain_cb( void *arg ){
+    uint32_t i;
+
+    (void)arg;
+
+    g_tx_drain_pending = 0;
+    TCP_SERVER_BARRIER();
+    for (i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        tcp_server_tx_drain(&g_clients[i]);
+    }
+}
+
+/* Data left in the ring because sndbuf was short goes out as soon as the peer ACKs */
+static err_t tcp_server_sent_callback( void *arg, struct tcp_pcb *tpcb, u16_t len ){
+    tcp_server_client_t *c = (tcp_server_client_t *)arg;
+    (void)tpcb;
+    (void)len;
+
+    if ((c != NULL) && (lwrb_get_full(&c->tx_rb) != 0)) {
+        tcp_server_tx_drain(c);
+        if (c->pcb == NULL) {
+            return ERR_ABRT;
+        }
+    }
+    return ERR_OK;
+}
+
+tcp_server_tx_stat_t tcp_server_tx_stat_get( void ){
+    return g_tx_stat;
 }
 
 static err_t tcp_server_recv_callback (void *arg,
@@ -470,19 +690,23 @@ static err_t tcp_server_recv_callback (void *arg,
                                        struct pbuf *p,
                                        err_t err)
 {
-    (void)arg;
+    tcp_server_client_t *c = (tcp_server_client_t *)arg;
     (void)err;
 
-    if (p == NULL) {
-        tcp_close(tpcb);
-        if (g_client_pcb == tpcb) {
-            g_client_pcb = NULL;
-            g_client_gen++;
+    if ((c == NULL) || (c->pcb != tpcb)) {
+        if (p != NULL) {
+            tcp_recved(tpcb, p->tot_len);
+            pbuf_free(p);
         }
         return ERR_OK;
     }
 
-    tcps_debug("RECV cb: tot_len=%u first_len=%u", (unsigned)p->tot_len, (unsigned)p->len);
+    if (p == NULL) {
+        return tcp_server_client_close(c, false);
+    }
+
+    tcps_debug("RECV cb: client=%u tot_len=%u first_len=%u",
+               (unsigned)(c - g_clients), (unsigned)p->tot_len, (unsigned)p->len);
 
     if (g_rx_cb == NULL || !g_tcps_rx_task_started) {
         tcp_recved(tpcb, p->tot_len);
@@ -490,7 +714,7 @@ static err_t tcp_server_recv_callback (void *arg,
         return (g_rx_cb == NULL) ? ERR_ARG : ERR_OK;
     }
 
-    if (!tcp_server_rxq_push(tpcb, p, g_client_gen)) {
+    if (!tcp_server_rxq_push(c, p, c->gen)) {
         /* do not free p: let lwIP keep it and re-call us later */
         tcps_debug("RXQ full");
         return ERR_MEM;
@@ -500,16 +724,21 @@ static err_t tcp_server_recv_callback (void *arg,
 }
 
 static void tcp_server_err_callback(void *arg, err_t err){
-    (void)arg;
+    tcp_server_client_t *c = (tcp_server_client_t *)arg;
     (void)err;
 
-    tcps_debug("ERR cb: err=%d client_pcb was=%p", (int)err, (void *)g_client_pcb);
+    tcps_debug("ERR cb: err=%d client=%p", (int)err, (void *)c);
 
-    g_client_pcb = NULL;
-    g_client_gen++;
+    /* pcb is already freed by lwIP */
+    if (c != NULL) {
+        c->pcb = NULL;
+        c->gen++;
+    }
 }
 
 static err_t tcp_server_accept_callback(void *arg, struct tcp_pcb *newpcb, err_t err){
+    tcp_server_client_t *c = NULL;
+    uint32_t i;
     (void)arg;
     (void)err;
 
@@ -521,15 +750,35 @@ static err_t tcp_server_accept_callback(void *arg, struct tcp_pcb *newpcb, err_t
         }
     }
 
-    if (g_client_pcb) {
+    for (i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        if (g_clients[i].pcb == NULL) {
+            c = &g_clients[i];
+            break;
+        }
+    }
+    if (c == NULL) {
+        tcps_debug("ACCEPT refused, %u clients connected", (unsigned)TCP_SERVER_MAX_CLIENTS);
         tcp_abort(newpcb);
         return ERR_ABRT;
     }
 
-    g_client_pcb = newpcb;
-    g_client_gen++;
+    /* whatever was queued for a previous client of the slot is stale */
+    lwrb_skip(&c->tx_rb, lwrb_get_full(&c->tx_rb));
+
+    c->addr      = *ip_2_ip4(&newpcb->remote_ip);
+    c->port      = newpcb->remote_port;
+    c->policy    = g_cfg.slow_policy;
+    c->kill      = false;
+    c->tx_frames = 0;
+    c->tx_drops  = 0;
+    c->rx_frames = 0;
+    c->gen++;
+    TCP_SERVER_BARRIER();
+    c->pcb = newpcb;
 
+    tcp_arg (newpcb, c);
     tcp_recv(newpcb, tcp_server_recv_callback);
+    tcp_sent(newpcb, tcp_server_sent_callback);
     tcp_err (newpcb, tcp_server_err_callback);
 
     return ERR_OK;
@@ -538,19 +787,30 @@ static err_t tcp_server_accept_callback(void *arg, struct tcp_pcb *newpcb, err_t
 int32_t tcp_server_init(tcp_server_rx_cb_t cb){
     struct tcp_pcb *pcb;
     err_t err;
+    uint32_t i;
     g_rx_cb = cb;
 
     tcp_server_config_load(&g_cfg);
     tcp_server_config_save(&g_cfg);
 
-    if (g_rx_cb != NULL) {
-        if (g_rx_pkg_buf == NULL) {
-            g_rx_pkg_buf = os_malloc(HALOW_MTU);
-            if (g_rx_pkg_buf == NULL) {
+    for (i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        tcp_server_client_t *c = &g_clients[i];
+
+        lwrb_init(&c->tx_rb, c->tx_rb_data, sizeof(c->tx_rb_data));
+
+        if ((g_rx_cb != NULL) && (c->frame_buf == NULL)) {
+            c->frame_buf = os_malloc(TCP_SERVER_FRAME_MAX);
+            if (c->frame_buf == NULL) {
                 tcps_debug("Out of memory while RX buff allocate\r\n");
                 return -3;
             }
+            deframer_init(&c->deframer, TCP_SERVER_FRAMING_MODE,
+                          c->frame_buf, TCP_SERVER_FRAME_MAX, HALOW_MTU,
+                          tcp_server_frame_cb, tcp_server_kiss_cmd_cb, c);
         }
+    }
+
+    if (g_rx_cb != NULL) {
         (void)tcp_server_rx_worker_init();
     }
 
@@ -585,7 +845,64 @@ int32_t tcp_server_init(tcp_server_rx_cb_t cb){
     return 0;
 }
 
-int32_t tcp_server_send(const uint8_t *data, uint32_t len){
+static uint32_t tcp_server_kiss_put(uint8_t *dst, uint8_t b){
+    if (b == DEFRAMER_KISS_FEND) {
+        dst[0] = DEFRAMER_KISS_FESC;
+        dst[1] = 0xDC;                  // TFEND
+        return 2;
+    }
+    if (b == DEFRAMER_KISS_FESC) {
+        dst[0] = DEFRAMER_KISS_FESC;
+        dst[1] = 0xDD;                  // TFESC
+        return 2;
+    }
+    dst[0] = b;
+    return 1;
+}
+
+static uint32_t tcp_server_rx_meta_frame(uint8_t *dst, const halow_rx_meta_t *meta, uint32_t len){
+    uint8_t raw[TCP_SERVER_RX_META_LEN];
+    uint32_t n = 0;
+    uint32_t i;
+
+    raw[0]  = TCP_SERVER_RX_META_VER;
+    raw[1]  = (uint8_t)meta->signal;
+    raw[2]  = (uint8_t)meta->evm;
+    raw[3]  = (uint8_t)((uint16_t)meta->freq_off >> 8);
+    raw[4]  = (uint8_t)meta->freq_off;
+    raw[5]  = meta->mcs;
+    raw[6]  = meta->bw;
+    memcpy(&raw[7], meta->src, 6);
+    raw[13] = (uint8_t)(len >> 8);
+    raw[14] = (uint8_t)len;
+
+    dst[n++] = DEFRAMER_KISS_FEND;
+    dst[n++] = TCP_SERVER_KISS_CMD_RX_META;
+    for (i = 0; i < sizeof(raw); i++) {
+        n += tcp_server_kiss_put(&dst[n], raw[i]);
+    }
+    dst[n++] = DEFRAMER_KISS_FEND;
+    return n;
+}
+
+/*
+ * Fans the frame out to every connected client, each through its own queue:
+ * a client that does not keep up only loses its own frames (or is closed,
+ * per its slow-consumer policy) and never holds back the others.
+ *
+ * With rx_meta enabled the link metrics go in front of the frame for clients
+ * that talk KISS (mode locked from their stream or forced by
+ * TCP_SERVER_FRAMING_MODE). HDLC and raw streams have no command frames, there
+ * the data goes out alone.
+ */
+int32_t tcp_server_send_rx(const uint8_t *data, uint32_t len, const halow_rx_meta_t *meta){
+    uint8_t hdr[TCP_SERVER_RX_META_FRAME_MAX];
+    uint32_t hdr_len = 0;
+    bool any = false;
+    bool queued = false;
+    bool wake = false;
+    uint32_t i;
+
     if (!data) {
         return -1;
     }
@@ -595,24 +912,61 @@ int32_t tcp_server_send(const uint8_t *data, uint32_t len){
     if (len > TCP_SERVER_MTU) {
         return -2;
     }
-    if (!g_client_pcb) {
-        return -3;
-    }
 
-    struct tcp_tx_package *tx_package = os_malloc(sizeof(struct tcp_tx_package) + len);
-    if (tx_package == NULL) {
-        return -4;
-    }
+    for (i = 0; i < TCP_SERVER_MAX_CLIENTS; i++) {
+        tcp_server_client_t *c = &g_clients[i];
+        uint32_t c_hdr_len = 0;
+
+        if ((c->pcb == NULL) || c->kill) {
+            continue;
+        }
+        any = true;
+
+        /* mode is only meaningful once the worker has seen this connection */
+        if ((meta != NULL) && g_cfg.rx_meta &&
+            (c->deframer_gen == c->gen) && (c->deframer.mode == DEFRAMER_MODE_KISS)) {
+            if (hdr_len == 0) {
+                hdr_len = tcp_server_rx_meta_frame(hdr, meta, len);
+            }
+            c_hdr_len = hdr_len;
+        }
 
+        /* both or nothing, a metadata frame must never describe the wrong data */
+        if (lwrb_get_free(&c->tx_rb) < c_hdr_len + len) {
+            c->tx_drops++;
+            g_tx_stat.drop_full++;
+            if (c->policy == TCP_SERVER_SLOW_CLOSE) {
+                c->kill = true;
+                wake = true;
+            }
+            continue;
+        }
+        if (c_hdr_len != 0) {
+            (void)lwrb_write(&c->tx_rb, hdr, c_hdr_len);
+            g_tx_stat.meta_frames++;
+        }
+        (void)lwrb_write(&c->tx_rb, data, len);
+        c->tx_frames++;
+        queued = true;
+    }
 
-    tx_package->pcb = g_client_pcb;
-    tx_package->len = (uint16_t)len;
-    memcpy(tx_package->data, data, len);
+    if (!any) {
+        g_tx_stat.drop_no_client++;
+        return -3;
+    }
+    if (queued) {
+        g_tx_stat.frames++;
+    }
 
-    if (tcpip_try_callback(tcp_server_send_callback, tx_package) != ERR_OK) {
-        os_free(tx_package);
-        return -4;
+    TCP_SERVER_BARRIER();
+    if ((queued || wake) && !g_tx_drain_pending) {
+        g_tx_drain_pending = 1;
+        if (tcpip_try_callback(tcp_server_tx_drain_cb, NULL) != ERR_OK) {
+            /* data stays queued, next frame or tcp_sent retries */
+            g_tx_drain_pending = 0;
+            g_tx_stat.wakeup_fail++;
+        }
     }
 
-    return 0;
+    return queued ? 0 : -4;
 }
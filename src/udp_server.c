@@ -0,0 +1,597 @@
+#include "udp_server.h"
+
+#include "lwip/udp.h"
+#include "lwip/tcpip.h"
+#include "sys_config.h"
+#include "configdb.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/ip_addr.h"
+#include "lib/lwrb/lwrb.h"
+#include "utils.h"
+#include <string.h>
+
+//#define UDP_SERVER_DEBUG
+
+#ifdef UDP_SERVER_DEBUG
+#define udps_debug(fmt, ...)  os_printf("[UDPS] " fmt "\r\n", ##__VA_ARGS__)
+#else
+#define udps_debug(fmt, ...)  do { } while (0)
+#endif
+
+#ifndef UDP_SERVER_CONFIG_PREFIX
+#define UDP_SERVER_CONFIG_PREFIX                    CONFIGDB_ADD_MODULE("udps")
+#define UDP_SERVER_CONFIG_ADD_CONFIG(name)          UDP_SERVER_CONFIG_PREFIX "." name
+
+#define UDP_SERVER_CONFIG_ENABLED_NAME              UDP_SERVER_CONFIG_ADD_CONFIG("enabled")
+#define UDP_SERVER_CONFIG_PORT_NAME                 UDP_SERVER_CONFIG_ADD_CONFIG("port")
+#define UDP_SERVER_CONFIG_MCAST_IP_NAME             UDP_SERVER_CONFIG_ADD_CONFIG("mc_ip")
+#define UDP_SERVER_CONFIG_MCAST_PORT_NAME           UDP_SERVER_CONFIG_ADD_CONFIG("mc_port")
+#define UDP_SERVER_CONFIG_SEQ_NAME                  UDP_SERVER_CONFIG_ADD_CONFIG("seq")
+#endif
+
+#ifndef UDP_SERVER_MAX_PEERS
+#define UDP_SERVER_MAX_PEERS                 4
+#endif
+
+#ifndef UDP_SERVER_PEER_TIMEOUT_MS
+#define UDP_SERVER_PEER_TIMEOUT_MS           (60 * 1000)
+#endif
+
+/* Same limit as a frame accepted by the TCP modem */
+#ifndef UDP_SERVER_FRAME_MAX
+#define UDP_SERVER_FRAME_MAX                 (2 * HALOW_MTU + 3)
+#endif
+
+/* Host -> radio queue: filled in the tcpip thread, emptied by the TX worker (radio TX may block) */
+#ifndef UDP_SERVER_RX_RING_SIZE
+#define UDP_SERVER_RX_RING_SIZE              (4 * 1024)
+#endif
+
+/* Radio -> host queue: filled by the LMAC RX context, sent from the tcpip thread */
+#ifndef UDP_SERVER_TX_RING_SIZE
+#define UDP_SERVER_TX_RING_SIZE              (4 * 1024)
+#endif
+
+#ifndef UDP_SERVER_TASK_STACK
+#define UDP_SERVER_TASK_STACK                2048
+#endif
+
+#ifndef UDP_SERVER_TASK_PRIO
+#define UDP_SERVER_TASK_PRIO                 20
+#endif
+
+#ifndef UDP_SERVER_BARRIER
+#define UDP_SERVER_BARRIER()                 __sync_synchronize()
+#endif
+
+#define UDP_SERVER_SEQ_LEN                   2
+#define UDP_SERVER_REC_HDR                   2      // ring record: u16 length, then the frame
+
+typedef struct {
+    ip4_addr_t addr;
+    uint16_t port;                      // 0: slot free
+    bool seq_valid;
+    uint16_t seq_last;
+    int64_t last_ms;
+    uint32_t frames;
+    uint32_t lost;
+    uint32_t dup;
+    uint32_t late;
+} udp_server_peer_t;
+
+static struct udp_pcb *g_pcb;
+static udp_server_config_t g_cfg;
+static udp_server_rx_cb_t g_rx_cb;
+static udp_server_peer_t g_peers[UDP_SERVER_MAX_PEERS];
+static volatile uint32_t g_peers_used;
+static uint16_t g_tx_seq;
+
+/* Both rings and g_frame_buf are allocated on the first enable, the server is off by default */
+static lwrb_t g_rx_rb;
+static lwrb_t g_tx_rb;
+static uint8_t *g_rb_data;
+static volatile uint32_t g_tx_drain_pending;
+static udp_server_stat_t g_stat;
+
+static struct os_semaphore g_rx_sem;
+static struct os_task g_udps_task;
+static bool g_udps_task_started;
+static uint8_t *g_frame_buf;
+
+void udp_server_config_load(udp_server_config_t *cfg){
+    int8_t enabled;
+    int8_t seq;
+    int16_t port;
+    int16_t mcast_port;
+    int32_t mcast_ip;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    cfg->enabled = UDP_SERVER_CONFIG_ENABLED_DEF ? true : false;
+    cfg->port = UDP_SERVER_CONFIG_PORT_DEF;
+    cfg->mcast_ip.addr = (uint32_t)UDP_SERVER_CONFIG_MCAST_IP_DEF;
+    cfg->mcast_port = UDP_SERVER_CONFIG_MCAST_PORT_DEF;
+    cfg->seq = UDP_SERVER_CONFIG_SEQ_DEF ? true : false;
+
+    if (configdb_get_i8(UDP_SERVER_CONFIG_ENABLED_NAME, &enabled) == 0) {
+        cfg->enabled = enabled ? true : false;
+    }
+    if (configdb_get_i16(UDP_SERVER_CONFIG_PORT_NAME, &port) == 0) {
+        cfg->port = (uint16_t)port;
+    }
+    if (configdb_get_i32(UDP_SERVER_CONFIG_MCAST_IP_NAME, &mcast_ip) == 0) {
+        cfg->mcast_ip.addr = (uint32_t)mcast_ip;
+    }
+    if (configdb_get_i16(UDP_SERVER_CONFIG_MCAST_PORT_NAME, &mcast_port) == 0) {
+        cfg->mcast_port = (uint16_t)mcast_port;
+    }
+    if (configdb_get_i8(UDP_SERVER_CONFIG_SEQ_NAME, &seq) == 0) {
+        cfg->seq = seq ? true : false;
+    }
+}
+
+void udp_server_config_save(const udp_server_config_t *cfg){
+    int8_t enabled;
+    int8_t seq;
+    int16_t port;
+    int16_t mcast_port;
+    int32_t mcast_ip;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    enabled = cfg->enabled ? 1 : 0;
+    port = (int16_t)cfg->port;
+    mcast_ip = (int32_t)cfg->mcast_ip.addr;
+    mcast_port = (int16_t)cfg->mcast_port;
+    seq = cfg->seq ? 1 : 0;
+
+    configdb_set_i8(UDP_SERVER_CONFIG_ENABLED_NAME, &enabled);
+    configdb_set_i16(UDP_SERVER_CONFIG_PORT_NAME, &port);
+    configdb_set_i32(UDP_SERVER_CONFIG_MCAST_IP_NAME, &mcast_ip);
+    configdb_set_i16(UDP_SERVER_CONFIG_MCAST_PORT_NAME, &mcast_port);
+    configdb_set_i8(UDP_SERVER_CONFIG_SEQ_NAME, &seq);
+}
+
+/* tcpip thread: sender's slot, a free or the least recently heard one is taken over */
+static udp_server_peer_t *udp_server_peer_get(const ip4_addr_t *addr, uint16_t port, int64_t now){
+    udp_server_peer_t *victim = NULL;
+    uint32_t used = 0;
+    uint32_t i;
+
+    for (i = 0; i < UDP_SERVER_MAX_PEERS; i++) {
+        udp_server_peer_t *pr = &g_peers[i];
+
+        if ((pr->port != 0) && (now - pr->last_ms >= UDP_SERVER_PEER_TIMEOUT_MS)) {
+            pr->port = 0;
+        }
+        if (pr->port == 0) {
+            if ((victim == NULL) || (victim->port != 0)) {
+                victim = pr;
+            }
+            continue;
+        }
+        used++;
+        if ((pr->port == port) && ip4_addr_cmp(&pr->addr, addr)) {
+            g_peers_used = used;
+            return pr;
+        }
+        if ((victim == NULL) || ((victim->port != 0) && (pr->last_ms < victim->last_ms))) {
+            victim = pr;
+        }
+    }
+
+    if (victim->port == 0) {
+        used++;
+    }
+    memset(victim, 0, sizeof(*victim));
+    ip4_addr_copy(victim->addr, *addr);
+    victim->port = port;
+    g_peers_used = used;
+    udps_debug("peer %s:%u", ip4addr_ntoa(addr), (unsigned)port);
+    return victim;
+}
+
+/* false: duplicate, drop it */
+static bool udp_server_peer_seq( udp_server_peer_t *pr, uint16_t seq ){
+    uint16_t diff;
+
+    if (!pr->seq_valid) {
+        pr->seq_valid = true;
+        pr->seq_last  = seq;
+        return true;
+    }
+
+    diff = (uint16_t)(seq - pr->seq_last);
+    if (diff == 0) {
+        pr->dup++;
+        return false;
+    }
+    if (diff < 0x8000u) {
+        pr->lost += (uint32_t)(diff - 1u);
+        pr->seq_last = seq;
+    } else {
+        /* arrived after a newer one: a counted gap was only a reordering */
+        pr->late++;
+        if (pr->lost != 0) {
+            pr->lost--;
+        }
+    }
+    return true;
+}
+
+static void udp_server_recv_cb( void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                                const ip_addr_t *addr, u16_t port ){
+    udp_server_peer_t *pr;
+    uint32_t off = 0;
+    uint32_t len;
+    uint16_t hdr;
+    struct pbuf *q;
+    (void)arg;
+    (void)pcb;
+
+    if (p == NULL) {
+        return;
+    }
+    if ((addr == NULL) || !IP_IS_V4(addr)) {
+        pbuf_free(p);
+        return;
+    }
+
+    pr = udp_server_peer_get(ip_2_ip4(addr), port, get_time_ms());
+    pr->last_ms = get_time_ms();
+
+    if (g_cfg.seq) {
+        uint8_t s[UDP_SERVER_SEQ_LEN];
+
+        if (pbuf_copy_partial(p, s, sizeof(s), 0) != sizeof(s)) {
+            pbuf_free(p);               // keepalive
+            return;
+        }
+        if (!udp_server_peer_seq(pr, (uint16_t)((s[0] << 8) | s[1]))) {
+            pbuf_free(p);
+            return;
+        }
+        off = UDP_SERVER_SEQ_LEN;
+    }
+
+    len = (uint32_t)p->tot_len - off;
+    if (len == 0) {
+        pbuf_free(p);                   // keepalive
+        return;
+    }
+    if (len > UDP_SERVER_FRAME_MAX) {
+        g_stat.rx_drop_size++;
+        pbuf_free(p);
+        return;
+    }
+    if (lwrb_get_free(&g_rx_rb) < UDP_SERVER_REC_HDR + len) {
+        g_stat.rx_drop_full++;
+        pbuf_free(p);
+        return;
+    }
+
+    /* datagrams are never held back: late frames are worse than lost ones */
+    hdr = (uint16_t)len;
+    (void)lwrb_write(&g_rx_rb, &hdr, sizeof(hdr));
+    for (q = p; (q != NULL) && (len != 0); q = q->next) {
+        uint32_t n = q->len;
+
+        if (off >= n) {
+            off -= n;
+            continue;
+        }
+        n -= off;
+        if (n > len) {
+            n = len;
+        }
+        (void)lwrb_write(&g_rx_rb, (const uint8_t *)q->payload + off, n);
+        len -= n;
+        off = 0;
+    }
+    pr->frames++;
+    pbuf_free(p);
+
+    (void)os_sema_up(&g_rx_sem);
+}
+
+/* Radio TX waits for TX queue space, so it runs here and not in the tcpip thread */
+static void udp_server_task( void *arg ){
+    (void)arg;
+
+    while (1) {
+        uint16_t len;
+
+        if (lwrb_peek(&g_rx_rb, 0, &len, sizeof(len)) != sizeof(len)) {
+            (void)os_sema_down(&g_rx_sem, 1000);
+            continue;
+        }
+        UDP_SERVER_BARRIER();
+        if (lwrb_get_full(&g_rx_rb) < (lwrb_sz_t)(sizeof(len) + len)) {
+            (void)os_sema_down(&g_rx_sem, 1);
+            continue;
+        }
+
+        lwrb_skip(&g_rx_rb, sizeof(len));
+        (void)lwrb_read(&g_rx_rb, g_frame_buf, len);
+
+        if ((g_rx_cb != NULL) && (g_rx_cb(g_frame_buf, len) == 0)) {
+            g_stat.rx_frames++;
+        }
+    }
+}
+
+/* The frame at the ring head as a fresh datagram: udp_sendto() prepends its headers in place */
+static void udp_server_sendto( uint16_t len, const ip4_addr_t *addr, uint16_t port ){
+    uint32_t hlen = g_cfg.seq ? UDP_SERVER_SEQ_LEN : 0;
+    ip_addr_t dst;
+    struct pbuf *p;
+
+    p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(hlen + len), PBUF_RAM);
+    if (p == NULL) {
+        g_stat.tx_send_err++;
+        return;
+    }
+    if (hlen != 0) {
+        ((uint8_t *)p->payload)[0] = (uint8_t)(g_tx_seq >> 8);
+        ((uint8_t *)p->payload)[1] = (uint8_t)g_tx_seq;
+    }
+    (void)lwrb_peek(&g_tx_rb, UDP_SERVER_REC_HDR, (uint8_t *)p->payload + hlen, len);
+
+    ip_addr_copy_from_ip4(dst, *addr);
+    if (udp_sendto(g_pcb, p, &dst, port) != ERR_OK) {
+        g_stat.tx_send_err++;
+    }
+    pbuf_free(p);
+}
+
+/* tcpip thread: one datagram per queued frame, to the group or to every active sender */
+static void udp_server_tx_drain( void ){
+    int64_t now = get_time_ms();
+
+    while (1) {
+        uint16_t len;
+        uint32_t i;
+
+        if (lwrb_peek(&g_tx_rb, 0, &len, sizeof(len)) != sizeof(len)) {
+            break;
+        }
+        if (lwrb_get_full(&g_tx_rb) < (lwrb_sz_t)(sizeof(len) + len)) {
+            break;
+        }
+
+        if (g_pcb == NULL) {
+            /* disabled meanwhile */
+        } else if (g_cfg.mcast_ip.addr != 0) {
+            udp_server_sendto(len, &g_cfg.mcast_ip, g_cfg.mcast_port);
+        } else {
+            for (i = 0; i < UDP_SERVER_MAX_PEERS; i++) {
+                const udp_server_peer_t *pr = &g_peers[i];
+
+                if ((pr->port != 0) && (now - pr->last_ms < UDP_SERVER_PEER_TIMEOUT_MS)) {
+                    udp_server_sendto(len, &pr->addr, pr->port);
+                }
+            }
+        }
+
+        lwrb_skip(&g_tx_rb, sizeof(len) + len);
+        g_tx_seq++;
+    }
+}
+
+static void udp_server_tx_drain_cb( void *arg ){
+    (void)arg;
+
+    g_tx_drain_pending = 0;
+    UDP_SERVER_BARRIER();
+    udp_server_tx_drain();
+}
+
+/* Single producer (radio RX path): never blocks, never allocates */
+int32_t udp_server_send(const uint8_t *data, uint32_t len){
+    uint16_t hdr;
+
+    if (!data) {
+        return -1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    if (len > UDP_SERVER_FRAME_MAX) {
+        return -2;
+    }
+    if (!g_cfg.enabled || (g_pcb == NULL) ||
+        ((g_cfg.mcast_ip.addr == 0) && (g_peers_used == 0))) {
+        g_stat.tx_drop_no_peer++;
+        return -3;
+    }
+
+    if (lwrb_get_free(&g_tx_rb) < UDP_SERVER_REC_HDR + len) {
+        g_stat.tx_drop_full++;
+        return -4;
+    }
+    hdr = (uint16_t)len;
+    (void)lwrb_write(&g_tx_rb, &hdr, sizeof(hdr));
+    (void)lwrb_write(&g_tx_rb, data, len);
+    g_stat.tx_frames++;
+
+    UDP_SERVER_BARRIER();
+    if (!g_tx_drain_pending) {
+        g_tx_drain_pending = 1;
+        if (tcpip_try_callback(udp_server_tx_drain_cb, NULL) != ERR_OK) {
+            /* data stays queued, next frame retries */
+            g_tx_drain_pending = 0;
+            g_stat.wakeup_fail++;
+        }
+    }
+
+    return 0;
+}
+
+/* tcpip thread, before the first pcb exists: nothing touches the rings yet */
+static int32_t udp_server_bufs_alloc( void ){
+    if (g_rb_data != NULL) {
+        return 0;
+    }
+
+    g_rb_data = (uint8_t *)os_malloc(UDP_SERVER_RX_RING_SIZE + UDP_SERVER_TX_RING_SIZE + UDP_SERVER_FRAME_MAX);
+    if (g_rb_data == NULL) {
+        return -1;
+    }
+    g_frame_buf = g_rb_data + UDP_SERVER_RX_RING_SIZE + UDP_SERVER_TX_RING_SIZE;
+    lwrb_init(&g_rx_rb, g_rb_data, UDP_SERVER_RX_RING_SIZE);
+    lwrb_init(&g_tx_rb, g_rb_data + UDP_SERVER_RX_RING_SIZE, UDP_SERVER_TX_RING_SIZE);
+    UDP_SERVER_BARRIER();
+    return 0;
+}
+
+static void udp_server_apply_cb(void *arg){
+    udp_server_config_t *cfg = (udp_server_config_t *)arg;
+    struct udp_pcb *pcb;
+    err_t err;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    if (g_pcb != NULL) {
+        udp_remove(g_pcb);
+        g_pcb = NULL;
+    }
+
+    memset(g_peers, 0, sizeof(g_peers));
+    g_peers_used = 0;
+    g_cfg = *cfg;
+
+    if (!g_cfg.enabled) {
+        udps_debug("APPLY(disabled)");
+        goto end;
+    }
+
+    if (udp_server_bufs_alloc() != 0) {
+        udps_debug("APPLY rings OOM");
+        goto end;
+    }
+
+    pcb = udp_new();
+    if (pcb == NULL) {
+        udps_debug("APPLY udp_new OOM");
+        goto end;
+    }
+
+    err = udp_bind(pcb, IP_ADDR_ANY, g_cfg.port);
+    if (err != ERR_OK) {
+        udps_debug("APPLY bind port=%u err=%d", (unsigned)g_cfg.port, (int)err);
+        udp_remove(pcb);
+        goto end;
+    }
+
+    udp_recv(pcb, udp_server_recv_cb, NULL);
+    g_pcb = pcb;
+    udps_debug("APPLY(ok) port=%u", (unsigned)g_cfg.port);
+
+end:
+    os_free(cfg);
+}
+
+void udp_server_config_apply(const udp_server_config_t *cfg){
+    udp_server_config_t *copy;
+
+    if (cfg == NULL) {
+        return;
+    }
+
+    copy = (udp_server_config_t *)os_malloc(sizeof(*copy));
+    if (copy == NULL) {
+        udps_debug("APPLY arg OOM");
+        return;
+    }
+
+    *copy = *cfg;
+
+    if (tcpip_try_callback(udp_server_apply_cb, copy) != ERR_OK) {
+        os_free(copy);
+        udps_debug("APPLY tcpip_try_callback failed");
+        return;
+    }
+}
+
+uint32_t udp_server_get_peers( udp_server_peer_info_t *out, uint32_t max ){
+    int64_t now = get_time_ms();
+    uint32_t n = 0;
+    uint32_t i;
+
+    for (i = 0; (i < UDP_SERVER_MAX_PEERS) && (n < max); i++) {
+        udp_server_peer_t pr = g_peers[i];
+
+        if ((pr.port == 0) || (now - pr.last_ms >= UDP_SERVER_PEER_TIMEOUT_MS)) {
+            continue;
+        }
+        if (out != NULL) {
+            out[n].addr   = pr.addr;
+            out[n].port   = pr.port;
+            out[n].age_ms = (now > pr.last_ms) ? (uint32_t)(now - pr.last_ms) : 0;
+            out[n].frames = pr.frames;
+            out[n].lost   = pr.lost;
+            out[n].dup    = pr.dup;
+            out[n].late   = pr.late;
+        }
+        n++;
+    }
+    return n;
+}
+
+udp_server_stat_t udp_server_stat_get( void ){
+    return g_stat;
+}
+
+static int32_t udp_server_task_init( void ){
+    int32_t ret;
+
+    if (g_udps_task_started) {
+        return 0;
+    }
+
+    (void)os_sema_init(&g_rx_sem, 0);
+
+    ret = os_task_init((const uint8 *)"udps", &g_udps_task, udp_server_task, 0);
+    udps_debug("os_task_init -> %d", (int)ret);
+    if (ret != 0) {
+        return ret;
+    }
+
+    ret = os_task_set_stacksize(&g_udps_task, UDP_SERVER_TASK_STACK);
+    udps_debug("os_task_set_stacksize -> %d", (int)ret);
+
+    ret = os_task_set_priority(&g_udps_task, UDP_SERVER_TASK_PRIO);
+    udps_debug("os_task_set_priority -> %d", (int)ret);
+
+    ret = os_task_run(&g_udps_task);
+    udps_debug("os_task_run -> %d", (int)ret);
+    if (ret == 0) {
+        g_udps_task_started = true;
+    }
+    return ret;
+}
+
+int32_t udp_server_init(udp_server_rx_cb_t cb){
+    udp_server_config_t cfg;
+    int32_t ret;
+
+    g_rx_cb = cb;
+
+    udp_server_config_load(&cfg);
+    udp_server_config_save(&cfg);
+
+    ret = udp_server_task_init();
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* pcb is set up in the tcpip thread like every later reconfiguration */
+    udp_server_config_apply(&cfg);
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deframer.h"
+#include "halow.h"
+#include "lib/lmac/ieee802_11_defs.h"
+#include "lib/skb/skb.h"
+#include "sys_config.h"
+#include "utils.h"
+
+/*
+ * TCP stream -> skb, old path against the current one. The stream holds HDLC
+ * frames and arrives as TCP_MSS sized pbufs in chains of BENCH_CHAIN.
+ *
+ * old: pbufs fed one by one, a frame spanning pbufs is assembled in frame_buf,
+ *      then halow_tx() built the header on the stack and copied header and
+ *      frame into the skb (the code before the gather API).
+ * new: the chain is fed at once, a spanning frame comes out as pieces of the
+ *      pbufs and is gathered into the skb like halow_tx_iov() does.
+ *
+ * Both sides run the real deframer and allocate a skb per frame. The TX queue
+ * and the LMAC are left out, they are the same for both.
+ */
+
+#define BENCH_MSS           1460
+#define BENCH_CHAIN         4
+#define BENCH_STREAM        (BENCH_MSS * BENCH_CHAIN * 64)
+#define BENCH_ROUNDS        50
+#define BENCH_HEADROOM      16
+#define BENCH_TAILROOM      4
+#define BENCH_FRAME_MAX     (2 * HALOW_MTU + 3)
+
+typedef struct {
+    uint8_t *dbuf;              // Deframer assembly buffer
+    struct ieee80211_hdr tx_hdr;
+    uint16_t seq;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t copied;            // Frame bytes moved by memcpy, deframer included
+} bench_t;
+
+static uint8_t g_stream[BENCH_STREAM];
+static uint32_t g_stream_len;
+
+static void bench_skb_done(struct sk_buff *skb){
+    /* keeps the copies from being optimised away */
+    if (skb->data[skb->len - 1] != 0x7E) {
+        abort();
+    }
+    kfree_skb(skb);
+}
+
+/* halow_tx() before the gather API */
+static void bench_old_tx(bench_t *b, const uint8_t *data, uint32_t len){
+    struct ieee80211_hdr hdr;
+    struct sk_buff *skb;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.frame_control = (uint16_t)(WLAN_FTYPE_DATA | WLAN_STYPE_DATA);
+    memset(hdr.addr1, 0xff, 6);
+    memset(hdr.addr2, 0xff, 6);
+    memset(hdr.addr3, 0xff, 6);
+    b->seq++;
+    hdr.seq_ctrl = (uint16_t)((b->seq & 0x0fff) << 4);
+
+    skb = alloc_tx_skb(BENCH_HEADROOM + sizeof(hdr) + len + BENCH_TAILROOM);
+    skb_reserve(skb, BENCH_HEADROOM);
+    memcpy(skb_put(skb, sizeof(hdr)), &hdr, sizeof(hdr));
+    memcpy(skb_put(skb, len), data, len);
+    b->copied += len;
+    bench_skb_done(skb);
+}
+
+/* Head of a spanning frame that the deframer copied when its segment was done */
+static void bench_count_head(bench_t *b, const deframer_seg_t *seg){
+    if (seg[0].data == b->dbuf) {
+        b->copied += seg[0].len;
+    }
+}
+
+/* Old deframer output: the closing piece was appended to the buffered head */
+static void bench_old_frame(void *arg, const deframer_seg_t *seg, uint32_t cnt, uint32_t len){
+    bench_t *b = (bench_t *)arg;
+    const uint8_t *data = seg[0].data;
+
+    bench_count_head(b, seg);
+    if (cnt > 1) {
+        uint32_t off = seg[0].len;
+
+        for (uint32_t i = 1; i < cnt; i++) {
+            memcpy(b->dbuf + off, seg[i].data, seg[i].len);
+            off += seg[i].len;
+        }
+        b->copied += len - seg[0].len;
+        data = b->dbuf;
+    }
+    bench_old_tx(b, data, len);
+    b->frames++;
+    b->bytes += len;
+}
+
+/* halow_tx_iov() without the queue */
+static void bench_new_frame(void *arg, const deframer_seg_t *seg, uint32_t cnt, uint32_t len){
+    bench_t *b = (bench_t *)arg;
+    struct ieee80211_hdr *hdr;
+    struct sk_buff *skb;
+
+    bench_count_head(b, seg);
+    skb = alloc_tx_skb(BENCH_HEADROOM + sizeof(*hdr) + len + BENCH_TAILROOM);
+    skb_reserve(skb, BENCH_HEADROOM);
+    hdr = (struct ieee80211_hdr *)skb_put(skb, sizeof(*hdr));
+    *hdr = b->tx_hdr;
+    b->seq++;
+    hdr->seq_ctrl = (uint16_t)((b->seq & 0x0fff) << 4);
+    for (uint32_t i = 0; i < cnt; i++) {
+        memcpy(skb_put(skb, seg[i].len), seg[i].data, seg[i].len);
+    }
+    b->copied += len;
+    bench_skb_done(skb);
+    b->frames++;
+    b->bytes += len;
+}
+
+static void bench_stream_make(uint32_t frame_len){
+    uint32_t n = 0;
+    uint32_t seed = 0x5EED;
+
+    while (n + frame_len + 1 <= sizeof(g_stream)) {
+        g_stream[n++] = 0x7E;
+        for (uint32_t i = 0; i < frame_len - 2; i++) {
+            uint8_t v;
+
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            v = (uint8_t)seed;
+            g_stream[n++] = (v == 0x7E) ? 0x7D : v;
+        }
+    }
+    g_stream[n++] = 0x7E;
+    g_stream_len = n;
+}
+
+static void bench_feed(deframer_t *d, bool chain){
+    deframer_seg_t seg[BENCH_CHAIN];
+    uint32_t off = 0;
+
+    while (off < g_stream_len) {
+        uint32_t cnt = 0;
+
+        while ((cnt < BENCH_CHAIN) && (off < g_stream_len)) {
+            seg[cnt].data = g_stream + off;
+            seg[cnt].len  = (g_stream_len - off < BENCH_MSS) ? (g_stream_len - off) : BENCH_MSS;
+            off += seg[cnt].len;
+            cnt++;
+        }
+        if (chain) {
+            deframer_feed_segs(d, seg, cnt);
+        } else {
+            for (uint32_t i = 0; i < cnt; i++) {
+                deframer_feed(d, seg[i].data, seg[i].len);
+            }
+        }
+    }
+}
+
+static void bench_run(const char *name, uint32_t frame_len, bool new_path){
+    static bench_t b;
+    static uint8_t buf[BENCH_FRAME_MAX];
+    deframer_t d;
+    int64_t t0;
+    int64_t us;
+
+    memset(&b, 0, sizeof(b));
+    b.dbuf = buf;
+    b.tx_hdr.frame_control = (uint16_t)(WLAN_FTYPE_DATA | WLAN_STYPE_DATA);
+    memset(b.tx_hdr.addr1, 0xff, 6);
+    memset(b.tx_hdr.addr2, 0xff, 6);
+    memset(b.tx_hdr.addr3, 0xff, 6);
+    deframer_init(&d, DEFRAMER_MODE_HDLC, buf, sizeof(buf), HALOW_MTU,
+                  new_path ? bench_new_frame : bench_old_frame, NULL, &b);
+
+    bench_feed(&d, new_path);             // warm up
+    b.frames = 0;
+    b.bytes  = 0;
+    b.copied = 0;
+
+    t0 = get_time_us();
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++) {
+        bench_feed(&d, new_path);
+    }
+    us = get_time_us() - t0;
+    if (us <= 0) {
+        us = 1;
+    }
+
+    printf("%s frame %4u B: %8.1f ns/frame %8.1f MB/s, %.2f copies per byte\n",
+           name, (unsigned)frame_len,
+           (double)us * 1000.0 / (double)b.frames,
+           (double)b.bytes / (double)us,
+           (double)b.copied / (double)b.bytes);
+}
+
+int main(void){
+    static const uint32_t lens[] = { 64, 256, 512, 1027 };
+
+    printf("TCP stream in %u B pbufs, chains of %u, %u rounds\n",
+           (unsigned)BENCH_MSS, (unsigned)BENCH_CHAIN, (unsigned)BENCH_ROUNDS);
+    for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        bench_stream_make(lens[i]);
+        bench_run("old", lens[i], false);
+        bench_run("new", lens[i], true);
+    }
+    return 0;
+}
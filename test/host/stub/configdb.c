@@ -0,0 +1,17 @@
+#include "configdb.h"
+
+/* Empty database: every get leaves the caller's default, every set is accepted */
+
+int32_t configdb_get_i32(const char *key, int32_t *paramp){ (void)key; (void)paramp; return -1; }
+int32_t configdb_set_i32(const char *key, int32_t *paramp){ (void)key; (void)paramp; return 0; }
+int32_t configdb_get_set_i32(const char *key, int32_t *paramp){ (void)key; (void)paramp; return 0; }
+
+int32_t configdb_get_i16(const char *key, int16_t *paramp){ (void)key; (void)paramp; return -1; }
+int32_t configdb_set_i16(const char *key, const int16_t *paramp){ (void)key; (void)paramp; return 0; }
+int32_t configdb_get_set_i16(const char *key, int16_t *paramp){ (void)key; (void)paramp; return 0; }
+
+int32_t configdb_get_i8(const char *key, int8_t *paramp){ (void)key; (void)paramp; return -1; }
+int32_t configdb_set_i8(const char *key, const int8_t *paramp){ (void)key; (void)paramp; return 0; }
+int32_t configdb_get_set_i8(const char *key, int8_t *paramp){ (void)key; (void)paramp; return 0; }
+
+int32_t configdb_init(void){ return 0; }
@@ -0,0 +1,6 @@
+#ifndef __HOST_FDB_DEF_H_
+#define __HOST_FDB_DEF_H_
+
+/* inc/configdb.h only needs the include to resolve, see stub/configdb.c */
+
+#endif // __HOST_FDB_DEF_H_
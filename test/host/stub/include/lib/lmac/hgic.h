@@ -0,0 +1,19 @@
+#ifndef __HOST_HGIC_H_
+#define __HOST_HGIC_H_
+
+#include "typesdef.h"
+
+struct hgic_rx_info {
+    uint8  band;
+    uint8  mcs: 4, bw: 4;
+    int8   evm;
+    int8   signal;
+    uint16 freq;
+    int16  freq_off;
+    uint8  rx_flags;
+    uint8  antenna: 4, moredata: 1, rev: 3;
+    uint8  vht_nss : 4, s1g_nss : 4;
+    uint8  vht_flag : 3, s1g_flag : 5;
+};
+
+#endif // __HOST_HGIC_H_
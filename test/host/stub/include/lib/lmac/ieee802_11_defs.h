@@ -0,0 +1,21 @@
+#ifndef __HOST_IEEE802_11_DEFS_H_
+#define __HOST_IEEE802_11_DEFS_H_
+
+#include "typesdef.h"
+
+#define WLAN_FTYPE_MGMT     0x0000
+#define WLAN_FTYPE_CTRL     0x0004
+#define WLAN_FTYPE_DATA     0x0008
+
+#define WLAN_STYPE_DATA     0x0000
+
+struct ieee80211_hdr {
+    le16 frame_control;
+    le16 duration_id;
+    u8 addr1[6];
+    u8 addr2[6];
+    u8 addr3[6];
+    le16 seq_ctrl;
+} __attribute__((packed));
+
+#endif // __HOST_IEEE802_11_DEFS_H_
@@ -0,0 +1,97 @@
+#ifndef __HOST_LMAC_DEF_H_
+#define __HOST_LMAC_DEF_H_
+
+/*
+ * The part of lmac.h / lmac_def.h that halow.c uses. Every setter ends up in
+ * ops->ioctl(), the simulated LMAC in stub/lmac_sim.c records nothing of it.
+ */
+
+#include "typesdef.h"
+
+struct sk_buff;
+struct hgic_rx_info;
+
+#define LMAC_PHY_S1G                        0
+#define LMAC_RATE_SHORT_GI                  (1 << 24)
+#define LMAC_RATE_DEF(phy_type, nss, mcs, flags) \
+    ((((phy_type) & 0xF) << 28) | (((nss) & 0xF) << 16) | ((mcs) & 0xFF) | (flags))
+
+enum {
+    DSLEEP_MODE_NONE,
+};
+
+enum {
+    DSLEEP_WAIT_MODE_PS_CONNECT,
+};
+
+enum {
+    LMAC_IOCTL_SET_MAC_ADDR,
+    LMAC_IOCTL_SET_OTHER,
+};
+
+struct lmac_init_param {
+    uint32 rxbuf, rxbuf_size;
+    uint32 tdma_buff, tdma_buff_size;
+    uint8  uart_tx_io;
+    uint8  dual_ant;
+};
+
+struct lmac_ops {
+    void *priv;
+    void *btops;
+    uint8  headroom, tailroom;
+    uint16 radio_on : 1;
+    int32(*open)(struct lmac_ops *ops);
+    int32(*close)(struct lmac_ops *ops);
+    int32(*tx)(struct lmac_ops *ops, struct sk_buff *skb);
+    int32(*tx_status)(struct lmac_ops *ops, struct sk_buff *skb);
+    int32(*rx)(struct lmac_ops *ops, struct hgic_rx_info *info, uint8 *data, int32 len);
+    int32(*ioctl)(struct lmac_ops *ops, uint32 cmd, uint32 param1, uint32 param2);
+};
+
+static inline int32 lmac_open(struct lmac_ops *ops)
+{
+    return ops->open(ops);
+}
+
+static inline int32 lmac_tx(struct lmac_ops *ops, struct sk_buff *skb)
+{
+    return ops->tx(ops, skb);
+}
+
+static inline int32 lmac_ioctl(struct lmac_ops *ops, uint32 cmd, uint32 param1, uint32 param2)
+{
+    return ops->ioctl(ops, cmd, param1, param2);
+}
+
+#define LMAC_SIM_SET(ops, a, b)                     lmac_ioctl(ops, LMAC_IOCTL_SET_OTHER, (uint32)(a), (uint32)(b))
+
+#define lmac_set_freq(ops, freq)                    LMAC_SIM_SET(ops, freq, 0)
+#define lmac_set_bss_bw(ops, bw)                    LMAC_SIM_SET(ops, bw, 0)
+#define lmac_set_tx_mcs(ops, mcs)                   LMAC_SIM_SET(ops, mcs, 0)
+#define lmac_set_fix_tx_rate(ops, rate)             LMAC_SIM_SET(ops, rate, 0)
+#define lmac_set_fallback_mcs(ops, mcs)             LMAC_SIM_SET(ops, mcs, 0)
+#define lmac_set_mcast_txmcs(ops, mcs)              LMAC_SIM_SET(ops, mcs, 0)
+#define lmac_set_txpower(ops, pwr)                  LMAC_SIM_SET(ops, pwr, 0)
+#define lmac_set_super_pwr(ops, en)                 LMAC_SIM_SET(ops, en, 0)
+#define lmac_set_aggcnt(ops, cnt)                   LMAC_SIM_SET(ops, cnt, 0)
+#define lmac_set_rx_aggcnt(ops, cnt)                LMAC_SIM_SET(ops, cnt, 0)
+#define lmac_set_auto_chan_switch(ops, en)          LMAC_SIM_SET(ops, en, 0)
+#define lmac_set_wakeup_io(ops, io, edge)           LMAC_SIM_SET(ops, io, edge)
+#define lmac_set_ps_mode(ops, mode)                 LMAC_SIM_SET(ops, mode, 0)
+#define lmac_set_wait_psmode(ops, mode)             LMAC_SIM_SET(ops, mode, 0)
+#define lmac_set_psconnect_period(ops, period)      LMAC_SIM_SET(ops, period, 0)
+#define lmac_set_ap_psmode_en(ops, en)              LMAC_SIM_SET(ops, en, 0)
+#define lmac_set_standby(ops, chn, time)            LMAC_SIM_SET(ops, chn, time)
+#define lmac_set_cca_for_ce(ops, en)                LMAC_SIM_SET(ops, en, 0)
+#define lmac_set_retry_cnt(ops, frm_max, rts_max)   LMAC_SIM_SET(ops, frm_max, rts_max)
+#define lmac_set_retry_fallback_cnt(ops, cnt)       LMAC_SIM_SET(ops, cnt, 0)
+#define lmac_set_rts(ops, thresh)                   LMAC_SIM_SET(ops, thresh, 0)
+#define lmac_set_ack_timeout_extra(ops, tmo)        LMAC_SIM_SET(ops, tmo, 0)
+#define lmac_set_dbg_levle(ops, level)              LMAC_SIM_SET(ops, level, 0)
+#define lmac_set_promisc_mode(ops, en)              LMAC_SIM_SET(ops, en, 0)
+#define lmac_set_bssid(ops, bssid)                  LMAC_SIM_SET(ops, ((void)(bssid), 0), 0)
+
+void *lmac_ah_init(struct lmac_init_param *param);
+
+#endif // __HOST_LMAC_DEF_H_
@@ -0,0 +1,11 @@
+#ifndef __HOST_SKB_H_
+#define __HOST_SKB_H_
+
+#include "lib/skb/skbuff.h"
+
+/* Heap backed, stub/skb.c counts live buffers for leak checks */
+struct sk_buff *alloc_tx_skb(uint32 size);
+void kfree_skb(struct sk_buff *skb);
+int32 skb_live_count(void);
+
+#endif // __HOST_SKB_H_
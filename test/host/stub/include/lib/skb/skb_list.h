@@ -0,0 +1,17 @@
+#ifndef __HOST_SKB_LIST_H_
+#define __HOST_SKB_LIST_H_
+
+#include "lib/skb/skbuff.h"
+
+struct skb_list {
+    struct sk_buff *next, *prev;
+    uint32 count;
+};
+
+int32 skb_list_init(struct skb_list *list);
+uint32 skb_list_count(struct skb_list *list);
+int32 skb_list_queue(struct skb_list *list, struct sk_buff *skb);
+struct sk_buff *skb_list_dequeue(struct skb_list *list);
+struct sk_buff *skb_list_first(struct skb_list *list);
+
+#endif // __HOST_SKB_LIST_H_
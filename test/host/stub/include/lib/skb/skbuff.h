@@ -0,0 +1,19 @@
+#ifndef __HOST_SKBUFF_H_
+#define __HOST_SKBUFF_H_
+
+#include "typesdef.h"
+
+struct sk_buff {
+    struct sk_buff *next, *prev;
+    uint8  *tail;
+    uint8  *data;
+    uint8  *head;
+    uint8  *end;
+    uint16  len;
+    uint16  priority:4, tx: 1;
+};
+
+uint8 *skb_put(struct sk_buff *skb, uint32 len);
+void skb_reserve(struct sk_buff *skb, int len);
+
+#endif // __HOST_SKBUFF_H_
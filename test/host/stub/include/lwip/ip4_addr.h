@@ -0,0 +1,13 @@
+#ifndef __HOST_LWIP_IP4_ADDR_H_
+#define __HOST_LWIP_IP4_ADDR_H_
+
+/* Enough of lwIP for inc/utils.h */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ip4_addr {
+    uint32_t addr;
+} ip4_addr_t;
+
+#endif // __HOST_LWIP_IP4_ADDR_H_
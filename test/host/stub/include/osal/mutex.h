@@ -0,0 +1,20 @@
+#ifndef __HOST_OSAL_MUTEX_H_
+#define __HOST_OSAL_MUTEX_H_
+
+#include <pthread.h>
+
+#include "typesdef.h"
+
+#ifndef osWaitForever
+#define osWaitForever 0xFFFFFFFFu
+#endif
+
+struct os_mutex {
+    pthread_mutex_t hdl;
+};
+
+int32 os_mutex_init(struct os_mutex *mutex);
+int32 os_mutex_lock(struct os_mutex *mutex, int32 tmo);
+int32 os_mutex_unlock(struct os_mutex *mutex);
+
+#endif // __HOST_OSAL_MUTEX_H_
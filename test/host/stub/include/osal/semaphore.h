@@ -0,0 +1,24 @@
+#ifndef __HOST_OSAL_SEMAPHORE_H_
+#define __HOST_OSAL_SEMAPHORE_H_
+
+#include <pthread.h>
+
+#include "typesdef.h"
+
+#ifndef osWaitForever
+#define osWaitForever 0xFFFFFFFFu
+#endif
+
+struct os_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int32           count;
+};
+
+int32 os_sema_init(struct os_semaphore *sem, int32 val);
+int32 os_sema_del(struct os_semaphore *sem);
+int32 os_sema_down(struct os_semaphore *sem, int32 tmo_ms);
+int32 os_sema_up(struct os_semaphore *sem);
+int32 os_sema_count(struct os_semaphore *sem);
+
+#endif // __HOST_OSAL_SEMAPHORE_H_
@@ -0,0 +1,15 @@
+#ifndef __HOST_OSAL_STRING_H_
+#define __HOST_OSAL_STRING_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "typesdef.h"
+
+#define os_malloc(size)     malloc(size)
+#define os_zalloc(size)     calloc(1, size)
+#define os_free(ptr)        free(ptr)
+#define os_printf           printf
+
+#endif // __HOST_OSAL_STRING_H_
@@ -0,0 +1,24 @@
+#ifndef __HOST_OSAL_TASK_H_
+#define __HOST_OSAL_TASK_H_
+
+#include <pthread.h>
+
+#include "typesdef.h"
+
+typedef void (*os_task_func_t)(void *arg);
+
+/* Tasks are detached threads, priority and stack size are recorded only */
+struct os_task {
+    pthread_t      hdl;
+    os_task_func_t func;
+    void          *arg;
+    uint8          priority;
+    int32          stack_size;
+};
+
+int32 os_task_init(const uint8 *name, struct os_task *task, os_task_func_t func, uint32 data);
+int32 os_task_set_priority(struct os_task *task, uint8 priority);
+int32 os_task_set_stacksize(struct os_task *task, int32 stack_size);
+int32 os_task_run(struct os_task *task);
+
+#endif // __HOST_OSAL_TASK_H_
@@ -0,0 +1,24 @@
+#ifndef __HOST_TYPESDEF_H_
+#define __HOST_TYPESDEF_H_
+
+/* SDK integer aliases, osal/csky/typesdef.h */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef int8_t     int8;
+typedef int16_t    int16;
+typedef int32_t    int32;
+typedef int64_t    int64;
+typedef uint8_t    uint8;
+typedef uint16_t   uint16;
+typedef uint32_t   uint32;
+typedef uint64_t   uint64;
+
+typedef uint8_t    u8;
+typedef uint16_t   u16;
+typedef uint32_t   u32;
+typedef uint16_t   le16;
+
+#endif // __HOST_TYPESDEF_H_
@@ -0,0 +1,20 @@
+#include <stdatomic.h>
+
+#include "halow_lbt.h"
+
+/* The channel is always clear on the host, only the charged airtime is kept */
+
+static atomic_uint g_airtime_us;
+
+void halow_lbt_wait_tx_allowed(uint32_t airtime_us){ (void)airtime_us; }
+void halow_lbt_wait_channel_clear(void){ }
+void halow_lbt_set_tx_as_active(void){ }
+void halow_lbt_set_tx_as_deactive(void){ }
+
+void halow_lbt_airtime_charge(uint32_t airtime_us){
+    atomic_fetch_add(&g_airtime_us, airtime_us);
+}
+
+uint32_t lbt_stub_airtime_us(void){
+    return atomic_load(&g_airtime_us);
+}
@@ -0,0 +1,120 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "lmac_sim.h"
+#include "lib/lmac/lmac_def.h"
+#include "lib/lmac/hgic.h"
+#include "lib/skb/skb.h"
+#include "osal/mutex.h"
+
+#define LMAC_SIM_HEADROOM   16
+#define LMAC_SIM_TAILROOM   4
+#define LMAC_SIM_FRAME_MAX  (8*1024)
+
+static struct lmac_ops g_sim_ops;
+static struct os_mutex g_sim_lock;
+static lmac_sim_cfg_t g_sim_cfg;
+static lmac_sim_stat_t g_sim_stat;
+static uint8_t g_sim_air[LMAC_SIM_FRAME_MAX];
+
+static int32 lmac_sim_open(struct lmac_ops *ops){
+    (void)ops;
+    return 0;
+}
+
+static int32 lmac_sim_ioctl(struct lmac_ops *ops, uint32 cmd, uint32 param1, uint32 param2){
+    (void)ops;
+    (void)cmd;
+    (void)param1;
+    (void)param2;
+    return 0;
+}
+
+static void lmac_sim_rx_info(struct hgic_rx_info *info, const lmac_sim_cfg_t *cfg){
+    memset(info, 0, sizeof(*info));
+    info->signal = cfg->signal;
+    info->evm    = cfg->evm;
+    info->mcs    = cfg->mcs & 0x0F;
+    info->bw     = cfg->bw & 0x0F;
+}
+
+/* Called by the halow TX task only, the air buffer needs no lock of its own */
+static int32 lmac_sim_tx(struct lmac_ops *ops, struct sk_buff *skb){
+    lmac_sim_cfg_t cfg;
+    struct hgic_rx_info info;
+    uint32_t n;
+    bool lost;
+
+    os_mutex_lock(&g_sim_lock, osWaitForever);
+    cfg = g_sim_cfg;
+    n   = g_sim_stat.tx_frames++;
+    g_sim_stat.tx_bytes += skb->len;
+    if ((cfg.reject != NULL) && cfg.reject(skb->data, skb->len, n)) {
+        g_sim_stat.rejected++;
+        os_mutex_unlock(&g_sim_lock);
+        return -1;
+    }
+    os_mutex_unlock(&g_sim_lock);
+
+    lost = (skb->len > sizeof(g_sim_air)) ||
+           ((cfg.drop != NULL) && cfg.drop(skb->data, skb->len, n));
+    if (!lost) {
+        memcpy(g_sim_air, skb->data, skb->len);
+        lmac_sim_rx_info(&info, &cfg);
+        ops->rx(ops, &info, g_sim_air, skb->len);
+    }
+
+    os_mutex_lock(&g_sim_lock, osWaitForever);
+    if (lost) {
+        g_sim_stat.dropped++;
+    } else {
+        g_sim_stat.delivered++;
+    }
+    os_mutex_unlock(&g_sim_lock);
+
+    if (cfg.tx_done_us != 0) {
+        usleep(cfg.tx_done_us);
+    }
+    return ops->tx_status(ops, skb);
+}
+
+void *lmac_ah_init(struct lmac_init_param *param){
+    (void)param;
+
+    memset(&g_sim_ops, 0, sizeof(g_sim_ops));
+    g_sim_ops.headroom = LMAC_SIM_HEADROOM;
+    g_sim_ops.tailroom = LMAC_SIM_TAILROOM;
+    g_sim_ops.open     = lmac_sim_open;
+    g_sim_ops.tx       = lmac_sim_tx;
+    g_sim_ops.ioctl    = lmac_sim_ioctl;
+    os_mutex_init(&g_sim_lock);
+    return &g_sim_ops;
+}
+
+void lmac_sim_config(const lmac_sim_cfg_t *cfg){
+    os_mutex_lock(&g_sim_lock, osWaitForever);
+    g_sim_cfg = *cfg;
+    memset(&g_sim_stat, 0, sizeof(g_sim_stat));
+    os_mutex_unlock(&g_sim_lock);
+}
+
+lmac_sim_stat_t lmac_sim_stat_get(void){
+    lmac_sim_stat_t stat;
+
+    os_mutex_lock(&g_sim_lock, osWaitForever);
+    stat = g_sim_stat;
+    os_mutex_unlock(&g_sim_lock);
+    return stat;
+}
+
+int32_t lmac_sim_inject(const uint8_t *frame, uint32_t len){
+    static uint8_t buf[LMAC_SIM_FRAME_MAX];
+    struct hgic_rx_info info;
+
+    if ((g_sim_ops.rx == NULL) || (len > sizeof(buf))) {
+        return -1;
+    }
+    memcpy(buf, frame, len);
+    lmac_sim_rx_info(&info, &g_sim_cfg);
+    return g_sim_ops.rx(&g_sim_ops, &info, buf, (int32)len);
+}
@@ -0,0 +1,45 @@
+#ifndef __LMAC_SIM_H_
+#define __LMAC_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Simulated LMAC: a single node on a loopback channel. Every frame handed to
+ * lmac_tx() is delivered back to ops->rx() unless the drop hook says it was
+ * lost, then completed through ops->tx_status() after tx_done_us.
+ * Functional only: no PHY rate (tx_done_us is fixed), no noise or busy
+ * channel, no second node.
+ */
+
+/* n counts frames sent since lmac_sim_config(), frame starts at the 802.11 header */
+typedef bool (*lmac_sim_drop_fn)(const uint8_t *frame, uint32_t len, uint32_t n);
+
+typedef struct {
+    lmac_sim_drop_fn drop;      // NULL: lossless channel
+    lmac_sim_drop_fn reject;    // lmac_tx() fails, no tx_status, the caller keeps the skb
+    uint32_t tx_done_us;        // Delay before tx_status, models the air time
+    int8_t   signal;            // Reported in hgic_rx_info
+    int8_t   evm;
+    uint8_t  mcs;
+    uint8_t  bw;
+} lmac_sim_cfg_t;
+
+typedef struct {
+    uint32_t tx_frames;
+    uint32_t tx_bytes;
+    uint32_t dropped;
+    uint32_t delivered;
+    uint32_t rejected;
+} lmac_sim_stat_t;
+
+void lmac_sim_config(const lmac_sim_cfg_t *cfg);
+lmac_sim_stat_t lmac_sim_stat_get(void);
+
+/* Hands a raw received frame to ops->rx() as if it came off the air */
+int32_t lmac_sim_inject(const uint8_t *frame, uint32_t len);
+
+/* Airtime charged through halow_lbt_airtime_charge(), stub/lbt.c */
+uint32_t lbt_stub_airtime_us(void);
+
+#endif // __LMAC_SIM_H_
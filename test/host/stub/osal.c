@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <time.h>
+
+#include "osal/semaphore.h"
+#include "osal/mutex.h"
+#include "osal/task.h"
+#include "utils.h"
+
+static void osal_deadline(struct timespec *ts, int32 tmo_ms){
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec  += tmo_ms / 1000;
+    ts->tv_nsec += (long)(tmo_ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+int64_t get_time_us(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t get_time_ms(void){
+    return get_time_us() / 1000;
+}
+
+int32 os_sema_init(struct os_semaphore *sem, int32 val){
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = val;
+    return 0;
+}
+
+int32 os_sema_del(struct os_semaphore *sem){
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    return 0;
+}
+
+/* osWaitForever arrives as -1 */
+int32 os_sema_down(struct os_semaphore *sem, int32 tmo_ms){
+    struct timespec ts;
+    int32 ret = 1;
+
+    if (tmo_ms >= 0) {
+        osal_deadline(&ts, tmo_ms);
+    }
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0) {
+        if (tmo_ms < 0) {
+            pthread_cond_wait(&sem->cond, &sem->lock);
+        } else if (pthread_cond_timedwait(&sem->cond, &sem->lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (sem->count > 0) {
+        sem->count--;
+    } else {
+        ret = 0;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+int32 os_sema_up(struct os_semaphore *sem){
+    pthread_mutex_lock(&sem->lock);
+    sem->count++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return 0;
+}
+
+int32 os_sema_count(struct os_semaphore *sem){
+    int32 n;
+
+    pthread_mutex_lock(&sem->lock);
+    n = sem->count;
+    pthread_mutex_unlock(&sem->lock);
+    return n;
+}
+
+int32 os_mutex_init(struct os_mutex *mutex){
+    return pthread_mutex_init(&mutex->hdl, NULL);
+}
+
+int32 os_mutex_lock(struct os_mutex *mutex, int32 tmo){
+    (void)tmo;
+    return pthread_mutex_lock(&mutex->hdl);
+}
+
+int32 os_mutex_unlock(struct os_mutex *mutex){
+    return pthread_mutex_unlock(&mutex->hdl);
+}
+
+int32 os_task_init(const uint8 *name, struct os_task *task, os_task_func_t func, uint32 data){
+    (void)name;
+    task->func       = func;
+    task->arg        = (void *)(uintptr_t)data;
+    task->priority   = 0;
+    task->stack_size = 0;
+    return 0;
+}
+
+int32 os_task_set_priority(struct os_task *task, uint8 priority){
+    task->priority = priority;
+    return 0;
+}
+
+int32 os_task_set_stacksize(struct os_task *task, int32 stack_size){
+    task->stack_size = stack_size;
+    return 0;
+}
+
+static void *os_task_entry(void *arg){
+    struct os_task *task = (struct os_task *)arg;
+
+    task->func(task->arg);
+    return NULL;
+}
+
+int32 os_task_run(struct os_task *task){
+    if (pthread_create(&task->hdl, NULL, os_task_entry, task) != 0) {
+        return -1;
+    }
+    pthread_detach(task->hdl);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "lib/skb/skb.h"
+#include "lib/skb/skb_list.h"
+
+static atomic_int g_skb_live;
+
+struct sk_buff *alloc_tx_skb(uint32 size){
+    struct sk_buff *skb = (struct sk_buff *)calloc(1, sizeof(*skb) + size);
+
+    if (skb == NULL) {
+        return NULL;
+    }
+    skb->head = (uint8 *)(skb + 1);
+    skb->data = skb->head;
+    skb->tail = skb->head;
+    skb->end  = skb->head + size;
+    atomic_fetch_add(&g_skb_live, 1);
+    return skb;
+}
+
+void kfree_skb(struct sk_buff *skb){
+    if (skb != NULL) {
+        atomic_fetch_sub(&g_skb_live, 1);
+        free(skb);
+    }
+}
+
+int32 skb_live_count(void){
+    return atomic_load(&g_skb_live);
+}
+
+uint8 *skb_put(struct sk_buff *skb, uint32 len){
+    uint8 *p = skb->tail;
+
+    if (skb->tail + len > skb->end) {
+        abort();
+    }
+    skb->tail += len;
+    skb->len  += (uint16)len;
+    return p;
+}
+
+void skb_reserve(struct sk_buff *skb, int len){
+    skb->data += len;
+    skb->tail += len;
+}
+
+int32 skb_list_init(struct skb_list *list){
+    list->next  = NULL;
+    list->prev  = NULL;
+    list->count = 0;
+    return 0;
+}
+
+uint32 skb_list_count(struct skb_list *list){
+    return list->count;
+}
+
+int32 skb_list_queue(struct skb_list *list, struct sk_buff *skb){
+    skb->next = NULL;
+    skb->prev = list->prev;
+    if (list->prev != NULL) {
+        list->prev->next = skb;
+    } else {
+        list->next = skb;
+    }
+    list->prev = skb;
+    list->count++;
+    return 0;
+}
+
+struct sk_buff *skb_list_dequeue(struct skb_list *list){
+    struct sk_buff *skb = list->next;
+
+    if (skb != NULL) {
+        list->next = skb->next;
+        if (list->next == NULL) {
+            list->prev = NULL;
+        }
+        skb->next = NULL;
+        skb->prev = NULL;
+        list->count--;
+    }
+    return skb;
+}
+
+struct sk_buff *skb_list_first(struct skb_list *list){
+    return list->next;
+}
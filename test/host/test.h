@@ -0,0 +1,37 @@
+#ifndef __HOST_TEST_H_
+#define __HOST_TEST_H_
+
+#include <stdio.h>
+
+/* Failed checks are counted and the test keeps going, main() returns TEST_RESULT() */
+
+static int g_test_failed;
+
+#define CHECK(cond) do {                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_test_failed++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(a, b) do {                                                 \
+        long long _a = (long long)(a);                                      \
+        long long _b = (long long)(b);                                      \
+        if (_a != _b) {                                                     \
+            printf("%s:%d: %s == %s failed: %lld != %lld\n",                \
+                   __FILE__, __LINE__, #a, #b, _a, _b);                     \
+            g_test_failed++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define TEST_RESULT() (printf("%s\n", g_test_failed ? "FAIL" : "OK"), g_test_failed ? 1 : 0)
+
+/* xorshift32, tests are reproducible */
+static inline uint32_t test_rand(uint32_t *s){
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+#endif // __HOST_TEST_H_
@@ -0,0 +1,299 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "deframer.h"
+#include "test.h"
+
+#define BUF_SIZE    64
+#define OUT_MAX     4096
+
+typedef struct {
+    uint8_t  out[OUT_MAX];      // Emitted frames back to back
+    uint32_t out_len;
+    uint32_t frames;
+    uint32_t cmds;
+    uint8_t  last_cmd;
+    uint32_t last_cmd_len;
+    const uint8_t *last_ptr;    // First piece of the last frame
+    uint32_t last_cnt;
+    uint32_t max_cnt;
+} sink_t;
+
+static void sink_frame(void *arg, const deframer_seg_t *seg, uint32_t cnt, uint32_t len){
+    sink_t *s = (sink_t *)arg;
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (s->out_len + seg[i].len <= OUT_MAX) {
+            memcpy(s->out + s->out_len, seg[i].data, seg[i].len);
+            s->out_len += seg[i].len;
+        }
+        sum += seg[i].len;
+    }
+    CHECK_EQ(sum, len);
+    CHECK(cnt <= DEFRAMER_FRAME_SEGS_MAX);
+    s->last_ptr = seg[0].data;
+    s->last_cnt = cnt;
+    if (s->max_cnt < cnt) {
+        s->max_cnt = cnt;
+    }
+    s->frames++;
+}
+
+static void sink_cmd(void *arg, uint8_t cmd, const uint8_t *data, uint32_t len){
+    sink_t *s = (sink_t *)arg;
+
+    (void)data;
+    s->last_cmd     = cmd;
+    s->last_cmd_len = len;
+    s->cmds++;
+}
+
+static void setup(deframer_t *d, sink_t *s, uint8_t *buf, deframer_mode_t mode, uint32_t raw_max){
+    memset(s, 0, sizeof(*s));
+    deframer_init(d, mode, buf, BUF_SIZE, raw_max, sink_frame, sink_cmd, s);
+}
+
+static void test_kiss(void){
+    static const uint8_t in[] = {
+        0xC0, 0x00, 'a', 'b', 0xC0,                 // data
+        0xC0, 0x01, 50,  0xC0,                      // TXDELAY
+        0xC0, 0xC0,                                 // padding
+        0x00, 'c', 0xDB, 0xDC, 0xC0,                // data, shares the opening delimiter
+        0xC0, 0xDB, 0xDC, 0xC0,                     // FESC as command byte
+    };
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    setup(&d, &s, buf, DEFRAMER_MODE_AUTO, 0);
+    deframer_feed(&d, in, sizeof(in));
+
+    CHECK_EQ(d.mode, DEFRAMER_MODE_KISS);
+    CHECK_EQ(s.frames, 2);
+    CHECK_EQ(d.frames, 2);
+    CHECK_EQ(s.cmds, 1);
+    CHECK_EQ(s.last_cmd, 0x01);
+    CHECK_EQ(s.last_cmd_len, 1);
+    CHECK_EQ(d.dropped, 1);
+    CHECK_EQ(s.out_len, 5 + 6);
+    CHECK(memcmp(s.out, in, 5) == 0);
+    CHECK(memcmp(s.out + 5, &in[10], 6) == 0);
+
+    /* Frames inside one segment are handed out in place */
+    CHECK(s.last_ptr == &in[10]);
+}
+
+static void test_hdlc_split(void){
+    static const uint8_t in[] = { 0x7E, 1, 2, 3, 4, 5, 6, 7, 0x7E, 8, 9, 0x7E };
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    setup(&d, &s, buf, DEFRAMER_MODE_AUTO, 0);
+    deframer_feed(&d, in, 4);
+    deframer_feed(&d, in + 4, 6);
+    CHECK_EQ(d.mode, DEFRAMER_MODE_HDLC);
+    CHECK_EQ(s.frames, 1);
+    CHECK(s.last_ptr == buf);               // head buffered, closing piece in place
+    CHECK_EQ(s.last_cnt, 2);
+    deframer_feed(&d, in + 10, 2);
+    CHECK_EQ(s.frames, 2);
+    CHECK_EQ(s.out_len, 9 + 4);
+    CHECK(memcmp(s.out, in, 9) == 0);
+    CHECK(memcmp(s.out + 9, in + 8, 4) == 0);
+}
+
+static void test_overflow(void){
+    uint8_t in[BUF_SIZE * 2];
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    setup(&d, &s, buf, DEFRAMER_MODE_HDLC, 0);
+
+    /* Too long in one segment */
+    memset(in, 0x55, sizeof(in));
+    in[0] = 0x7E;
+    in[sizeof(in) - 1] = 0x7E;
+    deframer_feed(&d, in, sizeof(in));
+    CHECK_EQ(s.frames, 0);
+    CHECK_EQ(d.dropped, 1);
+
+    /* Too long across segments, the next frame still gets through */
+    deframer_feed(&d, in + 1, BUF_SIZE);
+    deframer_feed(&d, in + 1, BUF_SIZE - 2);
+    deframer_feed(&d, in + sizeof(in) - 1, 1);
+    CHECK_EQ(s.frames, 0);
+    CHECK_EQ(d.dropped, 2);
+
+    in[4] = 0x7E;
+    deframer_feed(&d, in + 1, 4);
+    CHECK_EQ(s.frames, 1);
+    CHECK_EQ(s.out_len, 5);
+}
+
+static void test_raw(void){
+    uint8_t in[100];
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    for (uint32_t i = 0; i < sizeof(in); i++) {
+        in[i] = (uint8_t)(i + 1);
+    }
+    setup(&d, &s, buf, DEFRAMER_MODE_AUTO, 30);
+    deframer_feed(&d, in, sizeof(in));
+    CHECK_EQ(d.mode, DEFRAMER_MODE_RAW);
+    CHECK_EQ(s.frames, 4);                  // 30 + 30 + 30 + 10
+    CHECK_EQ(s.out_len, sizeof(in));
+    CHECK(memcmp(s.out, in, sizeof(in)) == 0);
+
+    /* raw_max is capped by the buffer */
+    setup(&d, &s, buf, DEFRAMER_MODE_RAW, 0);
+    deframer_feed(&d, in, sizeof(in));
+    CHECK_EQ(s.frames, 2);
+}
+
+/* A frame spanning the segments of one call is handed out as pieces of them */
+static void test_segs(void){
+    static const uint8_t in[] = { 0x7E, 1, 2, 3, 0x7E, 4, 5, 6, 7, 8, 9, 0x7E, 10 };
+    deframer_seg_t seg[4];
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    seg[0].data = in;      seg[0].len = 6;  // 7E 1 2 3 7E | 4
+    seg[1].data = in + 6;  seg[1].len = 2;  // 5 6
+    seg[2].data = in + 8;  seg[2].len = 4;  // 7 8 9 7E
+    seg[3].data = in + 12; seg[3].len = 1;  // 10, stays open
+
+    setup(&d, &s, buf, DEFRAMER_MODE_HDLC, 0);
+    deframer_feed_segs(&d, seg, 4);
+    CHECK_EQ(s.frames, 2);
+    CHECK_EQ(s.last_cnt, 3);
+    CHECK(s.last_ptr == in + 4);
+    CHECK_EQ(s.out_len, 5 + 8);
+    CHECK(memcmp(s.out, in, 5) == 0);
+    CHECK(memcmp(s.out + 5, in + 4, 8) == 0);
+    CHECK_EQ(d.buf_len, 2);                 // 7E 10 copied before returning
+    CHECK(memcmp(buf, in + 11, 2) == 0);
+}
+
+/* More pieces than can be held: the oldest are copied, nothing is lost */
+static void test_segs_many(void){
+    uint8_t in[3 * DEFRAMER_SEGS_MAX];
+    deframer_seg_t seg[3 * DEFRAMER_SEGS_MAX];
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    for (uint32_t i = 0; i < sizeof(in); i++) {
+        in[i] = (uint8_t)(i + 1);
+        seg[i].data = &in[i];
+        seg[i].len  = 1;
+    }
+    in[0] = 0x7E;
+    in[sizeof(in) - 1] = 0x7E;
+
+    setup(&d, &s, buf, DEFRAMER_MODE_HDLC, 0);
+    deframer_feed_segs(&d, seg, sizeof(in));
+    CHECK_EQ(s.frames, 1);
+    CHECK(s.last_cnt <= DEFRAMER_FRAME_SEGS_MAX);
+    CHECK(s.last_ptr == buf);
+    CHECK_EQ(s.out_len, sizeof(in));
+    CHECK(memcmp(s.out, in, sizeof(in)) == 0);
+}
+
+/* KISS command frame in pieces reaches cmd_cb contiguous */
+static void test_segs_cmd(void){
+    static const uint8_t in[] = { 0xC0, 0x06, 0x11, 0x22, 0x33, 0xC0 };
+    static uint8_t got[3];
+    deframer_seg_t seg[3];
+    uint8_t buf[BUF_SIZE];
+    deframer_t d;
+    sink_t s;
+
+    seg[0].data = in;     seg[0].len = 3;
+    seg[1].data = in + 3; seg[1].len = 1;
+    seg[2].data = in + 4; seg[2].len = 2;
+
+    setup(&d, &s, buf, DEFRAMER_MODE_KISS, 0);
+    deframer_feed_segs(&d, seg, 3);
+    CHECK_EQ(s.cmds, 1);
+    CHECK_EQ(s.last_cmd, 0x06);
+    CHECK_EQ(s.last_cmd_len, 3);
+    memcpy(got, buf + 2, 3);
+    CHECK(memcmp(got, in + 2, 3) == 0);
+    CHECK_EQ(s.frames, 0);
+}
+
+/* However the stream is cut, the same frames come out */
+static void test_random_cuts(void){
+    uint8_t in[2048];
+    uint8_t buf[BUF_SIZE];
+    uint32_t seed = 0xC0FFEE;
+    deframer_t d;
+    sink_t ref;
+    sink_t s;
+    uint32_t n = 0;
+
+    while (n < sizeof(in) - BUF_SIZE) {
+        uint32_t len = 1 + test_rand(&seed) % (BUF_SIZE - 4);
+
+        in[n++] = 0xC0;
+        in[n++] = 0x00;
+        for (uint32_t i = 0; i < len; i++) {
+            uint8_t b = (uint8_t)test_rand(&seed);
+
+            in[n++] = (b == 0xC0) ? 0xDB : b;
+        }
+        in[n++] = 0xC0;
+    }
+
+    setup(&d, &ref, buf, DEFRAMER_MODE_KISS, 0);
+    deframer_feed(&d, in, n);
+    CHECK(ref.frames > 20);
+    CHECK_EQ(d.dropped, 0);
+
+    for (uint32_t round = 0; round < 200; round++) {
+        uint32_t off = 0;
+
+        setup(&d, &s, buf, DEFRAMER_MODE_KISS, 0);
+        while (off < n) {
+            deframer_seg_t seg[12];
+            uint32_t cnt = 1 + test_rand(&seed) % 12;
+
+            /* Odd rounds feed one segment per call, even ones a chain */
+            if (round & 1) {
+                cnt = 1;
+            }
+            for (uint32_t i = 0; i < cnt; i++) {
+                uint32_t len = 1 + test_rand(&seed) % 80;
+
+                if (len > n - off) {
+                    len = n - off;
+                }
+                seg[i].data = in + off;
+                seg[i].len  = len;
+                off += len;
+            }
+            deframer_feed_segs(&d, seg, cnt);
+        }
+        CHECK_EQ(s.frames, ref.frames);
+        CHECK_EQ(s.out_len, ref.out_len);
+        CHECK(memcmp(s.out, ref.out, ref.out_len) == 0);
+    }
+}
+
+int main(void){
+    test_kiss();
+    test_hdlc_split();
+    test_overflow();
+    test_raw();
+    test_segs();
+    test_segs_many();
+    test_segs_cmd();
+    test_random_cuts();
+    return TEST_RESULT();
+}
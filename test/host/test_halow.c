@@ -0,0 +1,352 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "halow.h"
+#include "halow_fec.h"
+#include "lib/lmac/ieee802_11_defs.h"
+#include "lib/skb/skb.h"
+#include "lmac_sim.h"
+#include "sys_config.h"
+#include "utils.h"
+#include "test.h"
+
+/*
+ * halow.c on the simulated loopback LMAC: frames go through the real TX
+ * queue, TX task, aggregation and FEC, come back through halow_lmac_rx()
+ * and must reach the RX callback intact, once each.
+ */
+
+#define FRAMES_MAX      256
+#define WAIT_MS         3000
+
+static const uint8_t g_addr[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+static const uint8_t g_fec_addr3[6] = { 0x02, 'R', 'N', 'F', 'E', 'C' };
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static lmac_sim_drop_fn g_reject;       // picked up by the next cfg_set()
+static uint32_t g_tx_done_us;           // picked up by the next cfg_set()
+static uint32_t g_rx_seen[FRAMES_MAX];
+static uint32_t g_rx_frames;
+static uint32_t g_rx_bad;
+static uint32_t g_rx_order_err;
+static int32_t g_rx_last_id;
+
+/* Payload: u16 id, u16 length, then bytes derived from both */
+static uint32_t frame_make(uint8_t *p, uint32_t id, uint32_t len){
+    p[0] = (uint8_t)(id >> 8);
+    p[1] = (uint8_t)id;
+    p[2] = (uint8_t)(len >> 8);
+    p[3] = (uint8_t)len;
+    for (uint32_t i = 4; i < len; i++) {
+        p[i] = (uint8_t)(id * 31U + i);
+    }
+    return len;
+}
+
+static void rx_cb(const halow_rx_meta_t *meta, const uint8_t *data, int32_t len){
+    uint32_t id;
+    bool ok;
+
+    ok = (len >= 4) && (memcmp(meta->src, g_addr, 6) == 0) && (meta->signal == -40);
+    id = ok ? (((uint32_t)data[0] << 8) | data[1]) : 0;
+    ok = ok && (id < FRAMES_MAX) && ((((uint32_t)data[2] << 8) | data[3]) == (uint32_t)len);
+    for (int32_t i = 4; ok && (i < len); i++) {
+        ok = (data[i] == (uint8_t)(id * 31U + (uint32_t)i));
+    }
+
+    pthread_mutex_lock(&g_lock);
+    if (!ok) {
+        g_rx_bad++;
+    } else {
+        g_rx_seen[id]++;
+        if ((int32_t)id <= g_rx_last_id) {
+            g_rx_order_err++;
+        }
+        g_rx_last_id = (int32_t)id;
+    }
+    g_rx_frames++;
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void rx_reset(void){
+    pthread_mutex_lock(&g_lock);
+    memset(g_rx_seen, 0, sizeof(g_rx_seen));
+    g_rx_frames    = 0;
+    g_rx_bad       = 0;
+    g_rx_order_err = 0;
+    g_rx_last_id   = -1;
+    pthread_mutex_unlock(&g_lock);
+}
+
+static uint32_t rx_frames(void){
+    uint32_t n;
+
+    pthread_mutex_lock(&g_lock);
+    n = g_rx_frames;
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+/* Until `n` frames arrived and the TX side went quiet */
+static void rx_wait(uint32_t n){
+    int64_t end = get_time_ms() + WAIT_MS;
+    uint32_t sent = (uint32_t)-1;
+
+    while (get_time_ms() < end) {
+        lmac_sim_stat_t st = lmac_sim_stat_get();
+
+        if ((rx_frames() >= n) && (st.tx_frames == sent) && (skb_live_count() == 0)) {
+            return;
+        }
+        sent = st.tx_frames;
+        usleep(20000);
+    }
+}
+
+static void rx_check_all(uint32_t n, bool in_order){
+    pthread_mutex_lock(&g_lock);
+    CHECK_EQ(g_rx_bad, 0);
+    CHECK_EQ(g_rx_frames, n);
+    for (uint32_t i = 0; i < n; i++) {
+        CHECK_EQ(g_rx_seen[i], 1);
+    }
+    if (in_order) {
+        CHECK_EQ(g_rx_order_err, 0);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void cfg_set(uint16_t agg_max, uint8_t agg_hold, uint8_t fec_k, uint8_t fec_m, lmac_sim_drop_fn drop){
+    halow_config_t cfg;
+    lmac_sim_cfg_t sim;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.central_freq = HALOW_CONFIG_CENTRAL_FREQ_DEF;
+    cfg.bandwidth    = 1;
+    cfg.mcs          = 7;
+    cfg.rf_power     = HALOW_CONFIG_POWER_DEF;
+    cfg.agg_max      = agg_max;
+    cfg.agg_hold_ms  = agg_hold;
+    cfg.fec_k        = fec_k;
+    cfg.fec_m        = fec_m;
+    cfg.fec_hold_ms  = 20;
+    halow_config_apply(&cfg);
+
+    memset(&sim, 0, sizeof(sim));
+    sim.drop   = drop;
+    sim.reject = g_reject;
+    sim.tx_done_us = g_tx_done_us;
+    sim.signal = -40;
+    sim.evm    = -20;
+    sim.mcs    = 7;
+    sim.bw     = 1;
+    lmac_sim_config(&sim);
+    rx_reset();
+}
+
+/* Like the firmware's sending tasks: wait for TX queue space */
+static uint32_t send_frames(uint32_t cnt, uint32_t len_min, uint32_t len_max){
+    uint8_t buf[HALOW_MTU * 4];
+    uint32_t seed = 0xBEEF + cnt;
+
+    for (uint32_t id = 0; id < cnt; id++) {
+        halow_iov_t iov;
+
+        iov.data = buf;
+        iov.len  = frame_make(buf, id, len_min + test_rand(&seed) % (len_max - len_min + 1));
+        CHECK_EQ(halow_tx_iov_wait(&iov, 1, WAIT_MS), 0);
+    }
+    return cnt;
+}
+
+static void test_plain(void){
+    cfg_set(0, 0, 0, 0, NULL);
+    send_frames(64, 4, HALOW_MTU * 4);
+    rx_wait(64);
+    rx_check_all(64, true);
+    CHECK_EQ(lmac_sim_stat_get().tx_frames, 64);
+    CHECK_EQ(halow_txq_stat_get().lmac_err, 0);
+    CHECK(lbt_stub_airtime_us() > 0);
+}
+
+static void test_agg(void){
+    halow_agg_stat_t a0 = halow_agg_stat_get();
+    halow_agg_stat_t a1;
+
+    cfg_set(1200, 20, 0, 0, NULL);
+    send_frames(200, 4, 300);
+    rx_wait(200);
+    rx_check_all(200, true);
+
+    a1 = halow_agg_stat_get();
+    CHECK(a1.tx_aggregates > a0.tx_aggregates);
+    CHECK(lmac_sim_stat_get().tx_frames < 200);
+    CHECK_EQ(a1.rx_aggregates - a0.rx_aggregates, a1.tx_aggregates - a0.tx_aggregates);
+    CHECK_EQ(a1.rx_subframes - a0.rx_subframes, a1.tx_subframes - a0.tx_subframes);
+    CHECK_EQ(a1.rx_errors, a0.rx_errors);
+}
+
+/* FEC data frame with block index 1 */
+static bool drop_fec_idx1(const uint8_t *frame, uint32_t len, uint32_t n){
+    const struct ieee80211_hdr *hdr = (const struct ieee80211_hdr *)frame;
+
+    (void)n;
+    return (len > sizeof(*hdr) + 4) &&
+           (memcmp(hdr->addr3, g_fec_addr3, 6) == 0) &&
+           (frame[sizeof(*hdr) + 1] == 1);
+}
+
+static bool drop_every_5th(const uint8_t *frame, uint32_t len, uint32_t n){
+    (void)frame;
+    (void)len;
+    return (n % 5) == 2;
+}
+
+static void test_fec(void){
+    halow_fec_stat_t f0 = halow_fec_stat_get();
+    halow_fec_stat_t f1;
+
+    cfg_set(0, 0, 4, 2, drop_fec_idx1);
+    send_frames(80, 4, HALOW_MTU);
+    rx_wait(80);
+    rx_check_all(80, false);
+
+    f1 = halow_fec_stat_get();
+    CHECK_EQ(f1.tx_blocks - f0.tx_blocks, 20);
+    CHECK_EQ(f1.tx_parity - f0.tx_parity, 40);
+    CHECK_EQ(f1.rx_recovered - f0.rx_recovered, 20);
+    CHECK_EQ(f1.rx_errors, f0.rx_errors);
+    CHECK(f1.loss_permille > 0);
+}
+
+/* Aggregates inside FEC blocks, every fifth frame on the air lost */
+static void test_fec_agg(void){
+    halow_fec_stat_t f0 = halow_fec_stat_get();
+    halow_fec_stat_t f1;
+
+    cfg_set(600, 10, 4, 2, drop_every_5th);
+    send_frames(150, 4, 200);
+    rx_wait(150);
+    rx_check_all(150, false);
+
+    f1 = halow_fec_stat_get();
+    CHECK(f1.rx_recovered > f0.rx_recovered);
+    CHECK_EQ(f1.rx_unrecovered, f0.rx_unrecovered);
+    CHECK_EQ(f1.rx_errors, f0.rx_errors);
+}
+
+static bool reject_first_32(const uint8_t *frame, uint32_t len, uint32_t n){
+    (void)frame;
+    (void)len;
+    return n < 32;
+}
+
+/* Frames the LMAC refuses give their TX buffer bytes back, later frames still go out */
+static void test_lmac_reject(void){
+    halow_txq_stat_t t0 = halow_txq_stat_get();
+
+    g_reject = reject_first_32;
+    cfg_set(0, 0, 0, 0, NULL);
+    g_reject = NULL;
+
+    /* 32 kB refused, eight times the LMAC TX buffer */
+    send_frames(40, 1000, 1000);
+    rx_wait(8);
+
+    CHECK_EQ(lmac_sim_stat_get().rejected, 32);
+    CHECK_EQ(halow_txq_stat_get().lmac_err - t0.lmac_err, 32);
+    pthread_mutex_lock(&g_lock);
+    CHECK_EQ(g_rx_bad, 0);
+    CHECK_EQ(g_rx_frames, 8);
+    for (uint32_t i = 32; i < 40; i++) {
+        CHECK_EQ(g_rx_seen[i], 1);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+/* A full queue rejects halow_tx() at once instead of blocking the caller */
+static void test_txq_drop_new(void){
+    halow_txq_stat_t t0 = halow_txq_stat_get();
+    uint8_t buf[1000];
+    uint32_t accepted = 0;
+    int64_t start;
+
+    g_tx_done_us = 20000;
+    cfg_set(0, 0, 0, 0, NULL);
+    g_tx_done_us = 0;
+
+    start = get_time_ms();
+    for (uint32_t id = 0; id < 64; id++) {
+        int32_t res = halow_tx(buf, frame_make(buf, id, sizeof(buf)));
+
+        CHECK((res == 0) || (res == -6));
+        accepted += (res == 0);
+    }
+    CHECK(get_time_ms() - start < 200);
+    CHECK(accepted < 64);
+    CHECK_EQ(halow_txq_stat_get().dropped - t0.dropped, 64 - accepted);
+
+    rx_wait(accepted);
+    CHECK_EQ(rx_frames(), accepted);
+    cfg_set(0, 0, 0, 0, NULL);
+}
+
+/* Malformed frames straight into the RX path, nothing is delivered */
+static void test_rx_malformed(void){
+    static const uint8_t agg_addr3[6] = { 0x02, 'R', 'N', 'A', 'G', 'G' };
+    uint8_t frame[sizeof(struct ieee80211_hdr) + 64];
+    struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)frame;
+    uint8_t *p = frame + sizeof(*hdr);
+    halow_agg_stat_t a0 = halow_agg_stat_get();
+    halow_fec_stat_t f0 = halow_fec_stat_get();
+
+    cfg_set(0, 0, 0, 0, NULL);
+
+    memset(frame, 0, sizeof(frame));
+    hdr->frame_control = WLAN_FTYPE_DATA;
+    memcpy(hdr->addr2, g_addr, 6);
+
+    /* Sub-frame longer than the rest */
+    memcpy(hdr->addr3, agg_addr3, 6);
+    p[0] = 0;
+    p[1] = 200;
+    CHECK_EQ(lmac_sim_inject(frame, sizeof(frame)), 0);
+    /* Zero length sub-frame */
+    p[1] = 0;
+    CHECK_EQ(lmac_sim_inject(frame, sizeof(frame)), 0);
+    CHECK_EQ(halow_agg_stat_get().rx_errors - a0.rx_errors, 2);
+
+    /* FEC header only, then a parity index out of range */
+    memcpy(hdr->addr3, g_fec_addr3, 6);
+    CHECK_EQ(lmac_sim_inject(frame, sizeof(*hdr) + 4), 0);
+    p[0] = 9;
+    p[1] = 0x80 | HALOW_FEC_M_MAX;
+    p[2] = 4;
+    CHECK_EQ(lmac_sim_inject(frame, sizeof(frame)), 0);
+    CHECK_EQ(halow_fec_stat_get().rx_errors - f0.rx_errors, 2);
+
+    /* Not a data frame, too short */
+    hdr->frame_control = WLAN_FTYPE_MGMT;
+    CHECK_EQ(lmac_sim_inject(frame, sizeof(frame)), -1);
+    CHECK_EQ(lmac_sim_inject(frame, 10), -1);
+
+    CHECK_EQ(rx_frames(), 0);
+}
+
+int main(void){
+    CHECK(halow_init(0, 0, 0, 0));
+    halow_set_addr(g_addr);
+    halow_set_rx_cb(rx_cb);
+
+    test_plain();
+    test_agg();
+    test_fec();
+    test_fec_agg();
+    test_lmac_reject();
+    test_txq_drop_new();
+    test_rx_malformed();
+
+    CHECK_EQ(skb_live_count(), 0);
+    return TEST_RESULT();
+}
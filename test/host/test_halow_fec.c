@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "halow_fec.h"
+#include "test.h"
+
+#define SYM_MAX 64
+
+static uint32_t popcount(uint32_t v){
+    uint32_t n = 0;
+
+    while (v) {
+        v &= v - 1U;
+        n++;
+    }
+    return n;
+}
+
+/* Every erasure pattern of one block: decodes exactly when parity covers the losses */
+static void test_all_patterns(uint32_t k, uint32_t m, uint32_t len, uint32_t *seed){
+    uint8_t orig[HALOW_FEC_K_MAX][SYM_MAX];
+    uint8_t enc[HALOW_FEC_M_MAX][SYM_MAX];
+
+    for (uint32_t i = 0; i < k; i++) {
+        for (uint32_t b = 0; b < len; b++) {
+            orig[i][b] = (uint8_t)test_rand(seed);
+        }
+    }
+    memset(enc, 0, sizeof(enc));
+    for (uint32_t i = 0; i < k; i++) {
+        for (uint32_t j = 0; j < m; j++) {
+            halow_fec_encode(enc[j], j, i, orig[i], len);
+        }
+    }
+
+    for (uint32_t lost = 0; lost < (1UL << (k + m)); lost++) {
+        uint8_t data[HALOW_FEC_K_MAX][SYM_MAX];
+        uint8_t par[HALOW_FEC_M_MAX][SYM_MAX];
+        uint8_t *dp[HALOW_FEC_K_MAX];
+        uint8_t *pp[HALOW_FEC_M_MAX];
+        uint32_t have     = ((1UL << k) - 1U) & ~lost;
+        uint32_t par_have = ((1UL << m) - 1U) & ~(lost >> k);
+        uint32_t miss     = k - popcount(have);
+        int32_t rc;
+
+        memcpy(data, orig, sizeof(data));
+        memcpy(par, enc, sizeof(par));
+        for (uint32_t i = 0; i < k; i++) {
+            if ((have & (1UL << i)) == 0) {
+                memset(data[i], 0xA5, len);
+            }
+            dp[i] = data[i];
+        }
+        for (uint32_t j = 0; j < HALOW_FEC_M_MAX; j++) {
+            pp[j] = par[j];
+        }
+
+        rc = halow_fec_decode(dp, k, have, pp, par_have, len);
+        if (miss <= popcount(par_have)) {
+            CHECK_EQ(rc, miss);
+            for (uint32_t i = 0; i < k; i++) {
+                CHECK(memcmp(data[i], orig[i], len) == 0);
+            }
+        } else {
+            CHECK_EQ(rc, -1);
+        }
+    }
+}
+
+int main(void){
+    halow_fec_bench_t res[3];
+    uint32_t seed = 0x1234567U;
+    int32_t n;
+
+    halow_fec_init();
+
+    for (uint32_t k = 1; k <= HALOW_FEC_K_MAX; k++) {
+        for (uint32_t m = 1; m <= HALOW_FEC_M_MAX; m++) {
+            test_all_patterns(k, m, 1 + test_rand(&seed) % SYM_MAX, &seed);
+        }
+    }
+
+    /* More data symbols than the code supports */
+    {
+        uint8_t buf[SYM_MAX];
+        uint8_t *dp[HALOW_FEC_K_MAX + 1];
+        uint8_t *pp[HALOW_FEC_M_MAX];
+
+        for (uint32_t i = 0; i <= HALOW_FEC_K_MAX; i++) {
+            dp[i] = buf;
+        }
+        for (uint32_t j = 0; j < HALOW_FEC_M_MAX; j++) {
+            pp[j] = buf;
+        }
+        CHECK_EQ(halow_fec_decode(dp, 0, 0, pp, 0xF, 1), -1);
+        CHECK_EQ(halow_fec_decode(dp, HALOW_FEC_K_MAX + 1, 0x1FE, pp, 0xF, 1), -1);
+    }
+
+    n = halow_fec_bench(res, 3);
+    CHECK_EQ(n, 3);
+    for (int32_t i = 0; i < n; i++) {
+        CHECK(res[i].ok);
+        printf("bench k=%u m=%u len=%u: encode %u KiB/s, decode %u KiB/s\n",
+               (unsigned)res[i].k, (unsigned)res[i].m, (unsigned)res[i].sym_len,
+               (unsigned)res[i].enc_kbps, (unsigned)res[i].dec_kbps);
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "halow_ppdu.h"
+#include "test.h"
+
+static uint32_t dur(uint8_t mcs, uint8_t bw, halow_preamble_t pre, bool sgi, uint32_t len){
+    halow_ppdu_param_t p;
+
+    p.mcs       = mcs;
+    p.bandwidth = bw;
+    p.nss       = 1;
+    p.preamble  = pre;
+    p.short_gi  = sgi;
+    return halow_ppdu_duration_us(&p, len);
+}
+
+int main(void){
+    uint32_t prev = 0;
+
+    CHECK_EQ(halow_ppdu_duration_us(NULL, 100), 0);
+
+    /* 1 MHz MCS0: 560 us preamble, 814 bits over 12 bits/symbol = 68 symbols */
+    CHECK_EQ(dur(0, 1, HALOW_PREAMBLE_S1G_1M, false, 100), 560 + 68 * 40);
+
+    /* MCS10 repeats MCS0, 6 bits/symbol */
+    CHECK_EQ(dur(10, 1, HALOW_PREAMBLE_S1G_1M, false, 100), 560 + 136 * 40);
+
+    /* 2 MHz MCS7: 240 us short preamble, 260 bits/symbol, 8014 bits = 31 symbols */
+    CHECK_EQ(dur(7, 2, HALOW_PREAMBLE_S1G_SHORT, false, 1000), 240 + 31 * 40);
+    CHECK_EQ(dur(7, 2, HALOW_PREAMBLE_S1G_SHORT, true, 1000), 240 + 31 * 36);
+
+    /* Long preamble: STF 2 + LTF1 2 + SIG-A 2 + D-STF 1 + D-LTF 1 + SIG-B 1 */
+    CHECK_EQ(dur(7, 2, HALOW_PREAMBLE_S1G_LONG, false, 1000), 9 * 40 + 31 * 40);
+
+    /* 8 MHz MCS7: 120 * 234 / 24 = 1170 bits/symbol */
+    CHECK_EQ(dur(7, 8, HALOW_PREAMBLE_S1G_SHORT, false, 1500), 240 + 11 * 40);
+
+    /* Never shrinks with a longer PSDU, grows by one symbol at most per byte */
+    for (uint32_t len = 0; len < 2048; len++) {
+        uint32_t d = dur(3, 1, HALOW_PREAMBLE_S1G_1M, false, len);
+
+        CHECK(d >= prev);
+        CHECK((prev == 0) || (d - prev <= 40));
+        prev = d;
+    }
+
+    /* Faster MCS and wider bandwidth never take longer */
+    for (uint8_t mcs = 1; mcs <= 7; mcs++) {
+        CHECK(dur(mcs, 1, HALOW_PREAMBLE_S1G_1M, false, 512) <= dur(mcs - 1, 1, HALOW_PREAMBLE_S1G_1M, false, 512));
+        CHECK(dur(mcs, 4, HALOW_PREAMBLE_S1G_SHORT, false, 512) <= dur(mcs, 2, HALOW_PREAMBLE_S1G_SHORT, false, 512));
+    }
+
+    return TEST_RESULT();
+}
@@ -4,6 +4,7 @@ from __future__ import annotations
 import argparse
 import queue
 import signal
+import socket
 import struct
 import sys
 import threading
@@ -11,8 +12,6 @@ import time
 from dataclasses import dataclass
 from typing import Dict, List, Optional
 
-import kiss  # pip install pyham_kiss  (PyHam KISS)
-
 MAGIC_REQ = b"RTT0"   # request
 MAGIC_RSP = b"RTT1"   # response
 
@@ -43,6 +42,93 @@ def _percentile_sorted(xs_sorted: List[float], p: float) -> float:
     return xs_sorted[i] * (1.0 - frac) + xs_sorted[i + 1] * frac
 
 
+class KissLink:
+    """Modem TCP port, KISS framed (pip install pyham_kiss)."""
+
+    def __init__(self, host: str, port: int, rx_cb, kiss_port: int):
+        import kiss  # PyHam KISS, only needed for this transport
+
+        self.host = host
+        self.port = port
+        self.kiss_port = kiss_port
+        self._rx_cb = rx_cb
+        self._conn = kiss.Connection(self._on_frame)
+
+    def _on_frame(self, kport: int, data: bytearray):
+        # data is raw payload (already KISS-decoded)
+        self._rx_cb(bytes(data))
+
+    def connect(self):
+        self._conn.connect_to_server(self.host, int(self.port))
+
+    def send(self, data: bytes):
+        self._conn.send_data(data, port=self.kiss_port)
+
+    def close(self):
+        self._conn.disconnect_from_server()
+
+
+class UdpLink:
+    """Modem UDP port: one datagram per radio frame, optional u16 sequence header."""
+
+    KEEPALIVE_S = 10.0   # device forgets a silent peer after 60 s
+
+    def __init__(self, host: str, port: int, rx_cb, seq: bool):
+        self.addr = (host, int(port))
+        self.seq = seq
+        self._rx_cb = rx_cb
+        self._tx_seq = 0
+        self._rx_seq: Optional[int] = None
+        self.gaps = 0
+        self._stop = threading.Event()
+        self._sock: Optional[socket.socket] = None
+
+    def connect(self):
+        self._sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self._sock.bind(("", 0))
+        self._sock.settimeout(0.2)
+        # an empty datagram registers us as a listener without transmitting anything
+        self._sock.sendto(b"", self.addr)
+        threading.Thread(target=self._rx_loop, daemon=True).start()
+        threading.Thread(target=self._keepalive_loop, daemon=True).start()
+
+    def _rx_loop(self):
+        while not self._stop.is_set():
+            try:
+                data = self._sock.recv(65535)
+            except socket.timeout:
+                continue
+            except OSError:
+                break
+            if self.seq:
+                if len(data) < 2:
+                    continue
+                (s,) = struct.unpack(">H", data[:2])
+                if self._rx_seq is not None:
+                    self.gaps += (s - self._rx_seq - 1) & 0xFFFF
+                self._rx_seq = s
+                data = data[2:]
+            self._rx_cb(data)
+
+    def _keepalive_loop(self):
+        while not self._stop.wait(self.KEEPALIVE_S):
+            try:
+                self._sock.sendto(b"", self.addr)
+            except OSError:
+                break
+
+    def send(self, data: bytes):
+        if self.seq:
+            data = struct.pack(">H", self._tx_seq & 0xFFFF) + data
+            self._tx_seq += 1
+        self._sock.sendto(data, self.addr)
+
+    def close(self):
+        self._stop.set()
+        if self._sock is not None:
+            self._sock.close()
+
+
 @dataclass
 class Stats:
     sent: int = 0
@@ -60,48 +146,42 @@ class Stats:
 
 class RTTRunner:
     def __init__(self, a_host: str, a_port: int, b_host: str, b_port: int,
-                 rate: float, count: int, size: int, timeout_s: float, kiss_port: int):
-        self.a_host = a_host
-        self.a_port = a_port
-        self.b_host = b_host
-        self.b_port = b_port
+                 rate: float, count: int, size: int, timeout_s: float, kiss_port: int,
+                 transport: str = "kiss", udp_seq: bool = False):
         self.rate = rate
         self.count = count
         self.size = max(size, _HDR.size)
         self.timeout_s = timeout_s
-        self.kiss_port = kiss_port
+        self.transport = transport
 
         self._stop = threading.Event()
 
         self._a_rxq: "queue.Queue[bytes]" = queue.Queue()
         self._b_rxq: "queue.Queue[bytes]" = queue.Queue()
 
-        self._a = kiss.Connection(self._a_rx_cb)
-        self._b = kiss.Connection(self._b_rx_cb)
+        if transport == "udp":
+            self._a = UdpLink(a_host, a_port, self._a_rxq.put, udp_seq)
+            self._b = UdpLink(b_host, b_port, self._b_rxq.put, udp_seq)
+        else:
+            self._a = KissLink(a_host, a_port, self._a_rxq.put, kiss_port)
+            self._b = KissLink(b_host, b_port, self._b_rxq.put, kiss_port)
 
         self._pending: Dict[int, int] = {}  # seq -> t_send_ns
         self._pending_lock = threading.Lock()
 
         self.stats = Stats()
 
-    def _a_rx_cb(self, kport: int, data: bytearray):
-        # data is raw payload (already KISS-decoded)
-        self._a_rxq.put(bytes(data))
-
-    def _b_rx_cb(self, kport: int, data: bytearray):
-        self._b_rxq.put(bytes(data))
-
     def connect(self):
-        self._a.connect_to_server(self.a_host, int(self.a_port))
-        self._b.connect_to_server(self.b_host, int(self.b_port))
+        self._a.connect()
+        self._b.connect()
 
     def close(self):
         try:
-            self._a.disconnect_from_server()
+            self._a.close()
         except Exception:
             pass
         try:
-            self._b.disconnect_from_server()
+            self._b.close()
         except Exception:
             pass
 
@@ -140,7 +220,7 @@ class RTTRunner:
 
             rsp = self._mk_frame(MAGIC_RSP, seq, t0_ns)
             try:
-                self._b.send_data(rsp, port=self.kiss_port)
+                self._b.send(rsp)
                 self.stats.echoed += 1
             except Exception:
                 self.stats.bad += 1
@@ -195,7 +275,7 @@ class RTTRunner:
                 self._pending[seq] = t0
 
             try:
-                self._a.send_data(frame, port=self.kiss_port)
+                self._a.send(frame)
                 self.stats.sent += 1
             except Exception:
                 self.stats.bad += 1
@@ -292,11 +372,13 @@ class RTTRunner:
         print("\n--- final ---")
         print(f"sent={sent} recv={recv} loss={loss:.2f}% timeouts={self.stats.timeouts} bad={self.stats.bad}")
         print(f"rtt_ms avg={avg:.3f} p50={p50:.3f} p95={p95:.3f}")
+        if self.transport == "udp" and self._a.seq:
+            print(f"udp seq gaps: a={self._a.gaps} b={self._b.gaps}")
         return 0
 
 
 def main() -> int:
-    ap = argparse.ArgumentParser(description="KISS RTT tester (A->B echo->A), port 0 data frames")
+    ap = argparse.ArgumentParser(description="Modem RTT tester (A->B echo->A) over the KISS TCP or the UDP port")
     ap.add_argument("--a-host", required=True)
     ap.add_argument("--a-port", required=True, type=int)
     ap.add_argument("--b-host", required=True)
@@ -307,6 +389,10 @@ def main() -> int:
     ap.add_argument("--size", type=int, default=64, help="payload size in bytes incl header (default: 64)")
     ap.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for late replies (default: 2.0)")
     ap.add_argument("--kiss-port", type=int, default=0, help="KISS TNC port number (default: 0)")
+    ap.add_argument("--transport", choices=("kiss", "udp"), default="kiss",
+                    help="kiss: TCP modem port (8001), udp: UDP modem port (8002) (default: kiss)")
+    ap.add_argument("--udp-seq", action="store_true",
+                    help="UDP sequence number header, must match the device setting")
 
     args = ap.parse_args()
 
@@ -316,6 +402,7 @@ def main() -> int:
         rate=args.rate, count=args.count,
         size=args.size, timeout_s=args.timeout,
         kiss_port=args.kiss_port,
+        transport=args.transport, udp_seq=args.udp_seq,
     )
 
     def _sig(_signo, _frame):
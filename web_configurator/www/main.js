@@ -20,7 +20,9 @@
         halow: '',
         lbt: '',
         net: '',
-        tcp: ''
+        tcp: '',
+        udp: '',
+        l2: ''
     };
 
     function jsonSnapshot(obj) {
@@ -33,7 +35,12 @@
             central_freq: parseFloat(document.getElementById('halow_central_freq').value),
             mcs_index: document.getElementById('halow_mcs_index').value,
             bandwidth: document.getElementById('halow_bandwidth').value,
-            super_power: document.getElementById('halow_super_power').checked
+            super_power: document.getElementById('halow_super_power').checked,
+            agg_max: parseInt(document.getElementById('halow_agg_max').value, 10),
+            agg_hold_ms: parseInt(document.getElementById('halow_agg_hold_ms').value, 10),
+            fec_k: parseInt(document.getElementById('halow_fec_k').value, 10),
+            fec_m: parseInt(document.getElementById('halow_fec_m').value, 10),
+            fec_hold_ms: parseInt(document.getElementById('halow_fec_hold_ms').value, 10)
         };
     }
 
@@ -57,7 +64,27 @@
         return {
             enable: document.getElementById('tcp_enable').checked,
             port: parseInt(document.getElementById('tcp_port').value, 10),
-            whitelist: document.getElementById('tcp_whitelist').value
+            whitelist: document.getElementById('tcp_whitelist').value,
+            rx_meta: document.getElementById('tcp_rx_meta').checked,
+            slow_policy: document.getElementById('tcp_slow_policy').value
+        };
+    }
+
+    function readUdpForm() {
+        return {
+            enable: document.getElementById('udp_enable').checked,
+            port: parseInt(document.getElementById('udp_port').value, 10),
+            mcast: document.getElementById('udp_mcast').value.trim(),
+            mcast_port: parseInt(document.getElementById('udp_mcast_port').value, 10),
+            seq: document.getElementById('udp_seq').checked
+        };
+    }
+
+    function readL2Form() {
+        return {
+            enable: document.getElementById('l2_enable').checked,
+            bcast_pps: parseInt(document.getElementById('l2_bcast_pps').value, 10),
+            queue_ms: parseInt(document.getElementById('l2_queue_ms').value, 10)
         };
     }
 
@@ -68,6 +95,8 @@
         if (group === 'lbt')   { current = jsonSnapshot(readLbtForm());   btn = document.getElementById('save_lbt'); }
         if (group === 'net')   { current = jsonSnapshot(readNetForm());   btn = document.getElementById('save_net'); }
         if (group === 'tcp')   { current = jsonSnapshot(readTcpForm());   btn = document.getElementById('save_tcp'); }
+        if (group === 'udp')   { current = jsonSnapshot(readUdpForm());   btn = document.getElementById('save_udp'); }
+        if (group === 'l2')    { current = jsonSnapshot(readL2Form());    btn = document.getElementById('save_l2'); }
         if (!btn) return;
         btn.disabled = (current === baselines[group]);
     }
@@ -77,6 +106,8 @@
         if (group === 'lbt')   baselines.lbt   = jsonSnapshot(readLbtForm());
         if (group === 'net')   baselines.net   = jsonSnapshot(readNetForm());
         if (group === 'tcp')   baselines.tcp   = jsonSnapshot(readTcpForm());
+        if (group === 'udp')   baselines.udp   = jsonSnapshot(readUdpForm());
+        if (group === 'l2')    baselines.l2    = jsonSnapshot(readL2Form());
         updateSaveButton(group);
     }
 
@@ -85,14 +116,18 @@
         snapshotGroup('lbt');
         snapshotGroup('net');
         snapshotGroup('tcp');
+        snapshotGroup('udp');
+        snapshotGroup('l2');
     }
 
     function setupDirtyTracking() {
         const map = [
-            { group: 'halow', btn: 'save_halow', ids: ['halow_power_dbm','halow_central_freq','halow_mcs_index','halow_bandwidth','halow_super_power'] },
+            { group: 'halow', btn: 'save_halow', ids: ['halow_power_dbm','halow_central_freq','halow_mcs_index','halow_bandwidth','halow_super_power','halow_agg_max','halow_agg_hold_ms','halow_fec_k','halow_fec_m','halow_fec_hold_ms'] },
             { group: 'lbt',   btn: 'save_lbt',   ids: ['lbt_uen','lbt_umax'] },
             { group: 'net',   btn: 'save_net',   ids: ['net_dhcp','net_ip_address','net_gw_address','net_netmask'] },
-            { group: 'tcp',   btn: 'save_tcp',   ids: ['tcp_enable','tcp_port','tcp_whitelist'] }
+            { group: 'tcp',   btn: 'save_tcp',   ids: ['tcp_enable','tcp_port','tcp_whitelist','tcp_rx_meta','tcp_slow_policy'] },
+            { group: 'udp',   btn: 'save_udp',   ids: ['udp_enable','udp_port','udp_mcast','udp_mcast_port','udp_seq'] },
+            { group: 'l2',    btn: 'save_l2',    ids: ['l2_enable','l2_bcast_pps','l2_queue_ms'] }
         ];
 
         map.forEach(m => {
@@ -134,9 +169,9 @@
         setupDirtyTracking();
         // Load all configuration on startup.
         loadAllUntilSuccess();
-        // Kick off periodic statistic updates.
+        // Full statistics once, then live deltas pushed by the device.
         updateStats();
-        setInterval(updateStats, 1000);
+        startStatStream();
     });
 
     /**
@@ -184,6 +219,11 @@
         // TCP Bridge
         document.getElementById('tcp_enable').addEventListener('change', updateTcpDisabled);
         document.getElementById('save_tcp').addEventListener('click', saveTcp);
+        // UDP Bridge
+        document.getElementById('udp_enable').addEventListener('change', updateUdpDisabled);
+        document.getElementById('save_udp').addEventListener('click', saveUdp);
+        // Ethernet bridge
+        document.getElementById('save_l2').addEventListener('click', saveL2);
 		
 		document.getElementById('stat_reset_btn').addEventListener('click', resetStats);
         // Firmware Update
@@ -251,6 +291,13 @@
         });
     }
 
+    function updateUdpDisabled() {
+        const enabled = document.getElementById('udp_enable').checked;
+        document.getElementById('udp_fields').querySelectorAll('input').forEach(el => {
+            el.disabled = !enabled;
+        });
+    }
+
 	async function resetStats() {
 		try {
 			await fetch('/api/reset_stat', {
@@ -327,6 +374,71 @@
 			// ignore
 		}
 	}
+    const STAT_STREAM_HZ = 5;
+    let statPollTimer = null;
+
+    function fmtBytes(b) {
+        const k = b / 1024;
+        if (k < 1024) return k.toFixed(2) + ' KiB';
+        if (k < 1024 * 1024) return (k / 1024).toFixed(2) + ' MiB';
+        return (k / (1024 * 1024)).toFixed(2) + ' GiB';
+    }
+
+    function fmtUptime(s) {
+        const d = Math.floor(s / 86400);
+        const h = Math.floor(s / 3600) % 24;
+        const m = Math.floor(s / 60) % 60;
+        let out = '';
+        if (d) out += d + 'd ';
+        if (d || h) out += h + 'h ';
+        if (d || h || m) out += m + 'm ';
+        return out + (s % 60) + 's';
+    }
+
+    /**
+     * Subscribe to `/api/stat_stream` (server-sent events).  Each event
+     * carries only the fields that changed, so they are merged into
+     * `live` before rendering.  Falls back to 1 s polling of
+     * `/api/get_stat` when the stream is not available.
+     */
+    function startStatStream() {
+        if (!window.EventSource) {
+            statPollTimer = setInterval(updateStats, 1000);
+            return;
+        }
+
+        const live = {};
+        const es = new EventSource('/api/stat_stream?hz=' + STAT_STREAM_HZ);
+        let opened = false;
+
+        es.onopen = () => {
+            opened = true;
+            if (statPollTimer) { clearInterval(statPollTimer); statPollTimer = null; }
+        };
+        es.onmessage = (ev) => {
+            let d;
+            try { d = JSON.parse(ev.data); } catch (e) { return; }
+            Object.assign(live, d);
+
+            if ('up' in d)  setText('stat_uptime', fmtUptime(live.up));
+            if ('rxb' in d) setText('stat_rx_bytes', fmtBytes(live.rxb));
+            if ('txb' in d) setText('stat_tx_bytes', fmtBytes(live.txb));
+            if ('rxp' in d) setText('stat_rx_packets', live.rxp);
+            if ('txp' in d) setText('stat_tx_packets', live.txp);
+            if ('rxr' in d) setText('stat_rx_speed', (live.rxr / 1000).toFixed(2) + ' kbit/s');
+            if ('txr' in d) setText('stat_tx_speed', (live.txr / 1000).toFixed(2) + ' kbit/s');
+            if ('at' in d)  setText('stat_airtime', (live.at / 10).toFixed(1) + ' %');
+            if ('cu' in d)  setText('stat_ch_util', (live.cu / 10).toFixed(1) + ' %');
+            if ('ns' in d)  setText('stat_bg_pwr_now_dbm', live.ns.toFixed(1) + ' dBm');
+            if ('nl' in d)  setText('stat_bg_pwr_dbm', live.nl.toFixed(1) + ' dBm');
+        };
+        es.onerror = () => {
+            // EventSource reconnects by itself; poll meanwhile, or for good if it never opened.
+            if (!opened) { es.close(); }
+            if (!statPollTimer) { statPollTimer = setInterval(updateStats, 1000); }
+        };
+    }
+
     /**
      * Helper to set the text content of an element if the value is
      * defined; otherwise leave the element unchanged.  Undefined or
@@ -362,6 +474,11 @@
 		setSelect('halow_mcs_index', halow.mcs_index);
 		setSelect('halow_bandwidth', halow.bandwidth);
 		setCheckbox('halow_super_power', halow.super_power);
+		setInput('halow_agg_max', halow.agg_max);
+		setInput('halow_agg_hold_ms', halow.agg_hold_ms);
+		setInput('halow_fec_k', halow.fec_k);
+		setInput('halow_fec_m', halow.fec_m);
+		setInput('halow_fec_hold_ms', halow.fec_hold_ms);
 		updateBandwidthDisabled();
 
 		// LBT settings
@@ -383,9 +500,35 @@
 		setCheckbox('tcp_enable', tcp.enable);
 		setInput('tcp_port', tcp.port);
 		setInput('tcp_whitelist', tcp.whitelist);
+		setCheckbox('tcp_rx_meta', tcp.rx_meta);
+		setSelect('tcp_slow_policy', tcp.slow_policy);
 		setText('tcp_client', tcp.connected);
 		updateTcpDisabled();
 
+		// UDP bridge
+		const udp = pick(state?.udp, state?.api_udp_server_cfg, state?.udp_server_cfg);
+		setCheckbox('udp_enable', udp.enable);
+		setInput('udp_port', udp.port);
+		setInput('udp_mcast', udp.mcast);
+		setInput('udp_mcast_port', udp.mcast_port);
+		setCheckbox('udp_seq', udp.seq);
+		setText('udp_peers', (Array.isArray(udp.peers) && udp.peers.length)
+			? udp.peers.map(p => `${p.ip}:${p.port}`).join(', ')
+			: 'none');
+		updateUdpDisabled();
+
+		// Ethernet bridge
+		const l2 = pick(state?.bridge, state?.api_bridge_cfg, state?.bridge_cfg);
+		setCheckbox('l2_enable', l2.enable);
+		setInput('l2_bcast_pps', l2.bcast_pps);
+		setInput('l2_queue_ms', l2.queue_ms);
+		setText('l2_state', (l2.enable === l2.active)
+			? (l2.active ? 'active' : 'off')
+			: 'reboot to apply');
+		setText('l2_iperf', l2.iperf
+			? `${l2.iperf.remote}: ${(l2.iperf.kbps / 1000).toFixed(2)} Mbit/s, ${l2.iperf.ms} ms${l2.iperf.ok ? '' : ' (aborted)'}`
+			: 'none');
+
 		// Firmware update (versions list)
 		const ota = pick(state?.ota, state?.api_online_ota, state?.online_ota);
 		if (ota.versions && Array.isArray(ota.versions)) {
@@ -456,7 +599,12 @@
             central_freq: parseFloat(document.getElementById('halow_central_freq').value),
             mcs_index: document.getElementById('halow_mcs_index').value,
             bandwidth: document.getElementById('halow_bandwidth').value,
-            super_power: document.getElementById('halow_super_power').checked
+            super_power: document.getElementById('halow_super_power').checked,
+            agg_max: parseInt(document.getElementById('halow_agg_max').value, 10),
+            agg_hold_ms: parseInt(document.getElementById('halow_agg_hold_ms').value, 10),
+            fec_k: parseInt(document.getElementById('halow_fec_k').value, 10),
+            fec_m: parseInt(document.getElementById('halow_fec_m').value, 10),
+            fec_hold_ms: parseInt(document.getElementById('halow_fec_hold_ms').value, 10)
         };
         try {
             await fetch('/api/halow_cfg', {
@@ -523,7 +671,9 @@
         const payload = {
             enable: document.getElementById('tcp_enable').checked,
             port: parseInt(document.getElementById('tcp_port').value, 10),
-            whitelist: document.getElementById('tcp_whitelist').value
+            whitelist: document.getElementById('tcp_whitelist').value,
+            rx_meta: document.getElementById('tcp_rx_meta').checked,
+            slow_policy: document.getElementById('tcp_slow_policy').value
         };
         try {
             await fetch('/api/tcp_server_cfg', {
@@ -537,6 +687,40 @@
         loadAllUntilSuccess();
     }
 
+    /**
+     * Gather the UDP bridge settings and POST them.  After saving the
+     * configuration is refreshed.
+     */
+    async function saveUdp() {
+        try {
+            await fetch('/api/udp_server_cfg', {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify(readUdpForm())
+            });
+        } catch (err) {
+            console.error('saveUdp error', err);
+        }
+        loadAllUntilSuccess();
+    }
+
+    /**
+     * Gather the Ethernet bridge settings and POST them.  The mode switch
+     * takes effect after a reboot, the limits at once.
+     */
+    async function saveL2() {
+        try {
+            await fetch('/api/bridge_cfg', {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify(readL2Form())
+            });
+        } catch (err) {
+            console.error('saveL2 error', err);
+        }
+        loadAllUntilSuccess();
+    }
+
 
 
 	function updateFwDisabled() {
@@ -544,15 +728,6 @@
 		document.getElementById('fw_flash').disabled = !(f && f.length === 1);
 	}
 
-	function bytesToB64( u8 ){
-		let s = '';
-		const chunk = 0x8000;
-		for (let i = 0; i < u8.length; i += chunk){
-			s += String.fromCharCode.apply(null, u8.subarray(i, i + chunk));
-		}
-		return btoa(s);
-	}
-
 	// CRC32 (чтобы послать crc32 в begin/end). Если ты уже считаешь crc на девайсе — можно выкинуть.
 	function crc32_make_table(){
 		const t = new Uint32Array(256);
@@ -575,6 +750,35 @@
 		return (c ^ 0xFFFFFFFF) >>> 0;
 	}
 
+	// Length and CRC32 of the fw.bin member of a tar, null if there is none
+	function tarFindFw( u8 ){
+		const dec = new TextDecoder();
+		let off = 0;
+
+		function field( o, n ){
+			let e = o;
+			while (e < o + n && u8[e] !== 0) { e++; }
+			return dec.decode(u8.subarray(o, e));
+		}
+
+		while (off + 512 <= u8.length && u8[off] !== 0) {
+			let name = field(off, 100);
+			const size = parseInt(field(off + 124, 12).trim(), 8) || 0;
+			const type = u8[off + 156];
+			if (field(off + 257, 5) === 'ustar' && u8[off + 345] !== 0) {
+				name = field(off + 345, 155) + '/' + name;
+			}
+			name = name.replace(/^(\.?\/)+/, '');
+
+			off += 512;
+			if (name === 'fw.bin' && (type === 0x30 || type === 0)) {
+				return { size: size, crc: crc32_update(0, u8.subarray(off, off + size)) };
+			}
+			off += Math.ceil(size / 512) * 512;
+		}
+		return null;
+	}
+
 	function sleepMs( ms ){
 	return new Promise(r => setTimeout(r, ms));
 }
@@ -648,10 +852,36 @@ async function fwFlash() {
 	btn.disabled = true;
 	consoleEl.innerHTML = '';
 
-	const chunkSize = 512;
+	const chunkSize = 64 * 1024;
 	const tries = 6;
 	const baseDelayMs = 80;
 
+	async function putRange( u8, from, to, crc, fw ){
+		const headers = {
+			'Content-Type': 'application/octet-stream',
+			'Content-Range': 'bytes ' + from + '-' + (to - 1) + '/' + u8.length
+		};
+		if (from === 0) {
+			headers['X-OTA-CRC32'] = crc.toString(16);
+			if (fw) { headers['X-OTA-FW'] = fw.size + ' ' + fw.crc.toString(16); }
+		}
+
+		const r = await fetch('/api/ota_upload', {
+			method: 'PUT',
+			headers: headers,
+			body: u8.subarray(from, to)
+		});
+		const j = await r.json().catch(() => ({}));
+		if (!r.ok && r.status !== 416) { throw new Error('HTTP ' + r.status); }
+		return j;
+	}
+
+	async function deviceOffset(){
+		const r = await fetchJsonRetry('/api/ota_status', { method: 'GET' }, tries, baseDelayMs);
+		const j = await r.json();
+		return j.active ? (j.written >>> 0) : 0;
+	}
+
 	try {
 
 		stage('Reading file: ' + file.name);
@@ -663,43 +893,48 @@ async function fwFlash() {
 		const fileCrc32 = (crc32_update(0 >>> 0, fileU8) >>> 0);
 		ok('CRC32 = 0x' + fileCrc32.toString(16));
 
-		stage('Starting OTA session...');
-		await mkPost('/api/ota_begin', {
-			size: fileU8.length,
-			crc32: fileCrc32
-		});
-		ok('ota_begin accepted');
+		const fw = tarFindFw(fileU8);
+		if (fw) { ok('fw.bin ' + fw.size + ' bytes, CRC32 = 0x' + fw.crc.toString(16)); }
 
-		// ===== Upload with single progress line =====
-		stage('Uploading firmware...');
-		const progressLine = log('    0%');
+		// ===== Binary upload, resumes from the device offset on failure =====
+		// With fw.bin the device takes the tar twice: verify, then program
+		stage(fw ? 'Uploading for verification...' : 'Uploading...');
+		let progressLine = log('    0%');
 
 		let offset = 0;
-		while (offset < fileU8.length) {
+		let done = false;
+		let program = false;
+		let fails = 0;
+		while (!done) {
 			const nextOffset = Math.min(offset + chunkSize, fileU8.length);
-			const chunkBin   = fileU8.subarray(offset, nextOffset);
-			const chunkB64   = bytesToB64(chunkBin);
-
-			await mkPost('/api/ota_chunk', {
-				off: offset,
-				b64: chunkB64
-			});
-
-			offset = nextOffset;
+			try {
+				const j = await putRange(fileU8, offset, nextOffset, fileCrc32, fw);
+				if (j.size !== fileU8.length) { throw new Error(j.error || 'session lost'); }
+				offset = j.written >>> 0;
+				done = !!j.done;
+				if (j.program && !program) {
+					program = true;
+					progressLine.textContent = '[OK] Device CRC verification OK';
+					stage('Uploading again to write firmware to flash...');
+					progressLine = log('    0%');
+				}
+				fails = 0;
+			} catch (e) {
+				if (++fails >= tries) { throw e; }
+				await sleepMs(baseDelayMs * (1 << fails));
+				offset = await deviceOffset();
+			}
 
 			const percent = Math.floor((offset * 100) / fileU8.length);
 			progressLine.textContent = '    ' + percent + '%';
 		}
 
 		progressLine.textContent = '[OK] Upload complete';
+		ok(fw ? 'Flash write + verify OK' : 'Device CRC verification OK');
 
-		stage('Verifying file on device...');
-		await mkPost('/api/ota_end', { crc32: fileCrc32 });
-		ok('Device CRC verification OK');
-
-		stage('Writing firmware to flash...');
+		stage('Applying update...');
 		await mkPost('/api/ota_write', {});
-		ok('Flash write + verify OK');
+		ok('Update applied');
 
 		stage('OTA finished. Device may reboot.');
 